@@ -93,7 +93,7 @@ def print_database_summary(conn: kuzu.Connection):
     
     print("\n=== Sample ASTNode entries ===")
     try:
-        sample_nodes = query_to_list(conn, "MATCH (n:ASTNode) RETURN n.node_type as node_type, n.source_file as source_file, n.start_line as start_line LIMIT 10")
+        sample_nodes = query_to_list(conn, "MATCH (n:ASTNode), (f:SourceFile) WHERE n.file_id = f.file_id RETURN n.node_type as node_type, f.path as source_file, n.start_line as start_line LIMIT 10")
         for node in sample_nodes:
             print(f"  {node['node_type']} in {node['source_file']}:{node['start_line']}")
     except Exception as e:
@@ -27,7 +27,7 @@ def verify_ast_nodes(conn: kuzu.Connection) -> VerificationResult:
         
         # Verify required fields exist
         missing_fields = verify_required_fields(conn, [
-            "node_id", "node_type", "source_file", 
+            "node_id", "node_type", "file_id", 
             "start_line", "start_column", "end_line", "end_column"
         ])
         if missing_fields:
@@ -154,7 +154,7 @@ def validate_source_files(conn: kuzu.Connection, expected_files: list[str]) -> d
     
     # Get all source files
     source_files = query_to_list(conn,
-        "MATCH (n:ASTNode) RETURN DISTINCT n.source_file as file"
+        "MATCH (n:ASTNode), (f:SourceFile) WHERE n.file_id = f.file_id RETURN DISTINCT f.path as file"
     )
     
     found_files = [row["file"] for row in source_files]
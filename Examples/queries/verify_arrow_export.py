@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""
+Round-trip check of the Arrow IPC export
+
+Indexes the same compilation database twice, once into a Kuzu database and once
+with --export-arrow, then opens every exported file with pyarrow and compares it
+with the database, table by table: the schema, the row count and every value.
+Node IDs are assigned in traversal order, so both runs produce the same rows.
+"""
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+from collections import Counter
+from pathlib import Path
+from typing import Dict, List, Optional
+
+import pyarrow as pa
+import pyarrow.ipc
+
+# Add current directory to Python path
+current_dir = Path(__file__).parent.absolute()
+sys.path.insert(0, str(current_dir))
+
+from database_operations import (get_project_paths, fix_compilation_database_paths,
+                                 connect_to_database, run_dosatsu)
+
+
+def run_arrow_export(dosatsu_path: Path, compile_commands: Path, scratch_db: str, arrow_dir: str):
+    """Run Dosatsu with --export-arrow; the database path is required but left empty"""
+    project_root = dosatsu_path.parent.parent.parent.parent.absolute()
+    fixed_compile_db_path = fix_compilation_database_paths(compile_commands, project_root)
+    try:
+        cmd = [
+            str(dosatsu_path),
+            fixed_compile_db_path,
+            "--output-db", scratch_db,
+            f"--export-arrow={arrow_dir}"
+        ]
+        result = subprocess.run(cmd, capture_output=True, text=True, cwd=str(project_root), timeout=300)
+        if result.returncode != 0:
+            print(f"Dosatsu stdout: {result.stdout}")
+            print(f"Dosatsu stderr: {result.stderr}")
+            raise RuntimeError(f"Dosatsu --export-arrow failed with return code {result.returncode}")
+    finally:
+        os.unlink(fixed_compile_db_path)
+
+
+def read_arrow_file(path: Path) -> pa.Table:
+    """Read every record batch of an Arrow IPC file through its footer"""
+    with pa.memory_map(str(path), "r") as source:
+        reader = pyarrow.ipc.open_file(source)
+        return reader.read_all()
+
+
+def query_rows(conn, query: str) -> List[tuple]:
+    """Run a query and return all rows as tuples"""
+    result = conn.execute(query)
+    rows = []
+    while result.has_next():
+        rows.append(tuple(result.get_next()))
+    return rows
+
+
+def get_kuzu_tables(conn) -> Dict[str, str]:
+    """Map every table of the database to its type, NODE or REL"""
+    result = conn.execute("CALL show_tables() RETURN *")
+    columns = result.get_column_names()
+    name_index, type_index = columns.index("name"), columns.index("type")
+    tables = {}
+    while result.has_next():
+        row = result.get_next()
+        tables[row[name_index]] = row[type_index]
+    return tables
+
+
+def get_primary_keys(conn, relationship: str) -> tuple:
+    """Primary key columns of the source and destination tables of a relationship table"""
+    result = conn.execute(f"CALL show_connection('{relationship}') RETURN *")
+    columns = result.get_column_names()
+    row = result.get_next()
+    return (row[columns.index("source table primary key")],
+            row[columns.index("destination table primary key")])
+
+
+def compare_table(conn, name: str, table_type: str, arrow_table: Optional[pa.Table]) -> List[str]:
+    """Compare one table of the database with its Arrow file
+    Returns the differences found; rows are compared as multisets since the order is not defined."""
+    errors = []
+    if table_type == "REL":
+        from_key, to_key = get_primary_keys(conn, name)
+        properties = arrow_table.column_names[2:] if arrow_table is not None else []
+        returned = [f"a.{from_key}", f"b.{to_key}"] + [f"r.{column}" for column in properties]
+        query = f"MATCH (a)-[r:{name}]->(b) RETURN {', '.join(returned)}"
+    else:
+        if arrow_table is None:
+            count = query_rows(conn, f"MATCH (n:{name}) RETURN count(n)")[0][0]
+            return [f"{name}: {count} rows in the database but no Arrow file"] if count else []
+        query = f"MATCH (n:{name}) RETURN {', '.join(f'n.{column}' for column in arrow_table.column_names)}"
+
+    database_rows = query_rows(conn, query)
+    if arrow_table is None:
+        return [f"{name}: {len(database_rows)} rows in the database but no Arrow file"] if database_rows else []
+
+    if table_type == "REL" and arrow_table.column_names[:2] != ["from", "to"]:
+        errors.append(f"{name}: relationship file starts with {arrow_table.column_names[:2]}, not from and to")
+    if len(database_rows) != arrow_table.num_rows:
+        errors.append(f"{name}: {len(database_rows)} rows in the database, {arrow_table.num_rows} in the Arrow file")
+
+    arrow_rows = Counter(tuple(row.values()) for row in arrow_table.to_pylist())
+    missing = Counter(database_rows) - arrow_rows
+    extra = arrow_rows - Counter(database_rows)
+    for label, rows in (("only in the database", missing), ("only in the Arrow file", extra)):
+        if rows:
+            sample = next(iter(rows))
+            errors.append(f"{name}: {sum(rows.values())} rows {label}, e.g. {sample}")
+    return errors
+
+
+def verify_arrow_export(conn, arrow_dir: Path) -> List[str]:
+    """Compare every table of the database with the exported files"""
+    errors = []
+    tables = get_kuzu_tables(conn)
+    for path in sorted(arrow_dir.glob("*.arrow")):
+        if path.stem not in tables:
+            errors.append(f"{path.name}: no such table in the database")
+    for name, table_type in sorted(tables.items()):
+        path = arrow_dir / f"{name}.arrow"
+        try:
+            arrow_table = read_arrow_file(path) if path.exists() else None
+        except pa.ArrowInvalid as e:
+            errors.append(f"{path.name}: not a valid Arrow IPC file: {e}")
+            continue
+        errors.extend(compare_table(conn, name, table_type, arrow_table))
+    return errors
+
+
+def main():
+    project_root, dosatsu_path, _ = get_project_paths()
+    compile_commands = Path(os.environ.get(
+        'DOSATSU_COMPILE_DB', project_root / "artifacts" / "examples" / "simple_cmake_compile_commands.json"))
+
+    temp_dir = tempfile.mkdtemp(prefix="dosatsu_arrow_")
+    db = conn = None
+    try:
+        db_path = os.path.join(temp_dir, "db")
+        arrow_dir = Path(temp_dir) / "arrow"
+        run_dosatsu(dosatsu_path, compile_commands, db_path)
+        run_arrow_export(dosatsu_path, compile_commands, os.path.join(temp_dir, "scratch_db"), str(arrow_dir))
+
+        db, conn = connect_to_database(db_path)
+        errors = verify_arrow_export(conn, arrow_dir)
+        file_count = len(list(arrow_dir.glob("*.arrow")))
+        if errors:
+            print(f"Arrow export: {len(errors)} differences across {file_count} files")
+            for error in errors:
+                print(f"  Error: {error}")
+            return 1
+        print(f"Arrow export: {file_count} files match the database")
+        return 0
+    finally:
+        if conn:
+            conn.close()
+        if db:
+            db.close()
+        shutil.rmtree(temp_dir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
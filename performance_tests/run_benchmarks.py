@@ -0,0 +1,439 @@
+#!/usr/bin/env python3
+"""
+Indexing throughput benchmarks for Dosatsu with baseline regression gating.
+
+Corpora:
+    examples   - every program under Examples/cpp, one translation unit each
+    synthetic  - generated translation units sharing a set of generated headers
+    project    - a pinned release of {fmt} (library and tests), or any project
+                 given with --project-compile-commands
+
+For every corpus the indexer runs with --stats=json into a fresh database and
+reports TUs/s, nodes/s, edges/s, peak RSS and final database size.
+Results can be written as JSON and compared against a stored baseline; the
+script exits with 1 when any metric is worse than the baseline by more than
+the tolerance.
+
+Usage:
+    python run_benchmarks.py [--corpus examples synthetic project]
+                             [--output results.json]
+                             [--baseline benchmark_baseline.json [--update-baseline]]
+"""
+
+import argparse
+import json
+import os
+import platform
+import random
+import shutil
+import statistics
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+PROJECT_NAME = "fmt"
+PROJECT_URL = "https://github.com/fmtlib/fmt.git"
+PROJECT_TAG = "10.2.1"
+
+# Metric name -> True if higher is better
+METRICS = {
+    "tus_per_s": True,
+    "nodes_per_s": True,
+    "edges_per_s": True,
+    "peak_rss_mb": False,
+    "db_size_mb": False,
+}
+
+
+def get_project_root():
+    """Get the project root directory."""
+    return Path(__file__).resolve().parent.parent
+
+
+def get_benchmark_dir():
+    """Get the directory holding generated corpora and benchmark databases."""
+    return get_project_root() / "artifacts" / "benchmarks"
+
+
+def find_dosatsu(explicit_path):
+    """Locate the dosatsu_cpp executable, preferring release builds."""
+    if explicit_path:
+        return Path(explicit_path) if Path(explicit_path).exists() else None
+    for build_type in ("release", "debug"):
+        for name in ("dosatsu_cpp.exe", "dosatsu_cpp"):
+            candidate = get_project_root() / "artifacts" / build_type / "bin" / name
+            if candidate.exists():
+                return candidate
+    return None
+
+
+def write_compile_commands(output_file, sources, flags, directory):
+    """Write a compile_commands.json compiling every source with the same flags."""
+    commands = [
+        {
+            "directory": str(directory),
+            "arguments": ["clang++", *flags, "-c", str(source)],
+            "file": str(source),
+        }
+        for source in sources
+    ]
+    output_file.parent.mkdir(parents=True, exist_ok=True)
+    with open(output_file, "w") as f:
+        json.dump(commands, f, indent=2)
+    return output_file
+
+
+def prepare_examples_corpus(_args):
+    """Build the compilation database for the Examples/cpp programs."""
+    examples_dir = get_project_root() / "Examples" / "cpp"
+    sources = sorted(examples_dir.glob("*/*.cpp"))
+    output = get_benchmark_dir() / "examples" / "compile_commands.json"
+    return write_compile_commands(output, sources, ["-std=c++17", "-DEXAMPLE_MODE"], get_project_root())
+
+
+def generate_header(index, rng):
+    """Generate one shared header of the synthetic corpus."""
+    lines = ["#pragma once", f"namespace synthetic_{index} {{"]
+    lines.append(f"enum class Kind{index} {{ {', '.join(f'Value{i}' for i in range(rng.randint(3, 8)))} }};")
+    lines.append(f"template <typename T> struct Box{index} {{")
+    lines.append("    T value;")
+    lines.append("    auto get() const -> const T& { return value; }")
+    lines.append("    void set(const T& v) { value = v; }")
+    lines.append("};")
+    for k in range(rng.randint(2, 5)):
+        lines.append(f"/// Base class {k} of header {index}")
+        lines.append(f"class Base{index}_{k} {{")
+        lines.append("public:")
+        lines.append(f"    virtual ~Base{index}_{k}() = default;")
+        lines.append(f"    virtual auto compute(int x) const -> int {{ return x * {k + 1}; }}")
+        lines.append("protected:")
+        lines.append(f"    int state{k} = {k};")
+        lines.append("};")
+    for f in range(rng.randint(3, 8)):
+        lines.append(f"inline auto helper{index}_{f}(int a, int b) -> int")
+        lines.append("{")
+        lines.append(f"    return a > b ? a - b + {f} : b - a + {f};")
+        lines.append("}")
+    lines.append(f"}}  // namespace synthetic_{index}")
+    return "\n".join(lines) + "\n"
+
+
+def generate_source(index, headers, rng):
+    """Generate one translation unit of the synthetic corpus."""
+    lines = [f'#include "header_{h}.h"' for h in headers]
+    lines.append(f"namespace unit_{index} {{")
+    for h in headers:
+        lines.append(f"class Derived{h} : public synthetic_{h}::Base{h}_0 {{")
+        lines.append("public:")
+        lines.append(f"    auto compute(int x) const -> int override {{ return x + state0 + {index}; }}")
+        lines.append("};")
+    for f in range(rng.randint(5, 15)):
+        h = rng.choice(headers)
+        lines.append(f"// Function {f} of unit {index}")
+        lines.append(f"auto function{f}(int n) -> int")
+        lines.append("{")
+        lines.append(f"    synthetic_{h}::Box{h}<int> box{{n}};")
+        lines.append("    int total = 0;")
+        lines.append("    for (int i = 0; i < n; ++i)")
+        lines.append("    {")
+        lines.append(f"        if (i % {rng.randint(2, 7)} == 0)")
+        lines.append(f"            total += synthetic_{h}::helper{h}_0(i, box.get());")
+        lines.append("        else")
+        lines.append("            total -= i;")
+        lines.append("    }")
+        lines.append("    switch (total % 3)")
+        lines.append("    {")
+        lines.append("    case 0: return total;")
+        lines.append("    case 1: return -total;")
+        lines.append("    default: break;")
+        lines.append("    }")
+        lines.append(f"    Derived{h} derived;")
+        lines.append("    return derived.compute(total);")
+        lines.append("}")
+    lines.append(f"}}  // namespace unit_{index}")
+    return "\n".join(lines) + "\n"
+
+
+def prepare_synthetic_corpus(args):
+    """Generate the synthetic corpus; identical for the same size and seed."""
+    corpus_dir = get_benchmark_dir() / f"synthetic_{args.synthetic_tus}_{args.seed}"
+    output = corpus_dir / "compile_commands.json"
+    if output.exists():
+        return output
+
+    rng = random.Random(args.seed)
+    header_count = max(1, args.synthetic_tus // 5)
+    corpus_dir.mkdir(parents=True, exist_ok=True)
+    for h in range(header_count):
+        (corpus_dir / f"header_{h}.h").write_text(generate_header(h, rng))
+
+    sources = []
+    for i in range(args.synthetic_tus):
+        headers = sorted(rng.sample(range(header_count), min(3, header_count)))
+        source = corpus_dir / f"unit_{i}.cpp"
+        source.write_text(generate_source(i, headers, rng))
+        sources.append(source)
+
+    return write_compile_commands(output, sources, ["-std=c++17", f"-I{corpus_dir}"], corpus_dir)
+
+
+def prepare_project_corpus(args):
+    """Fetch and configure the pinned project, or use the given compilation database."""
+    if args.project_compile_commands:
+        return Path(args.project_compile_commands).resolve()
+
+    project_dir = get_benchmark_dir() / f"{PROJECT_NAME}-{PROJECT_TAG}"
+    build_dir = project_dir / "build"
+    output = build_dir / "compile_commands.json"
+    if output.exists():
+        return output
+
+    if not project_dir.exists():
+        print(f"Fetching {PROJECT_NAME} {PROJECT_TAG}...")
+        subprocess.run(
+            ["git", "clone", "--depth", "1", "--branch", PROJECT_TAG, PROJECT_URL, str(project_dir)], check=True
+        )
+
+    # Visual Studio generators cannot export compilation databases
+    configure_cmd = ["cmake", "-S", str(project_dir), "-B", str(build_dir), "-DCMAKE_EXPORT_COMPILE_COMMANDS=ON",
+                     "-DFMT_TEST=ON", "-DFMT_DOC=OFF"]
+    if shutil.which("ninja"):
+        configure_cmd += ["-G", "Ninja"]
+    subprocess.run(configure_cmd, check=True)
+    return output
+
+
+CORPORA = {
+    "examples": prepare_examples_corpus,
+    "synthetic": prepare_synthetic_corpus,
+    "project": prepare_project_corpus,
+}
+
+
+def get_windows_peak_rss(process):
+    """Peak working set of an exited process, read through its still open handle."""
+    import ctypes
+    from ctypes import wintypes
+
+    class ProcessMemoryCounters(ctypes.Structure):
+        _fields_ = [
+            ("cb", wintypes.DWORD),
+            ("PageFaultCount", wintypes.DWORD),
+            ("PeakWorkingSetSize", ctypes.c_size_t),
+            ("WorkingSetSize", ctypes.c_size_t),
+            ("QuotaPeakPagedPoolUsage", ctypes.c_size_t),
+            ("QuotaPagedPoolUsage", ctypes.c_size_t),
+            ("QuotaPeakNonPagedPoolUsage", ctypes.c_size_t),
+            ("QuotaNonPagedPoolUsage", ctypes.c_size_t),
+            ("PagefileUsage", ctypes.c_size_t),
+            ("PeakPagefileUsage", ctypes.c_size_t),
+        ]
+
+    counters = ProcessMemoryCounters()
+    counters.cb = ctypes.sizeof(counters)
+    if not ctypes.windll.psapi.GetProcessMemoryInfo(int(process._handle), ctypes.byref(counters), counters.cb):
+        return None
+    return counters.PeakWorkingSetSize
+
+
+def run_measured(cmd, log_path):
+    """Run a command with output to a log file; returns (exit code, seconds, peak RSS bytes)."""
+    with open(log_path, "w") as log:
+        start = time.perf_counter()
+        process = subprocess.Popen(cmd, cwd=get_project_root(), stdout=log, stderr=subprocess.STDOUT)
+        if os.name == "posix":
+            _, status, usage = os.wait4(process.pid, 0)
+            elapsed = time.perf_counter() - start
+            process.returncode = os.waitstatus_to_exitcode(status)
+            # ru_maxrss is in kilobytes on Linux and in bytes on macOS
+            peak_rss = usage.ru_maxrss * (1 if sys.platform == "darwin" else 1024)
+        else:
+            process.wait()
+            elapsed = time.perf_counter() - start
+            peak_rss = get_windows_peak_rss(process)
+    return process.returncode, elapsed, peak_rss
+
+
+def parse_stats(log_path):
+    """Extract the --stats=json object, printed as the last JSON line of the run."""
+    with open(log_path, errors="replace") as f:
+        lines = f.readlines()
+    for line in reversed(lines):
+        line = line.strip()
+        if line.startswith("{") and '"phases"' in line:
+            return json.loads(line)
+    return None
+
+
+def get_path_size(path):
+    """Size of a database file or directory, including Kuzu's write-ahead log."""
+    total = 0
+    for candidate in (path, Path(str(path) + ".wal")):
+        if candidate.is_file():
+            total += candidate.stat().st_size
+        elif candidate.is_dir():
+            total += sum(f.stat().st_size for f in candidate.rglob("*") if f.is_file())
+    return total
+
+
+def remove_database(path):
+    """Remove a benchmark database and its side files."""
+    for candidate in (path, Path(str(path) + ".wal"), Path(str(path) + ".bulk")):
+        if candidate.is_dir():
+            shutil.rmtree(candidate, ignore_errors=True)
+        elif candidate.exists():
+            candidate.unlink()
+
+
+def benchmark_corpus(name, compile_commands, dosatsu, args):
+    """Index a corpus args.repeat times; returns the metrics of the median run."""
+    with open(compile_commands) as f:
+        tu_count = len({entry["file"] for entry in json.load(f)})
+
+    runs = []
+    for repetition in range(args.repeat):
+        db_path = get_benchmark_dir() / "databases" / f"{name}.db"
+        db_path.parent.mkdir(parents=True, exist_ok=True)
+        remove_database(db_path)
+
+        cmd = [str(dosatsu), str(compile_commands), "--output-db", str(db_path), "--stats=json", *args.dosatsu_args]
+        log_path = get_benchmark_dir() / f"{name}_{repetition}.log"
+        print(f"  [{name}] run {repetition + 1}/{args.repeat}: {' '.join(cmd)}")
+        returncode, elapsed, peak_rss = run_measured(cmd, log_path)
+        stats = parse_stats(log_path)
+        if returncode != 0 or stats is None:
+            print(f"  [{name}] FAILED (exit code {returncode}), see {log_path}")
+            return None
+
+        nodes = sum(stats["node_rows"].values())
+        edges = sum(stats["relationship_rows"].values())
+        runs.append({
+            "tus": tu_count,
+            "nodes": nodes,
+            "edges": edges,
+            "wall_s": elapsed,
+            "tus_per_s": tu_count / elapsed,
+            "nodes_per_s": nodes / elapsed,
+            "edges_per_s": edges / elapsed,
+            "peak_rss_mb": peak_rss / (1024 * 1024) if peak_rss is not None else None,
+            "db_size_mb": get_path_size(db_path) / (1024 * 1024),
+            "phases_ms": {phase: values["wall_ms"] for phase, values in stats["phases"].items()},
+        })
+        remove_database(db_path)
+
+    median_wall = statistics.median(run["wall_s"] for run in runs)
+    return min(runs, key=lambda run: abs(run["wall_s"] - median_wall))
+
+
+def compare_with_baseline(results, baseline, tolerance):
+    """Print metric changes against the baseline; returns the list of regressions."""
+    regressions = []
+    print(f"\n=== Comparison against baseline (tolerance {tolerance:.0%}) ===")
+    for corpus, metrics in results["corpora"].items():
+        base = baseline.get("corpora", {}).get(corpus)
+        if base is None or metrics is None:
+            print(f"{corpus}: no baseline")
+            continue
+        if base.get("nodes") != metrics["nodes"] or base.get("edges") != metrics["edges"]:
+            print(f"{corpus}: output changed ({base.get('nodes')} -> {metrics['nodes']} nodes, "
+                  f"{base.get('edges')} -> {metrics['edges']} edges)")
+        for metric, higher_is_better in METRICS.items():
+            old, new = base.get(metric), metrics.get(metric)
+            if not old or new is None:
+                continue
+            change = (new - old) / old
+            worse = -change if higher_is_better else change
+            marker = "REGRESSION" if worse > tolerance else "ok"
+            print(f"{corpus:>10} {metric:<12} {old:>14.2f} -> {new:>14.2f} ({change:+.1%}) {marker}")
+            if worse > tolerance:
+                regressions.append(f"{corpus}.{metric}")
+    return regressions
+
+
+def print_results(results):
+    """Print a summary table of the results."""
+    print("\n=== Benchmark Results ===")
+    print(f"{'Corpus':<10} {'TUs':>6} {'TUs/s':>10} {'nodes/s':>12} {'edges/s':>12} {'RSS MB':>10} {'DB MB':>10}")
+    for corpus, metrics in results["corpora"].items():
+        if metrics is None:
+            print(f"{corpus:<10} FAILED")
+            continue
+        rss = f"{metrics['peak_rss_mb']:.1f}" if metrics["peak_rss_mb"] is not None else "n/a"
+        print(f"{corpus:<10} {metrics['tus']:>6} {metrics['tus_per_s']:>10.2f} {metrics['nodes_per_s']:>12.0f} "
+              f"{metrics['edges_per_s']:>12.0f} {rss:>10} {metrics['db_size_mb']:>10.1f}")
+
+
+def main():
+    """Main function."""
+    parser = argparse.ArgumentParser(description="Run Dosatsu indexing throughput benchmarks")
+    parser.add_argument("--corpus", nargs="+", choices=sorted(CORPORA), default=["examples", "synthetic"],
+                        help="Corpora to benchmark (default: examples synthetic)")
+    parser.add_argument("--dosatsu-path", help="Path to the dosatsu_cpp executable (default: auto-detect)")
+    parser.add_argument("--dosatsu-args", nargs=argparse.REMAINDER, default=[],
+                        help="Extra indexer arguments, e.g. --dosatsu-args --jobs 8 (must come last)")
+    parser.add_argument("--synthetic-tus", type=int, default=50, help="Translation units in the synthetic corpus")
+    parser.add_argument("--seed", type=int, default=1, help="Seed of the synthetic corpus generator")
+    parser.add_argument("--project-compile-commands", help="Benchmark this compilation database as the project corpus")
+    parser.add_argument("--repeat", type=int, default=3, help="Runs per corpus; the median run is reported")
+    parser.add_argument("--output", type=Path, help="Write the results as JSON")
+    parser.add_argument("--baseline", type=Path, help="Baseline JSON to compare against")
+    parser.add_argument("--update-baseline", action="store_true", help="Write the results to --baseline instead")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="Allowed relative slowdown (default: 0.10)")
+    args = parser.parse_args()
+
+    dosatsu = find_dosatsu(args.dosatsu_path)
+    if dosatsu is None:
+        print("Error: Dosatsu executable not found")
+        print("Please run 'python please.py build' first or pass --dosatsu-path")
+        return 1
+
+    results = {
+        "version": 1,
+        "machine": {"platform": platform.platform(), "cpu_count": os.cpu_count()},
+        "dosatsu_args": args.dosatsu_args,
+        "corpora": {},
+    }
+
+    print("=== Dosatsu Indexing Benchmarks ===")
+    for corpus in args.corpus:
+        try:
+            compile_commands = CORPORA[corpus](args)
+        except (OSError, subprocess.CalledProcessError) as e:
+            print(f"  [{corpus}] could not prepare corpus: {e}")
+            results["corpora"][corpus] = None
+            continue
+        results["corpora"][corpus] = benchmark_corpus(corpus, compile_commands, dosatsu, args)
+
+    print_results(results)
+
+    if args.output:
+        args.output.parent.mkdir(parents=True, exist_ok=True)
+        args.output.write_text(json.dumps(results, indent=2))
+        print(f"\nResults written to {args.output}")
+
+    failed = any(metrics is None for metrics in results["corpora"].values())
+    if args.baseline is None:
+        return 1 if failed else 0
+
+    if args.update_baseline:
+        args.baseline.write_text(json.dumps(results, indent=2))
+        print(f"Baseline written to {args.baseline}")
+        return 1 if failed else 0
+
+    if not args.baseline.exists():
+        print(f"\nNo baseline at {args.baseline}; create one with --update-baseline")
+        return 1 if failed else 0
+
+    baseline = json.loads(args.baseline.read_text())
+    if baseline.get("machine", {}).get("platform") != results["machine"]["platform"]:
+        print("Warning: baseline was recorded on a different platform")
+    regressions = compare_with_baseline(results, baseline, args.tolerance)
+    if regressions:
+        print(f"\nFAILED: {len(regressions)} metric(s) regressed: {', '.join(regressions)}")
+        return 1
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,88 @@
+//===--- ASTCache.cpp - Serialized ASTs reused across runs ----------------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "ASTCache.h"
+
+#include "IncrementalIndex.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticIDs.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileSystemOptions.h"
+#include "clang/Basic/Version.h"
+#include "clang/Lex/HeaderSearchOptions.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+using namespace clang;
+
+ASTCache::ASTCache(std::string directory)
+    : directory(std::move(directory)), pchOperations(std::make_shared<PCHContainerOperations>())
+{
+    if (auto error = llvm::sys::fs::create_directories(this->directory))
+        llvm::errs() << "Warning: cannot create AST cache directory " << this->directory << ": " << error.message()
+                     << "\n";
+}
+
+auto ASTCache::getPath(const tooling::CompileCommand& command) const -> std::string
+{
+    std::string fingerprint = getClangFullVersion();
+    fingerprint += '\n';
+    fingerprint += command.Directory;
+    fingerprint += '\0';
+    fingerprint += command.Filename;
+    for (const auto& argument : command.CommandLine)
+    {
+        fingerprint += '\0';
+        fingerprint += argument;
+    }
+
+    // The file name keeps entries recognizable; the hash keeps them apart
+    llvm::SmallString<256> path(directory);
+    llvm::sys::path::append(path,
+                            llvm::sys::path::filename(command.Filename) + "-" +
+                                IncrementalIndex::hashContents(fingerprint) + ".ast");
+    return std::string(path);
+}
+
+auto ASTCache::load(const tooling::CompileCommand& command) const -> std::unique_ptr<ASTUnit>
+{
+    std::string path = getPath(command);
+    if (!llvm::sys::fs::exists(path))
+        return nullptr;
+
+    // A stale entry is an expected miss, not something to report
+    IntrusiveRefCntPtr<DiagnosticsEngine> diagnostics(
+        new DiagnosticsEngine(new DiagnosticIDs(), new DiagnosticOptions(), new IgnoringDiagConsumer()));
+
+    // Relative paths in the AST resolve against the command's directory, without touching the process working directory
+    FileSystemOptions fileSystemOptions;
+    fileSystemOptions.WorkingDir = command.Directory;
+
+    return ASTUnit::LoadFromASTFile(path,
+                                    pchOperations->getRawReader(),
+                                    ASTUnit::LoadEverything,
+                                    diagnostics,
+                                    fileSystemOptions,
+                                    std::make_shared<HeaderSearchOptions>());
+}
+
+void ASTCache::store(ASTUnit& unit, const tooling::CompileCommand& command) const
+{
+    if (unit.getDiagnostics().hasErrorOccurred())
+        return;
+
+    // Save() writes a temporary file and renames it, so readers never see a partial entry
+    std::string path = getPath(command);
+    if (unit.Save(path))
+        llvm::errs() << "Warning: cannot write AST cache entry " << path << "\n";
+}
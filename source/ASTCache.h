@@ -0,0 +1,57 @@
+//===--- ASTCache.h - Serialized ASTs reused across runs ------------------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <memory>
+#include <string>
+
+namespace clang
+{
+
+/// Directory of AST files saved after parsing, loaded instead of parsing again
+/// An entry is named after its compile command and the Clang version, so a
+/// changed command or compiler never finds it. Changed source files are caught
+/// by the AST reader, which checks the size and modification time of every
+/// user file the AST was built from and rejects the entry if one differs; the
+/// translation unit is then parsed and its entry rewritten. Loading an AST file
+/// is much cheaper than parsing, which makes re-running analysis after a schema or
+/// analyzer change on unchanged sources mostly a matter of traversal.
+class ASTCache
+{
+public:
+    /// Constructor
+    /// \param directory Directory holding the AST files; created if missing
+    explicit ASTCache(std::string directory);
+
+    /// Load the AST of a compile command
+    /// \param command The compile command
+    /// \return The AST, or null if there is no entry or it is out of date
+    auto load(const tooling::CompileCommand& command) const -> std::unique_ptr<ASTUnit>;
+
+    /// Save a parsed AST as the entry of its compile command
+    /// ASTs with errors are not saved, so broken code is always reported afresh.
+    /// \param unit The freshly parsed AST
+    /// \param command The compile command it was parsed with
+    void store(ASTUnit& unit, const tooling::CompileCommand& command) const;
+
+private:
+    /// Path of the entry of a compile command
+    auto getPath(const tooling::CompileCommand& command) const -> std::string;
+
+    std::string directory;
+    std::shared_ptr<PCHContainerOperations> pchOperations;  // Read from lazily, for as long as a loaded AST lives
+};
+
+}  // namespace clang
@@ -6,6 +6,11 @@
 
 #include "ASTDumpAction.h"
 
+#include "GlobalDatabaseManager.h"
+#include "IncrementalIndex.h"
+#include "Trace.h"
+#include "TranslationUnitArena.h"
+
 // clang-format off
 #include "NoWarningScope_Enter.h"
 #include "clang/Frontend/CompilerInstance.h"
@@ -14,26 +19,64 @@
 
 using namespace clang;
 
-DosatsuASTDumpConsumer::DosatsuASTDumpConsumer(llvm::raw_ostream& OS, ASTContext& Context)
+DosatsuASTDumpConsumer::DosatsuASTDumpConsumer(llvm::raw_ostream& OS, TextDump::Format format)
+    : textOutput(&OS), textFormat(format)
 {
-    // Create the KuzuDump instance with the provided context (no colors)
-    Dumper = std::make_unique<KuzuDump>(OS, Context, false);
 }
 
-DosatsuASTDumpConsumer::DosatsuASTDumpConsumer(const std::string& databasePath, ASTContext& Context)
+DosatsuASTDumpConsumer::DosatsuASTDumpConsumer(const std::string& databasePath,
+                                               StringRef mainFile,
+                                               ASTContext& Context)
+    : mainFile(mainFile)
 {
     // Create the KuzuDump instance for database output
     Dumper = std::make_unique<KuzuDump>(databasePath, Context, false);
+
+    // Every node ID allocated from here on belongs to this translation unit
+    auto& dbManager = GlobalDatabaseManager::getInstance();
+    dbManager.beginTranslationUnit(IncrementalIndex::normalizePath(mainFile));
+    if (auto* database = dbManager.getDatabase())
+        database->beginFile();
 }
 
 void DosatsuASTDumpConsumer::HandleTranslationUnit(ASTContext& Context)
 {
-    // Process the entire translation unit starting from the translation unit declaration
-    Dumper->Visit(Context.getTranslationUnitDecl());
+    parseTimer.reset();
+    TraceSpan span("Translation unit", "indexing", mainFile);
+    PhaseTimer timer(StatisticsPhase::Traversal);
+
+    if (textOutput != nullptr)
+    {
+        TextDump::write(*textOutput, Context, textFormat);
+        return;
+    }
+
+    auto& dbManager = GlobalDatabaseManager::getInstance();
+    Dumper->dumpTranslationUnit(Context.getTranslationUnitDecl(), dbManager.shouldSkipIndexedHeaders());
+
+    if (const auto* index = dbManager.getIncrementalIndex())
+        index->recordTranslationUnit(*dbManager.getDatabase(), mainFile, Context.getSourceManager());
+
+    releaseTranslationUnitState();
+}
+
+DosatsuASTDumpConsumer::~DosatsuASTDumpConsumer()
+{
+    releaseTranslationUnitState();
+}
+
+void DosatsuASTDumpConsumer::releaseTranslationUnitState()
+{
+    if (mainFile.empty() || !Dumper)
+        return;
+
+    Dumper.reset();
+    GlobalDatabaseManager::getInstance().endTranslationUnit();
+    TranslationUnitArena::forThread().reset();
 }
 
 // DosatsuASTDumpAction implementations
-DosatsuASTDumpAction::DosatsuASTDumpAction(llvm::raw_ostream& OS) : OS(&OS)
+DosatsuASTDumpAction::DosatsuASTDumpAction(llvm::raw_ostream& OS, TextDump::Format format) : OS(&OS), format(format)
 {
 }
 
@@ -42,9 +85,13 @@ DosatsuASTDumpAction::DosatsuASTDumpAction(std::string databasePath)
 {
 }
 
-auto DosatsuASTDumpAction::CreateASTConsumer(CompilerInstance& CI, StringRef /*InFile*/) -> std::unique_ptr<ASTConsumer>
+auto DosatsuASTDumpAction::CreateASTConsumer(CompilerInstance& CI, StringRef InFile) -> std::unique_ptr<ASTConsumer>
 {
+    std::unique_ptr<DosatsuASTDumpConsumer> consumer;
     if (usingDatabase)
-        return std::make_unique<DosatsuASTDumpConsumer>(databasePath, CI.getASTContext());
-    return std::make_unique<DosatsuASTDumpConsumer>(*OS, CI.getASTContext());
+        consumer = std::make_unique<DosatsuASTDumpConsumer>(databasePath, InFile, CI.getASTContext());
+    else
+        consumer = std::make_unique<DosatsuASTDumpConsumer>(*OS, format);
+    consumer->startParseTimer();
+    return consumer;
 }
\ No newline at end of file
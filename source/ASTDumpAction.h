@@ -7,6 +7,8 @@
 #pragma once
 
 #include "KuzuDump.h"
+#include "Statistics.h"
+#include "TextDump.h"
 
 // clang-format off
 #include "NoWarningScope_Enter.h"
@@ -17,6 +19,7 @@
 // clang-format on
 
 #include <memory>
+#include <optional>
 
 namespace clang
 {
@@ -27,20 +30,41 @@ class DosatsuASTDumpConsumer : public ASTConsumer
 public:
     /// Constructor for text output
     /// \param OS Output stream for dumping
-    /// \param Context AST context for the current compilation unit
-    DosatsuASTDumpConsumer(llvm::raw_ostream& OS, ASTContext& Context);
+    /// \param format Output format
+    DosatsuASTDumpConsumer(llvm::raw_ostream& OS, TextDump::Format format);
 
     /// Constructor for database output
     /// \param databasePath Path to the Kuzu database
+    /// \param mainFile Main source file of the translation unit, as recorded by the incremental index
     /// \param Context AST context for the current compilation unit
-    DosatsuASTDumpConsumer(const std::string& databasePath, ASTContext& Context);
+    DosatsuASTDumpConsumer(const std::string& databasePath, StringRef mainFile, ASTContext& Context);
+
+    ~DosatsuASTDumpConsumer() override;
+
+    DosatsuASTDumpConsumer(const DosatsuASTDumpConsumer&) = delete;
+    auto operator=(const DosatsuASTDumpConsumer&) -> DosatsuASTDumpConsumer& = delete;
+
+    /// Charge the time until HandleTranslationUnit() to the Clang parse
+    /// Called when the consumer is created right before parsing starts; a consumer
+    /// handed an AST parsed elsewhere leaves it to whoever did the parsing.
+    void startParseTimer() { parseTimer.emplace(StatisticsPhase::ClangParse); }
 
     /// Handle the translation unit once it's fully parsed
     /// \param Context The AST context for this translation unit
     void HandleTranslationUnit(ASTContext& Context) override;
 
 private:
-    std::unique_ptr<KuzuDump> Dumper;
+    /// Destroy the analysis state of the translation unit before its ASTContext goes away
+    void releaseTranslationUnitState();
+
+    std::unique_ptr<KuzuDump> Dumper;  // Database output only
+    std::string mainFile;              // Empty for text output
+
+    // Text output only
+    llvm::raw_ostream* textOutput = nullptr;
+    TextDump::Format textFormat = TextDump::Format::Text;
+
+    std::optional<PhaseTimer> parseTimer;
 };
 
 /// Frontend action that creates DosatsuASTDumpConsumer instances
@@ -49,7 +73,8 @@ class DosatsuASTDumpAction : public ASTFrontendAction
 public:
     /// Constructor for text output
     /// \param OS Output stream for dumping
-    DosatsuASTDumpAction(llvm::raw_ostream& OS);
+    /// \param format Output format
+    DosatsuASTDumpAction(llvm::raw_ostream& OS, TextDump::Format format);
 
     /// Constructor for database output
     /// \param databasePath Path to the Kuzu database
@@ -64,6 +89,7 @@ protected:
 
 private:
     llvm::raw_ostream* OS;  // Pointer to allow null for database-only mode
+    TextDump::Format format = TextDump::Format::Text;
     std::string databasePath;
     bool usingDatabase = false;
 };
@@ -12,15 +12,36 @@
 // clang-format off
 #include "NoWarningScope_Enter.h"
 #include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
 #include <algorithm>
-#include <sstream>
+#include <array>
+#include <charconv>
 
 using namespace clang;
 
+namespace
+{
+
+// Room for a 64-bit pointer in hex
+using AddressBuffer = std::array<char, 16>;
+
+// Format a node's address into a stack buffer; a stream per node is far too slow
+auto formatAddress(const void* ptr, AddressBuffer& buffer) -> std::string_view
+{
+    auto address = reinterpret_cast<uintptr_t>(ptr);
+    auto [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), address, 16);
+    (void)error;  // 16 hex digits always fit
+    return {buffer.data(), static_cast<size_t>(end - buffer.data())};
+}
+
+}  // namespace
+
 ASTNodeProcessor::ASTNodeProcessor(KuzuDatabase& database, ASTContext& astContext)
     : database(database), sourceManager(&astContext.getSourceManager())
 {
@@ -31,56 +52,47 @@ auto ASTNodeProcessor::createASTNode(const clang::Decl* decl) -> int64_t
     if (!database.isInitialized() || (decl == nullptr))
         return -1;
 
-    // Check if already processed globally first
-    auto& dbManager = GlobalDatabaseManager::getInstance();
-    int64_t existingNodeId = dbManager.getGlobalNodeId(decl);
-    if (existingNodeId != -1)
-    {
-        // Also store in local map for faster lookup
-        nodeIdMap[decl] = existingNodeId;
-        return existingNodeId;
-    }
+    // A single probe resolves nodes already seen in this translation unit
+    auto& record = GlobalDatabaseManager::getInstance().getNodeRecord(decl);
+    if (record.nodeId != -1)
+        return record.nodeId;
 
-    // Check if already processed locally
-    auto it = nodeIdMap.find(decl);
-    if (it != nodeIdMap.end())
-        return it->second;
+    // Header declarations emitted by an earlier translation unit are reused
+    std::string stableKey = getStableKey(decl);
+    if (reuseStableNode(record, stableKey))
+        return record.nodeId;
 
     int64_t nodeId = getNextNodeId();
-    nodeIdMap[decl] = nodeId;
+    record.nodeId = nodeId;
 
-    // Register globally to prevent duplicates across files
-    dbManager.registerGlobalNode(decl, nodeId);
+    // Register the stable key so later translation units reuse the node
+    if (!stableKey.empty())
+        registerStableKey(std::move(stableKey), nodeId);
 
     try
     {
         // Extract basic information
-        std::string nodeType = extractNodeType(decl);
-
-        // Format memory address as hex string
-        std::stringstream addrStream;
-        addrStream << std::hex << (uintptr_t)decl;
-        std::string memoryAddr = addrStream.str();
+        llvm::StringRef nodeType = extractNodeType(decl);
+        AddressBuffer address;
 
         bool isImplicit = isImplicitNode(decl);
 
         // Extract detailed source location information
-        auto [filename, startLine, startColumn] = extractSourceLocationDetailed(decl->getLocation());
-        auto [endFilename, endLine, endColumn] = extractSourceLocationDetailed(decl->getSourceRange().getEnd());
-
-        // Use start location's filename for source_file with proper escaping for Kuzu queries
-        std::string sourceFile = KuzuDatabase::escapeString(filename);
-
-        // Create base AST node query using string concatenation
-        std::string query =
-            "CREATE (n:ASTNode {node_id: " + std::to_string(nodeId) + ", node_type: '" + nodeType +
-            "', memory_address: '" + memoryAddr + "', source_file: '" + sourceFile +
-            "', is_implicit: " + (isImplicit ? "true" : "false") + ", start_line: " + std::to_string(startLine) +
-            ", start_column: " + std::to_string(startColumn) + ", end_line: " + std::to_string(endLine) +
-            ", end_column: " + std::to_string(endColumn) + ", raw_text: ''})";
-
-        // Use batched operation for performance optimization
-        database.addToBatch(query);
+        NodeLocation start = resolveLocation(decl->getLocation());
+        NodeLocation end = resolveLocation(decl->getSourceRange().getEnd());
+
+        // Use start location's file for file_id
+        database.addNodeToBatch("ASTNode",
+                                {{"node_id", nodeId},
+                                 {"node_type", nodeType},
+                                 {"memory_address", formatAddress(decl, address)},
+                                 {"file_id", start.fileId},
+                                 {"is_implicit", isImplicit},
+                                 {"start_line", start.line},
+                                 {"start_column", start.column},
+                                 {"end_line", end.line},
+                                 {"end_column", end.column},
+                                 {"raw_text", std::string()}});
 
         return nodeId;
     }
@@ -96,53 +108,36 @@ auto ASTNodeProcessor::createASTNode(const clang::Stmt* stmt) -> int64_t
     if (!database.isInitialized() || (stmt == nullptr))
         return -1;
 
-    // Check if already processed globally first
-    auto& dbManager = GlobalDatabaseManager::getInstance();
-    int64_t existingNodeId = dbManager.getGlobalNodeId(stmt);
-    if (existingNodeId != -1)
-    {
-        // Also store in local map for faster lookup
-        nodeIdMap[stmt] = existingNodeId;
-        return existingNodeId;
-    }
-
-    // Check if already processed locally
-    auto it = nodeIdMap.find(stmt);
-    if (it != nodeIdMap.end())
-        return it->second;
+    // A single probe resolves nodes already seen in this translation unit
+    auto& record = GlobalDatabaseManager::getInstance().getNodeRecord(stmt);
+    if (record.nodeId != -1)
+        return record.nodeId;
 
     int64_t nodeId = getNextNodeId();
-    nodeIdMap[stmt] = nodeId;
-
-    // Register globally to prevent duplicates across files
-    dbManager.registerGlobalNode(stmt, nodeId);
+    record.nodeId = nodeId;
 
     try
     {
         // Extract basic information
-        std::string nodeType = extractNodeType(stmt);
-        // Format memory address as hex string
-        std::stringstream addrStream;
-        addrStream << std::hex << (uintptr_t)stmt;
-        std::string memoryAddr = addrStream.str();
+        llvm::StringRef nodeType = extractNodeType(stmt);
+        AddressBuffer address;
 
         // Extract detailed source location information
-        auto [filename, startLine, startColumn] = extractSourceLocationDetailed(stmt->getBeginLoc());
-        auto [endFilename, endLine, endColumn] = extractSourceLocationDetailed(stmt->getEndLoc());
-
-        // Use start location's filename for source_file with proper escaping for Kuzu queries
-        std::string sourceFile = KuzuDatabase::escapeString(filename);
-
-        // Create base AST node query using string concatenation
-        std::string query = "CREATE (n:ASTNode {node_id: " + std::to_string(nodeId) + ", node_type: '" + nodeType +
-                            "', memory_address: '" + memoryAddr + "', source_file: '" + sourceFile +
-                            "', is_implicit: false, start_line: " + std::to_string(startLine) +
-                            ", start_column: " + std::to_string(startColumn) +
-                            ", end_line: " + std::to_string(endLine) + ", end_column: " + std::to_string(endColumn) +
-                            ", raw_text: ''})";
-
-        // Use batched operation for performance optimization
-        database.addToBatch(query);
+        NodeLocation start = resolveLocation(stmt->getBeginLoc());
+        NodeLocation end = resolveLocation(stmt->getEndLoc());
+
+        // Use start location's file for file_id
+        database.addNodeToBatch("ASTNode",
+                                {{"node_id", nodeId},
+                                 {"node_type", nodeType},
+                                 {"memory_address", formatAddress(stmt, address)},
+                                 {"file_id", start.fileId},
+                                 {"is_implicit", false},
+                                 {"start_line", start.line},
+                                 {"start_column", start.column},
+                                 {"end_line", end.line},
+                                 {"end_column", end.column},
+                                 {"raw_text", std::string()}});
 
         return nodeId;
     }
@@ -153,58 +148,47 @@ auto ASTNodeProcessor::createASTNode(const clang::Stmt* stmt) -> int64_t
     }
 }
 
-auto ASTNodeProcessor::createASTNode(const clang::Type* type) -> int64_t
+auto ASTNodeProcessor::createASTNode(clang::QualType type, const std::string& spelling) -> int64_t
 {
-    if (!database.isInitialized() || (type == nullptr))
+    if (!database.isInitialized() || type.isNull())
         return -1;
 
-    // Check if already processed globally first
-    auto& dbManager = GlobalDatabaseManager::getInstance();
-    int64_t existingNodeId = dbManager.getGlobalNodeId(type);
-    if (existingNodeId != -1)
-    {
-        // Also store in local map for faster lookup
-        nodeIdMap[type] = existingNodeId;
-        return existingNodeId;
-    }
+    // A single probe resolves nodes already seen in this translation unit; the opaque
+    // pointer carries the fast qualifiers, so const T and T are different keys
+    auto& record = GlobalDatabaseManager::getInstance().getNodeRecord(type.getAsOpaquePtr());
+    if (record.nodeId != -1)
+        return record.nodeId;
 
-    // Check if already processed locally
-    auto it = nodeIdMap.find(type);
-    if (it != nodeIdMap.end())
-        return it->second;
+    // Types spelled the same as one of an earlier translation unit are reused
+    std::string stableKey = getStableKey(type, spelling);
+    if (reuseStableNode(record, stableKey))
+        return record.nodeId;
 
     int64_t nodeId = getNextNodeId();
-    nodeIdMap[type] = nodeId;
+    record.nodeId = nodeId;
 
-    // Register globally to prevent duplicates across files
-    dbManager.registerGlobalNode(type, nodeId);
+    // Register the stable key so later translation units reuse the node
+    if (!stableKey.empty())
+        registerStableKey(std::move(stableKey), nodeId);
 
     try
     {
         // Extract basic information
-        std::string nodeType = extractNodeType(type);
-        // Format memory address as hex string
-        std::stringstream addrStream;
-        addrStream << std::hex << (uintptr_t)type;
-        std::string memoryAddr = addrStream.str();
+        llvm::StringRef nodeType = extractNodeType(type.getTypePtr());
+        AddressBuffer address;
 
         // Types don't have specific source locations, so use empty values
-        std::string sourceFile = "";
-        int64_t startLine = -1;
-        int64_t startColumn = -1;
-        int64_t endLine = -1;
-        int64_t endColumn = -1;
-
-        // Create base AST node query using string concatenation
-        std::string query = "CREATE (n:ASTNode {node_id: " + std::to_string(nodeId) + ", node_type: '" + nodeType +
-                            "', memory_address: '" + memoryAddr + "', source_file: '" + sourceFile +
-                            "', is_implicit: false, start_line: " + std::to_string(startLine) +
-                            ", start_column: " + std::to_string(startColumn) +
-                            ", end_line: " + std::to_string(endLine) + ", end_column: " + std::to_string(endColumn) +
-                            ", raw_text: ''})";
-
-        // Use batched operation for performance optimization
-        database.addToBatch(query);
+        database.addNodeToBatch("ASTNode",
+                                {{"node_id", nodeId},
+                                 {"node_type", nodeType},
+                                 {"memory_address", formatAddress(type.getAsOpaquePtr(), address)},
+                                 {"file_id", int64_t{-1}},
+                                 {"is_implicit", false},
+                                 {"start_line", int64_t{-1}},
+                                 {"start_column", int64_t{-1}},
+                                 {"end_line", int64_t{-1}},
+                                 {"end_column", int64_t{-1}},
+                                 {"raw_text", std::string()}});
 
         return nodeId;
     }
@@ -217,38 +201,133 @@ auto ASTNodeProcessor::createASTNode(const clang::Type* type) -> int64_t
 
 auto ASTNodeProcessor::getNodeId(const void* ptr) -> int64_t
 {
-    // Check local map first for performance
-    auto it = nodeIdMap.find(ptr);
-    if (it != nodeIdMap.end())
-        return it->second;
+    return GlobalDatabaseManager::getInstance().getGlobalNodeId(ptr);
+}
 
-    // Check global map
+auto ASTNodeProcessor::getNextNodeId() -> int64_t
+{
+    return database.getNextNodeId();
+}
+
+auto ASTNodeProcessor::isDeduplicated(const void* ptr) const -> bool
+{
+    const auto* record = GlobalDatabaseManager::getInstance().findNodeRecord(ptr);
+    return record != nullptr && record->reused;
+}
+
+auto ASTNodeProcessor::reuseStableNode(NodeRecord& record, const std::string& key) -> bool
+{
+    if (key.empty())
+        return false;
+
+    int64_t nodeId = GlobalDatabaseManager::getInstance().getStableNodeId(key);
+    if (nodeId == -1)
+        return false;
+
+    // The emitting translation unit wrote the node's specialized rows as well
+    record.nodeId = nodeId;
+    record.reused = true;
+    record.writtenRows = AllNodeRows;
+    return true;
+}
+
+void ASTNodeProcessor::registerStableKey(std::string key, int64_t nodeId)
+{
     auto& dbManager = GlobalDatabaseManager::getInstance();
-    int64_t globalNodeId = dbManager.getGlobalNodeId(ptr);
-    if (globalNodeId != -1)
-    {
-        // Cache in local map for faster future lookups
-        nodeIdMap[ptr] = globalNodeId;
-        return globalNodeId;
-    }
 
-    return -1;
+    // Lets a merge of separately indexed databases recognize the same entity
+    if (dbManager.shouldRecordStableKeys())
+        database.addNodeToBatch("StableKey", {{"node_id", nodeId}, {"stable_key", key}});
+
+    dbManager.registerStableNode(std::move(key), nodeId);
 }
 
-auto ASTNodeProcessor::getNextNodeId() -> int64_t
+auto ASTNodeProcessor::getStableKey(const clang::Decl* decl) -> std::string
 {
-    return database.getNextNodeId();
+    // Main-file declarations are unique to their translation unit; only headers are shared
+    SourceLocation loc = sourceManager->getExpansionLoc(decl->getLocation());
+    if (loc.isInvalid() || sourceManager->isInMainFile(loc))
+        return {};
+
+    llvm::SmallString<128> key;
+    if (clang::index::generateUSRForDecl(decl, key))
+        return {};
+
+    key += '@';
+    key += sourceManager->getFilename(loc);
+    key += ':';
+    key += std::to_string(sourceManager->getFileOffset(loc));
+
+    // A body may only be instantiated in some translation units; the one that has it must emit it
+    const auto* function = dyn_cast<FunctionDecl>(decl);
+    if (function != nullptr && function->doesThisDeclarationHaveABody())
+        key += "#body";
+
+    return std::string(key);
 }
 
-auto ASTNodeProcessor::hasNode(const void* ptr) const -> bool
+auto ASTNodeProcessor::getStableKey(QualType type, const std::string& spelling) -> std::string
 {
-    // Check local map first
-    if (nodeIdMap.find(ptr) != nodeIdMap.end())
+    if (involvesMainFile(type))
+        return {};
+
+    QualType canonical = type.getCanonicalType();
+    if (canonical == type)
+        return spelling + "@" + spelling;
+    return spelling + "@" + canonical.getAsString();
+}
+
+auto ASTNodeProcessor::involvesMainFile(QualType type, unsigned depth) -> bool
+{
+    // Deeply nested types are rare; treating them as local only costs some sharing
+    constexpr unsigned MAX_DEPTH = 8;
+    if (type.isNull())
+        return false;
+    if (depth > MAX_DEPTH)
         return true;
 
-    // Check global map
-    auto& dbManager = GlobalDatabaseManager::getInstance();
-    return dbManager.hasGlobalNode(ptr);
+    auto isInMainFile = [this](const Decl* decl)
+    { return sourceManager->isInMainFile(sourceManager->getExpansionLoc(decl->getLocation())); };
+
+    if (const auto* typedefType = dyn_cast<TypedefType>(type.getTypePtr()); typedefType != nullptr)
+    {
+        if (isInMainFile(typedefType->getDecl()))
+            return true;
+    }
+
+    const clang::Type* canonical = type.getCanonicalType().getTypePtr();
+    if (canonical->isPointerType() || canonical->isReferenceType() || canonical->isMemberPointerType())
+        return involvesMainFile(canonical->getPointeeType(), depth + 1);
+    if (const auto* array = dyn_cast<ArrayType>(canonical))
+        return involvesMainFile(array->getElementType(), depth + 1);
+    if (const auto* function = dyn_cast<FunctionProtoType>(canonical))
+    {
+        if (involvesMainFile(function->getReturnType(), depth + 1))
+            return true;
+        return std::ranges::any_of(function->getParamTypes(),
+                                   [&](QualType param) { return involvesMainFile(param, depth + 1); });
+    }
+
+    if (const auto* tag = canonical->getAsTagDecl())
+    {
+        if (isInMainFile(tag))
+            return true;
+        if (const auto* specialization = dyn_cast<ClassTemplateSpecializationDecl>(tag))
+        {
+            for (const auto& argument : specialization->getTemplateArgs().asArray())
+            {
+                if (argument.getKind() == TemplateArgument::Type && involvesMainFile(argument.getAsType(), depth + 1))
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+auto ASTNodeProcessor::hasNode(const void* ptr) const -> bool
+{
+    return GlobalDatabaseManager::getInstance().hasGlobalNode(ptr);
 }
 
 auto ASTNodeProcessor::extractSourceLocation(const clang::SourceLocation& loc) -> std::string
@@ -296,21 +375,68 @@ auto ASTNodeProcessor::extractSourceLocationDetailed(const clang::SourceLocation
     }
 }
 
-auto ASTNodeProcessor::extractNodeType(const clang::Decl* decl) -> std::string
+auto ASTNodeProcessor::resolveLocation(clang::SourceLocation loc) -> NodeLocation
+{
+    auto& dbManager = GlobalDatabaseManager::getInstance();
+    if (loc.isInvalid() || (sourceManager == nullptr))
+        return {dbManager.getSourceFileId("<invalid>"), -1, -1};
+
+    auto [fileId, offset] = sourceManager->getDecomposedExpansionLoc(loc);
+    if (fileId.isInvalid())
+        return {dbManager.getSourceFileId("<invalid>"), -1, -1};
+
+    auto [it, inserted] = files.try_emplace(fileId);
+    auto& file = it->second;
+    if (inserted)
+    {
+        bool invalid = false;
+        const auto& entry = sourceManager->getSLocEntry(fileId, &invalid);
+        file.hasLineDirectives = invalid || !entry.isFile() || entry.getFile().hasLineDirectives();
+        if (!file.hasLineDirectives)
+            file.fileId = dbManager.getSourceFileId(std::get<0>(extractSourceLocationDetailed(loc)));
+    }
+
+    // #line directives remap file names and lines per location, which only getPresumedLoc() applies
+    if (file.hasLineDirectives)
+    {
+        auto [filename, line, column] = extractSourceLocationDetailed(loc);
+        return {dbManager.getSourceFileId(filename), line, column};
+    }
+
+    // Same line and column as getPresumedLoc(); the SourceManager caches the line table of the file queried last
+    bool invalid = false;
+    auto line = static_cast<int64_t>(sourceManager->getLineNumber(fileId, offset, &invalid));
+    auto column = static_cast<int64_t>(sourceManager->getColumnNumber(fileId, offset, &invalid));
+    if (invalid)
+        return {file.fileId, -1, -1};
+    return {file.fileId, line, column};
+}
+
+auto ASTNodeProcessor::extractNodeType(const clang::Decl* decl) -> llvm::StringRef
 {
     if (decl == nullptr)
         return "UnknownDecl";
-    return std::string(decl->getDeclKindName()) + "Decl";
+
+    // getDeclKindName() lacks the "Decl" suffix; spelling out every kind keeps the name a literal
+    switch (decl->getKind())
+    {
+#define DECL(DERIVED, BASE)                                                                                            \
+    case Decl::DERIVED:                                                                                                \
+        return #DERIVED "Decl";
+#define ABSTRACT_DECL(DECL)
+#include "clang/AST/DeclNodes.inc"
+    }
+    return "UnknownDecl";
 }
 
-auto ASTNodeProcessor::extractNodeType(const clang::Stmt* stmt) -> std::string
+auto ASTNodeProcessor::extractNodeType(const clang::Stmt* stmt) -> llvm::StringRef
 {
     if (stmt == nullptr)
         return "UnknownStmt";
     return stmt->getStmtClassName();
 }
 
-auto ASTNodeProcessor::extractNodeType(const clang::Type* type) -> std::string
+auto ASTNodeProcessor::extractNodeType(const clang::Type* type) -> llvm::StringRef
 {
     if (type == nullptr)
         return "UnknownType";
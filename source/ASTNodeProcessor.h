@@ -13,18 +13,28 @@
 #include "clang/AST/Stmt.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
 #include <cstdint>
 #include <string>
 #include <tuple>
-#include <unordered_map>
 
 namespace clang
 {
 
 class KuzuDatabase;
+struct NodeRecord;
+
+/// Position of a node as stored in its ASTNode row
+struct NodeLocation
+{
+    int64_t fileId = -1;  // SourceFile row, see GlobalDatabaseManager::getSourceFileId()
+    int64_t line = -1;
+    int64_t column = -1;
+};
 
 /// Handles core AST node creation and basic processing
 class ASTNodeProcessor
@@ -33,7 +43,7 @@ public:
     /// Constructor
     /// \param database Database instance for storage
     /// \param astContext AST context for source location information
-    explicit ASTNodeProcessor(KuzuDatabase& database, ASTContext& astContext);
+    ASTNodeProcessor(KuzuDatabase& database, ASTContext& astContext);
 
     /// Create a new AST node for a declaration
     /// \param decl The declaration to create a node for
@@ -45,10 +55,12 @@ public:
     /// \return The unique node ID assigned
     auto createASTNode(const clang::Stmt* stmt) -> int64_t;
 
-    /// Create a new AST node for a type
+    /// Create a new AST node for a qualified type
+    /// The node is keyed on the QualType itself, so qualifiers and sugar get nodes of their own.
     /// \param type The type to create a node for
+    /// \param spelling The type printed with getAsString(), shared with the caller's Type row
     /// \return The unique node ID assigned
-    auto createASTNode(const clang::Type* type) -> int64_t;
+    auto createASTNode(clang::QualType type, const std::string& spelling) -> int64_t;
 
     /// Get the node ID for a previously processed pointer
     /// \param ptr Pointer to the AST node
@@ -60,6 +72,13 @@ public:
     /// \return True if the node has been processed
     auto hasNode(const void* ptr) const -> bool;
 
+    /// Check if a node was emitted by an earlier translation unit and reused through its stable key
+    /// Such a node, its specialized rows and its subtree are already in the database,
+    /// so callers skip emitting and traversing it again.
+    /// \param ptr Pointer to the AST node passed to createASTNode()
+    /// \return True if the node was reused
+    [[nodiscard]] auto isDeduplicated(const void* ptr) const -> bool;
+
     /// Extract source location as string
     /// \param loc Source location to extract
     /// \return String representation of the location
@@ -70,20 +89,28 @@ public:
     /// \return Tuple of (filename, line, column)
     auto extractSourceLocationDetailed(const clang::SourceLocation& loc) -> std::tuple<std::string, int64_t, int64_t>;
 
+    /// Resolve a source location to the file ID, line and column of its presumed location
+    /// Files are resolved once per FileID and lines through the SourceManager's line
+    /// tables, so the common case copies no file name; files with #line directives
+    /// take the slow path through getPresumedLoc().
+    /// \param loc Source location to resolve
+    /// \return The position; the file of an invalid location is "<invalid>"
+    auto resolveLocation(clang::SourceLocation loc) -> NodeLocation;
+
     /// Extract node type string for a declaration
     /// \param decl The declaration
-    /// \return String representation of the node type
-    auto extractNodeType(const clang::Decl* decl) -> std::string;
+    /// \return Static string naming the node type
+    static auto extractNodeType(const clang::Decl* decl) -> llvm::StringRef;
 
     /// Extract node type string for a statement
     /// \param stmt The statement
-    /// \return String representation of the node type
-    auto extractNodeType(const clang::Stmt* stmt) -> std::string;
+    /// \return Static string naming the node type
+    static auto extractNodeType(const clang::Stmt* stmt) -> llvm::StringRef;
 
     /// Extract node type string for a type
     /// \param type The type
-    /// \return String representation of the node type
-    auto extractNodeType(const clang::Type* type) -> std::string;
+    /// \return Static string naming the node type
+    auto extractNodeType(const clang::Type* type) -> llvm::StringRef;
 
     /// Check if a declaration is implicit
     /// \param decl The declaration to check
@@ -94,11 +121,38 @@ private:
     KuzuDatabase& database;
     const SourceManager* sourceManager;
 
-    // Node tracking
-    std::unordered_map<const void*, int64_t> nodeIdMap;  // Pointer -> node_id mapping
+    /// A FileID of this translation unit, resolved on first use
+    struct ResolvedFile
+    {
+        int64_t fileId = -1;
+        bool hasLineDirectives = false;  // Locations are resolved one by one
+    };
+    llvm::DenseMap<FileID, ResolvedFile> files;
 
     /// Get the next available node ID from the database
     auto getNextNodeId() -> int64_t;
+
+    /// Reuse the node of an earlier translation unit for a stable key, if there is one
+    /// \param record Node record of the AST node being created, filled in on reuse
+    /// \param key Stable key, or empty if the node has none
+    /// \return True if the node was reused
+    static auto reuseStableNode(NodeRecord& record, const std::string& key) -> bool;
+
+    /// Register the node emitted for a stable key, recording the key in the database if requested
+    void registerStableKey(std::string key, int64_t nodeId);
+
+    /// Get the stable identity of a header declaration: its USR plus its location
+    /// Redeclarations share a USR, so the location tells them apart.
+    /// \return The key, or an empty string for declarations that must not be shared
+    auto getStableKey(const clang::Decl* decl) -> std::string;
+
+    /// Get the stable identity of a type: its spelling plus its canonical spelling
+    /// \return The key, or an empty string for types that must not be shared
+    auto getStableKey(QualType type, const std::string& spelling) -> std::string;
+
+    /// Check whether a type involves an entity declared in the main file
+    /// Such types print the same as unrelated types of other translation units.
+    auto involvesMainFile(QualType type, unsigned depth = 0) -> bool;
 };
 
 }  // namespace clang
@@ -0,0 +1,81 @@
+//===--- AdaptiveSize.cpp - Sizes tuned to measured throughput ------------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "AdaptiveSize.h"
+
+// clang-format off
+#include <doctest/doctest.h>
+// clang-format on
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+using namespace clang;
+
+TEST_CASE("AdaptiveSize")
+{
+    SUBCASE("Growing leaves small sizes")
+    {
+        AdaptiveSize size(1, 1, 100);
+        std::vector<size_t> sizes{size.get()};
+        while (size.get() < 100 && sizes.size() < 100)
+        {
+            size.record(size.get(), static_cast<double>(size.get()) * 1e-6);
+            sizes.push_back(size.get());
+        }
+        CHECK(sizes[1] == 2);
+        CHECK(sizes[2] == 3);
+        CHECK(sizes[3] == 4);
+        CHECK(std::ranges::adjacent_find(sizes, std::greater_equal<>()) == sizes.end());
+        CHECK(sizes.back() == 100);
+        CHECK(sizes.size() < 30);
+    }
+
+    SUBCASE("A clear drop turns the search around")
+    {
+        AdaptiveSize size(100, 1, 1000);
+        size.record(100, 1.0);
+        CHECK(size.get() == 125);
+        size.record(125, 2.0);
+        CHECK(size.get() == 100);
+        size.record(100, 1.0);
+        CHECK(size.get() == 80);
+    }
+
+    SUBCASE("Noise keeps the direction")
+    {
+        AdaptiveSize size(100, 1, 1000);
+        size.record(100, 1.0);
+        size.record(125, 1.25 / 0.97);
+        CHECK(size.get() == 157);
+    }
+
+    SUBCASE("Bounds")
+    {
+        AdaptiveSize size(500, 10, 100);
+        CHECK(size.get() == 100);
+        size.record(100, 1.0);
+        CHECK(size.get() == 100);
+
+        size.setBounds(0, 0, 0);
+        CHECK(size.get() == 1);
+
+        // Equal bounds fix the size
+        size.setBounds(5, 8, 8);
+        CHECK(size.get() == 8);
+        size.record(8, 1.0);
+        CHECK(size.get() == 8);
+    }
+
+    SUBCASE("Empty and untimed operations are ignored")
+    {
+        AdaptiveSize size(10, 1, 100);
+        size.record(0, 1.0);
+        size.record(10, 0.0);
+        CHECK(size.get() == 10);
+    }
+}
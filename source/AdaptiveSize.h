@@ -0,0 +1,73 @@
+//===--- AdaptiveSize.h - Sizes tuned to measured throughput --------------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace clang
+{
+
+/// A batch size that climbs towards the highest measured throughput
+/// Every measurement moves the size one step further in its current direction;
+/// the direction turns around when throughput drops noticeably, so the size keeps
+/// probing around the best value as the workload changes. Equal bounds fix it.
+class AdaptiveSize
+{
+public:
+    /// Constructor
+    /// \param initial Size used until the first measurement
+    /// \param minimum Smallest size ever chosen
+    /// \param maximum Largest size ever chosen
+    AdaptiveSize(size_t initial, size_t minimum, size_t maximum) { setBounds(initial, minimum, maximum); }
+
+    /// Reset the size and its bounds, forgetting earlier measurements
+    void setBounds(size_t initial, size_t minimum, size_t maximum)
+    {
+        lower = std::max<size_t>(minimum, 1);
+        upper = std::max(maximum, lower);
+        current = std::clamp(initial, lower, upper);
+        lastRate = 0;
+        growing = true;
+    }
+
+    /// Get the size to use for the next operation
+    [[nodiscard]] auto get() const -> size_t { return current; }
+
+    /// Report one operation done at the current size
+    /// \param rows Rows the operation handled
+    /// \param seconds Time it took
+    void record(size_t rows, double seconds)
+    {
+        if (lower == upper || rows == 0 || seconds <= 0)
+            return;
+
+        // Timings are noisy; only a clear drop turns the search around
+        constexpr double TOLERANCE = 0.05;
+        constexpr double STEP = 1.25;
+        double rate = static_cast<double>(rows) / seconds;
+        if (lastRate > 0 && rate < lastRate * (1.0 - TOLERANCE))
+            growing = !growing;
+        lastRate = rate;
+
+        // Growing rounds up and by at least one row, or small sizes would stay where they are
+        auto scaled = static_cast<double>(current) * (growing ? STEP : 1.0 / STEP);
+        size_t next =
+            growing ? std::max(current + 1, static_cast<size_t>(std::ceil(scaled))) : static_cast<size_t>(scaled);
+        current = std::clamp(next, lower, upper);
+    }
+
+private:
+    size_t lower = 1;
+    size_t upper = 1;
+    size_t current = 1;
+    double lastRate = 0;  // Rows per second of the previous measurement
+    bool growing = true;
+};
+
+}  // namespace clang
@@ -7,7 +7,11 @@
 #include "AdvancedAnalyzer.h"
 
 #include "ASTNodeProcessor.h"
+#include "ConstantEvaluator.h"
+#include "GlobalDatabaseManager.h"
 #include "KuzuDatabase.h"
+#include "MemoryMonitor.h"
+#include "Statistics.h"
 
 // clang-format off
 #include "NoWarningScope_Enter.h"
@@ -20,12 +24,51 @@
 
 #include <algorithm>
 #include <sstream>
+#include <vector>
 
 using namespace clang;
 
-AdvancedAnalyzer::AdvancedAnalyzer(KuzuDatabase& database, ASTNodeProcessor& nodeProcessor, ASTContext& astContext)
-    : database(database), nodeProcessor(nodeProcessor), astContext(&astContext)
+AdvancedAnalyzer::AdvancedAnalyzer(KuzuDatabase& database,
+                                   ASTNodeProcessor& nodeProcessor,
+                                   ConstantEvaluator& constantEvaluator,
+                                   ASTContext& astContext)
+    : database(database), nodeProcessor(nodeProcessor), constantEvaluator(constantEvaluator), astContext(&astContext),
+      cfgOptions(GlobalDatabaseManager::getInstance().getAnalysisOptions().cfg)
 {
+    switch (cfgOptions.detail)
+    {
+    case CFGOptions::Detail::Full:
+        cfgBuildOptions.AddEHEdges = true;
+        cfgBuildOptions.AddLifetime = true;
+        cfgBuildOptions.AddLoopExit = true;
+        cfgBuildOptions.AddTemporaryDtors = true;
+        [[fallthrough]];
+    case CFGOptions::Detail::Standard:
+        cfgBuildOptions.AddInitializers = true;
+        cfgBuildOptions.AddImplicitDtors = true;
+        break;
+    case CFGOptions::Detail::Basic:
+        break;
+    }
+}
+
+auto AdvancedAnalyzer::shouldBuildCFG(const clang::FunctionDecl* func) const -> bool
+{
+    switch (cfgOptions.scope)
+    {
+    case CFGOptions::Scope::None:
+        return false;
+    case CFGOptions::Scope::MainFile:
+    {
+        const auto& sourceManager = astContext->getSourceManager();
+        return sourceManager.isInMainFile(sourceManager.getExpansionLoc(func->getLocation()));
+    }
+    case CFGOptions::Scope::Matching:
+        return cfgOptions.pattern && cfgOptions.pattern->match(func->getQualifiedNameAsString());
+    case CFGOptions::Scope::All:
+        return true;
+    }
+    return true;
 }
 
 void AdvancedAnalyzer::analyzeCFGForFunction(const clang::FunctionDecl* func, int64_t functionNodeId)
@@ -34,60 +77,36 @@ void AdvancedAnalyzer::analyzeCFGForFunction(const clang::FunctionDecl* func, in
         return;
 
     // Only analyze functions with bodies
-    if (!func->hasBody())
+    if (!func->hasBody() || !shouldBuildCFG(func))
         return;
 
+    PhaseTimer timer(StatisticsPhase::CFGAnalysis);
+
+    // CFGs do not outlive this function, so a CFG counts until its blocks are stored
+    auto& monitor = MemoryMonitor::getInstance();
+    size_t accountedBytes = 0;
     try
     {
-        // Build CFG for the function
-        CFG::BuildOptions buildOptions;
-        buildOptions.AddEHEdges = true;
-        buildOptions.AddInitializers = true;
-        buildOptions.AddImplicitDtors = true;
-        buildOptions.AddLifetime = true;
-        buildOptions.AddLoopExit = true;
-        buildOptions.AddTemporaryDtors = true;
-
-        std::unique_ptr<CFG> cfg = CFG::buildCFG(func, func->getBody(), astContext, buildOptions);
+        // Building a CFG folds conditions with the constant evaluator, which fills the ASTContext's
+        // type and layout caches; those are not synchronized, so every analysis of a translation unit
+        // runs on the thread traversing it and parallelism comes from indexing several units at once
+        std::unique_ptr<CFG> cfg = CFG::buildCFG(func, func->getBody(), astContext, cfgBuildOptions);
         if (!cfg)
             return;
 
-        // Process each CFG block
-        for (CFG::const_iterator blockIt = cfg->begin(); blockIt != cfg->end(); ++blockIt)
-        {
-            const CFGBlock* block = *blockIt;
-            if (block == nullptr)
-                continue;
-
-            int blockIndex = block->getBlockID();
-            bool isEntry = (block == &cfg->getEntry());
-            bool isExit = (block == &cfg->getExit());
+        if (monitor.isEnabled())
+            monitor.update(MemorySubsystem::CFG, accountedBytes, cfg->getAllocator().getTotalMemory());
 
-            // Create node for this CFG block
-            static int64_t cfgBlockIdCounter = 2000000;  // Start high to avoid conflicts
-            int64_t blockNodeId = cfgBlockIdCounter++;
-
-            createCFGBlockNode(blockNodeId, functionNodeId, block, blockIndex, isEntry, isExit);
-
-            // Create edges to successor blocks
-            for (CFGBlock::const_succ_iterator succIt = block->succ_begin(); succIt != block->succ_end(); ++succIt)
-            {
-                const CFGBlock* succBlock = succIt->getReachableBlock();
-                if (succBlock != nullptr)
-                {
-                    int64_t succBlockNodeId = cfgBlockIdCounter + succBlock->getBlockID();
-                    std::string edgeType = extractCFGEdgeType(*block);
-                    std::string condition = extractCFGCondition(block);
-
-                    createCFGEdgeRelation(blockNodeId, succBlockNodeId, edgeType, condition);
-                }
-            }
-        }
+        if (cfgOptions.format == CFGOptions::Format::Compact)
+            createCompactCFG(*cfg, functionNodeId);
+        else
+            createCFGGraph(*cfg, functionNodeId);
     }
     catch (const std::exception& e)
     {
         llvm::errs() << "Exception analyzing CFG: " << e.what() << "\n";
     }
+    monitor.update(MemorySubsystem::CFG, accountedBytes, 0);
 }
 
 void AdvancedAnalyzer::createConstantExpressionNode(int64_t nodeId,
@@ -102,38 +121,29 @@ void AdvancedAnalyzer::createConstantExpressionNode(int64_t nodeId,
     {
         std::string evaluationResult = evaluateConstantExpression(expr);
         std::string resultType = expr->getType().isNull() ? "unknown" : expr->getType().getAsString();
-        bool isCompileTimeConstant = expr->isEvaluatable(*astContext);
+        // A constant expression without side effects is what Expr::isEvaluatable() accepts, minus folding
+        const auto& evaluation = constantEvaluator.evaluate(expr);
+        bool isCompileTimeConstant =
+            evaluation.status == ConstantEvaluator::Status::Constant && !evaluation.result.HasSideEffects;
         auto [constantValue, constantType] = extractConstantValue(expr);
         std::string evaluationStatus = extractEvaluationStatus(expr);
 
-        // Escape single quotes for database storage
-        std::string cleanEvaluationContext = evaluationContext;
-        std::string cleanEvaluationResult = evaluationResult;
-        std::string cleanResultType = resultType;
-        std::string cleanConstantValue = constantValue;
-        std::string cleanConstantType = constantType;
-
-        cleanEvaluationContext = KuzuDatabase::escapeString(cleanEvaluationContext);
-        cleanEvaluationResult = KuzuDatabase::escapeString(cleanEvaluationResult);
-        cleanResultType = KuzuDatabase::escapeString(cleanResultType);
-        cleanConstantValue = KuzuDatabase::escapeString(cleanConstantValue);
-        cleanConstantType = KuzuDatabase::escapeString(cleanConstantType);
-
         // Generate a unique node ID for the ConstantExpression table
         int64_t constantExprNodeId = database.getNextNodeId();
 
-        std::string query = "CREATE (ce:ConstantExpression {node_id: " + std::to_string(constantExprNodeId) +
-                            ", is_constexpr_function: " + (isConstexprFunction ? "true" : "false") +
-                            ", evaluation_context: '" + cleanEvaluationContext + "', evaluation_result: '" +
-                            cleanEvaluationResult + "', result_type: '" + cleanResultType +
-                            "', is_compile_time_constant: " + (isCompileTimeConstant ? "true" : "false") +
-                            ", constant_value: '" + cleanConstantValue + "', constant_type: '" + cleanConstantType +
-                            "', evaluation_status: '" + evaluationStatus + "'})";
-
-        database.addToBatch(query);
+        database.addNodeToBatch("ConstantExpression",
+                                {{"node_id", constantExprNodeId},
+                                 {"is_constexpr_function", isConstexprFunction},
+                                 {"evaluation_context", evaluationContext},
+                                 {"evaluation_result", evaluationResult},
+                                 {"result_type", resultType},
+                                 {"is_compile_time_constant", isCompileTimeConstant},
+                                 {"constant_value", constantValue},
+                                 {"constant_type", constantType},
+                                 {"evaluation_status", evaluationStatus}});
 
         std::map<std::string, std::string> properties;
-        properties["evaluation_stage"] = cleanEvaluationContext;
+        properties["evaluation_stage"] = evaluationContext;
         database.addRelationshipToBatch(nodeId, constantExprNodeId, "HAS_CONSTANT_VALUE", properties);
     }
     catch (const std::exception& e)
@@ -153,18 +163,13 @@ void AdvancedAnalyzer::createStaticAssertionNode(int64_t nodeId, const clang::St
         std::string failureReason = assertionResult ? "" : "static_assert_failed";
         std::string evaluationContext = "compile_time";
 
-        // Escape strings for safe database storage
-        assertionExpression = KuzuDatabase::escapeString(assertionExpression);
-        assertionMessage = KuzuDatabase::escapeString(assertionMessage);
-        failureReason = KuzuDatabase::escapeString(failureReason);
-
-        std::string query = "CREATE (sa:StaticAssertion {node_id: " + std::to_string(nodeId) +
-                            ", assertion_expression: '" + assertionExpression + "', assertion_message: '" +
-                            assertionMessage + "', assertion_result: " + (assertionResult ? "true" : "false") +
-                            ", failure_reason: '" + failureReason + "', evaluation_context: '" + evaluationContext +
-                            "'})";
-
-        database.addToBatch(query);
+        database.addNodeToBatch("StaticAssertion",
+                                {{"node_id", nodeId},
+                                 {"assertion_expression", assertionExpression},
+                                 {"assertion_message", assertionMessage},
+                                 {"assertion_result", assertionResult},
+                                 {"failure_reason", failureReason},
+                                 {"evaluation_context", evaluationContext}});
     }
     catch (const std::exception& e)
     {
@@ -196,23 +201,24 @@ void AdvancedAnalyzer::createMacroDefinitionNode(int64_t nodeId,
             parameterNames += parameters[i];
         }
 
-        // Use proper escaping for database storage
-        std::string cleanMacroName = KuzuDatabase::escapeString(macroName);
-        std::string cleanParameterNames = KuzuDatabase::escapeString(parameterNames);
-        std::string cleanReplacementText = KuzuDatabase::escapeString(replacementText);
-
         // Limit text length for database storage
-        if (cleanReplacementText.length() > 1000)
-            cleanReplacementText = cleanReplacementText.substr(0, 1000) + "...";
-
-        std::string query = "CREATE (md:MacroDefinition {node_id: " + std::to_string(nodeId) + ", macro_name: '" +
-                            cleanMacroName + "', is_function_like: " + (isFunctionLike ? "true" : "false") +
-                            ", parameter_count: " + std::to_string(parameterCount) + ", parameter_names: '" +
-                            cleanParameterNames + "', replacement_text: '" + cleanReplacementText +
-                            "', is_builtin: " + (isBuiltin ? "true" : "false") +
-                            ", is_conditional: " + (isConditional ? "true" : "false") + "})";
+        std::string_view storedReplacementText = replacementText;
+        std::string truncatedReplacementText;
+        if (replacementText.length() > 1000)
+        {
+            truncatedReplacementText = replacementText.substr(0, 1000) + "...";
+            storedReplacementText = truncatedReplacementText;
+        }
 
-        database.addToBatch(query);
+        database.addNodeToBatch("MacroDefinition",
+                                {{"node_id", nodeId},
+                                 {"macro_name", macroName},
+                                 {"is_function_like", isFunctionLike},
+                                 {"parameter_count", parameterCount},
+                                 {"parameter_names", parameterNames},
+                                 {"replacement_text", storedReplacementText},
+                                 {"is_builtin", isBuiltin},
+                                 {"is_conditional", isConditional}});
     }
     catch (const std::exception& e)
     {
@@ -225,25 +231,20 @@ auto AdvancedAnalyzer::evaluateConstantExpression(const clang::Expr* expr) -> st
     if (expr == nullptr)
         return "null_expression";
 
-    if (expr->isValueDependent() || expr->isTypeDependent())
-        return "dependent";
-
-    Expr::EvalResult result;
-    if (expr->EvaluateAsConstantExpr(result, *astContext))
+    const auto& evaluation = constantEvaluator.evaluate(expr);
+    switch (evaluation.status)
     {
-        if (result.Val.isInt())
-            return std::to_string(result.Val.getInt().getLimitedValue());
-        if (result.Val.isFloat())
-        {
-            llvm::SmallString<16> str;
-            result.Val.getFloat().toString(str);
-            return str.str().str();
-        }
-        if (result.Val.isLValue())
-            return "lvalue_constant";
-        return "other_constant";
+    case ConstantEvaluator::Status::Dependent:
+        return "dependent";
+    case ConstantEvaluator::Status::Constant:
+        return ConstantEvaluator::formatValue(evaluation,
+                                              evaluation.result.Val.isLValue() ? "lvalue_constant" : "other_constant");
+    case ConstantEvaluator::Status::OverBudget:
+        return "over_budget";
+    case ConstantEvaluator::Status::InvalidType:
+    case ConstantEvaluator::Status::NotConstant:
+        break;
     }
-
     return "not_constant";
 }
 
@@ -252,26 +253,16 @@ auto AdvancedAnalyzer::extractConstantValue(const clang::Expr* expr) -> std::pai
     if (expr == nullptr)
         return {"", ""};
 
-    if (expr->isValueDependent() || expr->isTypeDependent())
+    const auto& evaluation = constantEvaluator.evaluate(expr);
+    if (evaluation.status == ConstantEvaluator::Status::Dependent)
         return {"dependent", "dependent"};
 
-    Expr::EvalResult result;
-    if (expr->EvaluateAsConstantExpr(result, *astContext))
-    {
-        std::string type = expr->getType().isNull() ? "unknown" : expr->getType().getAsString();
-
-        if (result.Val.isInt())
-            return {std::to_string(result.Val.getInt().getLimitedValue()), type};
-        if (result.Val.isFloat())
-        {
-            llvm::SmallString<16> str;
-            result.Val.getFloat().toString(str);
-            return {str.str().str(), type};
-        }
-        return {"constant", type};
-    }
-
-    return {"not_constant", expr->getType().isNull() ? "unknown" : expr->getType().getAsString()};
+    std::string type = expr->getType().isNull() ? "unknown" : expr->getType().getAsString();
+    if (evaluation.status == ConstantEvaluator::Status::Constant)
+        return {ConstantEvaluator::formatValue(evaluation, "constant"), type};
+    if (evaluation.status == ConstantEvaluator::Status::OverBudget)
+        return {"over_budget", type};
+    return {"not_constant", type};
 }
 
 auto AdvancedAnalyzer::extractEvaluationStatus(const clang::Expr* expr) -> std::string
@@ -288,7 +279,10 @@ auto AdvancedAnalyzer::extractEvaluationStatus(const clang::Expr* expr) -> std::
     if (expr->containsUnexpandedParameterPack())
         return "unexpanded_pack";
 
-    if (expr->isEvaluatable(*astContext))
+    const auto& evaluation = constantEvaluator.evaluate(expr);
+    if (evaluation.status == ConstantEvaluator::Status::OverBudget)
+        return "over_budget";
+    if (evaluation.status == ConstantEvaluator::Status::Constant && !evaluation.result.HasSideEffects)
         return "evaluatable";
 
     return "not_evaluatable";
@@ -320,16 +314,9 @@ auto AdvancedAnalyzer::extractStaticAssertInfo(const clang::StaticAssertDecl* as
     bool result = false;
     if (const Expr* assertExpr = assertDecl->getAssertExpr())
     {
-        // Only evaluate if the expression is not dependent
-        if (!assertExpr->isValueDependent() && !assertExpr->isTypeDependent())
-        {
-            Expr::EvalResult evalResult;
-            if (assertExpr->EvaluateAsConstantExpr(evalResult, *astContext))
-            {
-                if (evalResult.Val.isInt())
-                    result = evalResult.Val.getInt().getBoolValue();
-            }
-        }
+        const auto& evaluation = constantEvaluator.evaluate(assertExpr);
+        if (evaluation.status == ConstantEvaluator::Status::Constant && evaluation.result.Val.isInt())
+            result = evaluation.result.Val.getInt().getBoolValue();
     }
 
     return {expression, message, result};
@@ -340,7 +327,8 @@ void AdvancedAnalyzer::createCFGBlockNode(int64_t blockNodeId,
                                           const clang::CFGBlock* block,
                                           int blockIndex,
                                           bool isEntry,
-                                          bool isExit)
+                                          bool isExit,
+                                          const std::string& condition)
 {
     if (!database.isInitialized() || (block == nullptr))
         return;
@@ -349,7 +337,6 @@ void AdvancedAnalyzer::createCFGBlockNode(int64_t blockNodeId,
     {
         std::string terminatorKind = "none";
         std::string blockContent = extractCFGBlockContent(block);
-        std::string conditionExpression = extractCFGCondition(block);
         bool hasTerminator = (block->getTerminator().getStmt() != nullptr);
         bool reachable = !block->hasNoReturnElement();
 
@@ -360,24 +347,153 @@ void AdvancedAnalyzer::createCFGBlockNode(int64_t blockNodeId,
                 terminatorKind = terminator->getStmtClassName();
         }
 
-        // Escape strings for safe database storage
-        blockContent = KuzuDatabase::escapeString(blockContent);
-        conditionExpression = KuzuDatabase::escapeString(conditionExpression);
+        database.addNodeToBatch("CFGBlock",
+                                {{"node_id", blockNodeId},
+                                 {"function_id", functionNodeId},
+                                 {"block_index", static_cast<int64_t>(blockIndex)},
+                                 {"is_entry_block", isEntry},
+                                 {"is_exit_block", isExit},
+                                 {"terminator_kind", terminatorKind},
+                                 {"block_content", blockContent},
+                                 {"condition_expression", condition},
+                                 {"has_terminator", hasTerminator},
+                                 {"reachable", reachable}});
+    }
+    catch (const std::exception& e)
+    {
+        llvm::errs() << "Exception creating CFGBlock node: " << e.what() << "\n";
+    }
+}
+
+void AdvancedAnalyzer::createCFGGraph(const clang::CFG& cfg, int64_t functionNodeId)
+{
+    // One ID per block ID, so successor edges can be created before their target block
+    int64_t firstBlockNodeId = database.reserveNodeIds(cfg.getNumBlockIDs());
+
+    // Process each CFG block
+    for (CFG::const_iterator blockIt = cfg.begin(); blockIt != cfg.end(); ++blockIt)
+    {
+        const CFGBlock* block = *blockIt;
+        if (block == nullptr)
+            continue;
+
+        int blockIndex = block->getBlockID();
+        bool isEntry = (block == &cfg.getEntry());
+        bool isExit = (block == &cfg.getExit());
+
+        // Create node for this CFG block
+        int64_t blockNodeId = firstBlockNodeId + blockIndex;
+
+        // Edge type and condition depend on the source block only
+        std::string edgeType = extractCFGEdgeType(*block);
+        std::string condition = extractCFGCondition(block);
+        createCFGBlockNode(blockNodeId, functionNodeId, block, blockIndex, isEntry, isExit, condition);
+
+        // Create edges to successor blocks
+        for (CFGBlock::const_succ_iterator succIt = block->succ_begin(); succIt != block->succ_end(); ++succIt)
+        {
+            const CFGBlock* succBlock = succIt->getReachableBlock();
+            if (succBlock != nullptr)
+            {
+                int64_t succBlockNodeId = firstBlockNodeId + succBlock->getBlockID();
+                createCFGEdgeRelation(blockNodeId, succBlockNodeId, edgeType, condition);
+            }
+        }
+    }
+}
+
+void AdvancedAnalyzer::createCompactCFG(const clang::CFG& cfg, int64_t functionNodeId)
+{
+    std::vector<const CFGBlock*> blocks(cfg.getNumBlockIDs(), nullptr);
+    for (const CFGBlock* block : cfg)
+    {
+        if (block != nullptr)
+            blocks[block->getBlockID()] = block;
+    }
 
-        std::string query = "CREATE (cfgb:CFGBlock {node_id: " + std::to_string(blockNodeId) +
-                            ", function_id: " + std::to_string(functionNodeId) +
-                            ", block_index: " + std::to_string(blockIndex) +
-                            ", is_entry_block: " + (isEntry ? "true" : "false") +
-                            ", is_exit_block: " + (isExit ? "true" : "false") + ", terminator_kind: '" +
-                            terminatorKind + "', block_content: '" + blockContent + "', condition_expression: '" +
-                            conditionExpression + "', has_terminator: " + (hasTerminator ? "true" : "false") +
-                            ", reachable: " + (reachable ? "true" : "false") + "})";
+    std::string terminators;
+    std::string successors;
+    std::string statements;
+    std::string blockText;
+    std::vector<int64_t> statementIds;
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        if (i > 0)
+        {
+            successors += ';';
+            statements += ';';
+            if (cfgOptions.blockText)
+                blockText += ';';
+        }
+        const CFGBlock* block = blocks[i];
+        if (block == nullptr)
+        {
+            terminators += '-';
+            continue;
+        }
+
+        // The edge types start with distinct letters: conditional, loop, switch, terminator, fallthrough
+        terminators += extractCFGEdgeType(*block).front();
+        if (cfgOptions.blockText)
+            blockText += extractCFGBlockContent(block);
+
+        bool first = true;
+        for (const CFGBlock::AdjacentBlock& successor : block->succs())
+        {
+            if (const CFGBlock* target = successor.getReachableBlock())
+            {
+                if (!first)
+                    successors += ',';
+                successors += std::to_string(target->getBlockID());
+                first = false;
+            }
+        }
 
-        database.addToBatch(query);
+        // Statements only have node IDs when the body was traversed
+        statementIds.clear();
+        for (const CFGElement& element : *block)
+        {
+            if (auto cfgStmt = element.getAs<CFGStmt>())
+            {
+                int64_t nodeId = nodeProcessor.getNodeId(cfgStmt->getStmt());
+                if (nodeId != -1)
+                    statementIds.push_back(nodeId);
+            }
+        }
+        std::ranges::sort(statementIds);
+        for (size_t run = 0; run < statementIds.size();)
+        {
+            size_t end = run + 1;
+            while (end < statementIds.size() && statementIds[end] <= statementIds[end - 1] + 1)
+                ++end;
+            if (run > 0)
+                statements += ',';
+            statements += std::to_string(statementIds[run]);
+            if (statementIds[end - 1] != statementIds[run])
+                statements += '-' + std::to_string(statementIds[end - 1]);
+            run = end;
+        }
+    }
+
+    try
+    {
+        // The edge, not the function_id column, makes the shard merger drop the CFG with its function
+        int64_t cfgNodeId = database.getNextNodeId();
+        database.addNodeToBatch("FunctionCFG",
+                                {{"node_id", cfgNodeId},
+                                 {"function_id", functionNodeId},
+                                 {"block_count", static_cast<int64_t>(blocks.size())},
+                                 {"entry_block", static_cast<int64_t>(cfg.getEntry().getBlockID())},
+                                 {"exit_block", static_cast<int64_t>(cfg.getExit().getBlockID())},
+                                 {"terminators", terminators},
+                                 {"successors", successors},
+                                 {"statements", statements},
+                                 {"block_content", blockText}});
+        database.addRelationshipToBatch(functionNodeId, cfgNodeId, "HAS_CFG", {{"cfg_format", "compact"}});
     }
     catch (const std::exception& e)
     {
-        llvm::errs() << "Exception creating CFGBlock node: " << e.what() << "\n";
+        llvm::errs() << "Exception creating FunctionCFG node: " << e.what() << "\n";
     }
 }
 
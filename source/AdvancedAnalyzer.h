@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "AnalysisOptions.h"
+
 // clang-format off
 #include "NoWarningScope_Enter.h"
 #include "clang/AST/ASTContext.h"
@@ -25,6 +27,7 @@ namespace clang
 
 class KuzuDatabase;
 class ASTNodeProcessor;
+class ConstantEvaluator;
 
 /// Handles advanced analysis including CFG, constant expressions, macros
 class AdvancedAnalyzer
@@ -33,10 +36,14 @@ public:
     /// Constructor
     /// \param database Database instance for storage
     /// \param nodeProcessor Node processor for creating basic nodes
+    /// \param constantEvaluator Shared evaluator for constant expressions and static assertions
     /// \param astContext AST context for analysis
-    AdvancedAnalyzer(KuzuDatabase& database, ASTNodeProcessor& nodeProcessor, ASTContext& astContext);
+    AdvancedAnalyzer(KuzuDatabase& database,
+                     ASTNodeProcessor& nodeProcessor,
+                     ConstantEvaluator& constantEvaluator,
+                     ASTContext& astContext);
 
-    /// Analyze CFG for a function
+    /// Analyze CFG for a function, if the run's CFGOptions select it
     /// \param func Function declaration to analyze
     /// \param functionNodeId Node ID of the function
     void analyzeCFGForFunction(const clang::FunctionDecl* func, int64_t functionNodeId);
@@ -101,7 +108,13 @@ public:
 private:
     KuzuDatabase& database;
     ASTNodeProcessor& nodeProcessor;
+    ConstantEvaluator& constantEvaluator;
     ASTContext* astContext;
+    const CFGOptions& cfgOptions;
+    CFG::BuildOptions cfgBuildOptions;
+
+    /// Check whether the CFGOptions select a function
+    auto shouldBuildCFG(const clang::FunctionDecl* func) const -> bool;
 
     /// Create CFG block node
     /// \param blockNodeId Node ID for the block
@@ -110,12 +123,27 @@ private:
     /// \param blockIndex Index of block
     /// \param isEntry Whether this is entry block
     /// \param isExit Whether this is exit block
+    /// \param condition The block's extractCFGCondition(), shared with its edges
     void createCFGBlockNode(int64_t blockNodeId,
                             int64_t functionNodeId,
                             const clang::CFGBlock* block,
                             int blockIndex,
                             bool isEntry,
-                            bool isExit);
+                            bool isExit,
+                            const std::string& condition);
+
+    /// Store a CFG as a CFGBlock row per block and a CFG_EDGE relationship per successor
+    /// \param cfg The CFG
+    /// \param functionNodeId Function the CFG belongs to
+    void createCFGGraph(const clang::CFG& cfg, int64_t functionNodeId);
+
+    /// Store a CFG as one FunctionCFG row
+    /// Per block, in block ID order and separated by ';': the successor block IDs,
+    /// and the node IDs of the statements as ascending ranges "first-last". Each
+    /// block's terminator is one letter of extractCFGEdgeType().
+    /// \param cfg The CFG
+    /// \param functionNodeId Function the CFG belongs to
+    void createCompactCFG(const clang::CFG& cfg, int64_t functionNodeId);
 
     /// Create CFG edge relationship
     /// \param fromBlockId Source block node ID
@@ -0,0 +1,139 @@
+//===--- AnalysisOptions.cpp - Per-run settings of the analyzers ----------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "AnalysisOptions.h"
+
+// clang-format off
+#include <doctest/doctest.h>
+
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Error.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+using namespace clang;
+
+auto CFGOptions::parseScope(llvm::StringRef spec, std::string& error) -> bool
+{
+    if (spec == "none")
+        scope = Scope::None;
+    else if (spec == "defined-in-main-file")
+        scope = Scope::MainFile;
+    else if (spec == "all")
+        scope = Scope::All;
+    else if (spec.consume_front("matching:"))
+    {
+        auto glob = llvm::GlobPattern::create(spec);
+        if (!glob)
+        {
+            error = llvm::toString(glob.takeError());
+            return false;
+        }
+        scope = Scope::Matching;
+        pattern = std::move(*glob);
+    }
+    else
+    {
+        error = "expected none, defined-in-main-file, matching:<pattern> or all";
+        return false;
+    }
+    return true;
+}
+
+auto AnalysisProfile::parse(llvm::StringRef spec, std::string& error) -> bool
+{
+    AnalysisProfile profile;
+    profile.types = profile.statements = profile.templates = profile.comments = false;
+    profile.advanced = profile.calls = false;
+
+    llvm::SmallVector<llvm::StringRef, 7> components;
+    spec.split(components, '+');
+    for (llvm::StringRef component : components)
+    {
+        component = component.trim();
+        if (component == "full")
+            profile = AnalysisProfile();
+        else if (component == "types")
+            profile.types = true;
+        else if (component == "stmts")
+            profile.statements = true;
+        else if (component == "templates")
+            profile.templates = true;
+        else if (component == "comments")
+            profile.comments = true;
+        else if (component == "advanced")
+            profile.advanced = true;
+        else if (component == "calls")
+            profile.calls = true;
+        else if (component != "decls")
+        {
+            error = "unknown component '" + component.str() +
+                    "', expected decls, types, stmts, templates, comments, advanced, calls or full";
+            return false;
+        }
+    }
+    *this = profile;
+    return true;
+}
+
+TEST_CASE("CFGOptions::parseScope")
+{
+    CFGOptions options;
+    std::string error;
+    CHECK(options.parseScope("none", error));
+    CHECK(options.scope == CFGOptions::Scope::None);
+    CHECK(options.parseScope("defined-in-main-file", error));
+    CHECK(options.scope == CFGOptions::Scope::MainFile);
+    CHECK(options.parseScope("all", error));
+    CHECK(options.scope == CFGOptions::Scope::All);
+
+    REQUIRE(options.parseScope("matching:*::parse*", error));
+    CHECK(options.scope == CFGOptions::Scope::Matching);
+    REQUIRE(options.pattern);
+    CHECK(options.pattern->match("clang::AnalysisProfile::parse"));
+    CHECK_FALSE(options.pattern->match("clang::AnalysisProfile::print"));
+
+    CHECK_FALSE(options.parseScope("matching:[", error));
+    CHECK_FALSE(error.empty());
+    error.clear();
+    CHECK_FALSE(options.parseScope("some", error));
+    CHECK_FALSE(error.empty());
+    CHECK(options.scope == CFGOptions::Scope::Matching);
+}
+
+TEST_CASE("AnalysisProfile::parse")
+{
+    AnalysisProfile profile;
+    std::string error;
+
+    REQUIRE(profile.parse("decls", error));
+    CHECK_FALSE(profile.types);
+    CHECK_FALSE(profile.statements);
+    CHECK_FALSE(profile.templates);
+    CHECK_FALSE(profile.comments);
+    CHECK_FALSE(profile.advanced);
+    CHECK_FALSE(profile.calls);
+
+    REQUIRE(profile.parse("decls + types+calls", error));
+    CHECK(profile.types);
+    CHECK(profile.calls);
+    CHECK_FALSE(profile.statements);
+    CHECK_FALSE(profile.advanced);
+
+    REQUIRE(profile.parse("full", error));
+    CHECK(profile.types);
+    CHECK(profile.statements);
+    CHECK(profile.templates);
+    CHECK(profile.comments);
+    CHECK(profile.advanced);
+    CHECK(profile.calls);
+
+    // A rejected value names the component and leaves the profile as it was
+    CHECK_FALSE(profile.parse("decls+cfg", error));
+    CHECK(llvm::StringRef(error).contains("'cfg'"));
+    CHECK(profile.statements);
+}
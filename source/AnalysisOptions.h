@@ -0,0 +1,97 @@
+//===--- AnalysisOptions.h - Per-run settings of the analyzers ------------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/GlobPattern.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+namespace clang
+{
+
+/// Which functions get a control flow graph, and how detailed it is
+struct CFGOptions
+{
+    /// Functions whose bodies get a CFG
+    enum class Scope
+    {
+        None,
+        MainFile,  // Functions defined in the main file of their translation unit
+        Matching,  // Functions whose qualified name matches the pattern
+        All
+    };
+
+    /// CFG::BuildOptions presets, from cheapest to most detailed
+    enum class Detail
+    {
+        Basic,     // Blocks and edges of the written statements only
+        Standard,  // Plus initializers and implicit destructors, as Clang's own analyses use
+        Full       // Plus exception edges, lifetime ends, loop exits and temporary destructors
+    };
+
+    /// How a CFG is stored
+    enum class Format
+    {
+        Graph,   // A CFGBlock row per block and a CFG_EDGE relationship per successor
+        Compact  // One FunctionCFG row per function with packed successor and statement lists
+    };
+
+    Scope scope = Scope::All;
+    Detail detail = Detail::Full;
+    Format format = Format::Graph;
+    bool blockText = false;  // Store block descriptions in FunctionCFG rows
+    std::optional<llvm::GlobPattern> pattern;  // Set for Scope::Matching
+
+    /// Parse a --cfg value: none, defined-in-main-file, matching:<pattern> or all
+    /// \param spec The value
+    /// \param error Receives the reason if the value is rejected
+    /// \return False if \p spec is malformed
+    auto parseScope(llvm::StringRef spec, std::string& error) -> bool;
+};
+
+/// Limits on the constant evaluation behind the is_constexpr and ConstantExpression columns
+struct ConstantEvaluationOptions
+{
+    unsigned stepLimit = 65536;              // Evaluator steps per expression, as -fconstexpr-steps; 0 for Clang's
+    std::chrono::milliseconds timeBudget{};  // Evaluation time per translation unit; zero for no limit
+};
+
+/// Which analyzers run; AST nodes, declarations and their scopes are always indexed
+struct AnalysisProfile
+{
+    bool types = true;
+    bool statements = true;  // Statement and Expression rows; without them function bodies are not traversed
+    bool templates = true;
+    bool comments = true;
+    bool advanced = true;  // Constant evaluation, static assertions and control flow graphs
+    bool calls = true;     // CALLS edges, collected from function bodies even without statements
+
+    /// Parse a --profile value: components joined by '+', from decls, types, stmts,
+    /// templates, comments, advanced and calls, or full for all of them
+    /// \param spec The value, e.g. decls+types
+    /// \param error Receives the reason if the value is rejected
+    /// \return False if \p spec names an unknown component
+    auto parse(llvm::StringRef spec, std::string& error) -> bool;
+};
+
+/// Per-run settings of the analyzers, shared by all indexing threads
+struct AnalysisOptions
+{
+    AnalysisProfile profile;
+    CFGOptions cfg;
+    ConstantEvaluationOptions constants;
+    bool instantiationBodies = false;  // Traverse implicit template instantiations instead of summarizing them
+};
+
+}  // namespace clang
@@ -0,0 +1,921 @@
+//===--- ArrowExporter.cpp - Arrow IPC files written from the row buffers -===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "ArrowExporter.h"
+
+// clang-format off
+#include <doctest/doctest.h>
+
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+using namespace clang;
+
+namespace
+{
+
+static_assert(std::endian::native == std::endian::little, "Arrow IPC buffers are written in host byte order");
+
+constexpr std::string_view FILE_MAGIC("ARROW1\0\0", 8);
+constexpr uint32_t CONTINUATION = 0xFFFFFFFF;
+
+// Schema.fbs and Message.fbs constants
+constexpr int16_t METADATA_VERSION_V5 = 4;
+constexpr uint8_t HEADER_SCHEMA = 1;
+constexpr uint8_t HEADER_RECORD_BATCH = 3;
+constexpr uint8_t TYPE_INT = 2;
+constexpr uint8_t TYPE_UTF8 = 5;
+constexpr uint8_t TYPE_BOOL = 6;
+
+/// Minimal FlatBuffers encoder for the Arrow IPC metadata
+/// Objects are laid out front to back, each one ahead of the objects it refers
+/// to, so every offset points forward as the format requires. Only what the
+/// Arrow schemas use is supported: tables of scalars and offsets, strings, and
+/// vectors of tables or structs.
+class FlatBuffer
+{
+public:
+    struct Object;
+    using Ref = std::unique_ptr<Object>;
+
+    struct Object
+    {
+        enum class Kind
+        {
+            Table,
+            String,
+            TableVector,
+            StructVector
+        };
+
+        struct Scalar
+        {
+            uint16_t slot;
+            uint8_t size;
+            uint64_t bits;
+        };
+
+        Kind kind = Kind::Table;
+        std::vector<Scalar> scalars;                   // Table fields stored inline
+        std::vector<std::pair<uint16_t, Ref>> fields;  // Table fields referring to other objects
+        std::vector<Ref> elements;                     // TableVector
+        std::string bytes;                             // String characters or StructVector elements
+        uint32_t length = 0;                           // StructVector element count
+        size_t alignment = 4;                          // StructVector element alignment
+    };
+
+    static auto table() -> Ref { return std::make_unique<Object>(); }
+
+    template <typename T> static void addScalar(Object& table, uint16_t slot, T value)
+    {
+        static_assert(std::is_integral_v<T> && sizeof(T) <= sizeof(uint64_t));
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(T));
+        table.scalars.push_back({slot, static_cast<uint8_t>(sizeof(T)), bits});
+    }
+
+    static void addField(Object& table, uint16_t slot, Ref object)
+    {
+        table.fields.emplace_back(slot, std::move(object));
+    }
+
+    static auto string(std::string_view value) -> Ref
+    {
+        auto object = std::make_unique<Object>();
+        object->kind = Object::Kind::String;
+        object->bytes = value;
+        return object;
+    }
+
+    static auto tableVector(std::vector<Ref> elements) -> Ref
+    {
+        auto object = std::make_unique<Object>();
+        object->kind = Object::Kind::TableVector;
+        object->elements = std::move(elements);
+        return object;
+    }
+
+    template <typename T> static auto structVector(std::span<const T> elements) -> Ref
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto object = std::make_unique<Object>();
+        object->kind = Object::Kind::StructVector;
+        object->bytes.assign(reinterpret_cast<const char*>(elements.data()), elements.size_bytes());
+        object->length = static_cast<uint32_t>(elements.size());
+        object->alignment = std::max<size_t>(alignof(T), 4);
+        return object;
+    }
+
+    /// Serialize a buffer whose root is the given table, padded to 8 bytes
+    static auto finish(const Object& root) -> std::string
+    {
+        std::string out;
+        append<uint32_t>(out, 0);
+        size_t position = write(out, root);
+        put<uint32_t>(out, 0, static_cast<uint32_t>(position));
+        pad(out, 8);
+        return out;
+    }
+
+private:
+    /// Pad so that (size + extra) is a multiple of the alignment
+    static void pad(std::string& out, size_t alignment, size_t extra = 0)
+    {
+        while ((out.size() + extra) % alignment != 0)
+            out.push_back('\0');
+    }
+
+    template <typename T> static void put(std::string& out, size_t position, T value)
+    {
+        std::memcpy(out.data() + position, &value, sizeof(T));
+    }
+
+    template <typename T> static void append(std::string& out, T value)
+    {
+        out.resize(out.size() + sizeof(T));
+        put(out, out.size() - sizeof(T), value);
+    }
+
+    /// Point the uoffset at a position to an object written later
+    static void link(std::string& out, size_t position, size_t target)
+    {
+        put<uint32_t>(out, position, static_cast<uint32_t>(target - position));
+    }
+
+    /// Write an object followed by everything it refers to
+    /// \return Position of the object, which offsets to it point at
+    static auto write(std::string& out, const Object& object) -> size_t
+    {
+        switch (object.kind)
+        {
+        case Object::Kind::String:
+        {
+            pad(out, 4);
+            size_t position = out.size();
+            append<uint32_t>(out, static_cast<uint32_t>(object.bytes.size()));
+            out += object.bytes;
+            out.push_back('\0');
+            return position;
+        }
+        case Object::Kind::StructVector:
+        {
+            // The elements, not the length in front of them, carry the struct alignment
+            pad(out, object.alignment, sizeof(uint32_t));
+            size_t position = out.size();
+            append<uint32_t>(out, object.length);
+            out += object.bytes;
+            return position;
+        }
+        case Object::Kind::TableVector:
+        {
+            pad(out, 4);
+            size_t position = out.size();
+            append<uint32_t>(out, static_cast<uint32_t>(object.elements.size()));
+            size_t slots = out.size();
+            out.resize(slots + sizeof(uint32_t) * object.elements.size());
+            for (size_t i = 0; i < object.elements.size(); ++i)
+                link(out, slots + sizeof(uint32_t) * i, write(out, *object.elements[i]));
+            return position;
+        }
+        case Object::Kind::Table:
+            break;
+        }
+
+        uint16_t slotCount = 0;
+        size_t alignment = 4;
+        for (const auto& scalar : object.scalars)
+        {
+            slotCount = std::max(slotCount, static_cast<uint16_t>(scalar.slot + 1));
+            alignment = std::max<size_t>(alignment, scalar.size);
+        }
+        for (const auto& [slot, _] : object.fields)
+            slotCount = std::max(slotCount, static_cast<uint16_t>(slot + 1));
+
+        // The vtable goes first; the table refers back to it with a signed offset
+        pad(out, 2);
+        size_t vtable = out.size();
+        out.resize(vtable + sizeof(uint16_t) * (2 + slotCount));
+        pad(out, alignment);
+        size_t table = out.size();
+        append<int32_t>(out, static_cast<int32_t>(table - vtable));
+
+        auto setSlot = [&](uint16_t slot)
+        { put<uint16_t>(out, vtable + sizeof(uint16_t) * (2 + slot), static_cast<uint16_t>(out.size() - table)); };
+
+        // Widest scalars first, each at its natural alignment within the buffer
+        std::vector<const Object::Scalar*> scalars;
+        for (const auto& scalar : object.scalars)
+            scalars.push_back(&scalar);
+        std::ranges::stable_sort(scalars, std::greater<>(), [](const Object::Scalar* scalar) { return scalar->size; });
+        for (const Object::Scalar* scalar : scalars)
+        {
+            pad(out, scalar->size);
+            setSlot(scalar->slot);
+            out.append(reinterpret_cast<const char*>(&scalar->bits), scalar->size);
+        }
+
+        std::vector<size_t> fieldPositions;
+        for (const auto& [slot, _] : object.fields)
+        {
+            pad(out, 4);
+            setSlot(slot);
+            fieldPositions.push_back(out.size());
+            append<uint32_t>(out, 0);
+        }
+
+        put<uint16_t>(out, vtable, static_cast<uint16_t>(sizeof(uint16_t) * (2 + slotCount)));
+        put<uint16_t>(out, vtable + sizeof(uint16_t), static_cast<uint16_t>(out.size() - table));
+
+        for (size_t i = 0; i < object.fields.size(); ++i)
+            link(out, fieldPositions[i], write(out, *object.fields[i].second));
+        return table;
+    }
+};
+
+/// FieldNode struct of Message.fbs
+struct FieldNode
+{
+    int64_t length;
+    int64_t nullCount;
+};
+
+/// Buffer struct of Schema.fbs, relative to the start of the message body
+struct BufferLocation
+{
+    int64_t offset;
+    int64_t length;
+};
+
+/// Name and type of every column of a table's files, relationship endpoints included
+auto getFileColumns(const SchemaTable& table) -> std::vector<SchemaColumn>
+{
+    std::vector<SchemaColumn> columns;
+    if (table.isRelationship())
+    {
+        columns.push_back({"from", ColumnBuffer::ColumnType::Int64});
+        columns.push_back({"to", ColumnBuffer::ColumnType::Int64});
+    }
+    columns.insert(columns.end(), table.columns.begin(), table.columns.end());
+    return columns;
+}
+
+/// The Schema table describing a table's files
+auto buildSchema(const SchemaTable& table) -> FlatBuffer::Ref
+{
+    std::vector<FlatBuffer::Ref> fields;
+    for (const SchemaColumn& column : getFileColumns(table))
+    {
+        auto type = FlatBuffer::table();
+        uint8_t typeId = TYPE_UTF8;
+        if (column.type == ColumnBuffer::ColumnType::Int64)
+        {
+            typeId = TYPE_INT;
+            FlatBuffer::addScalar<int32_t>(*type, 0, 64);  // bitWidth
+            FlatBuffer::addScalar<uint8_t>(*type, 1, 1);   // is_signed
+        }
+        else if (column.type == ColumnBuffer::ColumnType::Bool)
+            typeId = TYPE_BOOL;
+
+        auto field = FlatBuffer::table();
+        FlatBuffer::addField(*field, 0, FlatBuffer::string(column.name));
+        FlatBuffer::addScalar<uint8_t>(*field, 1, 1);  // nullable
+        FlatBuffer::addScalar<uint8_t>(*field, 2, typeId);
+        FlatBuffer::addField(*field, 3, std::move(type));
+        // Readers expect the children vector even for primitive types
+        FlatBuffer::addField(*field, 5, FlatBuffer::tableVector({}));
+        fields.push_back(std::move(field));
+    }
+
+    auto schema = FlatBuffer::table();
+    FlatBuffer::addField(*schema, 1, FlatBuffer::tableVector(std::move(fields)));
+    return schema;
+}
+
+/// Serialized Message table wrapping a header
+auto buildMessage(uint8_t headerType, FlatBuffer::Ref header, int64_t bodyLength) -> std::string
+{
+    auto message = FlatBuffer::table();
+    FlatBuffer::addScalar<int16_t>(*message, 0, METADATA_VERSION_V5);
+    FlatBuffer::addScalar<uint8_t>(*message, 1, headerType);
+    FlatBuffer::addField(*message, 2, std::move(header));
+    FlatBuffer::addScalar<int64_t>(*message, 3, bodyLength);
+    return FlatBuffer::finish(*message);
+}
+
+/// Write the continuation marker, metadata length and metadata of a message
+/// \return Bytes written, which the footer records as the block's metadata length
+auto writeMessageMetadata(llvm::raw_ostream& os, const std::string& metadata) -> int32_t
+{
+    auto length = static_cast<int32_t>(metadata.size());
+    os.write(reinterpret_cast<const char*>(&CONTINUATION), sizeof(CONTINUATION));
+    os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    os << metadata;
+    return static_cast<int32_t>(sizeof(CONTINUATION) + sizeof(length)) + length;
+}
+
+void appendBit(std::vector<uint8_t>& bits, size_t index, bool value)
+{
+    if (index % 8 == 0)
+        bits.push_back(0);
+    if (value)
+        bits.back() |= static_cast<uint8_t>(1U << (index % 8));
+}
+
+}  // namespace
+
+/// Values of one column of a record batch, in Arrow's buffer layout
+class ArrowExporter::Column
+{
+public:
+    explicit Column(ColumnBuffer::ColumnType type) : type(type) {}
+
+    void appendNull()
+    {
+        appendBit(validity, length++, false);
+        ++nullCount;
+        if (type == ColumnBuffer::ColumnType::Int64)
+            ints.push_back(0);
+        else if (type == ColumnBuffer::ColumnType::Bool)
+            appendBit(bits, length - 1, false);
+        else
+            offsets.push_back(static_cast<int32_t>(chars.size()));
+    }
+
+    void appendInt64(int64_t value)
+    {
+        appendBit(validity, length++, true);
+        ints.push_back(value);
+    }
+
+    void appendBool(bool value)
+    {
+        appendBit(validity, length, true);
+        appendBit(bits, length++, value);
+    }
+
+    void appendString(std::string_view value)
+    {
+        // Utf8 offsets are 32 bits; a batch never comes close, but a value past the limit is not silently cut
+        if (chars.size() + value.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+        {
+            appendNull();
+            return;
+        }
+        appendBit(validity, length++, true);
+        chars += value;
+        offsets.push_back(static_cast<int32_t>(chars.size()));
+    }
+
+    /// Append a value given as text, as relationship properties are
+    void appendText(std::string_view text)
+    {
+        if (type == ColumnBuffer::ColumnType::String)
+            appendString(text);
+        else if (type == ColumnBuffer::ColumnType::Bool)
+            appendBool(text == "true" || text == "1");
+        else
+        {
+            int64_t value = 0;
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (ec == std::errc() && end == text.data() + text.size())
+                appendInt64(value);
+            else
+                appendNull();
+        }
+    }
+
+    /// The buffers of the column, in the order Arrow lists them for its type
+    [[nodiscard]] auto getBuffers() const -> std::vector<std::string_view>
+    {
+        auto bytesOf = [](const auto& values)
+        { return std::string_view(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0])); };
+
+        // Without nulls the validity bitmap may be omitted
+        std::vector<std::string_view> buffers{nullCount == 0 ? std::string_view() : bytesOf(validity)};
+        if (type == ColumnBuffer::ColumnType::Int64)
+            buffers.push_back(bytesOf(ints));
+        else if (type == ColumnBuffer::ColumnType::Bool)
+            buffers.push_back(bytesOf(bits));
+        else
+        {
+            buffers.push_back(bytesOf(offsets));
+            buffers.emplace_back(chars);
+        }
+        return buffers;
+    }
+
+    [[nodiscard]] auto getLength() const -> size_t { return length; }
+    [[nodiscard]] auto getNullCount() const -> size_t { return nullCount; }
+
+private:
+    ColumnBuffer::ColumnType type;
+    size_t length = 0;
+    size_t nullCount = 0;
+    std::vector<uint8_t> validity;
+    std::vector<int64_t> ints;
+    std::vector<uint8_t> bits;
+    std::vector<int32_t> offsets{0};
+    std::string chars;
+};
+
+ArrowExporter::ArrowExporter(std::string directory) : directory(std::move(directory))
+{
+    std::filesystem::create_directories(this->directory);
+}
+
+auto ArrowExporter::openTable(const std::string& table) -> TableFile*
+{
+    auto it = files.find(table);
+    if (it != files.end())
+        return it->second.stream ? &it->second : nullptr;
+
+    TableFile& file = files[table];
+    file.path = (std::filesystem::path(directory) / (table + ".arrow")).generic_string();
+    file.schema = findSchemaTable(table);
+    if (file.schema == nullptr)
+    {
+        // Leave the stream unset so the table is skipped from now on; reported once
+        llvm::errs() << "Arrow export: table " << table << " is not in the schema, skipping its rows\n";
+        return nullptr;
+    }
+
+    std::error_code ec;
+    file.stream = std::make_unique<llvm::raw_fd_ostream>(file.path, ec);
+    if (ec)
+    {
+        llvm::errs() << "Arrow export: cannot open " << file.path << ": " << ec.message() << "\n";
+        file.stream.reset();
+        return nullptr;
+    }
+
+    *file.stream << FILE_MAGIC;
+    writeMessageMetadata(*file.stream, buildMessage(HEADER_SCHEMA, buildSchema(*file.schema), 0));
+    return &file;
+}
+
+void ArrowExporter::writeNodes(const ColumnBuffer& buffer)
+{
+    if (buffer.empty())
+        return;
+    TableFile* file = openTable(buffer.getTable());
+    if (file == nullptr)
+        return;
+
+    std::vector<Column> columns;
+    for (const SchemaColumn& column : file->schema->columns)
+    {
+        Column& values = columns.emplace_back(column.type);
+        std::optional<size_t> source;
+        for (size_t i = 0; i < buffer.getColumnCount(); ++i)
+        {
+            if (buffer.getColumnName(i) == column.name && buffer.getColumnType(i) == column.type)
+                source = i;
+        }
+
+        for (size_t row = 0; row < buffer.getRowCount(); ++row)
+        {
+            if (!source)
+                values.appendNull();
+            else if (column.type == ColumnBuffer::ColumnType::Int64)
+                values.appendInt64(buffer.getInt64(*source, row));
+            else if (column.type == ColumnBuffer::ColumnType::Bool)
+                values.appendBool(buffer.getBool(*source, row));
+            else
+                values.appendString(buffer.getString(*source, row));
+        }
+    }
+
+    writeBatch(*file, columns, buffer.getRowCount());
+    nodeRows += buffer.getRowCount();
+}
+
+void ArrowExporter::writeRelationships(const Relationships& relationships)
+{
+    // One record batch per table, with the rows of each table in their original order
+    std::map<std::string_view, std::vector<size_t>> rowsByTable;
+    for (size_t i = 0; i < relationships.size(); ++i)
+        rowsByTable[std::get<2>(relationships[i])].push_back(i);
+
+    for (const auto& [table, rows] : rowsByTable)
+    {
+        TableFile* file = openTable(std::string(table));
+        if (file == nullptr)
+            continue;
+
+        std::vector<Column> columns;
+        columns.reserve(2 + file->schema->columns.size());
+        Column& from = columns.emplace_back(ColumnBuffer::ColumnType::Int64);
+        Column& to = columns.emplace_back(ColumnBuffer::ColumnType::Int64);
+        for (size_t row : rows)
+        {
+            from.appendInt64(std::get<0>(relationships[row]));
+            to.appendInt64(std::get<1>(relationships[row]));
+        }
+        for (const SchemaColumn& column : file->schema->columns)
+        {
+            Column& values = columns.emplace_back(column.type);
+            for (size_t row : rows)
+            {
+                const auto& properties = std::get<3>(relationships[row]);
+                auto it = properties.find(std::string(column.name));
+                if (it == properties.end())
+                    values.appendNull();
+                else
+                    values.appendText(it->second);
+            }
+        }
+
+        writeBatch(*file, columns, rows.size());
+        relationshipRows += rows.size();
+    }
+}
+
+void ArrowExporter::writeBatch(TableFile& file, const std::vector<Column>& columns, size_t rows)
+{
+    // Every buffer starts at a multiple of 8 bytes from the start of the body
+    std::vector<FieldNode> nodes;
+    std::vector<BufferLocation> locations;
+    std::vector<std::string_view> buffers;
+    int64_t bodyLength = 0;
+    for (const Column& column : columns)
+    {
+        nodes.push_back({static_cast<int64_t>(column.getLength()), static_cast<int64_t>(column.getNullCount())});
+        for (std::string_view buffer : column.getBuffers())
+        {
+            locations.push_back({bodyLength, static_cast<int64_t>(buffer.size())});
+            buffers.push_back(buffer);
+            bodyLength += static_cast<int64_t>((buffer.size() + 7) & ~size_t{7});
+        }
+    }
+
+    auto batch = FlatBuffer::table();
+    FlatBuffer::addScalar<int64_t>(*batch, 0, static_cast<int64_t>(rows));
+    FlatBuffer::addField(*batch, 1, FlatBuffer::structVector<FieldNode>(nodes));
+    FlatBuffer::addField(*batch, 2, FlatBuffer::structVector<BufferLocation>(locations));
+
+    auto& os = *file.stream;
+    Block block{static_cast<int64_t>(os.tell()), 0, 0, bodyLength};
+    block.metaDataLength = writeMessageMetadata(os, buildMessage(HEADER_RECORD_BATCH, std::move(batch), bodyLength));
+    constexpr char PADDING[8] = {};
+    for (std::string_view buffer : buffers)
+    {
+        os << buffer;
+        os.write(PADDING, ((buffer.size() + 7) & ~size_t{7}) - buffer.size());
+    }
+    file.blocks.push_back(block);
+}
+
+auto ArrowExporter::finish() -> bool
+{
+    bool success = true;
+    for (auto& [table, file] : files)
+    {
+        if (!file.stream)
+        {
+            success = false;
+            continue;
+        }
+
+        // End-of-stream marker, then the footer indexing the record batches for random access
+        auto& os = *file.stream;
+        constexpr uint32_t END_OF_STREAM = 0;
+        os.write(reinterpret_cast<const char*>(&CONTINUATION), sizeof(CONTINUATION));
+        os.write(reinterpret_cast<const char*>(&END_OF_STREAM), sizeof(END_OF_STREAM));
+
+        auto footer = FlatBuffer::table();
+        FlatBuffer::addScalar<int16_t>(*footer, 0, METADATA_VERSION_V5);
+        FlatBuffer::addField(*footer, 1, buildSchema(*file.schema));
+        FlatBuffer::addField(*footer, 2, FlatBuffer::structVector<Block>({}));
+        FlatBuffer::addField(*footer, 3, FlatBuffer::structVector<Block>(file.blocks));
+        std::string metadata = FlatBuffer::finish(*footer);
+        auto length = static_cast<int32_t>(metadata.size());
+        os << metadata;
+        os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        os << FILE_MAGIC.substr(0, 6);
+
+        os.close();
+        if (os.has_error())
+        {
+            llvm::errs() << "Arrow export: failed to write " << file.path << ": " << os.error().message() << "\n";
+            os.clear_error();
+            success = false;
+        }
+        file.stream.reset();
+    }
+    files.clear();
+    return success;
+}
+
+namespace
+{
+
+/// Reads FlatBuffers tables by following the format, independently of the encoder above
+/// Reads are checked against the buffer bounds and the natural alignment of the
+/// value, which Arrow's verifier insists on.
+class FlatBufferReader
+{
+public:
+    explicit FlatBufferReader(std::string_view buffer) : buffer(buffer) {}
+
+    template <typename T> [[nodiscard]] auto read(size_t position) const -> T
+    {
+        REQUIRE(position + sizeof(T) <= buffer.size());
+        CHECK(position % sizeof(T) == 0);
+        T value;
+        std::memcpy(&value, buffer.data() + position, sizeof(T));
+        return value;
+    }
+
+    [[nodiscard]] auto getRoot() const -> size_t { return read<uint32_t>(0); }
+
+    /// Position of a table field
+    /// \return The position, or 0 if the table does not store the field
+    [[nodiscard]] auto getField(size_t table, uint16_t slot) const -> size_t
+    {
+        size_t vtable = static_cast<size_t>(static_cast<int64_t>(table) - read<int32_t>(table));
+        if (sizeof(uint16_t) * (2 + slot) >= read<uint16_t>(vtable))
+            return 0;
+        uint16_t offset = read<uint16_t>(vtable + sizeof(uint16_t) * (2 + slot));
+        return offset == 0 ? 0 : table + offset;
+    }
+
+    template <typename T> [[nodiscard]] auto getScalar(size_t table, uint16_t slot) const -> T
+    {
+        size_t position = getField(table, slot);
+        return position == 0 ? T{} : read<T>(position);
+    }
+
+    /// Position of the object a table field refers to
+    [[nodiscard]] auto getObject(size_t table, uint16_t slot) const -> size_t
+    {
+        size_t position = getField(table, slot);
+        REQUIRE(position != 0);
+        return position + read<uint32_t>(position);
+    }
+
+    [[nodiscard]] auto getString(size_t string) const -> std::string_view
+    {
+        return buffer.substr(string + sizeof(uint32_t), read<uint32_t>(string));
+    }
+
+    [[nodiscard]] auto getLength(size_t vector) const -> uint32_t { return read<uint32_t>(vector); }
+
+    /// Position of a table in a vector of tables
+    [[nodiscard]] auto getElement(size_t vector, size_t index) const -> size_t
+    {
+        size_t slot = vector + sizeof(uint32_t) * (1 + index);
+        return slot + read<uint32_t>(slot);
+    }
+
+private:
+    std::string_view buffer;
+};
+
+// Block struct of File.fbs: int64 offset, int32 metaDataLength padded to 8 bytes, int64 bodyLength
+constexpr size_t BLOCK_SIZE = 24;
+
+/// Field of a decoded schema
+struct DecodedField
+{
+    std::string name;
+    uint8_t typeId;
+};
+
+/// Record batch of a decoded file, with its buffers sliced from the message body
+struct DecodedBatch
+{
+    int64_t length = 0;
+    std::vector<FieldNode> nodes;
+    std::vector<std::string_view> buffers;
+};
+
+struct DecodedFile
+{
+    std::vector<DecodedField> fields;
+    std::vector<DecodedBatch> batches;
+};
+
+auto decodeFields(const FlatBufferReader& reader, size_t schema) -> std::vector<DecodedField>
+{
+    std::vector<DecodedField> fields;
+    size_t vector = reader.getObject(schema, 1);
+    for (size_t i = 0; i < reader.getLength(vector); ++i)
+    {
+        size_t field = reader.getElement(vector, i);
+        std::string_view name = reader.getString(reader.getObject(field, 0));
+        fields.push_back({std::string(name), reader.getScalar<uint8_t>(field, 2)});
+        if (fields.back().typeId == TYPE_INT)
+        {
+            size_t type = reader.getObject(field, 3);
+            CHECK(reader.getScalar<int32_t>(type, 0) == 64);
+            CHECK(reader.getScalar<uint8_t>(type, 1) == 1);
+        }
+    }
+    return fields;
+}
+
+/// Decode an Arrow IPC file through its footer, as a random-access reader does
+auto decodeArrowFile(std::string_view file) -> DecodedFile
+{
+    REQUIRE(file.size() > 2 * FILE_MAGIC.size());
+    REQUIRE(file.substr(0, FILE_MAGIC.size()) == FILE_MAGIC);
+    REQUIRE(file.substr(file.size() - 6) == FILE_MAGIC.substr(0, 6));
+
+    int32_t footerLength = 0;
+    std::memcpy(&footerLength, file.data() + file.size() - 10, sizeof(footerLength));
+    size_t footerStart = file.size() - 10 - static_cast<size_t>(footerLength);
+    CHECK(footerStart % 8 == 0);
+    FlatBufferReader footer(file.substr(footerStart, static_cast<size_t>(footerLength)));
+    size_t root = footer.getRoot();
+    CHECK(footer.getScalar<int16_t>(root, 0) == METADATA_VERSION_V5);
+
+    DecodedFile decoded;
+    decoded.fields = decodeFields(footer, footer.getObject(root, 1));
+
+    // The schema message at the start of the file must agree with the footer
+    FlatBufferReader message(file.substr(16));
+    REQUIRE(message.read<uint32_t>(0) != 0);
+    CHECK(message.getScalar<uint8_t>(message.getRoot(), 1) == HEADER_SCHEMA);
+    auto schemaFields = decodeFields(message, message.getObject(message.getRoot(), 2));
+    REQUIRE(schemaFields.size() == decoded.fields.size());
+
+    size_t blocks = footer.getObject(root, 3);
+    for (size_t i = 0; i < footer.getLength(blocks); ++i)
+    {
+        size_t block = blocks + sizeof(uint32_t) + BLOCK_SIZE * i;
+        auto offset = static_cast<size_t>(footer.read<int64_t>(block));
+        auto metaDataLength = static_cast<size_t>(footer.read<int32_t>(block + 8));
+        auto bodyLength = static_cast<size_t>(footer.read<int64_t>(block + 16));
+        REQUIRE(offset % 8 == 0);
+        REQUIRE(offset + metaDataLength + bodyLength <= footerStart);
+
+        uint32_t continuation = 0;
+        int32_t length = 0;
+        std::memcpy(&continuation, file.data() + offset, sizeof(continuation));
+        std::memcpy(&length, file.data() + offset + 4, sizeof(length));
+        CHECK(continuation == CONTINUATION);
+        CHECK(8 + static_cast<size_t>(length) == metaDataLength);
+
+        FlatBufferReader batchMessage(file.substr(offset + 8, static_cast<size_t>(length)));
+        size_t messageRoot = batchMessage.getRoot();
+        CHECK(batchMessage.getScalar<int16_t>(messageRoot, 0) == METADATA_VERSION_V5);
+        REQUIRE(batchMessage.getScalar<uint8_t>(messageRoot, 1) == HEADER_RECORD_BATCH);
+        CHECK(batchMessage.getScalar<int64_t>(messageRoot, 3) == static_cast<int64_t>(bodyLength));
+
+        size_t batch = batchMessage.getObject(messageRoot, 2);
+        DecodedBatch& decodedBatch = decoded.batches.emplace_back();
+        decodedBatch.length = batchMessage.getScalar<int64_t>(batch, 0);
+
+        size_t nodes = batchMessage.getObject(batch, 1);
+        for (size_t node = 0; node < batchMessage.getLength(nodes); ++node)
+        {
+            size_t position = nodes + sizeof(uint32_t) + sizeof(FieldNode) * node;
+            decodedBatch.nodes.push_back(
+                {batchMessage.read<int64_t>(position), batchMessage.read<int64_t>(position + 8)});
+        }
+
+        std::string_view body = file.substr(offset + metaDataLength, bodyLength);
+        size_t buffers = batchMessage.getObject(batch, 2);
+        for (size_t buffer = 0; buffer < batchMessage.getLength(buffers); ++buffer)
+        {
+            size_t position = buffers + sizeof(uint32_t) + sizeof(BufferLocation) * buffer;
+            auto bufferOffset = static_cast<size_t>(batchMessage.read<int64_t>(position));
+            auto bufferLength = static_cast<size_t>(batchMessage.read<int64_t>(position + 8));
+            CHECK(bufferOffset % 8 == 0);
+            REQUIRE(bufferOffset + bufferLength <= body.size());
+            decodedBatch.buffers.push_back(body.substr(bufferOffset, bufferLength));
+        }
+    }
+    return decoded;
+}
+
+template <typename T> auto valueAt(std::string_view buffer, size_t index) -> T
+{
+    REQUIRE((index + 1) * sizeof(T) <= buffer.size());
+    T value;
+    std::memcpy(&value, buffer.data() + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+auto bitAt(std::string_view buffer, size_t index) -> bool
+{
+    REQUIRE(index / 8 < buffer.size());
+    return ((static_cast<uint8_t>(buffer[index / 8]) >> (index % 8)) & 1U) != 0;
+}
+
+/// Index of the first buffer of a column: two for integers and booleans, three for strings
+auto firstBuffer(const std::vector<DecodedField>& fields, size_t column) -> size_t
+{
+    size_t buffer = 0;
+    for (size_t i = 0; i < column; ++i)
+        buffer += fields[i].typeId == TYPE_UTF8 ? 3 : 2;
+    return buffer;
+}
+
+auto readArrowFile(const std::string& directory, const std::string& table) -> std::string
+{
+    auto buffer = llvm::MemoryBuffer::getFile(directory + "/" + table + ".arrow");
+    REQUIRE(buffer);
+    return (*buffer)->getBuffer().str();
+}
+
+}  // namespace
+
+TEST_CASE("ArrowExporter writes files that decode to the rows written")
+{
+    llvm::SmallString<128> directory;
+    REQUIRE(!llvm::sys::fs::createUniqueDirectory("dosatsu-arrow", directory));
+
+    ColumnBuffer nodes("ASTNode");
+    using namespace std::string_view_literals;
+    nodes.appendRow({{"node_id", int64_t{7}}, {"node_type", "FunctionDecl"sv}, {"is_implicit", true}});
+    nodes.appendRow({{"node_id", int64_t{8}}, {"node_type", "ReturnStmt"sv}, {"is_implicit", false}});
+
+    ArrowExporter exporter(directory.str().str());
+    exporter.writeNodes(nodes);
+    exporter.writeRelationships({{7, 8, "PARENT_OF", {{"child_index", "0"}, {"relationship_kind", "child"}}},
+                                 {7, 8, "PARENT_OF", {{"child_index", "x"}}}});
+    REQUIRE(exporter.finish());
+    CHECK(exporter.getNodeRowCount() == 2);
+    CHECK(exporter.getRelationshipRowCount() == 2);
+
+    SUBCASE("Node table")
+    {
+        std::string contents = readArrowFile(exporter.getDirectory(), "ASTNode");
+        DecodedFile file = decodeArrowFile(contents);
+        REQUIRE(file.fields.size() == std::size(schema::AST_NODE_COLUMNS));
+        CHECK(file.fields[0].name == "node_id");
+        CHECK(file.fields[0].typeId == TYPE_INT);
+        CHECK(file.fields[1].typeId == TYPE_UTF8);
+        CHECK(file.fields[8].name == "is_implicit");
+        CHECK(file.fields[8].typeId == TYPE_BOOL);
+
+        REQUIRE(file.batches.size() == 1);
+        const DecodedBatch& batch = file.batches[0];
+        CHECK(batch.length == 2);
+        REQUIRE(batch.nodes.size() == file.fields.size());
+        CHECK(batch.nodes[0].nullCount == 0);
+        CHECK(batch.nodes[2].nullCount == 2);  // memory_address was not written
+
+        size_t ids = firstBuffer(file.fields, 0);
+        CHECK(valueAt<int64_t>(batch.buffers[ids + 1], 0) == 7);
+        CHECK(valueAt<int64_t>(batch.buffers[ids + 1], 1) == 8);
+
+        size_t types = firstBuffer(file.fields, 1);
+        CHECK(valueAt<int32_t>(batch.buffers[types + 1], 1) == 12);
+        CHECK(valueAt<int32_t>(batch.buffers[types + 1], 2) == 22);
+        CHECK(batch.buffers[types + 2] == "FunctionDeclReturnStmt");
+
+        size_t implicit = firstBuffer(file.fields, 8);
+        CHECK(bitAt(batch.buffers[implicit + 1], 0));
+        CHECK(!bitAt(batch.buffers[implicit + 1], 1));
+    }
+
+    SUBCASE("Relationship table")
+    {
+        std::string contents = readArrowFile(exporter.getDirectory(), "PARENT_OF");
+        DecodedFile file = decodeArrowFile(contents);
+        REQUIRE(file.fields.size() == 4);
+        CHECK(file.fields[0].name == "from");
+        CHECK(file.fields[1].name == "to");
+        CHECK(file.fields[2].name == "child_index");
+
+        REQUIRE(file.batches.size() == 1);
+        const DecodedBatch& batch = file.batches[0];
+        CHECK(batch.length == 2);
+        CHECK(valueAt<int64_t>(batch.buffers[1], 1) == 7);
+        CHECK(valueAt<int64_t>(batch.buffers[3], 1) == 8);
+
+        // A property that does not parse as its schema type is null, not zero
+        size_t index = firstBuffer(file.fields, 2);
+        CHECK(batch.nodes[2].nullCount == 1);
+        CHECK(bitAt(batch.buffers[index], 0));
+        CHECK(!bitAt(batch.buffers[index], 1));
+        CHECK(valueAt<int64_t>(batch.buffers[index + 1], 0) == 0);
+        CHECK(batch.buffers[firstBuffer(file.fields, 3) + 2] == "child");
+    }
+
+    llvm::sys::fs::remove_directories(directory);
+}
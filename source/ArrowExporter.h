@@ -0,0 +1,98 @@
+//===--- ArrowExporter.h - Arrow IPC files written from the row buffers ---===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "BulkLoader.h"
+#include "ColumnBuffer.h"
+#include "Schema.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang
+{
+
+/// Writes every table as an Arrow IPC file (<table>.arrow) instead of a database
+/// Columns follow SCHEMA_TABLES; relationship files start with int64 "from" and
+/// "to" columns holding the endpoint node IDs. Each node buffer and each batch
+/// of relationships becomes one record batch that is written as soon as it is
+/// encoded, so memory stays bounded by the batch size however large the run.
+/// The files can be memory-mapped by any Arrow reader without going through
+/// Cypher, or converted to Parquet for COPY FROM.
+class ArrowExporter
+{
+public:
+    using Relationships = BulkLoader::Relationships;
+
+    /// Constructor
+    /// \param directory Directory receiving the files; created if missing
+    explicit ArrowExporter(std::string directory);
+
+    /// Append the rows of a node buffer to its table's file as one record batch
+    /// \param buffer Rows to write; cells of columns the schema types differently are written as null
+    void writeNodes(const ColumnBuffer& buffer);
+
+    /// Append relationship rows to their tables' files, one record batch per table
+    /// \param relationships Rows to write; property strings are converted to the schema types
+    void writeRelationships(const Relationships& relationships);
+
+    /// Write the footer of every file and close it
+    /// \return True if every file was written completely
+    auto finish() -> bool;
+
+    /// Total number of node rows written so far
+    [[nodiscard]] auto getNodeRowCount() const -> size_t { return nodeRows; }
+
+    /// Total number of relationship rows written so far
+    [[nodiscard]] auto getRelationshipRowCount() const -> size_t { return relationshipRows; }
+
+    /// Directory receiving the files
+    [[nodiscard]] auto getDirectory() const -> const std::string& { return directory; }
+
+private:
+    /// Location of one record batch in a file, as listed by the footer
+    struct Block
+    {
+        int64_t offset;
+        int32_t metaDataLength;  // Message prefix and metadata, padding included
+        int32_t padding;
+        int64_t bodyLength;
+    };
+
+    struct TableFile
+    {
+        std::string path;
+        std::unique_ptr<llvm::raw_fd_ostream> stream;
+        const SchemaTable* schema = nullptr;
+        std::vector<Block> blocks;
+    };
+
+    class Column;
+
+    /// Get the open file for a table, creating it with its schema message on first use
+    /// \return The file, or nullptr if the table is not in the schema or the file could not be opened
+    auto openTable(const std::string& table) -> TableFile*;
+
+    /// Encode one record batch and append it to a file
+    static void writeBatch(TableFile& file, const std::vector<Column>& columns, size_t rows);
+
+    std::string directory;
+    std::map<std::string, TableFile> files;
+    size_t nodeRows = 0;
+    size_t relationshipRows = 0;
+};
+
+}  // namespace clang
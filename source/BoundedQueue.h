@@ -0,0 +1,106 @@
+//===--- BoundedQueue.h - Bounded blocking queue for pipeline stages ------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace clang
+{
+
+/// Multi-producer, multi-consumer FIFO with a fixed capacity.
+/// Producers block while the queue is full, which gives natural back-pressure
+/// between a fast producer stage and a slower consumer stage.
+template <typename T>
+class BoundedQueue
+{
+public:
+    /// Constructor
+    /// \param capacity Maximum number of queued items before push() blocks
+    explicit BoundedQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    auto operator=(const BoundedQueue&) -> BoundedQueue& = delete;
+
+    /// Enqueue an item, blocking while the queue is full
+    /// \param item Item to enqueue
+    /// \return False if the queue was closed and the item was dropped
+    auto push(T item) -> bool
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /// Dequeue an item, blocking until one is available
+    /// \return The next item, or std::nullopt once the queue is closed and drained
+    auto pop() -> std::optional<T>
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return std::nullopt;
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    /// Dequeue an item, waiting at most \p timeout for one
+    /// \return The next item, or std::nullopt on timeout or once the queue is closed and drained
+    template <typename Rep, typename Period> auto popFor(std::chrono::duration<Rep, Period> timeout) -> std::optional<T>
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!notEmpty.wait_for(lock, timeout, [this] { return closed || !items.empty(); }) || items.empty())
+            return std::nullopt;
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    /// Check whether the queue is closed and drained, so pop() would return std::nullopt at once
+    [[nodiscard]] auto isFinished() const -> bool
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed && items.empty();
+    }
+
+    /// Stop accepting new items; consumers drain what is left and then see std::nullopt
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    /// Number of items currently queued
+    [[nodiscard]] auto size() const -> size_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+private:
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+}  // namespace clang
@@ -0,0 +1,363 @@
+//===--- BulkLoader.cpp - Streaming CSV staging and COPY FROM import ------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "BulkLoader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <queue>
+#include <system_error>
+
+using namespace clang;
+
+namespace
+{
+
+// Bytes of buffered relationship rows per table before they are sorted and spilled to a run
+constexpr size_t RUN_BYTES = size_t{64} << 20;
+
+/// Reads back the rows of one spilled run in their sorted order
+struct RunReader
+{
+    explicit RunReader(const std::string& path) : in(path, std::ios::binary) {}
+
+    auto next() -> bool
+    {
+        uint64_t length = 0;
+        if (!in.read(reinterpret_cast<char*>(&from), sizeof(from)) ||
+            !in.read(reinterpret_cast<char*>(&to), sizeof(to)) ||
+            !in.read(reinterpret_cast<char*>(&length), sizeof(length)))
+            return false;
+        properties.resize(length);
+        return static_cast<bool>(in.read(properties.data(), static_cast<std::streamsize>(length)));
+    }
+
+    std::ifstream in;
+    int64_t from = 0;
+    int64_t to = 0;
+    std::string properties;
+};
+
+}  // namespace
+
+BulkLoader::BulkLoader(std::string directory, ColumnLookup lookupColumns)
+    : directory(std::move(directory)), lookupColumns(std::move(lookupColumns))
+{
+    std::filesystem::create_directories(this->directory);
+}
+
+auto BulkLoader::openTable(std::map<std::string, TableFile>& files, const std::string& table, bool isRelationship)
+    -> TableFile*
+{
+    auto it = files.find(table);
+    if (it != files.end())
+        return it->second.stream ? &it->second : nullptr;
+
+    TableFile& file = files[table];
+    file.path = (std::filesystem::path(directory) / (table + ".csv")).generic_string();
+    file.columns = lookupColumns(table);
+    if (file.columns.empty())
+    {
+        // Leave the stream unset so the table is skipped from now on; reported once
+        llvm::errs() << "Bulk load: no columns known for table " << table << ", skipping its rows\n";
+        return nullptr;
+    }
+
+    std::error_code ec;
+    file.stream = std::make_unique<llvm::raw_fd_ostream>(file.path, ec);
+    if (ec)
+    {
+        llvm::errs() << "Bulk load: cannot open " << file.path << ": " << ec.message() << "\n";
+        file.stream.reset();
+        return nullptr;
+    }
+
+    // The header row is skipped by COPY (HEADER=true) and documents the layout
+    auto& os = *file.stream;
+    bool first = true;
+    if (isRelationship)
+    {
+        os << "from,to";
+        first = false;
+    }
+    for (const auto& column : file.columns)
+    {
+        if (!first)
+            os << ',';
+        first = false;
+        os << column.name;
+    }
+    os << '\n';
+
+    return &file;
+}
+
+void BulkLoader::writeString(TableFile& file, llvm::raw_ostream& os, std::string_view value)
+{
+    // Each find() is a vectorized memchr; the runs between quotes are written in bulk
+    if (!file.hasMultilineValues)
+        file.hasMultilineValues =
+            value.find('\n') != std::string_view::npos || value.find('\r') != std::string_view::npos;
+
+    os << '"';
+    size_t run = 0;
+    for (size_t quote = value.find('"'); quote != std::string_view::npos; quote = value.find('"', run))
+    {
+        // The quote is written twice: once ending the run, once here
+        os.write(value.data() + run, quote + 1 - run);
+        os << '"';
+        run = quote + 1;
+    }
+    os.write(value.data() + run, value.size() - run);
+    os << '"';
+}
+
+void BulkLoader::writeNodes(const ColumnBuffer& buffer)
+{
+    if (buffer.empty())
+        return;
+
+    TableFile* file = openTable(nodeFiles, buffer.getTable(), false);
+    if (file == nullptr)
+        return;
+
+    // Map each table column to the buffer column holding it; absent columns are written as NULL
+    std::vector<std::optional<size_t>> sourceColumns;
+    sourceColumns.reserve(file->columns.size());
+    for (const auto& column : file->columns)
+    {
+        std::optional<size_t> source;
+        for (size_t i = 0; i < buffer.getColumnCount(); ++i)
+        {
+            if (buffer.getColumnName(i) == column.name)
+            {
+                source = i;
+                break;
+            }
+        }
+        sourceColumns.push_back(source);
+    }
+
+    auto& os = *file->stream;
+    for (size_t row = 0; row < buffer.getRowCount(); ++row)
+    {
+        for (size_t i = 0; i < sourceColumns.size(); ++i)
+        {
+            if (i > 0)
+                os << ',';
+            if (!sourceColumns[i])
+                continue;
+
+            size_t column = *sourceColumns[i];
+            switch (buffer.getColumnType(column))
+            {
+            case ColumnBuffer::ColumnType::Int64:
+                os << buffer.getInt64(column, row);
+                break;
+            case ColumnBuffer::ColumnType::Bool:
+                os << (buffer.getBool(column, row) ? "true" : "false");
+                break;
+            case ColumnBuffer::ColumnType::String:
+                writeString(*file, os, buffer.getString(column, row));
+                break;
+            }
+        }
+        os << '\n';
+    }
+
+    nodeRows += buffer.getRowCount();
+}
+
+void BulkLoader::writeRelationships(const Relationships& relationships)
+{
+    const std::string* currentType = nullptr;
+    TableFile* file = nullptr;
+
+    for (const auto& [fromId, toId, relationshipType, properties] : relationships)
+    {
+        if (currentType == nullptr || *currentType != relationshipType)
+        {
+            currentType = &relationshipType;
+            file = openTable(relationshipFiles, relationshipType, true);
+        }
+        if (file == nullptr)
+            continue;
+
+        size_t offset = file->properties.size();
+        {
+            llvm::raw_string_ostream os(file->properties);
+            for (const auto& column : file->columns)
+            {
+                os << ',';
+                auto it = properties.find(column.name);
+                if (it == properties.end())
+                    continue;
+
+                if (column.type == "STRING")
+                    writeString(*file, os, it->second);
+                else if (column.type == "BOOL")
+                    os << ((it->second == "true" || it->second == "1") ? "true" : "false");
+                else
+                    os << it->second;
+            }
+        }
+        file->edges.push_back({fromId, toId, offset, file->properties.size() - offset});
+        ++relationshipRows;
+
+        if (file->properties.size() + file->edges.size() * sizeof(StagedEdge) >= RUN_BYTES && !spillRun(*file))
+        {
+            // The table's rows cannot be kept in order; skip it like a table that failed to open
+            file->stream.reset();
+            file = nullptr;
+        }
+    }
+}
+
+auto BulkLoader::spillRun(TableFile& file) -> bool
+{
+    std::ranges::sort(file.edges, {}, [](const StagedEdge& edge) { return std::pair{edge.from, edge.to}; });
+
+    std::string path = file.path + ".run" + std::to_string(file.runs.size());
+    std::error_code ec;
+    llvm::raw_fd_ostream os(path, ec);
+    if (ec)
+    {
+        llvm::errs() << "Bulk load: cannot open " << path << ": " << ec.message() << "\n";
+        return false;
+    }
+    for (const auto& edge : file.edges)
+    {
+        uint64_t length = edge.length;
+        os.write(reinterpret_cast<const char*>(&edge.from), sizeof(edge.from));
+        os.write(reinterpret_cast<const char*>(&edge.to), sizeof(edge.to));
+        os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        os.write(file.properties.data() + edge.offset, edge.length);
+    }
+    file.runs.push_back(std::move(path));
+    file.edges.clear();
+    file.properties.clear();
+    return true;
+}
+
+auto BulkLoader::writeSortedRelationships(TableFile& file) -> bool
+{
+    auto& os = *file.stream;
+    if (file.runs.empty())
+    {
+        std::ranges::sort(file.edges, {}, [](const StagedEdge& edge) { return std::pair{edge.from, edge.to}; });
+        for (const auto& edge : file.edges)
+        {
+            os << edge.from << ',' << edge.to << std::string_view(file.properties).substr(edge.offset, edge.length)
+               << '\n';
+        }
+        file.edges.clear();
+        file.properties.clear();
+        return true;
+    }
+
+    if (!file.edges.empty() && !spillRun(file))
+        return false;
+
+    std::vector<std::unique_ptr<RunReader>> readers;
+    auto later = [&readers](size_t a, size_t b)
+    { return std::pair{readers[a]->from, readers[a]->to} > std::pair{readers[b]->from, readers[b]->to}; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads(later);
+    for (const auto& run : file.runs)
+    {
+        readers.push_back(std::make_unique<RunReader>(run));
+        if (readers.back()->next())
+            heads.push(readers.size() - 1);
+    }
+    while (!heads.empty())
+    {
+        size_t index = heads.top();
+        heads.pop();
+        auto& reader = *readers[index];
+        os << reader.from << ',' << reader.to << reader.properties << '\n';
+        if (reader.next())
+            heads.push(index);
+    }
+
+    readers.clear();
+    for (const auto& run : file.runs)
+    {
+        std::error_code ec;
+        std::filesystem::remove(run, ec);
+    }
+    file.runs.clear();
+    return true;
+}
+
+auto BulkLoader::copyTable(kuzu::main::Connection& connection,
+                           const std::string& table,
+                           TableFile& file,
+                           bool isRelationship) -> bool
+{
+    std::string query = "COPY " + table + " FROM '" + file.path + "' (HEADER=true, ESCAPE='\"'";
+    if (file.hasMultilineValues)
+        query += ", PARALLEL=false";
+    // Edges whose endpoint was never emitted as a node of the right table are
+    // skipped, matching what MATCH ... CREATE does for them in the regular path
+    if (isRelationship)
+        query += ", IGNORE_ERRORS=true";
+    query += ")";
+
+    auto result = connection.query(query);
+    if (!result->isSuccess())
+    {
+        llvm::errs() << "Bulk load: COPY into " << table << " failed: " << result->getErrorMessage() << "\n";
+        return false;
+    }
+    return true;
+}
+
+auto BulkLoader::importInto(kuzu::main::Connection& connection) -> bool
+{
+    bool success = true;
+    for (auto& [_, file] : relationshipFiles)
+    {
+        if (file.stream && !writeSortedRelationships(file))
+        {
+            llvm::errs() << "Bulk load: cannot sort the rows of " << file.path << "\n";
+            success = false;
+            file.stream.reset();
+        }
+    }
+    for (auto* files : {&nodeFiles, &relationshipFiles})
+    {
+        for (auto& [_, file] : *files)
+        {
+            if (file.stream)
+                file.stream->close();
+        }
+    }
+
+    for (auto& [table, file] : nodeFiles)
+    {
+        if (file.stream)
+            success = copyTable(connection, table, file, false) && success;
+    }
+    for (auto& [table, file] : relationshipFiles)
+    {
+        if (file.stream)
+            success = copyTable(connection, table, file, true) && success;
+    }
+
+    if (success)
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+    }
+    else
+    {
+        llvm::errs() << "Bulk load: staging files kept in " << directory << "\n";
+    }
+
+    nodeFiles.clear();
+    relationshipFiles.clear();
+    return success;
+}
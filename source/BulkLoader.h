@@ -0,0 +1,130 @@
+//===--- BulkLoader.h - Streaming CSV staging and COPY FROM import --------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "ColumnBuffer.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "kuzu.hpp"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace clang
+{
+
+/// Streams node and relationship rows into one CSV file per table and loads
+/// them with a single COPY FROM per table at the end of the run
+/// COPY bypasses the per-statement parse/plan cost entirely, which is what makes
+/// indexing a whole project feasible. Node tables are loaded first, so their
+/// primary-key indexes are built once; relationship rows are then loaded sorted
+/// by their endpoints, so the key lookups of each COPY walk the index in order.
+/// Relationships are sorted in memory and spilled to sorted runs when a table
+/// outgrows the memory budget; the runs are merged into the CSV at import.
+class BulkLoader
+{
+public:
+    /// Name and Kuzu type (e.g., "STRING", "INT64", "BOOL") of a table column
+    struct TableColumn
+    {
+        std::string name;
+        std::string type;
+    };
+
+    /// Returns the property columns of a table in declaration order
+    /// For relationship tables the FROM/TO endpoints are not included.
+    using ColumnLookup = std::function<std::vector<TableColumn>(const std::string& table)>;
+
+    /// Relationship rows as buffered by KuzuDatabase
+    using Relationships = std::vector<std::tuple<int64_t, int64_t, std::string, std::map<std::string, std::string>>>;
+
+    /// Constructor
+    /// \param directory Directory receiving the staging files; created if missing
+    /// \param lookupColumns Provides table layouts, so rows are written in COPY column order
+    BulkLoader(std::string directory, ColumnLookup lookupColumns);
+
+    /// Append the rows of a node buffer to its table's file
+    /// \param buffer Rows to write
+    void writeNodes(const ColumnBuffer& buffer);
+
+    /// Append relationship rows to their tables' files
+    /// \param relationships Rows to write
+    void writeRelationships(const Relationships& relationships);
+
+    /// Close all files and COPY them into the database, node tables before relationship tables
+    /// Must be called outside of an explicit transaction. The staging files are
+    /// removed when every COPY succeeds and kept for inspection otherwise.
+    /// \param connection Connection to run the COPY statements on
+    /// \return True if every COPY succeeded
+    auto importInto(kuzu::main::Connection& connection) -> bool;
+
+    /// Total number of node rows written so far
+    [[nodiscard]] auto getNodeRowCount() const -> size_t { return nodeRows; }
+
+    /// Total number of relationship rows written so far
+    [[nodiscard]] auto getRelationshipRowCount() const -> size_t { return relationshipRows; }
+
+private:
+    /// A relationship row waiting to be sorted; its formatted properties live in TableFile::properties
+    struct StagedEdge
+    {
+        int64_t from;
+        int64_t to;
+        size_t offset;
+        size_t length;
+    };
+
+    struct TableFile
+    {
+        std::string path;
+        std::unique_ptr<llvm::raw_fd_ostream> stream;
+        std::vector<TableColumn> columns;
+        bool hasMultilineValues = false;  // Kuzu's parallel CSV reader cannot split quoted newlines
+
+        // Relationship tables only: unsorted rows, and the sorted runs already spilled to disk
+        std::vector<StagedEdge> edges;
+        std::string properties;
+        std::vector<std::string> runs;
+    };
+
+    /// Get the open file for a table, creating it and its header row on first use
+    /// \return The file, or nullptr if it could not be opened
+    auto openTable(std::map<std::string, TableFile>& files, const std::string& table, bool isRelationship)
+        -> TableFile*;
+
+    /// Write a quoted CSV string field
+    static void writeString(TableFile& file, llvm::raw_ostream& os, std::string_view value);
+
+    /// Sort the buffered rows of a relationship table and write them to a new run file
+    static auto spillRun(TableFile& file) -> bool;
+
+    /// Write all rows of a relationship table to its CSV file in endpoint order
+    static auto writeSortedRelationships(TableFile& file) -> bool;
+
+    /// COPY one staged file into its table
+    auto copyTable(kuzu::main::Connection& connection, const std::string& table, TableFile& file, bool isRelationship)
+        -> bool;
+
+    std::string directory;
+    ColumnLookup lookupColumns;
+    std::map<std::string, TableFile> nodeFiles;
+    std::map<std::string, TableFile> relationshipFiles;
+    size_t nodeRows = 0;
+    size_t relationshipRows = 0;
+};
+
+}  // namespace clang
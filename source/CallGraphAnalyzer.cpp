@@ -0,0 +1,175 @@
+//===--- CallGraphAnalyzer.cpp - Aggregated caller to callee edges --------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "CallGraphAnalyzer.h"
+
+#include "ASTNodeProcessor.h"
+#include "DeclarationAnalyzer.h"
+#include "KuzuDatabase.h"
+#include "Trace.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/AST/ExprCXX.h"
+#include "llvm/ADT/STLExtras.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+CallGraphAnalyzer::CallGraphAnalyzer(KuzuDatabase& database,
+                                     ASTNodeProcessor& nodeProcessor,
+                                     DeclarationAnalyzer& declarationAnalyzer,
+                                     ASTContext& astContext)
+    : database(database), nodeProcessor(nodeProcessor), declarationAnalyzer(declarationAnalyzer),
+      astContext(astContext)
+{
+}
+
+void CallGraphAnalyzer::analyzeFunction(const clang::FunctionDecl* func, int64_t functionNodeId)
+{
+    if (func == nullptr || !func->doesThisDeclarationHaveABody())
+        return;
+
+    // A lambda's calls belong to the function whose body holds it
+    if (const auto* method = dyn_cast<CXXMethodDecl>(func); method != nullptr && method->getParent()->isLambda())
+        return;
+
+    TraceSpan span("CallGraphAnalyzer");
+
+    std::vector<const Stmt*> pending;
+    pending.push_back(func->getBody());
+    if (const auto* constructor = dyn_cast<CXXConstructorDecl>(func))
+    {
+        for (const CXXCtorInitializer* initializer : constructor->inits())
+            pending.push_back(initializer->getInit());
+    }
+
+    while (!pending.empty())
+    {
+        const Stmt* stmt = pending.back();
+        pending.pop_back();
+        if (stmt == nullptr)
+            continue;
+
+        if (const auto* call = dyn_cast<CallExpr>(stmt))
+        {
+            const auto* member = dyn_cast<MemberExpr>(call->getCallee()->IgnoreParenImpCasts());
+            bool isVirtual = member != nullptr && member->performsVirtualDispatch(astContext.getLangOpts());
+            addCall(functionNodeId, call->getDirectCallee(), call->getBeginLoc(), isVirtual);
+        }
+        else if (const auto* construct = dyn_cast<CXXConstructExpr>(stmt))
+            addCall(functionNodeId, construct->getConstructor(), construct->getBeginLoc(), false);
+
+        for (const Stmt* child : stmt->children())
+            pending.push_back(child);
+    }
+}
+
+void CallGraphAnalyzer::noteMethod(const clang::CXXMethodDecl* method)
+{
+    if (method == nullptr || !method->isVirtual())
+        return;
+
+    const auto* canonical = method->getCanonicalDecl();
+    if (!notedMethods.insert(canonical).second)
+        return;
+    for (const CXXMethodDecl* overridden : canonical->overridden_methods())
+        overriders[overridden->getCanonicalDecl()].push_back(canonical);
+}
+
+void CallGraphAnalyzer::addCall(int64_t callerNodeId,
+                                const FunctionDecl* callee,
+                                SourceLocation location,
+                                bool isVirtual)
+{
+    if (callee == nullptr)
+        return;
+
+    auto [it, inserted] = calls.try_emplace({callerNodeId, callee->getCanonicalDecl()});
+    auto& sites = it->second;
+    if (inserted)
+        sites.order = calls.size();
+    ++sites.count;
+    sites.isVirtual = sites.isVirtual || isVirtual;
+    int64_t line = nodeProcessor.resolveLocation(location).line;
+    if (line >= 0 && (sites.firstLine < 0 || line < sites.firstLine))
+        sites.firstLine = line;
+}
+
+auto CallGraphAnalyzer::getCalleeNodeId(const FunctionDecl* callee) -> int64_t
+{
+    // Calls to one function land on its definition when the translation unit has it
+    const FunctionDecl* target = callee->getDefinition();
+    if (target == nullptr)
+        target = callee;
+
+    int64_t nodeId = nodeProcessor.createASTNode(target);
+    if (nodeId != -1)
+        declarationAnalyzer.createDeclarationNode(nodeId, target);
+    return nodeId;
+}
+
+void CallGraphAnalyzer::finish()
+{
+    // Edges are merged by node ID, since a virtual call and a direct call can reach the same override
+    std::map<std::pair<int64_t, int64_t>, CallSites> edges;
+    auto addEdge = [&](int64_t caller, int64_t callee, const CallSites& sites, bool throughDispatch)
+    {
+        if (callee == -1)
+            return;
+        auto [it, inserted] = edges.try_emplace({caller, callee}, CallSites{0, sites.firstLine, throughDispatch, 0});
+        it->second.count += sites.count;
+        if (sites.firstLine >= 0 && (it->second.firstLine < 0 || sites.firstLine < it->second.firstLine))
+            it->second.firstLine = sites.firstLine;
+        it->second.isVirtual = it->second.isVirtual && throughDispatch;
+    };
+
+    // Callee nodes are created in the order the calls were found, so node IDs do not depend on pointer values
+    std::vector<std::pair<std::pair<int64_t, const FunctionDecl*>, CallSites>> ordered(calls.begin(), calls.end());
+    std::ranges::sort(ordered, [](const auto& a, const auto& b) { return a.second.order < b.second.order; });
+
+    for (const auto& [key, sites] : ordered)
+    {
+        auto [caller, callee] = key;
+        addEdge(caller, getCalleeNodeId(callee), sites, false);
+
+        const auto* method = dyn_cast<CXXMethodDecl>(callee);
+        if (!sites.isVirtual || method == nullptr)
+            continue;
+
+        llvm::SmallVector<const CXXMethodDecl*, 8> pending;
+        llvm::append_range(pending, overriders.lookup(method));
+        llvm::DenseSet<const CXXMethodDecl*> visited;
+        while (!pending.empty())
+        {
+            const CXXMethodDecl* overrider = pending.pop_back_val();
+            if (!visited.insert(overrider).second)
+                continue;
+            addEdge(caller, getCalleeNodeId(overrider), sites, true);
+            llvm::append_range(pending, overriders.lookup(overrider));
+        }
+    }
+
+    for (const auto& [key, sites] : edges)
+    {
+        database.addRelationshipToBatch(key.first,
+                                        key.second,
+                                        "CALLS",
+                                        {{"count", std::to_string(sites.count)},
+                                         {"first_line", std::to_string(sites.firstLine)},
+                                         {"is_virtual", sites.isVirtual ? "true" : "false"}});
+    }
+
+    calls.clear();
+    overriders.clear();
+    notedMethods.clear();
+}
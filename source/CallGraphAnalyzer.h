@@ -0,0 +1,91 @@
+//===--- CallGraphAnalyzer.h - Aggregated caller to callee edges ----------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <utility>
+
+namespace clang
+{
+
+class KuzuDatabase;
+class ASTNodeProcessor;
+class DeclarationAnalyzer;
+
+/// Records one CALLS edge per caller and callee of a translation unit
+/// Function bodies are walked directly rather than through the statement
+/// traversal, so the call graph is available without Statement and Expression
+/// rows. Calls inside lambdas belong to the enclosing function. A virtual call
+/// leads to the method it names and, marked as virtual, to every override of
+/// that method declared in the translation unit; the edges are written at the
+/// end of the translation unit, once all overrides are known.
+class CallGraphAnalyzer
+{
+public:
+    /// Constructor
+    /// \param database Database instance for storage
+    /// \param nodeProcessor Node processor for creating callee nodes
+    /// \param declarationAnalyzer Declaration analyzer for creating callee Declaration rows
+    /// \param astContext AST context for analysis
+    CallGraphAnalyzer(KuzuDatabase& database,
+                      ASTNodeProcessor& nodeProcessor,
+                      DeclarationAnalyzer& declarationAnalyzer,
+                      ASTContext& astContext);
+
+    /// Collect the calls made by a function definition
+    /// \param func The function; ignored unless it has a body
+    /// \param functionNodeId Node ID of the function
+    void analyzeFunction(const clang::FunctionDecl* func, int64_t functionNodeId);
+
+    /// Remember which methods a virtual method overrides, for resolving virtual calls
+    /// \param method Any method of the translation unit
+    void noteMethod(const clang::CXXMethodDecl* method);
+
+    /// Write the CALLS edges of the translation unit
+    void finish();
+
+private:
+    /// Calls from one caller to one callee
+    struct CallSites
+    {
+        int64_t count = 0;
+        int64_t firstLine = -1;
+        bool isVirtual = false;  // Reached through virtual dispatch
+        size_t order = 0;        // When the pair was first found
+    };
+
+    /// Record one call expression found in a body
+    void addCall(int64_t callerNodeId, const FunctionDecl* callee, SourceLocation location, bool isVirtual);
+
+    /// Node ID of a callee, creating its node and Declaration row if needed
+    auto getCalleeNodeId(const FunctionDecl* callee) -> int64_t;
+
+    KuzuDatabase& database;
+    ASTNodeProcessor& nodeProcessor;
+    DeclarationAnalyzer& declarationAnalyzer;
+    ASTContext& astContext;
+
+    // Keyed by caller node ID and canonical callee
+    llvm::DenseMap<std::pair<int64_t, const FunctionDecl*>, CallSites> calls;
+
+    // Canonical overridden method to the canonical methods overriding it directly
+    llvm::DenseMap<const CXXMethodDecl*, llvm::SmallVector<const CXXMethodDecl*, 2>> overriders;
+    llvm::DenseSet<const CXXMethodDecl*> notedMethods;
+};
+
+}  // namespace clang
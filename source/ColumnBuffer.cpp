@@ -0,0 +1,145 @@
+//===--- ColumnBuffer.cpp - Typed struct-of-arrays row buffer -------------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "ColumnBuffer.h"
+
+using namespace clang;
+
+auto ColumnBuffer::typeOf(const Value& value) -> ColumnType
+{
+    switch (value.index())
+    {
+    case 0:
+        return ColumnBuffer::ColumnType::Int64;
+    case 1:
+        return ColumnBuffer::ColumnType::Bool;
+    default:
+        return ColumnBuffer::ColumnType::String;
+    }
+}
+
+ColumnBuffer::ColumnBuffer(std::string table) : table(std::move(table))
+{
+}
+
+auto ColumnBuffer::matchesColumns(std::span<const Cell> cells) const -> bool
+{
+    if (cells.size() != columns.size())
+        return false;
+
+    size_t index = 0;
+    for (const auto& cell : cells)
+    {
+        const auto& column = columns[index++];
+        if (column.name != cell.column || column.type != typeOf(cell.value))
+            return false;
+    }
+    return true;
+}
+
+auto ColumnBuffer::appendRow(std::span<const Cell> cells) -> bool
+{
+    if (columns.empty())
+    {
+        columns.reserve(cells.size());
+        for (const auto& cell : cells)
+            columns.emplace_back(std::string(cell.column), typeOf(cell.value));
+    }
+    else if (!matchesColumns(cells))
+    {
+        return false;
+    }
+
+    size_t index = 0;
+    for (const auto& cell : cells)
+    {
+        auto& column = columns[index++];
+        switch (column.type)
+        {
+        case ColumnType::Int64:
+            column.ints.push_back(std::get<int64_t>(cell.value));
+            break;
+        case ColumnType::Bool:
+            column.bools.push_back(std::get<bool>(cell.value) ? 1 : 0);
+            break;
+        case ColumnType::String:
+            column.chars.append(std::get<std::string_view>(cell.value));
+            column.offsets.push_back(column.chars.size());
+            break;
+        }
+    }
+
+    ++rowCount;
+    return true;
+}
+
+auto ColumnBuffer::appendRows(const ColumnBuffer& other) -> bool
+{
+    if (other.empty())
+        return true;
+
+    if (columns.empty())
+    {
+        for (const auto& column : other.columns)
+            columns.emplace_back(column.name, column.type);
+    }
+    else
+    {
+        if (columns.size() != other.columns.size())
+            return false;
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            if (columns[i].name != other.columns[i].name || columns[i].type != other.columns[i].type)
+                return false;
+        }
+    }
+
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        auto& column = columns[i];
+        const auto& source = other.columns[i];
+        column.ints.insert(column.ints.end(), source.ints.begin(), source.ints.end());
+        column.bools.insert(column.bools.end(), source.bools.begin(), source.bools.end());
+
+        // Rebase the source offsets onto the end of this column's character buffer
+        size_t base = column.chars.size();
+        column.chars += source.chars;
+        for (size_t row = 1; row < source.offsets.size(); ++row)
+            column.offsets.push_back(base + source.offsets[row]);
+    }
+
+    rowCount += other.rowCount;
+    return true;
+}
+
+void ColumnBuffer::clear()
+{
+    for (auto& column : columns)
+    {
+        column.ints.clear();
+        column.bools.clear();
+        column.offsets.resize(1);
+        column.chars.clear();
+    }
+    rowCount = 0;
+}
+
+auto ColumnBuffer::getMemoryBytes() const -> size_t
+{
+    size_t bytes = 0;
+    for (const auto& column : columns)
+    {
+        bytes += (column.ints.capacity() * sizeof(int64_t)) + column.bools.capacity() +
+                 (column.offsets.capacity() * sizeof(size_t)) + column.chars.capacity();
+    }
+    return bytes;
+}
+
+auto ColumnBuffer::getString(size_t column, size_t row) const -> std::string_view
+{
+    const auto& col = columns[column];
+    return std::string_view(col.chars).substr(col.offsets[row], col.offsets[row + 1] - col.offsets[row]);
+}
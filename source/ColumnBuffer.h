@@ -0,0 +1,111 @@
+//===--- ColumnBuffer.h - Typed struct-of-arrays row buffer ---------------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace clang
+{
+
+/// Buffers rows of one node table column by column
+/// Integers and booleans live in plain vectors and all strings of a column share
+/// one character buffer, so appending a row allocates nothing once the buffer
+/// has grown to its working size.
+class ColumnBuffer
+{
+public:
+    /// Storage type of a column
+    enum class ColumnType
+    {
+        Int64,
+        Bool,
+        String
+    };
+
+    /// A single cell value; strings are copied into the buffer on append
+    using Value = std::variant<int64_t, bool, std::string_view>;
+
+    /// Column name and value of one cell
+    struct Cell
+    {
+        std::string_view column;
+        Value value;
+    };
+
+    /// Storage type of a cell value
+    static auto typeOf(const Value& value) -> ColumnType;
+
+    /// Constructor
+    /// \param table Name of the node table the rows belong to
+    explicit ColumnBuffer(std::string table);
+
+    /// Append one row
+    /// The first row fixes the column names, order and types of the buffer.
+    /// \param cells Cell values, in the same column order for every row
+    /// \return False if the row does not match the buffer's columns; the row is dropped
+    auto appendRow(std::initializer_list<Cell> cells) -> bool
+    {
+        return appendRow(std::span<const Cell>(cells.begin(), cells.size()));
+    }
+
+    /// Append one row whose cells are only known at run time
+    /// \param cells Cell values, in the same column order for every row
+    /// \return False if the row does not match the buffer's columns; the row is dropped
+    auto appendRow(std::span<const Cell> cells) -> bool;
+
+    /// Append all rows of another buffer with identical columns
+    /// \param other Buffer to copy rows from
+    /// \return False if the columns differ; nothing is appended
+    auto appendRows(const ColumnBuffer& other) -> bool;
+
+    /// Drop all rows but keep the columns and the allocated capacity
+    void clear();
+
+    /// Bytes allocated for the rows, including capacity kept by clear()
+    [[nodiscard]] auto getMemoryBytes() const -> size_t;
+
+    [[nodiscard]] auto getTable() const -> const std::string& { return table; }
+    [[nodiscard]] auto getRowCount() const -> size_t { return rowCount; }
+    [[nodiscard]] auto empty() const -> bool { return rowCount == 0; }
+    [[nodiscard]] auto getColumnCount() const -> size_t { return columns.size(); }
+    [[nodiscard]] auto getColumnName(size_t column) const -> const std::string& { return columns[column].name; }
+    [[nodiscard]] auto getColumnType(size_t column) const -> ColumnType { return columns[column].type; }
+
+    /// Cell accessors; the column must have the matching type
+    [[nodiscard]] auto getInt64(size_t column, size_t row) const -> int64_t { return columns[column].ints[row]; }
+    [[nodiscard]] auto getBool(size_t column, size_t row) const -> bool { return columns[column].bools[row] != 0; }
+    [[nodiscard]] auto getString(size_t column, size_t row) const -> std::string_view;
+
+private:
+    struct Column
+    {
+        Column(std::string name, ColumnType type) : name(std::move(name)), type(type) {}
+
+        std::string name;
+        ColumnType type;
+        std::vector<int64_t> ints;
+        std::vector<uint8_t> bools;
+        std::vector<size_t> offsets{0};  // offsets[row]..offsets[row + 1] delimit a string in chars
+        std::string chars;
+    };
+
+    /// Check whether the cells match the column layout fixed by the first row
+    [[nodiscard]] auto matchesColumns(std::span<const Cell> cells) const -> bool;
+
+    std::string table;
+    std::vector<Column> columns;
+    size_t rowCount = 0;
+};
+
+}  // namespace clang
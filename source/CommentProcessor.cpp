@@ -8,16 +8,20 @@
 
 #include "ASTNodeProcessor.h"
 #include "KuzuDatabase.h"
+#include "Statistics.h"
 
 // clang-format off
 #include "NoWarningScope_Enter.h"
 #include "clang/AST/CommentVisitor.h"
 #include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExternalASTSource.h"
 #include "llvm/Support/raw_ostream.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
 #include <algorithm>
+#include <iterator>
 
 using namespace clang;
 using namespace clang::comments;
@@ -30,29 +34,144 @@ CommentProcessor::CommentProcessor(KuzuDatabase& database, ASTNodeProcessor& nod
 
 void CommentProcessor::processComments(const clang::Decl* decl, int64_t declId)
 {
-    if (!database.isInitialized() || (decl == nullptr) || declId == -1)
+    if (!database.isInitialized() || (decl == nullptr) || declId == -1 || decl->isImplicit())
         return;
 
-    const RawComment* rawComment = astContext->getRawCommentForDeclNoCache(decl);
-    if (rawComment == nullptr)
+    // Implicit instantiations and parameters never carry comments of their own
+    if (const auto* function = dyn_cast<FunctionDecl>(decl);
+        function != nullptr && function->getTemplateSpecializationKind() == TSK_ImplicitInstantiation)
         return;
+    if (const auto* var = dyn_cast<VarDecl>(decl); var != nullptr && var->isStaticDataMember() &&
+                                                   var->getTemplateSpecializationKind() == TSK_ImplicitInstantiation)
+        return;
+    if (const auto* record = dyn_cast<CXXRecordDecl>(decl);
+        record != nullptr && record->getTemplateSpecializationKind() == TSK_ImplicitInstantiation)
+        return;
+    if (const auto* specialization = dyn_cast<ClassTemplateSpecializationDecl>(decl))
+    {
+        auto kind = specialization->getSpecializationKind();
+        if (kind == TSK_ImplicitInstantiation || kind == TSK_Undeclared)
+            return;
+    }
+    if (const auto* enumDecl = dyn_cast<EnumDecl>(decl);
+        enumDecl != nullptr && enumDecl->getTemplateSpecializationKind() == TSK_ImplicitInstantiation)
+        return;
+    if (const auto* tag = dyn_cast<TagDecl>(decl);
+        tag != nullptr && tag->isEmbeddedInDeclarator() && !tag->isCompleteDefinition())
+        return;
+    if (isa<ParmVarDecl, TemplateTypeParmDecl, NonTypeTemplateParmDecl, TemplateTemplateParmDecl>(decl))
+        return;
+
+    if (decl->getLocation().isMacroID())
+    {
+        macroDecls.emplace_back(decl, declId);
+        return;
+    }
 
+    // Declarators share a declaration statement, so most declarations are found by name; templates,
+    // specializations and typedefs by their start, so a comment before 'template <...>' belongs to them
+    SourceLocation location = decl->getLocation();
+    if (isa<RedeclarableTemplateDecl, ClassTemplateSpecializationDecl, TypedefDecl>(decl))
+        location = decl->getBeginLoc();
+    if (location.isInvalid() || !location.isFileID())
+        return;
+
+    auto [file, offset] = astContext->getSourceManager().getDecomposedLoc(location);
+    pendingDecls[file].push_back({offset, decl, declId});
+}
+
+void CommentProcessor::finish()
+{
+    PhaseTimer timer(StatisticsPhase::CommentProcessing);
+
+    // A unit loaded from the AST cache reads its comments into the list only when asked;
+    // getRawCommentForDeclNoCache() asks, reading the list directly does not
+    if (auto* source = astContext->getExternalSource(); source != nullptr && !pendingDecls.empty())
+        source->ReadComments();
+
+    for (auto& [file, decls] : pendingDecls)
+    {
+        const auto* comments = astContext->Comments.getCommentsInFile(file);
+        if (comments == nullptr || comments->empty())
+            continue;
+
+        std::ranges::sort(decls, [](const PendingDecl& a, const PendingDecl& b) { return a.offset < b.offset; });
+        auto behind = comments->begin();
+        for (const PendingDecl& pending : decls)
+        {
+            if (const RawComment* comment = findComment(pending, file, *comments, behind))
+                emitComment(pending.decl, pending.declId, *comment);
+        }
+    }
+
+    for (const auto& [decl, declId] : macroDecls)
+    {
+        if (const RawComment* comment = astContext->getRawCommentForDeclNoCache(decl))
+            emitComment(decl, declId, *comment);
+    }
+
+    pendingDecls.clear();
+    macroDecls.clear();
+}
+
+auto CommentProcessor::findComment(const PendingDecl& pending,
+                                   FileID file,
+                                   const std::map<unsigned, RawComment*>& comments,
+                                   std::map<unsigned, RawComment*>::const_iterator& behind) const -> const RawComment*
+{
+    while (behind != comments.end() && behind->first < pending.offset)
+        ++behind;
+
+    bool parseAll = astContext->getLangOpts().CommentOpts.ParseAllComments;
+    const auto& sourceManager = astContext->getSourceManager();
+
+    // A trailing comment on the declaration's line documents members, enumerators and variables
+    if (behind != comments.end())
+    {
+        const RawComment* comment = behind->second;
+        if ((comment->isDocumentation() || parseAll) && comment->isTrailingComment() &&
+            isa<FieldDecl, EnumConstantDecl, VarDecl>(pending.decl) &&
+            sourceManager.getLineNumber(file, pending.offset) ==
+                astContext->Comments.getCommentBeginLine(behind->second, file, behind->first))
+            return comment;
+    }
+
+    if (behind == comments.begin())
+        return nullptr;
+    auto before = std::prev(behind);
+    RawComment* comment = before->second;
+    if (!(comment->isDocumentation() || parseAll) || comment->isTrailingComment())
+        return nullptr;
+
+    // Another declaration or a directive between the comment and the declaration takes the comment
+    unsigned commentEnd = astContext->Comments.getCommentEndOffset(comment);
+    bool invalid = false;
+    llvm::StringRef buffer = sourceManager.getBufferData(file, &invalid);
+    if (invalid || commentEnd > pending.offset)
+        return nullptr;
+    if (buffer.slice(commentEnd, pending.offset).find_last_of(";{}#@") != llvm::StringRef::npos)
+        return nullptr;
+    return comment;
+}
+
+void CommentProcessor::emitComment(const Decl* decl, int64_t declId, const RawComment& rawComment)
+{
     try
     {
         // Get the comment text
-        std::string commentText = rawComment->getRawText(astContext->getSourceManager()).str();
+        std::string commentText = rawComment.getRawText(astContext->getSourceManager()).str();
 
         // Determine if this is a documentation comment
-        bool isDocumentation = rawComment->isDocumentation();
+        bool isDocumentation = rawComment.isDocumentation();
 
         std::string commentKind = isDocumentation ? "documentation" : "regular";
         std::string briefText;
         std::string detailedText;
 
-        // Try to parse structured comment if it's documentation
+        // The comment is parsed directly; getCommentForDecl() would search for it again
         if (isDocumentation)
         {
-            const FullComment* fullComment = astContext->getCommentForDecl(decl, nullptr);
+            const FullComment* fullComment = rawComment.parse(*astContext, nullptr, decl);
             if (fullComment != nullptr)
             {
                 // Extract brief and detailed text from structured comment
@@ -62,8 +181,7 @@ void CommentProcessor::processComments(const clang::Decl* decl, int64_t declId)
         }
 
         // Create a comment node (generate unique ID since RawComment is not an AST node)
-        static int64_t commentIdCounter = 1000000;  // Start high to avoid conflicts
-        int64_t commentNodeId = commentIdCounter++;
+        int64_t commentNodeId = database.getNextNodeId();
 
         createCommentNode(commentNodeId, commentText, commentKind, isDocumentation, briefText, detailedText);
         createCommentRelation(declId, commentNodeId);
@@ -86,26 +204,17 @@ void CommentProcessor::createCommentNode(int64_t nodeId,
 
     try
     {
-        // Escape single quotes and clean up text for database storage
-        std::string cleanCommentText = KuzuDatabase::escapeString(commentText);
-        std::string cleanBriefText = KuzuDatabase::escapeString(briefText);
-        std::string cleanDetailedText = KuzuDatabase::escapeString(detailedText);
-        std::string escapedCommentKind = KuzuDatabase::escapeString(commentKind);
-
         // Limit text length for database storage
-        if (cleanCommentText.length() > 1000)
-            cleanCommentText = cleanCommentText.substr(0, 1000) + "...";
-        if (cleanBriefText.length() > 500)
-            cleanBriefText = cleanBriefText.substr(0, 500) + "...";
-        if (cleanDetailedText.length() > 2000)
-            cleanDetailedText = cleanDetailedText.substr(0, 2000) + "...";
-
-        std::string query = "CREATE (c:Comment {node_id: " + std::to_string(nodeId) + ", comment_text: '" +
-                            cleanCommentText + "', comment_kind: '" + escapedCommentKind +
-                            "', is_documentation: " + (isDocumentationComment ? "true" : "false") + ", brief_text: '" +
-                            cleanBriefText + "', detailed_text: '" + cleanDetailedText + "'})";
-
-        database.addToBatch(query);
+        auto truncate = [](const std::string& text, size_t limit)
+        { return text.length() > limit ? text.substr(0, limit) + "..." : text; };
+
+        database.addNodeToBatch("Comment",
+                                {{"node_id", nodeId},
+                                 {"comment_text", truncate(commentText, 1000)},
+                                 {"comment_kind", commentKind},
+                                 {"is_documentation", isDocumentationComment},
+                                 {"brief_text", truncate(briefText, 500)},
+                                 {"detailed_text", truncate(detailedText, 2000)}});
     }
     catch (const std::exception& e)
     {
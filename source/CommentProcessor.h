@@ -12,11 +12,16 @@
 #include "clang/AST/Decl.h"
 #include "clang/AST/RawCommentList.h"
 #include "clang/AST/Comment.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
 #include <cstdint>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace clang
 {
@@ -25,6 +30,11 @@ class KuzuDatabase;
 class ASTNodeProcessor;
 
 /// Handles comment and documentation processing for AST storage
+/// Declarations are collected during the traversal and matched to their comments
+/// at the end of the translation unit, one file at a time: the declarations of a
+/// file are sorted by location and walked alongside the file's comment list, so
+/// each comment list is traversed once instead of searched for every declaration.
+/// The matching follows the rules of ASTContext::getRawCommentForDeclNoCache().
 class CommentProcessor
 {
 public:
@@ -34,11 +44,14 @@ public:
     /// \param astContext AST context for comment analysis
     CommentProcessor(KuzuDatabase& database, ASTNodeProcessor& nodeProcessor, ASTContext& astContext);
 
-    /// Process comments for a declaration
+    /// Queue a declaration for comment matching
     /// \param decl Declaration to process comments for
     /// \param declId Node ID of the declaration
     void processComments(const clang::Decl* decl, int64_t declId);
 
+    /// Match the queued declarations to their comments and create the Comment rows
+    void finish();
+
     /// Create comment node
     /// \param nodeId Node ID for the comment
     /// \param commentText Text content of the comment
@@ -74,8 +87,36 @@ public:
     auto isDocumentationComment(const clang::comments::Comment* comment) -> bool;
 
 private:
+    /// A queued declaration at its comment search location
+    struct PendingDecl
+    {
+        unsigned offset;  // In the file the declaration's group is keyed by
+        const Decl* decl;
+        int64_t declId;
+    };
+
+    /// Find the comment of a declaration in its file's comment list
+    /// \param pending The declaration
+    /// \param file The file of the declaration
+    /// \param comments The file's comments keyed by offset
+    /// \param behind First comment at or after the declaration; advanced as declarations are walked in order
+    /// \return The comment, or null
+    auto findComment(const PendingDecl& pending,
+                     FileID file,
+                     const std::map<unsigned, RawComment*>& comments,
+                     std::map<unsigned, RawComment*>::const_iterator& behind) const -> const RawComment*;
+
+    /// Create the Comment row and HAS_COMMENT relationship of a declaration
+    void emitComment(const Decl* decl, int64_t declId, const RawComment& rawComment);
+
     KuzuDatabase& database;
     const ASTContext* astContext;
+
+    // Declarations waiting for finish(), per file
+    llvm::DenseMap<FileID, std::vector<PendingDecl>> pendingDecls;
+
+    // Declarations whose location is in a macro, matched by Clang one at a time
+    llvm::SmallVector<std::pair<const Decl*, int64_t>, 0> macroDecls;
 };
 
 }  // namespace clang
@@ -6,12 +6,20 @@
 
 #include "CompilationDatabaseLoader.h"
 
+#include "IncrementalIndex.h"
+#include "StreamingCompilationDatabase.h"
+
 // clang-format off
+#include <doctest/doctest.h>
+
 #include "NoWarningScope_Enter.h"
-#include "clang/Tooling/JSONCompilationDatabase.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
@@ -20,8 +28,10 @@
 using namespace clang;
 using namespace clang::tooling;
 
-auto CompilationDatabaseLoader::loadFromFile(const std::string& path, std::string& errorMessage)
-    -> std::unique_ptr<CompilationDatabase>
+auto CompilationDatabaseLoader::loadFromFile(const std::string& path,
+                                             std::string& errorMessage,
+                                             const FileFilter& filter,
+                                             Shard shard) -> std::unique_ptr<CompilationDatabase>
 {
     // Check if file exists
     if (!llvm::sys::fs::exists(path))
@@ -37,19 +47,17 @@ auto CompilationDatabaseLoader::loadFromFile(const std::string& path, std::strin
         return nullptr;
     }
 
-    // Try to load the compilation database
-    std::string loadError;
-    auto database = JSONCompilationDatabase::loadFromFile(path, loadError, JSONCommandLineSyntax::AutoDetect);
-
+    // Entries outside the filter or shard are dropped during the scan, before any command is parsed
+    auto database = StreamingCompilationDatabase::load(
+        path, [&](llvm::StringRef file) { return filter.matches(file) && isInShard(file, shard); }, errorMessage);
     if (!database)
     {
-        errorMessage = "Failed to load compilation database: " + loadError;
+        errorMessage = "Failed to load compilation database: " + errorMessage;
         return nullptr;
     }
 
     // Validate that the database has some entries
-    auto allFiles = database->getAllFiles();
-    if (allFiles.empty())
+    if (database->getEntryCount() == 0)
     {
         errorMessage = "Compilation database is empty (no source files found)";
         return nullptr;
@@ -60,64 +68,157 @@ auto CompilationDatabaseLoader::loadFromFile(const std::string& path, std::strin
     return database;
 }
 
-auto CompilationDatabaseLoader::filterSourceFiles(const CompilationDatabase& db, const std::string& pattern)
-    -> std::vector<std::string>
+auto CompilationDatabaseLoader::filterSourceFiles(const CompilationDatabase& db,
+                                                  const FileFilter& filter,
+                                                  IncrementalIndex* index,
+                                                  Shard shard) -> std::vector<std::string>
 {
     auto allFiles = db.getAllFiles();
     std::vector<std::string> filteredFiles;
+    std::vector<std::string> upToDateFiles;
+    filteredFiles.reserve(allFiles.size());
 
-    // If no pattern specified, return all files
-    if (pattern.empty())
+    for (const auto& file : allFiles)
     {
-        filteredFiles.reserve(allFiles.size());
-        for (const auto& file : allFiles)
+        if (!filter.matches(file))
+            continue;
+        if (!isInShard(file, shard))
+            continue;
+        if (index != nullptr && index->isUpToDate(db, file))
+            upToDateFiles.push_back(file);
+        else
             filteredFiles.push_back(file);
-        return filteredFiles;
     }
 
-    // Filter files by pattern
-    for (const auto& file : allFiles)
-        if (matchesPattern(file, pattern))
-            filteredFiles.push_back(file);
+    if (index != nullptr)
+        index->rescheduleBorrowers(filteredFiles, upToDateFiles);
 
     return filteredFiles;
 }
 
-auto CompilationDatabaseLoader::matchesPattern(llvm::StringRef filePath, llvm::StringRef pattern) -> bool
+auto CompilationDatabaseLoader::parseShard(llvm::StringRef spec, Shard& shard) -> bool
 {
-    // Simple pattern matching - supports basic wildcards
-    // For now, implement basic substring matching with * wildcards
+    auto [index, count] = spec.split('/');
+    Shard parsed;
+    if (index.getAsInteger(10, parsed.index) || count.getAsInteger(10, parsed.count))
+        return false;
+    if (parsed.count == 0 || parsed.index >= parsed.count)
+        return false;
+
+    shard = parsed;
+    return true;
+}
 
-    if (pattern.empty())
+auto CompilationDatabaseLoader::isInShard(llvm::StringRef filePath, Shard shard) -> bool
+{
+    if (shard.count <= 1)
         return true;
+    return llvm::xxh3_64bits(IncrementalIndex::normalizePath(filePath)) % shard.count == shard.index;
+}
 
-    // Handle simple cases
-    if (pattern == "*")
-        return true;
+namespace
+{
 
-    // Convert to lowercase for case-insensitive matching on Windows
-    std::string lowerFilePath = filePath.lower();
-    std::string lowerPattern = pattern.lower();
+/// Bring a path or pattern to the form patterns are matched in
+void normalizeForMatching(llvm::StringRef text, llvm::SmallVectorImpl<char>& normalized)
+{
+    // Windows separators would read as glob escapes
+    bool windows = llvm::sys::path::is_style_windows(llvm::sys::path::Style::native);
+    normalized.clear();
+    normalized.reserve(text.size());
+    for (char c : text)
+        normalized.push_back(windows && c == '\\' ? '/' : llvm::toLower(c));
+}
 
-    // Simple wildcard matching
-    if (lowerPattern.front() == '*' && lowerPattern.back() == '*')
-    {
-        // Pattern like "*substring*"
-        std::string substring = lowerPattern.substr(1, lowerPattern.length() - 2);
-        return lowerFilePath.find(substring) != std::string::npos;
-    }
-    if (lowerPattern.front() == '*')
+auto compilePatterns(const std::vector<std::string>& patterns,
+                     std::vector<llvm::GlobPattern>& compiled,
+                     std::string& errorMessage) -> bool
+{
+    compiled.clear();
+    llvm::SmallString<256> normalized;
+    for (const auto& pattern : patterns)
     {
-        // Pattern like "*suffix"
-        std::string suffix = lowerPattern.substr(1);
-        return lowerFilePath.ends_with(suffix);
+        normalizeForMatching(pattern, normalized);
+        if (normalized.str().find_first_of("*?[{") == llvm::StringRef::npos)
+        {
+            normalized.insert(normalized.begin(), '*');
+            normalized.push_back('*');
+        }
+
+        auto glob = llvm::GlobPattern::create(normalized);
+        if (!glob)
+        {
+            errorMessage = "Invalid pattern '" + pattern + "': " + llvm::toString(glob.takeError());
+            return false;
+        }
+        compiled.push_back(std::move(*glob));
     }
-    if (lowerPattern.back() == '*')
+    return true;
+}
+
+}  // namespace
+
+auto CompilationDatabaseLoader::FileFilter::compile(const std::vector<std::string>& includes,
+                                                    const std::vector<std::string>& excludes,
+                                                    std::string& errorMessage) -> bool
+{
+    return compilePatterns(includes, this->includes, errorMessage) &&
+           compilePatterns(excludes, this->excludes, errorMessage);
+}
+
+auto CompilationDatabaseLoader::FileFilter::matches(llvm::StringRef filePath) const -> bool
+{
+    if (includes.empty() && excludes.empty())
+        return true;
+
+    llvm::SmallString<256> normalized;
+    normalizeForMatching(filePath, normalized);
+    auto matchesAny = [&](const std::vector<llvm::GlobPattern>& patterns)
+    { return std::ranges::any_of(patterns, [&](const auto& glob) { return glob.match(normalized); }); };
+    return (includes.empty() || matchesAny(includes)) && !matchesAny(excludes);
+}
+
+TEST_CASE("CompilationDatabaseLoader::FileFilter")
+{
+    using FileFilter = CompilationDatabaseLoader::FileFilter;
+    std::string error;
+
+    CHECK(FileFilter().matches("/project/src/parser.cpp"));
+
+    FileFilter filter;
+    REQUIRE(filter.compile({"*/src/*.cpp", "Tools"}, {"*_test.cpp"}, error));
+    CHECK(filter.matches("/project/src/parser.cpp"));
+    CHECK(filter.matches("/project/src/detail/lexer.cpp"));
+    CHECK(filter.matches("/project/SRC/Parser.CPP"));
+    CHECK_FALSE(filter.matches("/project/src/parser_test.cpp"));
+    CHECK_FALSE(filter.matches("/project/include/parser.h"));
+
+    // A pattern without wildcards matches any path containing it
+    CHECK(filter.matches("/project/tools/generate.py"));
+    CHECK_FALSE(filter.matches("/project/tool/generate.py"));
+    if (llvm::sys::path::is_style_windows(llvm::sys::path::Style::native))
+        CHECK(filter.matches("C:\\project\\src\\parser.cpp"));
+
+    FileFilter excludeOnly;
+    REQUIRE(excludeOnly.compile({}, {"third_party"}, error));
+    CHECK(excludeOnly.matches("/project/src/parser.cpp"));
+    CHECK_FALSE(excludeOnly.matches("/project/third_party/zlib/inflate.c"));
+
+    CHECK_FALSE(filter.compile({"[a"}, {}, error));
+    CHECK(llvm::StringRef(error).contains("'[a'"));
+}
+
+TEST_CASE("CompilationDatabaseLoader::parseShard")
+{
+    CompilationDatabaseLoader::Shard shard;
+    REQUIRE(CompilationDatabaseLoader::parseShard("2/4", shard));
+    CHECK(shard.index == 2);
+    CHECK(shard.count == 4);
+
+    for (const char* spec : {"4/4", "1/0", "a/2", "1", "1/", "-1/2", "1/2/3"})
     {
-        // Pattern like "prefix*"
-        std::string prefix = lowerPattern.substr(0, lowerPattern.length() - 1);
-        return lowerFilePath.starts_with(prefix);
+        CAPTURE(spec);
+        CHECK_FALSE(CompilationDatabaseLoader::parseShard(spec, shard));
     }
-    // Exact substring match
-    return lowerFilePath.find(lowerPattern) != std::string::npos;
+    CHECK(shard.index == 2);
 }
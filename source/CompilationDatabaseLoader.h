@@ -10,6 +10,7 @@
 #include "NoWarningScope_Enter.h"
 #include "clang/Tooling/CompilationDatabase.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/GlobPattern.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
@@ -20,30 +21,76 @@
 namespace clang
 {
 
+class IncrementalIndex;
+
 /// Utility class for loading and validating compilation databases
 class CompilationDatabaseLoader
 {
 public:
+    /// One of several disjoint slices of a compilation database, each indexed by its own process
+    struct Shard
+    {
+        unsigned index = 0;
+        unsigned count = 1;
+    };
+
+    /// Include and exclude globs, compiled once and matched against every database entry
+    /// A file is selected if it matches any include, or there are none, and no exclude.
+    /// Patterns match the whole path, ignoring case and with '/' as the separator; a
+    /// pattern without wildcards matches any path containing it.
+    class FileFilter
+    {
+    public:
+        /// Compile the patterns
+        /// \param includes Globs selecting files; empty selects all
+        /// \param excludes Globs removing files from the selection
+        /// \param errorMessage Receives the reason if a pattern is malformed
+        /// \return False if a pattern is malformed
+        auto compile(const std::vector<std::string>& includes,
+                     const std::vector<std::string>& excludes,
+                     std::string& errorMessage) -> bool;
+
+        /// Check whether a file is selected
+        [[nodiscard]] auto matches(llvm::StringRef filePath) const -> bool;
+
+    private:
+        std::vector<llvm::GlobPattern> includes;
+        std::vector<llvm::GlobPattern> excludes;
+    };
+
+    /// Parse a shard given as "i/N" with 0 <= i < N
+    /// \param spec The shard specification
+    /// \param shard Receives the parsed shard
+    /// \return False if \p spec is malformed
+    static auto parseShard(llvm::StringRef spec, Shard& shard) -> bool;
+
     /// Load a compilation database from a file
     /// \param path Path to the compile_commands.json file
     /// \param errorMessage Output parameter for error messages
+    /// \param filter Files to keep; the others are left out of the database
+    /// \param shard Slice of the files to keep
     /// \return Unique pointer to the loaded database, or nullptr on failure
-    static auto loadFromFile(const std::string& path, std::string& errorMessage)
-        -> std::unique_ptr<clang::tooling::CompilationDatabase>;
+    static auto loadFromFile(const std::string& path,
+                             std::string& errorMessage,
+                             const FileFilter& filter = {},
+                             Shard shard = {0, 1}) -> std::unique_ptr<clang::tooling::CompilationDatabase>;
 
     /// Filter source files from the compilation database
     /// \param db The compilation database to filter
-    /// \param pattern Optional pattern to filter files (empty means all files)
-    /// \return Vector of source file paths that match the pattern
-    static auto filterSourceFiles(const clang::tooling::CompilationDatabase& db, const std::string& pattern = "")
-        -> std::vector<std::string>;
+    /// \param filter Files to keep; the default keeps all
+    /// \param index Optional incremental index; files it reports as up to date are left out
+    /// \param shard Slice of the files to keep; files are assigned by a hash of their path
+    /// \return Vector of source file paths that match the filter
+    static auto filterSourceFiles(const clang::tooling::CompilationDatabase& db,
+                                  const FileFilter& filter = {},
+                                  IncrementalIndex* index = nullptr,
+                                  Shard shard = {0, 1}) -> std::vector<std::string>;
 
 private:
-    /// Check if a file path matches the given pattern
-    /// \param filePath The file path to check
-    /// \param pattern The pattern to match against (supports basic wildcards)
-    /// \return True if the file matches the pattern
-    static auto matchesPattern(llvm::StringRef filePath, llvm::StringRef pattern) -> bool;
+    /// Check if a file belongs to a shard
+    /// The assignment depends on the path only, so a file stays in its shard as the
+    /// compilation database changes, which keeps --incremental effective per shard.
+    static auto isInShard(llvm::StringRef filePath, Shard shard) -> bool;
 };
 
 }  // namespace clang
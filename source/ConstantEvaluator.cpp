@@ -0,0 +1,93 @@
+//===--- ConstantEvaluator.cpp - Cached, budgeted constant evaluation -----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConstantEvaluator.h"
+
+#include "Statistics.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Basic/LangOptions.h"
+#include "llvm/ADT/SmallString.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <string>
+
+using namespace clang;
+
+namespace
+{
+
+/// Lower the evaluator's step limit for the evaluations of one scope
+/// Clang reads the limit from the LangOptions each time an evaluation starts. The
+/// options belong to the compiler invocation and are mutable there; the AST is
+/// complete by the time the analyzers run, so Sema no longer depends on them.
+class StepLimitScope
+{
+public:
+    StepLimitScope(const LangOptions& langOptions, unsigned limit)
+        : langOptions(const_cast<LangOptions&>(langOptions)), saved(langOptions.ConstexprStepLimit)
+    {
+        if (limit != 0 && limit < saved)
+            this->langOptions.ConstexprStepLimit = limit;
+    }
+
+    ~StepLimitScope() { langOptions.ConstexprStepLimit = saved; }
+
+    StepLimitScope(const StepLimitScope&) = delete;
+    auto operator=(const StepLimitScope&) -> StepLimitScope& = delete;
+
+private:
+    LangOptions& langOptions;
+    unsigned saved;
+};
+
+}  // namespace
+
+ConstantEvaluator::ConstantEvaluator(ASTContext& astContext, const ConstantEvaluationOptions& options)
+    : astContext(astContext), options(options)
+{
+}
+
+auto ConstantEvaluator::evaluate(const Expr* expr) -> const Evaluation&
+{
+    auto [it, inserted] = evaluations.try_emplace(expr);
+    Evaluation& evaluation = it->second;
+    if (!inserted)
+        return evaluation;
+
+    if (expr->isValueDependent() || expr->isTypeDependent())
+        evaluation.status = Status::Dependent;
+    else if (expr->getType().isNull())
+        evaluation.status = Status::InvalidType;
+    else if (options.timeBudget.count() != 0 && spent >= options.timeBudget)
+        evaluation.status = Status::OverBudget;
+    else
+    {
+        PhaseTimer timer(StatisticsPhase::ConstantEvaluation);
+        StepLimitScope stepLimit(astContext.getLangOpts(), options.stepLimit);
+        auto start = std::chrono::steady_clock::now();
+        bool constant = expr->EvaluateAsConstantExpr(evaluation.result, astContext);
+        spent += std::chrono::steady_clock::now() - start;
+        evaluation.status = constant ? Status::Constant : Status::NotConstant;
+    }
+    return evaluation;
+}
+
+auto ConstantEvaluator::formatValue(const Evaluation& evaluation, const std::string& fallback) -> std::string
+{
+    const APValue& value = evaluation.result.Val;
+    if (value.isInt())
+        return std::to_string(value.getInt().getLimitedValue());
+    if (value.isFloat())
+    {
+        llvm::SmallString<16> str;
+        value.getFloat().toString(str);
+        return str.str().str();
+    }
+    return fallback;
+}
@@ -0,0 +1,78 @@
+//===--- ConstantEvaluator.h - Cached, budgeted constant evaluation -------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "AnalysisOptions.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "llvm/ADT/DenseMap.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <chrono>
+
+namespace clang
+{
+
+/// Evaluates each expression of a translation unit as a constant expression at most once
+/// The Expression, ConstantExpression and StaticAssertion rows all derive their
+/// fields from the one cached Expr::EvalResult. Every evaluation runs under the
+/// run's ConstantEvaluationOptions step limit, and once the translation unit has
+/// spent its time budget the remaining expressions are not evaluated at all.
+class ConstantEvaluator
+{
+public:
+    /// Outcome of evaluating one expression
+    enum class Status
+    {
+        Dependent,    // Value or type dependent; never evaluated
+        InvalidType,  // No type to evaluate for
+        Constant,     // Evaluated; the result holds the value
+        NotConstant,  // Not a constant expression, or over the step limit
+        OverBudget    // Not evaluated: the translation unit's time budget is spent
+    };
+
+    /// A cached evaluation
+    struct Evaluation
+    {
+        Status status = Status::NotConstant;
+        Expr::EvalResult result;  // Meaningful for Status::Constant only
+    };
+
+    /// Constructor
+    /// \param astContext AST context of the translation unit
+    /// \param options Limits of the run
+    ConstantEvaluator(ASTContext& astContext, const ConstantEvaluationOptions& options);
+
+    /// Evaluate an expression, or return its earlier evaluation
+    /// \param expr The expression
+    /// \return The evaluation, valid until the next call
+    auto evaluate(const Expr* expr) -> const Evaluation&;
+
+    /// Check whether an expression evaluates to a constant
+    auto isConstant(const Expr* expr) -> bool { return evaluate(expr).status == Status::Constant; }
+
+    /// Format the value of a constant evaluation the way the analyzers store it
+    /// \param evaluation A Status::Constant evaluation
+    /// \param fallback Text for values that are neither integers nor floats
+    /// \return The integer or float value, or \p fallback
+    static auto formatValue(const Evaluation& evaluation, const std::string& fallback) -> std::string;
+
+private:
+    ASTContext& astContext;
+    const ConstantEvaluationOptions& options;
+
+    // Evaluation time spent by this translation unit
+    std::chrono::steady_clock::duration spent{};
+
+    llvm::DenseMap<const Expr*, Evaluation> evaluations;
+};
+
+}  // namespace clang
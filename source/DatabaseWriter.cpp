@@ -0,0 +1,100 @@
+//===--- DatabaseWriter.cpp - Single writer thread for staged batches -----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "DatabaseWriter.h"
+
+#include "GlobalDatabaseManager.h"
+#include "Statistics.h"
+#include "Trace.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+using namespace clang;
+
+DatabaseWriter::DatabaseWriter(KuzuDatabase& database, size_t queueCapacity)
+    : database(database), queue(queueCapacity), thread([this] { run(); })
+{
+}
+
+DatabaseWriter::~DatabaseWriter()
+{
+    finish();
+}
+
+void DatabaseWriter::submit(KuzuDatabase::PendingBatch&& batch)
+{
+    // Only extract threads submit, so a full queue holds back the extract stage
+    auto start = std::chrono::steady_clock::now();
+    bool queued = queue.push(std::move(batch));
+    Statistics::getInstance().addStageOutputWait(PipelineStage::Extract, nanosecondsSince(start));
+    Trace::getInstance().addSpan("Wait for database writer", "wait", start, std::chrono::steady_clock::now());
+    if (!queued)
+        llvm::errs() << "Warning: database writer already finished, dropping batch\n";
+}
+
+void DatabaseWriter::finish()
+{
+    queue.close();
+    if (thread.joinable())
+        thread.join();
+}
+
+void DatabaseWriter::run()
+{
+    auto& statistics = Statistics::getInstance();
+    statistics.setStageThreads(PipelineStage::Write, 1);
+    auto& trace = Trace::getInstance();
+    trace.setThreadName("database writer");
+    auto waitStart = std::chrono::steady_clock::now();
+    while (auto batch = queue.pop())
+    {
+        int64_t inputWait = nanosecondsSince(waitStart);
+        auto executeStart = std::chrono::steady_clock::now();
+        trace.addSpan("Wait for batch", "wait", waitStart, executeStart);
+        try
+        {
+            database.executeStagedBatch(std::move(*batch));
+        }
+        catch (const std::exception& e)
+        {
+            llvm::errs() << "Exception executing staged batch: " << e.what() << "\n";
+        }
+        statistics.addStageTime(PipelineStage::Write, nanosecondsSince(executeStart), inputWait);
+        waitStart = std::chrono::steady_clock::now();
+    }
+
+    database.flushOperations();
+}
+
+StagedThreadDatabase::StagedThreadDatabase(KuzuDatabase& database, DatabaseWriter& writer)
+    : staging(KuzuDatabase::createStaging(
+          database,
+          [&writer](KuzuDatabase::PendingBatch&& batch)
+          {
+              writer.submit(std::move(batch));
+              GlobalDatabaseManager::getInstance().publishTranslationUnits();
+          }))
+{
+    GlobalDatabaseManager::bindThreadDatabase(staging.get());
+}
+
+StagedThreadDatabase::~StagedThreadDatabase()
+{
+    try
+    {
+        staging->flushOperations();
+        GlobalDatabaseManager::getInstance().publishTranslationUnits();
+    }
+    catch (const std::exception& e)
+    {
+        llvm::errs() << "Exception flushing staged rows: " << e.what() << "\n";
+    }
+    GlobalDatabaseManager::bindThreadDatabase(nullptr);
+}
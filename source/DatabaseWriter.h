@@ -0,0 +1,72 @@
+//===--- DatabaseWriter.h - Single writer thread for staged batches -------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "BoundedQueue.h"
+#include "KuzuDatabase.h"
+
+#include <memory>
+#include <thread>
+
+namespace clang
+{
+
+/// Owns the only thread that talks to a connected KuzuDatabase
+/// Kuzu serializes write transactions anyway, so indexing workers stage their
+/// batches and hand them over here rather than contending for the connection.
+class DatabaseWriter
+{
+public:
+    /// Constructor - starts the writer thread
+    /// \param database Connected database that executes the batches
+    /// \param queueCapacity Number of batches that may wait before submit() blocks
+    DatabaseWriter(KuzuDatabase& database, size_t queueCapacity);
+
+    /// Destructor - drains the queue and joins the writer thread
+    ~DatabaseWriter();
+
+    DatabaseWriter(const DatabaseWriter&) = delete;
+    auto operator=(const DatabaseWriter&) -> DatabaseWriter& = delete;
+
+    /// Queue a batch for execution, blocking while the queue is full
+    /// \param batch The batch to execute
+    void submit(KuzuDatabase::PendingBatch&& batch);
+
+    /// Execute all queued batches, flush the database and stop the writer thread
+    void finish();
+
+private:
+    /// Writer thread body
+    void run();
+
+    KuzuDatabase& database;
+    BoundedQueue<KuzuDatabase::PendingBatch> queue;
+    std::thread thread;
+};
+
+/// Routes the calling thread's database writes through a DatabaseWriter for its lifetime
+/// The thread stages its rows and keeps traversing while the writer thread executes
+/// the previous batches; submit() blocks once the writer's queue is full.
+class StagedThreadDatabase
+{
+public:
+    /// Constructor - binds a staging database to the calling thread
+    /// \param database Connected database the writer executes the batches on
+    /// \param writer Writer receiving the staged batches; must outlive this object
+    StagedThreadDatabase(KuzuDatabase& database, DatabaseWriter& writer);
+
+    /// Destructor - hands the last rows to the writer and unbinds the staging database
+    ~StagedThreadDatabase();
+
+    StagedThreadDatabase(const StagedThreadDatabase&) = delete;
+    auto operator=(const StagedThreadDatabase&) -> StagedThreadDatabase& = delete;
+
+private:
+    std::unique_ptr<KuzuDatabase> staging;
+};
+
+}  // namespace clang
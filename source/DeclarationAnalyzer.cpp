@@ -8,19 +8,18 @@
 
 #include "GlobalDatabaseManager.h"
 #include "KuzuDatabase.h"
+#include "Trace.h"
 
 // clang-format off
 #include "NoWarningScope_Enter.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/DeclTemplate.h"
 #include "clang/Lex/Lexer.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
-#include <algorithm>
-#include <vector>
-
 using namespace clang;
 
 DeclarationAnalyzer::DeclarationAnalyzer(KuzuDatabase& database) : database(database)
@@ -32,31 +31,27 @@ void DeclarationAnalyzer::createDeclarationNode(int64_t nodeId, const clang::Nam
     if (!database.isInitialized() || (decl == nullptr))
         return;
 
-    // Check if Declaration node already exists for this nodeId
-    auto& dbManager = GlobalDatabaseManager::getInstance();
-    if (dbManager.hasDeclarationNode(nodeId))
+    // Claim the row up front: one probe both checks and records it
+    if (!GlobalDatabaseManager::getInstance().markNodeRow(decl, DeclarationRow))
         return;
 
+    TraceSpan span("DeclarationAnalyzer");
+
     try
     {
-        std::string name = KuzuDatabase::escapeString(decl->getNameAsString());
-        std::string qualifiedName = extractQualifiedName(decl);
-        std::string accessSpec = KuzuDatabase::escapeString(extractAccessSpecifier(decl));
-        std::string storageClass = KuzuDatabase::escapeString(extractStorageClass(decl));
-        std::string namespaceContext = KuzuDatabase::escapeString(extractNamespaceContext(decl));
-        bool isDef = isDefinition(decl);
-
         // Create Declaration node with extracted properties
-        std::string query = "CREATE (d:Declaration {node_id: " + std::to_string(nodeId) + ", name: '" + name +
-                            "', qualified_name: '" + qualifiedName + "', access_specifier: '" + accessSpec +
-                            "', storage_class: '" + storageClass + "', is_definition: " + (isDef ? "true" : "false") +
-                            ", namespace_context: '" + namespaceContext + "'})";
-
-        // Use batched operation for performance optimization
-        database.addToBatch(query);
-
-        // Register that this Declaration node has been created
-        dbManager.registerDeclarationNode(nodeId);
+        llvm::SmallString<64> name;
+        llvm::SmallString<128> qualifiedName;
+        llvm::SmallString<128> namespaceContext;
+        llvm::raw_svector_ostream(name) << decl->getDeclName();
+        database.addNodeToBatch("Declaration",
+                                {{"node_id", nodeId},
+                                 {"name", name.str()},
+                                 {"qualified_name", extractQualifiedName(decl, qualifiedName)},
+                                 {"access_specifier", extractAccessSpecifier(decl)},
+                                 {"storage_class", extractStorageClass(decl)},
+                                 {"is_definition", isDefinition(decl)},
+                                 {"namespace_context", extractNamespaceContext(decl, namespaceContext)}});
     }
     catch (const std::exception& e)
     {
@@ -92,17 +87,12 @@ void DeclarationAnalyzer::createUsingDeclarationNode(int64_t nodeId, const clang
 
         introducesName = decl->getNameAsString();
 
-        // Use proper escaping for database storage
-        targetName = KuzuDatabase::escapeString(targetName);
-        introducesName = KuzuDatabase::escapeString(introducesName);
-        std::string escapedUsingKind = KuzuDatabase::escapeString(usingKind);
-        std::string escapedScopeImpact = KuzuDatabase::escapeString(scopeImpact);
-
-        std::string query = "CREATE (u:UsingDeclaration {node_id: " + std::to_string(nodeId) + ", using_kind: '" +
-                            escapedUsingKind + "', target_name: '" + targetName + "', introduces_name: '" +
-                            introducesName + "', scope_impact: '" + escapedScopeImpact + "'})";
-
-        database.addToBatch(query);
+        database.addNodeToBatch("UsingDeclaration",
+                                {{"node_id", nodeId},
+                                 {"using_kind", usingKind},
+                                 {"target_name", targetName},
+                                 {"introduces_name", introducesName},
+                                 {"scope_impact", scopeImpact}});
     }
     catch (const std::exception& e)
     {
@@ -129,17 +119,12 @@ void DeclarationAnalyzer::createUsingDirectiveNode(int64_t nodeId, const clang::
             introducesName = "*";  // Directive brings in all names from namespace
         }
 
-        // Use proper escaping for database storage
-        targetName = KuzuDatabase::escapeString(targetName);
-        introducesName = KuzuDatabase::escapeString(introducesName);
-        std::string escapedUsingKind = KuzuDatabase::escapeString(usingKind);
-        std::string escapedScopeImpact = KuzuDatabase::escapeString(scopeImpact);
-
-        std::string query = "CREATE (u:UsingDeclaration {node_id: " + std::to_string(nodeId) + ", using_kind: '" +
-                            escapedUsingKind + "', target_name: '" + targetName + "', introduces_name: '" +
-                            introducesName + "', scope_impact: '" + escapedScopeImpact + "'})";
-
-        database.addToBatch(query);
+        database.addNodeToBatch("UsingDeclaration",
+                                {{"node_id", nodeId},
+                                 {"using_kind", usingKind},
+                                 {"target_name", targetName},
+                                 {"introduces_name", introducesName},
+                                 {"scope_impact", scopeImpact}});
     }
     catch (const std::exception& e)
     {
@@ -163,17 +148,12 @@ void DeclarationAnalyzer::createNamespaceAliasNode(int64_t nodeId, const clang::
         if (const auto* aliasedNS = decl->getNamespace())
             targetName = aliasedNS->getQualifiedNameAsString();
 
-        // Use proper escaping for database storage
-        targetName = KuzuDatabase::escapeString(targetName);
-        introducesName = KuzuDatabase::escapeString(introducesName);
-        std::string escapedUsingKind = KuzuDatabase::escapeString(usingKind);
-        std::string escapedScopeImpact = KuzuDatabase::escapeString(scopeImpact);
-
-        std::string query = "CREATE (u:UsingDeclaration {node_id: " + std::to_string(nodeId) + ", using_kind: '" +
-                            escapedUsingKind + "', target_name: '" + targetName + "', introduces_name: '" +
-                            introducesName + "', scope_impact: '" + escapedScopeImpact + "'})";
-
-        database.addToBatch(query);
+        database.addNodeToBatch("UsingDeclaration",
+                                {{"node_id", nodeId},
+                                 {"using_kind", usingKind},
+                                 {"target_name", targetName},
+                                 {"introduces_name", introducesName},
+                                 {"scope_impact", scopeImpact}});
     }
     catch (const std::exception& e)
     {
@@ -199,17 +179,19 @@ void DeclarationAnalyzer::createReferenceRelation(int64_t fromId, int64_t toId,
     }
 }
 
-auto DeclarationAnalyzer::extractQualifiedName(const clang::NamedDecl* decl) -> std::string
+auto DeclarationAnalyzer::extractQualifiedName(const clang::NamedDecl* decl, llvm::SmallVectorImpl<char>& buffer)
+    -> llvm::StringRef
 {
+    buffer.clear();
     if (decl == nullptr)
         return "";
 
-    std::string qualifiedName = decl->getQualifiedNameAsString();
-    // Escape string for safe database storage
-    return KuzuDatabase::escapeString(qualifiedName);
+    llvm::raw_svector_ostream os(buffer);
+    decl->printQualifiedName(os);
+    return os.str();
 }
 
-auto DeclarationAnalyzer::extractAccessSpecifier(const clang::Decl* decl) -> std::string
+auto DeclarationAnalyzer::extractAccessSpecifier(const clang::Decl* decl) -> llvm::StringRef
 {
     if (decl == nullptr)
         return "none";
@@ -228,7 +210,7 @@ auto DeclarationAnalyzer::extractAccessSpecifier(const clang::Decl* decl) -> std
     }
 }
 
-auto DeclarationAnalyzer::extractStorageClass(const clang::Decl* decl) -> std::string
+auto DeclarationAnalyzer::extractStorageClass(const clang::Decl* decl) -> llvm::StringRef
 {
     if (const auto* varDecl = dyn_cast<VarDecl>(decl))
     {
@@ -266,40 +248,34 @@ auto DeclarationAnalyzer::extractStorageClass(const clang::Decl* decl) -> std::s
     return "none";
 }
 
-auto DeclarationAnalyzer::extractNamespaceContext(const clang::Decl* decl) -> std::string
+auto DeclarationAnalyzer::extractNamespaceContext(const clang::Decl* decl, llvm::SmallVectorImpl<char>& buffer)
+    -> llvm::StringRef
 {
+    buffer.clear();
     if (decl == nullptr)
         return "";
 
-    const DeclContext* context = decl->getDeclContext();
-    std::vector<std::string> namespaces;
-
-    while ((context != nullptr) && !context->isTranslationUnit())
+    // Identifier names live in the ASTContext, so collecting them copies nothing
+    llvm::SmallVector<llvm::StringRef, 8> names;
+    for (const DeclContext* context = decl->getDeclContext(); (context != nullptr) && !context->isTranslationUnit();
+         context = context->getParent())
     {
         if (const auto* nsDecl = dyn_cast<NamespaceDecl>(context))
         {
             if (!nsDecl->isAnonymousNamespace())
-                namespaces.push_back(nsDecl->getNameAsString());
+                names.push_back(nsDecl->getName());
         }
         else if (const auto* recordDecl = dyn_cast<RecordDecl>(context))
         {
             if (recordDecl->getIdentifier() != nullptr)
-                namespaces.push_back(recordDecl->getNameAsString());
+                names.push_back(recordDecl->getName());
         }
-        context = context->getParent();
-    }
-
-    std::ranges::reverse(namespaces);
-
-    std::string result;
-    for (size_t i = 0; i < namespaces.size(); ++i)
-    {
-        if (i > 0)
-            result += "::";
-        result += namespaces[i];
     }
 
-    return result;
+    llvm::raw_svector_ostream os(buffer);
+    for (auto it = names.rbegin(); it != names.rend(); ++it)
+        os << (it == names.rbegin() ? "" : "::") << *it;
+    return os.str();
 }
 
 auto DeclarationAnalyzer::isDefinition(const clang::Decl* decl) -> bool
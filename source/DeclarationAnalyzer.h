@@ -10,6 +10,8 @@
 #include "NoWarningScope_Enter.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclCXX.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
@@ -57,23 +59,25 @@ public:
 
     /// Extract qualified name from declaration
     /// \param decl The named declaration
-    /// \return Qualified name string
-    auto extractQualifiedName(const clang::NamedDecl* decl) -> std::string;
+    /// \param buffer Storage the name is printed into, reused across declarations
+    /// \return Qualified name, valid while \p buffer is unchanged
+    auto extractQualifiedName(const clang::NamedDecl* decl, llvm::SmallVectorImpl<char>& buffer) -> llvm::StringRef;
 
     /// Extract access specifier from declaration
     /// \param decl The declaration
-    /// \return Access specifier string
-    auto extractAccessSpecifier(const clang::Decl* decl) -> std::string;
+    /// \return Static access specifier string
+    auto extractAccessSpecifier(const clang::Decl* decl) -> llvm::StringRef;
 
     /// Extract storage class from declaration
     /// \param decl The declaration
-    /// \return Storage class string
-    auto extractStorageClass(const clang::Decl* decl) -> std::string;
+    /// \return Static storage class string
+    auto extractStorageClass(const clang::Decl* decl) -> llvm::StringRef;
 
     /// Extract namespace context from declaration
     /// \param decl The declaration
-    /// \return Namespace context string
-    auto extractNamespaceContext(const clang::Decl* decl) -> std::string;
+    /// \param buffer Storage the enclosing namespace and class names are joined into
+    /// \return Namespace context, valid while \p buffer is unchanged
+    auto extractNamespaceContext(const clang::Decl* decl, llvm::SmallVectorImpl<char>& buffer) -> llvm::StringRef;
 
     /// Check if declaration is a definition
     /// \param decl The declaration
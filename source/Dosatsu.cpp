@@ -1,6 +1,17 @@
 #include "ASTDumpAction.h"
+#include "AnalysisOptions.h"
 #include "CompilationDatabaseLoader.h"
+#include "DatabaseWriter.h"
 #include "GlobalDatabaseManager.h"
+#include "IncrementalIndex.h"
+#include "IndexServer.h"
+#include "MemoryMonitor.h"
+#include "ParallelIndexer.h"
+#include "ShardMerger.h"
+#include "SummaryTables.h"
+#include "Statistics.h"
+#include "TextDump.h"
+#include "Trace.h"
 
 // clang-format off
 #define DOCTEST_CONFIG_IMPLEMENT
@@ -9,7 +20,9 @@
 #include "NoWarningScope_Enter.h"
 #include "clang/Tooling/Tooling.h"
 #include "clang/Tooling/CommonOptionsParser.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
@@ -18,10 +31,20 @@
 #include <windows.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <vector>
 
+/// When rows are staged for one COPY per table, see --bulk-load
+enum class BulkLoadMode
+{
+    Off,
+    On,
+    Auto  // Only into a database without AST nodes
+};
+
 // Command line options
 static llvm::cl::OptionCategory DosatsuCategory("Dosatsu Options");
 
@@ -35,19 +58,306 @@ static llvm::cl::opt<std::string> OutputFile("output",
                                              llvm::cl::value_desc("filename"),
                                              llvm::cl::cat(DosatsuCategory));
 
-static llvm::cl::opt<std::string>
+static llvm::cl::opt<clang::TextDump::Format> OutputFormat(
+    "output-format",
+    llvm::cl::desc("Format of --output (default: text)"),
+    llvm::cl::values(clEnumValN(clang::TextDump::Format::Text, "text", "Clang's -ast-dump tree"),
+                     clEnumValN(clang::TextDump::Format::JsonLines,
+                                "jsonl",
+                                "One JSON object per declaration and statement")),
+    llvm::cl::init(clang::TextDump::Format::Text),
+    llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::list<std::string>
     FilterPattern("filter",
-                  llvm::cl::desc("Filter files by pattern (e.g., \"*Dosatsu*\", default: process all files)"),
+                  llvm::cl::desc("Only process files matching this glob, case-insensitive; may be repeated "
+                                 "(e.g., \"*/source/*.cpp\", default: process all files)"),
                   llvm::cl::value_desc("pattern"),
                   llvm::cl::cat(DosatsuCategory));
 
+static llvm::cl::list<std::string>
+    ExcludePattern("exclude",
+                   llvm::cl::desc("Skip files matching this glob, case-insensitive; may be repeated "
+                                  "(e.g., \"*/third_party/*\")"),
+                   llvm::cl::value_desc("pattern"),
+                   llvm::cl::cat(DosatsuCategory));
+
 static llvm::cl::opt<std::string> DatabasePath("output-db",
                                                llvm::cl::desc("Output to Kuzu graph database instead of text file"),
                                                llvm::cl::value_desc("database_path"),
                                                llvm::cl::cat(DosatsuCategory));
 
+static llvm::cl::opt<unsigned>
+    Jobs("jobs",
+         llvm::cl::desc("Number of translation units to index in parallel (database output only, default: 1)"),
+         llvm::cl::value_desc("N"),
+         llvm::cl::init(1),
+         llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<unsigned>
+    ParseJobs("parse-jobs",
+              llvm::cl::desc("Number of threads building ASTs ahead of the --jobs threads that traverse them "
+                             "(database output only, default: same as --jobs)"),
+              llvm::cl::value_desc("N"),
+              llvm::cl::init(0),
+              llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    ASTCacheDirectory("ast-cache",
+                      llvm::cl::desc("Save parsed ASTs in this directory and load them instead of parsing "
+                                     "translation units whose sources and compile commands are unchanged "
+                                     "(database output only)"),
+                      llvm::cl::value_desc("directory"),
+                      llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<BulkLoadMode> BulkLoad(
+    "bulk-load",
+    llvm::cl::desc("Stage all rows in CSV files and load them with one COPY per table at the end "
+                   "(database output only; default: insert row by row)"),
+    llvm::cl::ValueOptional,
+    llvm::cl::values(clEnumValN(BulkLoadMode::On, "true", "Always bulk load"),
+                     clEnumValN(BulkLoadMode::Off, "false", "Insert row by row"),
+                     clEnumValN(BulkLoadMode::Auto, "auto", "Bulk load only into a database without AST nodes"),
+                     // --bulk-load without a value
+                     clEnumValN(BulkLoadMode::On, "", "")),
+    llvm::cl::init(BulkLoadMode::Off),
+    llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<bool>
+    Incremental("incremental",
+                llvm::cl::desc("Skip translation units whose source, headers and compile commands are unchanged "
+                               "since they were last indexed into --output-db"),
+                llvm::cl::init(false),
+                llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<bool>
+    Serve("serve",
+          llvm::cl::desc("After indexing, stay resident: re-index translation units as their files change and "
+                         "answer Cypher queries read from standard input, one per line (database output only)"),
+          llvm::cl::init(false),
+          llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<unsigned>
+    WatchInterval("watch-interval",
+                  llvm::cl::desc("Milliseconds between checks for changed files with --serve (default: 500)"),
+                  llvm::cl::init(500),
+                  llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<bool> SkipIndexedHeaders(
+    "skip-indexed-headers",
+    llvm::cl::desc("Do not traverse top-level declarations of headers that an earlier translation unit already "
+                   "emitted with identical contents (database output only)"),
+    llvm::cl::init(false),
+    llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<bool>
+    Summaries("summaries",
+              llvm::cl::desc("After indexing, rebuild the summary tables INHERITANCE_CLOSURE, FileSummary and "
+                             "CallSummary from the whole database (database output only; shards get them with "
+                             "'merge --summaries')"),
+              llvm::cl::init(false),
+              llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    ExportArrow("export-arrow",
+                llvm::cl::desc("Write every table as an Arrow IPC file <table>.arrow in this directory instead of "
+                               "inserting the rows; --output-db only provides node IDs and stays empty"),
+                llvm::cl::value_desc("directory"),
+                llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    RejectFile("reject-file",
+               llvm::cl::desc("Write rows the database rejects, each with its error and a statement inserting it, "
+                              "to this file as JSON lines; without it only the first rejects are printed"),
+               llvm::cl::value_desc("path"),
+               llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    Stats("stats",
+          llvm::cl::ValueOptional,
+          llvm::cl::value_desc("text|json"),
+          llvm::cl::desc("Report wall and CPU time per phase, rows per table and bulk vs. fallback statement "
+                         "counts at the end of the run; --stats=json prints one JSON object"),
+          llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    TraceFile("trace",
+              llvm::cl::desc("Write a timeline of translation units, analyzer calls, batch executions, commits and "
+                             "queue waits per thread to this file in the Chrome trace format, for ui.perfetto.dev "
+                             "or chrome://tracing"),
+              llvm::cl::value_desc("path"),
+              llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<unsigned>
+    TraceMinDuration("trace-min-duration",
+                     llvm::cl::desc("Microseconds a span must last to be written with --trace; translation units "
+                                    "and parses are always written (default: 10)"),
+                     llvm::cl::init(10),
+                     llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    Profile("profile",
+            llvm::cl::desc("Analyzers to run, joined by '+': decls, types, stmts, templates, comments, advanced, "
+                           "calls, or full for all of them (default: full); e.g. decls+types skips function bodies "
+                           "and decls+calls records only the call graph"),
+            llvm::cl::value_desc("components"),
+            llvm::cl::init("full"),
+            llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    CFGScope("cfg",
+             llvm::cl::desc("Functions that get a control flow graph: none, defined-in-main-file, "
+                            "matching:<glob on the qualified name> or all (default: all)"),
+             llvm::cl::value_desc("scope"),
+             llvm::cl::init("all"),
+             llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<clang::CFGOptions::Detail> CFGDetail(
+    "cfg-detail",
+    llvm::cl::desc("Detail of the control flow graphs that are built (default: full)"),
+    llvm::cl::values(clEnumValN(clang::CFGOptions::Detail::Basic,
+                                "basic",
+                                "Blocks and edges of the written statements"),
+                     clEnumValN(clang::CFGOptions::Detail::Standard,
+                                "standard",
+                                "Plus initializers and implicit destructors"),
+                     clEnumValN(clang::CFGOptions::Detail::Full,
+                                "full",
+                                "Plus exception edges, lifetime ends, loop exits and temporary destructors")),
+    llvm::cl::init(clang::CFGOptions::Detail::Full),
+    llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<clang::CFGOptions::Format> CFGFormat(
+    "cfg-format",
+    llvm::cl::desc("How control flow graphs are stored (default: graph)"),
+    llvm::cl::values(clEnumValN(clang::CFGOptions::Format::Graph, "graph", "CFGBlock rows and CFG_EDGE relationships"),
+                     clEnumValN(clang::CFGOptions::Format::Compact,
+                                "compact",
+                                "One FunctionCFG row per function with packed successor and statement lists")),
+    llvm::cl::init(clang::CFGOptions::Format::Graph),
+    llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<bool>
+    CFGBlockText("cfg-block-text",
+                 llvm::cl::desc("Store block descriptions in compact control flow graphs"),
+                 llvm::cl::init(false),
+                 llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<unsigned>
+    ConstexprSteps("constexpr-steps",
+                   llvm::cl::desc("Evaluator steps allowed per expression when evaluating constant expressions for "
+                                  "the database; 0 for the compiler's limit (default: 65536)"),
+                   llvm::cl::init(65536),
+                   llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<unsigned> ConstexprBudget(
+    "constexpr-budget",
+    llvm::cl::desc("Milliseconds of constant evaluation per translation unit; later expressions are stored as "
+                   "over_budget. 0 for no limit (default)"),
+    llvm::cl::value_desc("ms"),
+    llvm::cl::init(0),
+    llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<bool> InstantiationBodies(
+    "instantiation-bodies",
+    llvm::cl::desc("Emit the members and bodies of implicit template instantiations; by default each is stored "
+                   "as its node, its template arguments and a SPECIALIZES edge only"),
+    llvm::cl::init(false),
+    llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    ShardSpec("shard",
+              llvm::cl::desc("Index only slice i of N of the compilation database, for one of N processes whose "
+                             "databases are combined with 'dosatsu_cpp merge' (database output only)"),
+              llvm::cl::value_desc("i/N"),
+              llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    BatchRows("batch-rows",
+              llvm::cl::desc("Bounds for the operations buffered per database flush, which adapts to the measured "
+                             "throughput (default: 100:20000); a single number fixes it"),
+              llvm::cl::value_desc("min:max"),
+              llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    CommitRows("commit-rows",
+               llvm::cl::desc("Bounds for the operations per database transaction, which adapts to the measured "
+                              "throughput (default: 1000:500000); a single number fixes it"),
+               llvm::cl::value_desc("min:max"),
+               llvm::cl::cat(DosatsuCategory));
+
+static llvm::cl::opt<std::string>
+    MaxMemory("max-memory",
+              llvm::cl::desc("Resident memory budget, e.g. 12G; above it Dosatsu flushes and commits early, drops "
+                             "its header caches and turns off templates, comments and advanced analysis "
+                             "(database output only)"),
+              llvm::cl::value_desc("size"),
+              llvm::cl::cat(DosatsuCategory));
+
+/// Parse a --batch-rows or --commit-rows value: min:max, or one number for both
+static auto ParseRowBounds(llvm::StringRef spec, size_t& minimum, size_t& maximum) -> bool
+{
+    auto [first, second] = spec.split(':');
+    if (first.getAsInteger(10, minimum) || minimum == 0)
+        return false;
+    if (second.empty() && !spec.contains(':'))
+        maximum = minimum;
+    else if (second.getAsInteger(10, maximum))
+        return false;
+    return minimum <= maximum;
+}
+
+/// Combine shard databases: dosatsu_cpp merge [--summaries] <output-db> <shard-db>...
+auto MergeMain(int argc, char** argv) -> int
+{
+    int first = 2;
+    bool summaries = argc > first && llvm::StringRef(argv[first]) == "--summaries";
+    if (summaries)
+        ++first;
+    if (argc < first + 2)
+    {
+        llvm::errs() << "Usage: " << argv[0] << " merge [--summaries] <output-db> <shard-db>...\n";
+        return 1;
+    }
+
+    std::string outputPath = argv[first];
+    if (llvm::sys::fs::exists(outputPath))
+    {
+        llvm::errs() << "Error: merge output " << outputPath << " already exists\n";
+        return 1;
+    }
+
+    try
+    {
+        clang::KuzuDatabase output(outputPath);
+        output.initialize();
+
+        clang::ShardMerger merger(*output.getConnection(), outputPath + ".merge");
+        for (int i = first + 1; i < argc; ++i)
+        {
+            if (!merger.addShard(argv[i]))
+                return 1;
+        }
+        if (!merger.finish())
+            return 1;
+        if (summaries && !clang::SummaryTables(output).rebuild())
+            return 1;
+    }
+    catch (const std::exception& e)
+    {
+        llvm::errs() << "Exception during merge: " << e.what() << "\n";
+        return 1;
+    }
+
+    llvm::outs() << "Merged " << (argc - first - 1) << " shards into " << outputPath << "\n";
+    return 0;
+}
+
 auto RealMain(int argc, char** argv) -> int
 {
+    if (argc > 1 && llvm::StringRef(argv[1]) == "merge")
+        return MergeMain(argc, argv);
+
     // Parse command line arguments
     llvm::cl::SetVersionPrinter(
         [](llvm::raw_ostream& OS)
@@ -81,6 +391,151 @@ auto RealMain(int argc, char** argv) -> int
         llvm::errs() << "Error: cannot specify both --output and --output-db\n";
         return 1;
     }
+    if (OutputFormat.getNumOccurrences() > 0 && useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --output-format requires --output\n";
+        return 1;
+    }
+    if (Jobs == 0)
+    {
+        llvm::errs() << "Error: --jobs must be at least 1\n";
+        return 1;
+    }
+    if (Jobs > 1 && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --jobs requires --output-db\n";
+        return 1;
+    }
+    if (ParseJobs > 0 && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --parse-jobs requires --output-db\n";
+        return 1;
+    }
+    if (!ASTCacheDirectory.empty() && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --ast-cache requires --output-db\n";
+        return 1;
+    }
+    if (BulkLoad != BulkLoadMode::Off && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --bulk-load requires --output-db\n";
+        return 1;
+    }
+    if (Incremental && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --incremental requires --output-db\n";
+        return 1;
+    }
+    if (SkipIndexedHeaders && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --skip-indexed-headers requires --output-db\n";
+        return 1;
+    }
+    if (Summaries && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --summaries requires --output-db\n";
+        return 1;
+    }
+    if (Serve && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --serve requires --output-db\n";
+        return 1;
+    }
+    if (Serve && !ExportArrow.empty())
+    {
+        llvm::errs() << "Error: --serve cannot be combined with --export-arrow\n";
+        return 1;
+    }
+    if (!ExportArrow.empty() && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --export-arrow requires --output-db\n";
+        return 1;
+    }
+    if (!ExportArrow.empty() && (BulkLoad != BulkLoadMode::Off || Incremental || Summaries))
+    {
+        // Each of these reads back or loads rows that an export never stores
+        llvm::errs() << "Error: --export-arrow cannot be combined with --bulk-load, --incremental or --summaries\n";
+        return 1;
+    }
+    if (!RejectFile.empty() && !useDatabaseOutput)
+    {
+        llvm::errs() << "Error: --reject-file requires --output-db\n";
+        return 1;
+    }
+    clang::CompilationDatabaseLoader::Shard shard;
+    if (!ShardSpec.empty())
+    {
+        if (!useDatabaseOutput)
+        {
+            llvm::errs() << "Error: --shard requires --output-db\n";
+            return 1;
+        }
+        if (!clang::CompilationDatabaseLoader::parseShard(ShardSpec, shard))
+        {
+            llvm::errs() << "Error: --shard expects i/N with 0 <= i < N\n";
+            return 1;
+        }
+    }
+    clang::AnalysisOptions analysisOptions;
+    if (std::string error; !analysisOptions.profile.parse(Profile, error))
+    {
+        llvm::errs() << "Error: invalid --profile value '" << Profile << "': " << error << "\n";
+        return 1;
+    }
+    analysisOptions.cfg.detail = CFGDetail;
+    analysisOptions.cfg.format = CFGFormat;
+    analysisOptions.cfg.blockText = CFGBlockText;
+    analysisOptions.instantiationBodies = InstantiationBodies;
+    analysisOptions.constants.stepLimit = ConstexprSteps;
+    analysisOptions.constants.timeBudget = std::chrono::milliseconds(ConstexprBudget);
+    if (std::string error; !analysisOptions.cfg.parseScope(CFGScope, error))
+    {
+        llvm::errs() << "Error: invalid --cfg value '" << CFGScope << "': " << error << "\n";
+        return 1;
+    }
+    clang::KuzuDatabase::BatchLimits batchLimits;
+    if (!BatchRows.empty() && !ParseRowBounds(BatchRows, batchLimits.minBatchRows, batchLimits.maxBatchRows))
+    {
+        llvm::errs() << "Error: --batch-rows expects min:max or a single number, with 0 < min <= max\n";
+        return 1;
+    }
+    if (!CommitRows.empty() && !ParseRowBounds(CommitRows, batchLimits.minCommitRows, batchLimits.maxCommitRows))
+    {
+        llvm::errs() << "Error: --commit-rows expects min:max or a single number, with 0 < min <= max\n";
+        return 1;
+    }
+    size_t memoryBudget = 0;
+    if (!MaxMemory.empty())
+    {
+        if (!useDatabaseOutput)
+        {
+            llvm::errs() << "Error: --max-memory requires --output-db\n";
+            return 1;
+        }
+        if (!clang::MemoryMonitor::parseSize(MaxMemory, memoryBudget))
+        {
+            llvm::errs() << "Error: --max-memory expects a size in bytes with an optional K, M or G suffix\n";
+            return 1;
+        }
+    }
+    bool printStats = Stats.getNumOccurrences() > 0;
+    if (printStats && !Stats.empty() && Stats != "text" && Stats != "json")
+    {
+        llvm::errs() << "Error: --stats accepts 'text' or 'json'\n";
+        return 1;
+    }
+    if (printStats)
+    {
+        clang::Statistics::getInstance().enable();
+        clang::MemoryMonitor::getInstance().enable();
+    }
+    clang::MemoryMonitor::getInstance().setBudget(memoryBudget);
+    if (!TraceFile.empty())
+    {
+        if (!clang::Trace::getInstance().start(TraceFile, std::chrono::microseconds(TraceMinDuration)))
+            return 1;
+        clang::Trace::getInstance().setThreadName("main");
+    }
 
     // Display parsed options for debugging
     llvm::outs() << "Dosatsu starting with options:\n";
@@ -90,14 +545,74 @@ auto RealMain(int argc, char** argv) -> int
     else
         llvm::outs() << "  Text output: " << OutputFile << "\n";
     if (!FilterPattern.empty())
-        llvm::outs() << "  Filter pattern: " << FilterPattern << "\n";
+        llvm::outs() << "  Filter patterns: " << llvm::join(FilterPattern, " ") << "\n";
     else
         llvm::outs() << "  Filter: none (processing all files)\n";
+    if (!ExcludePattern.empty())
+        llvm::outs() << "  Exclude patterns: " << llvm::join(ExcludePattern, " ") << "\n";
+    if (Jobs > 1)
+        llvm::outs() << "  Jobs: " << Jobs << "\n";
+    if (ParseJobs > 0)
+        llvm::outs() << "  Parse jobs: " << ParseJobs << "\n";
+    if (!ASTCacheDirectory.empty())
+        llvm::outs() << "  AST cache: " << ASTCacheDirectory << "\n";
+    if (BulkLoad == BulkLoadMode::On)
+        llvm::outs() << "  Bulk load: enabled\n";
+    else if (BulkLoad == BulkLoadMode::Auto)
+        llvm::outs() << "  Bulk load: auto\n";
+    if (!ExportArrow.empty())
+        llvm::outs() << "  Arrow export: " << ExportArrow << "\n";
+    if (!RejectFile.empty())
+        llvm::outs() << "  Reject file: " << RejectFile << "\n";
+    if (!TraceFile.empty())
+        llvm::outs() << "  Trace: " << TraceFile << "\n";
+    if (Incremental)
+        llvm::outs() << "  Incremental: enabled\n";
+    if (Serve)
+        llvm::outs() << "  Serve: watching every " << WatchInterval << " ms\n";
+    if (SkipIndexedHeaders)
+        llvm::outs() << "  Skip indexed headers: enabled\n";
+    if (!ShardSpec.empty())
+        llvm::outs() << "  Shard: " << shard.index << " of " << shard.count << "\n";
+    if (Profile.getNumOccurrences() > 0)
+        llvm::outs() << "  Profile: " << Profile << "\n";
+    if (CFGScope.getNumOccurrences() > 0 || CFGDetail.getNumOccurrences() > 0 || CFGFormat.getNumOccurrences() > 0)
+    {
+        const char* detail = "full";
+        if (CFGDetail == clang::CFGOptions::Detail::Basic)
+            detail = "basic";
+        else if (CFGDetail == clang::CFGOptions::Detail::Standard)
+            detail = "standard";
+        const char* format = CFGFormat == clang::CFGOptions::Format::Compact ? "compact" : "graph";
+        llvm::outs() << "  CFG: " << CFGScope << " (" << detail << " detail, " << format << ")\n";
+    }
+    if (InstantiationBodies)
+        llvm::outs() << "  Instantiation bodies: enabled\n";
+    if (ConstexprSteps.getNumOccurrences() > 0 || ConstexprBudget != 0)
+    {
+        std::string budget =
+            ConstexprBudget != 0 ? std::to_string(ConstexprBudget) + " ms per translation unit" : "no time limit";
+        llvm::outs() << "  Constant evaluation: " << ConstexprSteps << " steps per expression, " << budget << "\n";
+    }
+    if (!BatchRows.empty())
+        llvm::outs() << "  Batch rows: " << batchLimits.minBatchRows << " to " << batchLimits.maxBatchRows << "\n";
+    if (memoryBudget != 0)
+        llvm::outs() << "  Max memory: " << MaxMemory << "\n";
+    if (!CommitRows.empty())
+        llvm::outs() << "  Commit rows: " << batchLimits.minCommitRows << " to " << batchLimits.maxCommitRows << "\n";
     llvm::outs() << "\n";
 
-    // Load compilation database
+    clang::CompilationDatabaseLoader::FileFilter fileFilter;
     std::string errorMessage;
-    auto database = clang::CompilationDatabaseLoader::loadFromFile(CompileCommandsPath, errorMessage);
+    if (!fileFilter.compile(FilterPattern, ExcludePattern, errorMessage))
+    {
+        llvm::errs() << "Error: " << errorMessage << "\n";
+        return 1;
+    }
+
+    // Load compilation database
+    auto database =
+        clang::CompilationDatabaseLoader::loadFromFile(CompileCommandsPath, errorMessage, fileFilter, shard);
     if (!database)
     {
         llvm::errs() << "Error loading compilation database: " << errorMessage << "\n";
@@ -106,17 +621,37 @@ auto RealMain(int argc, char** argv) -> int
 
     llvm::outs() << "Successfully loaded compilation database from: " << CompileCommandsPath << "\n";
 
-    // Filter source files based on command line option
-    std::string filterPattern;
-    if (FilterPattern.empty())
-        filterPattern = "*";
-    else
-        filterPattern = FilterPattern.getValue();
-    auto sourceFiles = clang::CompilationDatabaseLoader::filterSourceFiles(*database, filterPattern);
+    // The database is opened up front, since scheduling depends on what it already holds
+    auto& dbManager = clang::GlobalDatabaseManager::getInstance();
+    clang::IncrementalIndex incrementalIndex;
+    if (useDatabaseOutput)
+    {
+        try
+        {
+            // Each shard allocates node IDs from its own range, so a merge can keep them as they are
+            dbManager.initializeDatabase(DatabasePath, shard.index);
+            dbManager.getDatabase()->setBatchLimits(batchLimits);
+        }
+        catch (const std::exception& e)
+        {
+            llvm::errs() << "Error opening database: " << e.what() << "\n";
+            return 1;
+        }
+        incrementalIndex.load(*dbManager.getDatabase());
+    }
+
+    // Filter source files based on command line option; a server starts from what the database already holds
+    bool incremental = Incremental || Serve;
+    auto sourceFiles = clang::CompilationDatabaseLoader::filterSourceFiles(
+        *database, fileFilter, incremental ? &incrementalIndex : nullptr, shard);
 
     llvm::outs() << "Found " << sourceFiles.size() << " source files";
-    if (!FilterPattern.empty())
-        llvm::outs() << " matching pattern '" << FilterPattern << "'";
+    if (incremental)
+        llvm::outs() << " to re-index";
+    if (!FilterPattern.empty() || !ExcludePattern.empty())
+        llvm::outs() << " matching the filter";
+    if (!ShardSpec.empty())
+        llvm::outs() << " in shard " << ShardSpec;
     llvm::outs() << ":\n";
 
     // Display first few files for verification
@@ -129,11 +664,23 @@ auto RealMain(int argc, char** argv) -> int
     llvm::outs() << "\n";
 
     // Check if we have any files to process
+    if (sourceFiles.empty() && incremental)
+    {
+        llvm::outs() << "All translation units are up to date\n";
+        if (!Serve)
+            return 0;
+    }
+    if (sourceFiles.empty() && !ShardSpec.empty())
+    {
+        // Small projects split into many shards leave some of them empty
+        llvm::outs() << "No source files fall into this shard\n";
+        return 0;
+    }
     if (sourceFiles.empty())
     {
         llvm::errs() << "Error: No source files found";
-        if (!FilterPattern.empty())
-            llvm::errs() << " matching pattern '" << FilterPattern << "'";
+        if (!FilterPattern.empty() || !ExcludePattern.empty())
+            llvm::errs() << " matching the filter";
         llvm::errs() << " in compilation database\n";
         return 1;
     }
@@ -149,6 +696,9 @@ auto RealMain(int argc, char** argv) -> int
             llvm::errs() << "Error opening output file '" << OutputFile << "': " << EC.message() << "\n";
             return 1;
         }
+        // Dumps are written a node at a time; a large buffer turns them into few big writes
+        constexpr size_t OUTPUT_BUFFER_BYTES = size_t{1} << 20;
+        OutputFileStream->SetBufferSize(OUTPUT_BUFFER_BYTES);
         llvm::outs() << "Writing AST dump to: " << OutputFile << "\n";
     }
     else
@@ -160,19 +710,21 @@ auto RealMain(int argc, char** argv) -> int
     llvm::outs() << "Starting AST processing...\n";
     try
     {
-        clang::tooling::ClangTool Tool(*database, sourceFiles);
-
         // Create a custom factory for our AST dump action
         class DosatsuASTDumpActionFactory : public clang::tooling::FrontendActionFactory
         {
         private:
             llvm::raw_ostream* OS;
+            clang::TextDump::Format format = clang::TextDump::Format::Text;
             std::string databasePath;
             bool usingDatabase;
 
         public:
             // Text output constructor
-            DosatsuASTDumpActionFactory(llvm::raw_ostream& OS) : OS(&OS), usingDatabase(false) {}
+            DosatsuASTDumpActionFactory(llvm::raw_ostream& OS, clang::TextDump::Format format)
+                : OS(&OS), format(format), usingDatabase(false)
+            {
+            }
 
             // Database output constructor
             DosatsuASTDumpActionFactory(std::string databasePath)
@@ -184,19 +736,72 @@ auto RealMain(int argc, char** argv) -> int
             {
                 if (usingDatabase)
                     return std::make_unique<clang::DosatsuASTDumpAction>(databasePath);
-                return std::make_unique<clang::DosatsuASTDumpAction>(*OS);
+                return std::make_unique<clang::DosatsuASTDumpAction>(*OS, format);
             }
         };
 
-        std::unique_ptr<DosatsuASTDumpActionFactory> ActionFactory;
+        // Old nodes of the scheduled files go before any new ones are written
         if (useDatabaseOutput)
-            ActionFactory = std::make_unique<DosatsuASTDumpActionFactory>(DatabasePath);
-        else
-            ActionFactory = std::make_unique<DosatsuASTDumpActionFactory>(*OutputFileStream);
+        {
+            incrementalIndex.prepare(*dbManager.getDatabase(), *database, sourceFiles);
+            dbManager.setIncrementalIndex(&incrementalIndex);
+            dbManager.setSkipIndexedHeaders(SkipIndexedHeaders);
+            dbManager.setRecordStableKeys(!ShardSpec.empty());
+            dbManager.setAnalysisOptions(std::move(analysisOptions));
+        }
 
-        // Run the tool
-        int Result = Tool.run(ActionFactory.get());
+        // A fresh database is built by loading all node tables and then all edges with COPY,
+        // instead of maintaining its primary-key indexes one insert at a time
+        bool freshBuild = BulkLoad == BulkLoadMode::Auto && dbManager.getDatabase()->isFresh();
+        if (freshBuild)
+            llvm::outs() << "Fresh database: staging all rows for a bulk load\n";
+        if (BulkLoad == BulkLoadMode::On || freshBuild)
+            dbManager.getDatabase()->enableBulkLoad(DatabasePath + ".bulk");
+        if (!ExportArrow.empty())
+            dbManager.getDatabase()->enableArrowExport(ExportArrow);
+        if (!RejectFile.empty() && !dbManager.getDatabase()->setRejectFile(RejectFile))
+            return 1;
 
+        auto indexFiles = [&](const std::vector<std::string>& files) -> int
+        {
+            // The AST cache sits in the parse stage, so it runs the pipeline even with one job
+            if (Jobs > 1 || ParseJobs > 0 || !ASTCacheDirectory.empty())
+            {
+                clang::ParallelIndexer indexer(*database, DatabasePath, Jobs, ParseJobs);
+                if (!ASTCacheDirectory.empty())
+                    indexer.setASTCache(ASTCacheDirectory);
+                return indexer.run(files);
+            }
+
+            clang::tooling::ClangTool Tool(*database, files);
+
+            std::unique_ptr<DosatsuASTDumpActionFactory> ActionFactory;
+            if (useDatabaseOutput)
+                ActionFactory = std::make_unique<DosatsuASTDumpActionFactory>(DatabasePath);
+            else
+                ActionFactory = std::make_unique<DosatsuASTDumpActionFactory>(*OutputFileStream, OutputFormat);
+
+            // Kuzu executes each batch on a writer thread while the next one is being
+            // filled; a second full batch waits in the queue before traversal blocks
+            constexpr size_t QUEUED_BATCHES = 1;
+            std::optional<clang::DatabaseWriter> writer;
+            std::optional<clang::StagedThreadDatabase> staging;
+            if (useDatabaseOutput)
+            {
+                writer.emplace(*dbManager.getDatabase(), QUEUED_BATCHES);
+                staging.emplace(*dbManager.getDatabase(), *writer);
+            }
+
+            // Run the tool
+            int result = Tool.run(ActionFactory.get());
+
+            staging.reset();
+            if (writer)
+                writer->finish();
+            return result;
+        };
+
+        int Result = sourceFiles.empty() ? 0 : indexFiles(sourceFiles);
         if (Result == 0)
             llvm::outs() << "AST processing completed successfully!\n";
         else
@@ -204,17 +809,48 @@ auto RealMain(int argc, char** argv) -> int
 
         // Explicitly flush database operations before exiting
         // This ensures all pending operations are committed to the database
-        if (useDatabaseOutput)
+        if (useDatabaseOutput && dbManager.isInitialized())
         {
-            auto& dbManager = clang::GlobalDatabaseManager::getInstance();
-            if (dbManager.isInitialized())
+            auto* db = dbManager.getDatabase();
+            if (db != nullptr)
             {
-                auto* db = dbManager.getDatabase();
-                if (db != nullptr)
-                    db->flushOperations();
+                db->flushOperations();
+                if (!db->finishBulkLoad() && Result == 0)
+                    Result = 1;
+                if (!db->finishArrowExport() && Result == 0)
+                    Result = 1;
+                if (Summaries && !clang::SummaryTables(*db).rebuild() && Result == 0)
+                    Result = 1;
+                if (db->getRejectedRowCount() > 0)
+                {
+                    llvm::errs() << "Warning: " << db->getRejectedRowCount() << " rows were rejected"
+                                 << (RejectFile.empty() ? std::string() : " and written to " + RejectFile) << "\n";
+                }
             }
         }
 
+        // Later changes are indexed by this process, which keeps the database and the stable keys it has
+        if (Serve && dbManager.isInitialized())
+        {
+            clang::IndexServer server(*dbManager.getDatabase(), *database, fileFilter, shard, indexFiles);
+            server.setPollInterval(std::chrono::milliseconds(WatchInterval));
+            server.setRebuildSummaries(Summaries);
+            int served = server.run(std::cin, llvm::outs());
+            if (Result == 0)
+                Result = served;
+        }
+
+        if (printStats)
+        {
+            if (Stats == "json")
+                clang::Statistics::getInstance().printJson(llvm::outs());
+            else
+                clang::Statistics::getInstance().print(llvm::outs());
+        }
+
+        if (!clang::Trace::getInstance().finish() && Result == 0)
+            Result = 1;
+
         return Result;
     }
     catch (const std::exception& e)
@@ -383,9 +1019,3 @@ auto main(int argc, char** argv) -> int
 
     return r;
 }
-
-// This is just a small dummy test to make sure we actualy have a test and can verify that the testing system works
-// We can remove this test once we start having actual tests
-TEST_CASE("Empty dummy test")
-{
-}
@@ -6,21 +6,45 @@
 
 #include "GlobalDatabaseManager.h"
 
+#include "MemoryMonitor.h"
+#include "Statistics.h"
+
 // clang-format off
+#include <doctest/doctest.h>
+
 #include "NoWarningScope_Enter.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
+#include <algorithm>
+#include <string_view>
+#include <thread>
+
 using namespace clang;
 
+namespace
+{
+
+/// Estimate the bytes a stable key takes in a map: key, pair and hash node
+/// Only estimated, so the maps are never walked for it.
+auto estimateStableKeyBytes(const std::string& key) -> size_t
+{
+    return key.capacity() + sizeof(std::string) + sizeof(std::pair<int64_t, size_t>) + (2 * sizeof(void*));
+}
+
+}  // namespace
+
+thread_local KuzuDatabase* GlobalDatabaseManager::threadDatabase = nullptr;
+
 auto GlobalDatabaseManager::getInstance() -> GlobalDatabaseManager&
 {
     static GlobalDatabaseManager instance;
     return instance;
 }
 
-void GlobalDatabaseManager::initializeDatabase(const std::string& databasePath)
+void GlobalDatabaseManager::initializeDatabase(const std::string& databasePath, int64_t nodeIdShard)
 {
     if (initialized)
     {
@@ -31,8 +55,17 @@ void GlobalDatabaseManager::initializeDatabase(const std::string& databasePath)
     try
     {
         database = std::make_unique<KuzuDatabase>(databasePath);
+        database->setNodeIdShard(nodeIdShard);
         database->initialize();
         initialized = true;
+
+        // Rows of earlier runs already hold their paths
+        if (auto* connection = database->getConnection())
+        {
+            auto result = connection->query("MATCH (f:SourceFile) RETURN f.file_id");
+            while (result->isSuccess() && result->hasNext())
+                writtenSourceFiles.insert(result->getNext()->getValue(0)->getValue<int64_t>());
+        }
         llvm::outs() << "Global database initialized at: " << databasePath << "\n";
     }
     catch (const std::exception& e)
@@ -46,68 +79,314 @@ void GlobalDatabaseManager::initializeDatabase(const std::string& databasePath)
 
 auto GlobalDatabaseManager::getDatabase() -> KuzuDatabase*
 {
+    if (threadDatabase != nullptr)
+        return threadDatabase;
     return database.get();
 }
 
 auto GlobalDatabaseManager::isInitialized() const -> bool
 {
+    if (threadDatabase != nullptr)
+        return true;
     return initialized && database != nullptr;
 }
 
-auto GlobalDatabaseManager::getGlobalNodeId(const void* ptr) -> int64_t
+void GlobalDatabaseManager::bindThreadDatabase(KuzuDatabase* threadDb)
 {
-    auto it = globalNodeIdMap.find(ptr);
-    return (it != globalNodeIdMap.end()) ? it->second : -1;
+    threadDatabase = threadDb;
 }
 
-auto GlobalDatabaseManager::hasGlobalNode(const void* ptr) const -> bool
+auto GlobalDatabaseManager::registry() -> NodeRegistry&
 {
-    return globalNodeIdMap.find(ptr) != globalNodeIdMap.end();
+    thread_local NodeRegistry threadRegistry;
+    return threadRegistry;
 }
 
-void GlobalDatabaseManager::registerGlobalNode(const void* ptr, int64_t nodeId)
+auto GlobalDatabaseManager::getStableKeyShard(const std::string& key) -> StableKeyShard&
 {
-    globalNodeIdMap[ptr] = nodeId;
+    // A different hash than the maps use, so the keys of one shard still spread over its buckets
+    return stableKeyShards[llvm::xxh3_64bits(key) % STABLE_KEY_SHARDS];
 }
 
-auto GlobalDatabaseManager::hasDeclarationNode(int64_t nodeId) const -> bool
+void GlobalDatabaseManager::clearStableKeyShards()
 {
-    return createdDeclarationNodes.find(nodeId) != createdDeclarationNodes.end();
+    auto& monitor = MemoryMonitor::getInstance();
+    for (auto& shard : stableKeyShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.nodeIds = {};
+        shard.bytes = 0;
+        monitor.update(MemorySubsystem::StableKeys, shard.accountedBytes, 0);
+    }
 }
 
-void GlobalDatabaseManager::registerDeclarationNode(int64_t nodeId)
+void GlobalDatabaseManager::clearIndexedHeaders(NodeRegistry& threadRegistry)
 {
-    createdDeclarationNodes.insert(nodeId);
+    threadRegistry.currentIndexedHeaders.clear();
+    threadRegistry.endedIndexedHeaders.clear();
+
+    std::lock_guard<std::mutex> lock(indexedHeaderMutex);
+    indexedHeaders.clear();
+    indexedHeaderGeneration.fetch_add(1, std::memory_order_relaxed);
 }
 
-auto GlobalDatabaseManager::hasTypeNode(int64_t nodeId) const -> bool
+void GlobalDatabaseManager::beginTranslationUnit(const std::string& mainFile)
 {
-    return createdTypeNodes.find(nodeId) != createdTypeNodes.end();
+    auto& threadRegistry = registry();
+    threadRegistry.nodes.clear();
+    threadRegistry.borrowedTranslationUnits.clear();
+    threadRegistry.headerGeneration = indexedHeaderGeneration.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(translationUnitMutex);
+    threadRegistry.translationUnit = translationUnits.size();
+    translationUnits.push_back(mainFile);
 }
 
-void GlobalDatabaseManager::registerTypeNode(int64_t nodeId)
+void GlobalDatabaseManager::endTranslationUnit()
 {
-    createdTypeNodes.insert(nodeId);
+    // The node table is at its largest now, just before it is cleared
+    auto& threadRegistry = registry();
+    auto& monitor = MemoryMonitor::getInstance();
+    if (monitor.isEnabled())
+    {
+        monitor.update(
+            MemorySubsystem::NodeTable, threadRegistry.accountedNodeBytes, threadRegistry.nodes.getMemorySize());
+        monitor.update(
+            MemorySubsystem::StableKeys, threadRegistry.accountedStableKeyBytes, threadRegistry.stableKeyBytes);
+    }
+    threadRegistry.nodes.clear();
+
+    threadRegistry.endedStableNodeIds.merge(threadRegistry.currentStableNodeIds);
+    threadRegistry.currentStableNodeIds.clear();
+    if (threadRegistry.endedIndexedHeaders.empty())
+        threadRegistry.endedHeaderGeneration = threadRegistry.headerGeneration;
+    threadRegistry.endedIndexedHeaders.merge(threadRegistry.currentIndexedHeaders);
+    threadRegistry.currentIndexedHeaders.clear();
+
+    // Rows written straight to the database precede every later statement, so there is nothing to wait for
+    if (auto* db = getDatabase(); db == nullptr || !db->isStaging())
+        publishTranslationUnits();
+
+    if (monitor.isOverBudget())
+        relieveMemoryPressure(threadRegistry);
 }
 
-auto GlobalDatabaseManager::hasStatementNode(int64_t nodeId) const -> bool
+void GlobalDatabaseManager::publishTranslationUnits()
 {
-    return createdStatementNodes.find(nodeId) != createdStatementNodes.end();
+    auto& threadRegistry = registry();
+    if (threadRegistry.endedStableNodeIds.empty() && threadRegistry.endedIndexedHeaders.empty())
+        return;
+
+    // The keys go first, so a thread that finds a header published also finds the keys linking it up
+    auto& monitor = MemoryMonitor::getInstance();
+    size_t duplicates = 0;
+    while (!threadRegistry.endedStableNodeIds.empty())
+    {
+        auto entry = threadRegistry.endedStableNodeIds.extract(threadRegistry.endedStableNodeIds.begin());
+        size_t bytes = estimateStableKeyBytes(entry.key());
+        threadRegistry.stableKeyBytes -= std::min(bytes, threadRegistry.stableKeyBytes);
+
+        auto& shard = getStableKeyShard(entry.key());
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.nodeIds.insert(std::move(entry)).inserted)
+        {
+            // Another thread emitted the entity while this one could not see it yet
+            ++duplicates;
+            continue;
+        }
+        shard.bytes += bytes;
+        monitor.update(MemorySubsystem::StableKeys, shard.accountedBytes, shard.bytes);
+    }
+    monitor.update(MemorySubsystem::StableKeys, threadRegistry.accountedStableKeyBytes, threadRegistry.stableKeyBytes);
+    Statistics::getInstance().addDuplicateStableNodes(duplicates);
+
+    std::lock_guard<std::mutex> lock(indexedHeaderMutex);
+    if (threadRegistry.endedHeaderGeneration == indexedHeaderGeneration.load(std::memory_order_relaxed))
+        indexedHeaders.merge(threadRegistry.endedIndexedHeaders);
+    threadRegistry.endedIndexedHeaders.clear();
 }
 
-void GlobalDatabaseManager::registerStatementNode(int64_t nodeId)
+void GlobalDatabaseManager::relieveMemoryPressure(NodeRegistry& threadRegistry)
 {
-    createdStatementNodes.insert(nodeId);
+    // A staging database hands its rows to the writer here, which publishes the ended units' keys
+    if (auto* threadDb = getDatabase())
+        threadDb->flushOperations();
+
+    threadRegistry.nodes = NodeTable();
+    threadRegistry.currentStableNodeIds = {};
+    threadRegistry.endedStableNodeIds = {};
+    threadRegistry.borrowedTranslationUnits.clear();
+    threadRegistry.sourceFileIds.clear();
+    threadRegistry.stableKeyBytes = 0;
+
+    // The published keys are most of the cache; translationUnits stays, as other threads index into it
+    clearStableKeyShards();
+
+    // Skipped headers are only linked up through the stable keys just dropped
+    clearIndexedHeaders(threadRegistry);
+
+    auto& monitor = MemoryMonitor::getInstance();
+    monitor.update(MemorySubsystem::NodeTable, threadRegistry.accountedNodeBytes, 0);
+    monitor.update(MemorySubsystem::StableKeys, threadRegistry.accountedStableKeyBytes, 0);
+    monitor.disableOptionalAnalyzers();
+}
+
+auto GlobalDatabaseManager::getStableNodeId(const std::string& key) -> int64_t
+{
+    auto& threadRegistry = registry();
+    if (auto it = threadRegistry.currentStableNodeIds.find(key); it != threadRegistry.currentStableNodeIds.end())
+        return it->second.first;
+
+    std::pair<int64_t, size_t> entry;
+    if (auto it = threadRegistry.endedStableNodeIds.find(key); it != threadRegistry.endedStableNodeIds.end())
+    {
+        entry = it->second;
+    }
+    else
+    {
+        auto& shard = getStableKeyShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto shardIt = shard.nodeIds.find(key);
+        if (shardIt == shard.nodeIds.end())
+            return -1;
+        entry = shardIt->second;
+    }
+
+    auto [nodeId, translationUnit] = entry;
+    if (translationUnit != threadRegistry.translationUnit)
+        threadRegistry.borrowedTranslationUnits.insert(translationUnit);
+    return nodeId;
 }
 
-auto GlobalDatabaseManager::hasExpressionNode(int64_t nodeId) const -> bool
+void GlobalDatabaseManager::registerStableNode(std::string key, int64_t nodeId)
 {
-    return createdExpressionNodes.find(nodeId) != createdExpressionNodes.end();
+    auto& threadRegistry = registry();
+    size_t bytes = estimateStableKeyBytes(key);
+    if (threadRegistry.currentStableNodeIds.try_emplace(std::move(key), nodeId, threadRegistry.translationUnit).second)
+        threadRegistry.stableKeyBytes += bytes;
 }
 
-void GlobalDatabaseManager::registerExpressionNode(int64_t nodeId)
+void GlobalDatabaseManager::forgetTranslationUnits(const std::vector<std::string>& mainFiles)
 {
-    createdExpressionNodes.insert(nodeId);
+    std::set<std::string_view> forgotten(mainFiles.begin(), mainFiles.end());
+    std::vector<bool> isForgotten;
+    {
+        std::lock_guard<std::mutex> lock(translationUnitMutex);
+        isForgotten.resize(translationUnits.size());
+        for (size_t i = 0; i < translationUnits.size(); ++i)
+            isForgotten[i] = forgotten.contains(translationUnits[i]);
+    }
+
+    // Erases the keys of forgotten translation units from a map, keeping its byte estimate in step
+    auto forget = [&](StableNodeMap& nodeIds, size_t& bytes)
+    {
+        std::erase_if(nodeIds,
+                      [&](const auto& entry)
+                      {
+                          size_t translationUnit = entry.second.second;
+                          if (translationUnit >= isForgotten.size() || !isForgotten[translationUnit])
+                              return false;
+                          bytes -= std::min(estimateStableKeyBytes(entry.first), bytes);
+                          return true;
+                      });
+    };
+
+    auto& threadRegistry = registry();
+    forget(threadRegistry.currentStableNodeIds, threadRegistry.stableKeyBytes);
+    forget(threadRegistry.endedStableNodeIds, threadRegistry.stableKeyBytes);
+
+    auto& monitor = MemoryMonitor::getInstance();
+    for (auto& shard : stableKeyShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        forget(shard.nodeIds, shard.bytes);
+        monitor.update(MemorySubsystem::StableKeys, shard.accountedBytes, shard.bytes);
+    }
+    clearIndexedHeaders(threadRegistry);
+}
+
+auto GlobalDatabaseManager::getBorrowedTranslationUnits() const -> std::vector<std::string>
+{
+    const auto& threadRegistry = registry();
+    std::vector<std::string> mainFiles;
+    mainFiles.reserve(threadRegistry.borrowedTranslationUnits.size());
+
+    std::lock_guard<std::mutex> lock(translationUnitMutex);
+    for (size_t translationUnit : threadRegistry.borrowedTranslationUnits)
+    {
+        if (translationUnit < translationUnits.size())
+            mainFiles.push_back(translationUnits[translationUnit]);
+    }
+    return mainFiles;
+}
+
+auto GlobalDatabaseManager::isHeaderIndexed(const std::string& key) const -> bool
+{
+    const auto& threadRegistry = registry();
+    if (threadRegistry.currentIndexedHeaders.contains(key))
+        return true;
+    if (threadRegistry.endedIndexedHeaders.contains(key) &&
+        threadRegistry.endedHeaderGeneration == indexedHeaderGeneration.load(std::memory_order_relaxed))
+        return true;
+
+    std::lock_guard<std::mutex> lock(indexedHeaderMutex);
+    return indexedHeaders.contains(key);
+}
+
+void GlobalDatabaseManager::registerIndexedHeader(std::string key)
+{
+    registry().currentIndexedHeaders.insert(std::move(key));
+}
+
+auto GlobalDatabaseManager::getSourceFileId(llvm::StringRef path) -> int64_t
+{
+    auto [it, inserted] = registry().sourceFileIds.try_emplace(path, 0);
+    if (!inserted)
+        return it->second;
+
+    auto fileId = static_cast<int64_t>(llvm::xxh3_64bits(path) & static_cast<uint64_t>(INT64_MAX));
+    it->second = fileId;
+
+    bool isNew = false;
+    {
+        std::lock_guard<std::mutex> lock(sourceFileMutex);
+        isNew = writtenSourceFiles.insert(fileId).second;
+    }
+    if (auto* db = getDatabase(); isNew && db != nullptr)
+        db->addNodeToBatch("SourceFile", {{"file_id", fileId}, {"path", std::string_view(path)}});
+    return fileId;
+}
+
+auto GlobalDatabaseManager::getNodeRecord(const void* ptr) -> NodeRecord&
+{
+    return registry().nodes[ptr];
+}
+
+auto GlobalDatabaseManager::findNodeRecord(const void* ptr) const -> const NodeRecord*
+{
+    const auto& nodes = registry().nodes;
+    auto it = nodes.find(ptr);
+    return (it != nodes.end()) ? &it->second : nullptr;
+}
+
+auto GlobalDatabaseManager::getGlobalNodeId(const void* ptr) const -> int64_t
+{
+    const auto* record = findNodeRecord(ptr);
+    return (record != nullptr) ? record->nodeId : -1;
+}
+
+auto GlobalDatabaseManager::hasGlobalNode(const void* ptr) const -> bool
+{
+    return getGlobalNodeId(ptr) != -1;
+}
+
+auto GlobalDatabaseManager::markNodeRow(const void* ptr, NodeRow row) -> bool
+{
+    auto& record = registry().nodes[ptr];
+    if ((record.writtenRows & row) != 0)
+        return false;
+    record.writtenRows |= row;
+    return true;
 }
 
 void GlobalDatabaseManager::cleanup()
@@ -117,11 +396,28 @@ void GlobalDatabaseManager::cleanup()
         database->flushOperations();
         database.reset();
     }
-    globalNodeIdMap.clear();
-    createdDeclarationNodes.clear();
-    createdTypeNodes.clear();
-    createdStatementNodes.clear();
-    createdExpressionNodes.clear();
+    registry().nodes.clear();
+    registry().currentStableNodeIds.clear();
+    registry().endedStableNodeIds.clear();
+    for (auto& shard : stableKeyShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.nodeIds.clear();
+        shard.bytes = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(translationUnitMutex);
+        translationUnits.clear();
+    }
+    registry().borrowedTranslationUnits.clear();
+    registry().currentIndexedHeaders.clear();
+    registry().endedIndexedHeaders.clear();
+    {
+        std::lock_guard<std::mutex> lock(indexedHeaderMutex);
+        indexedHeaders.clear();
+    }
+    registry().sourceFileIds.clear();
+    writtenSourceFiles.clear();
     initialized = false;
 }
 
@@ -129,3 +425,78 @@ GlobalDatabaseManager::~GlobalDatabaseManager()
 {
     cleanup();
 }
+
+TEST_CASE("GlobalDatabaseManager shares stable keys once they are published")
+{
+    auto& dbManager = GlobalDatabaseManager::getInstance();
+    auto lookUpOnOtherThread = [&](const std::string& key)
+    {
+        int64_t nodeId = -1;
+        std::thread([&] { nodeId = dbManager.getStableNodeId(key); }).join();
+        return nodeId;
+    };
+
+    std::thread(
+        [&]
+        {
+            // Rows of a staging database may not have reached the writer yet, so the key stays private
+            KuzuDatabase writer{std::string()};
+            auto staging = KuzuDatabase::createStaging(writer, [](KuzuDatabase::PendingBatch&&) {});
+            GlobalDatabaseManager::bindThreadDatabase(staging.get());
+            dbManager.beginTranslationUnit("/test/shared_a.cpp");
+            dbManager.registerStableNode("test:shared", 42);
+            dbManager.endTranslationUnit();
+            CHECK(dbManager.getStableNodeId("test:shared") == 42);
+            CHECK(lookUpOnOtherThread("test:shared") == -1);
+
+            dbManager.publishTranslationUnits();
+            CHECK(lookUpOnOtherThread("test:shared") == 42);
+            GlobalDatabaseManager::bindThreadDatabase(nullptr);
+        })
+        .join();
+
+    std::thread(
+        [&]
+        {
+            dbManager.beginTranslationUnit("/test/shared_b.cpp");
+            CHECK(dbManager.getStableNodeId("test:shared") == 42);
+            CHECK(dbManager.getBorrowedTranslationUnits() == std::vector<std::string>{"/test/shared_a.cpp"});
+            dbManager.endTranslationUnit();
+        })
+        .join();
+
+    dbManager.forgetTranslationUnits({"/test/shared_a.cpp", "/test/shared_b.cpp"});
+    CHECK(lookUpOnOtherThread("test:shared") == -1);
+}
+
+TEST_CASE("GlobalDatabaseManager shares indexed headers once they are published")
+{
+    auto& dbManager = GlobalDatabaseManager::getInstance();
+    auto isIndexedOnOtherThread = [&](const std::string& key)
+    {
+        bool indexed = false;
+        std::thread([&] { indexed = dbManager.isHeaderIndexed(key); }).join();
+        return indexed;
+    };
+
+    std::thread(
+        [&]
+        {
+            KuzuDatabase writer{std::string()};
+            auto staging = KuzuDatabase::createStaging(writer, [](KuzuDatabase::PendingBatch&&) {});
+            GlobalDatabaseManager::bindThreadDatabase(staging.get());
+            dbManager.beginTranslationUnit("/test/header_a.cpp");
+            dbManager.registerIndexedHeader("/test/header.h:1");
+            dbManager.endTranslationUnit();
+            CHECK(dbManager.isHeaderIndexed("/test/header.h:1"));
+            CHECK_FALSE(isIndexedOnOtherThread("/test/header.h:1"));
+
+            dbManager.publishTranslationUnits();
+            CHECK(isIndexedOnOtherThread("/test/header.h:1"));
+            GlobalDatabaseManager::bindThreadDatabase(nullptr);
+        })
+        .join();
+
+    dbManager.forgetTranslationUnits({"/test/header_a.cpp"});
+    CHECK_FALSE(isIndexedOnOtherThread("/test/header.h:1"));
+}
@@ -6,16 +6,52 @@
 
 #pragma once
 
+#include "AnalysisOptions.h"
 #include "KuzuDatabase.h"
 
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace clang
 {
 
+class IncrementalIndex;
+
+/// Specialized tables a node can have a row in, as bits of NodeRecord::writtenRows
+enum NodeRow : uint8_t
+{
+    DeclarationRow = 1U << 0,
+    TypeRow = 1U << 1,
+    StatementRow = 1U << 2,
+    ExpressionRow = 1U << 3,
+    AllNodeRows = DeclarationRow | TypeRow | StatementRow | ExpressionRow
+};
+
+/// What is known about one AST node of the current translation unit
+struct NodeRecord
+{
+    int64_t nodeId = -1;
+    uint8_t writtenRows = 0;  // NodeRow bits
+    bool reused = false;      // Node was emitted by an earlier translation unit or AST node
+};
+
 /// Global singleton for managing database instances across multiple files
 class GlobalDatabaseManager
 {
@@ -24,64 +60,134 @@ public:
     static auto getInstance() -> GlobalDatabaseManager&;
 
     /// Initialize the global database (call once)
-    void initializeDatabase(const std::string& databasePath);
+    /// \param databasePath Path to the Kuzu database
+    /// \param nodeIdShard Node ID space to allocate from, see KuzuDatabase::setNodeIdShard()
+    void initializeDatabase(const std::string& databasePath, int64_t nodeIdShard = 0);
 
-    /// Get the global database instance
+    /// Get the database for the calling thread
+    /// \return The database bound with bindThreadDatabase(), or the global database
     auto getDatabase() -> KuzuDatabase*;
 
-    /// Check if database is initialized
+    /// Check if a database is available to the calling thread
     [[nodiscard]] auto isInitialized() const -> bool;
 
-    /// Get the node ID for a previously processed pointer (global across all files)
-    /// \param ptr Pointer to the AST node
-    /// \return Node ID if found, -1 otherwise
-    auto getGlobalNodeId(const void* ptr) -> int64_t;
+    /// Route the calling thread's database accesses to \p threadDb
+    /// Used by indexing workers to write into their own staging database. AST node
+    /// bookkeeping below is per thread; stable keys are shared once published, see
+    /// publishTranslationUnits().
+    /// \param threadDb Database for this thread, or nullptr to fall back to the global one
+    static void bindThreadDatabase(KuzuDatabase* threadDb);
 
-    /// Check if a node has already been processed globally
-    /// \param ptr Pointer to the AST node
-    /// \return True if the node has been processed
-    auto hasGlobalNode(const void* ptr) const -> bool;
+    /// Set the incremental index that records every translation unit written to the database
+    /// Must be set before indexing starts; it is only read while indexing.
+    /// \param index Index to record into, or nullptr to disable recording
+    void setIncrementalIndex(const IncrementalIndex* index) { incrementalIndex = index; }
 
-    /// Register a node ID for a pointer globally
-    /// \param ptr Pointer to the AST node
-    /// \param nodeId The node ID to associate with the pointer
-    void registerGlobalNode(const void* ptr, int64_t nodeId);
+    /// Get the incremental index set with setIncrementalIndex()
+    [[nodiscard]] auto getIncrementalIndex() const -> const IncrementalIndex* { return incrementalIndex; }
+
+    /// Skip top-level declarations of headers an earlier translation unit already emitted
+    /// \param skip True to enable skipping
+    void setSkipIndexedHeaders(bool skip) { skipIndexedHeaders = skip; }
+
+    /// Check whether already indexed headers are skipped, see setSkipIndexedHeaders()
+    [[nodiscard]] auto shouldSkipIndexedHeaders() const -> bool { return skipIndexedHeaders; }
+
+    /// Set the analyzer settings of the run; must be set before indexing starts
+    void setAnalysisOptions(AnalysisOptions options) { analysisOptions = std::move(options); }
+
+    /// Get the analyzer settings of the run, see setAnalysisOptions()
+    [[nodiscard]] auto getAnalysisOptions() const -> const AnalysisOptions& { return analysisOptions; }
+
+    /// Write a StableKey row for every header entity, so the database can be merged with others
+    /// Must be set before indexing starts.
+    void setRecordStableKeys(bool record) { recordStableKeys = record; }
+
+    /// Check whether StableKey rows are written, see setRecordStableKeys()
+    [[nodiscard]] auto shouldRecordStableKeys() const -> bool { return recordStableKeys; }
+
+    /// Check if a header was fully emitted by an earlier translation unit of any thread
+    /// Headers of other threads count once they are published, see publishTranslationUnits().
+    /// \param key Normalized path and content hash of the header
+    [[nodiscard]] auto isHeaderIndexed(const std::string& key) const -> bool;
+
+    /// Register a header as fully emitted by the current translation unit
+    /// \param key Normalized path and content hash of the header
+    void registerIndexedHeader(std::string key);
+
+    /// Start node bookkeeping for a new translation unit on the calling thread
+    /// Pointer keys are dropped, since AST addresses are only meaningful within one
+    /// ASTContext and get reused once it is freed; stable keys are kept.
+    /// \param mainFile Main source file of the translation unit
+    void beginTranslationUnit(const std::string& mainFile);
+
+    /// End the translation unit started by beginTranslationUnit() on the calling thread
+    /// Drops the pointer keys before the ASTContext that owns them is freed. Without a
+    /// staging database the unit's stable keys are published right away.
+    void endTranslationUnit();
+
+    /// Make the stable keys and indexed headers of the calling thread's ended translation units visible
+    /// to all threads
+    /// Called once their rows are handed to the writer, whose FIFO order then puts the rows before
+    /// any relationship another thread writes to them. A key another thread published first wins;
+    /// the node emitted for it here is counted as a duplicate in --stats.
+    void publishTranslationUnits();
+
+    /// Look up a node emitted by an earlier translation unit of any thread
+    /// Nodes of other threads are found once they are published, see publishTranslationUnits().
+    /// A hit is remembered as a dependency of the current translation unit on the
+    /// one that emitted the node, see getBorrowedTranslationUnits().
+    /// \param key Stable identity of the entity (see ASTNodeProcessor)
+    /// \return Node ID if found, -1 otherwise
+    auto getStableNodeId(const std::string& key) -> int64_t;
 
-    /// Check if a Declaration node has been created for this node ID
-    /// \param nodeId The node ID to check
-    /// \return True if Declaration node already exists
-    [[nodiscard]] auto hasDeclarationNode(int64_t nodeId) const -> bool;
+    /// Register the node emitted for a stable key by the current translation unit
+    /// \param key Stable identity of the entity
+    /// \param nodeId The node ID emitted for it
+    void registerStableNode(std::string key, int64_t nodeId);
 
-    /// Register that a Declaration node has been created for this node ID
-    /// \param nodeId The node ID to register
-    void registerDeclarationNode(int64_t nodeId);
+    /// Drop the stable keys registered for some translation units
+    /// Called before those translation units are indexed again, since their old nodes
+    /// are deleted and must not be reused. Headers are no longer skipped as already
+    /// indexed, as they may have been emitted by one of them.
+    /// \param mainFiles Normalized main files of the translation units
+    void forgetTranslationUnits(const std::vector<std::string>& mainFiles);
 
-    /// Check if a Type node has been created for this node ID
-    /// \param nodeId The node ID to check
-    /// \return True if Type node already exists
-    [[nodiscard]] auto hasTypeNode(int64_t nodeId) const -> bool;
+    /// Get the main files of the earlier translation units whose nodes the current one reuses
+    [[nodiscard]] auto getBorrowedTranslationUnits() const -> std::vector<std::string>;
 
-    /// Register that a Type node has been created for this node ID
-    /// \param nodeId The node ID to register
-    void registerTypeNode(int64_t nodeId);
+    /// Get the ID of a source file, writing its SourceFile row the first time the database sees the path
+    /// IDs are derived from the path, so every thread, run and shard assigns the same one.
+    /// \param path File name as stored for the node
+    /// \return ID referenced by the file_id column of ASTNode rows
+    auto getSourceFileId(llvm::StringRef path) -> int64_t;
 
-    /// Check if a Statement node has been created for this node ID
-    /// \param nodeId The node ID to check
-    /// \return True if Statement node already exists
-    [[nodiscard]] auto hasStatementNode(int64_t nodeId) const -> bool;
+    /// Get the node record of an AST node, creating an empty one on first use
+    /// The reference is invalidated by the next insertion into the table.
+    /// \param ptr Pointer to the AST node
+    /// \return Record whose nodeId is -1 if no node has been assigned yet
+    auto getNodeRecord(const void* ptr) -> NodeRecord&;
 
-    /// Register that a Statement node has been created for this node ID
-    /// \param nodeId The node ID to register
-    void registerStatementNode(int64_t nodeId);
+    /// Find the node record of an AST node without creating one
+    /// \param ptr Pointer to the AST node
+    /// \return The record, or nullptr if the node has not been seen
+    [[nodiscard]] auto findNodeRecord(const void* ptr) const -> const NodeRecord*;
 
-    /// Check if an Expression node has been created for this node ID
-    /// \param nodeId The node ID to check
-    /// \return True if Expression node already exists
-    [[nodiscard]] auto hasExpressionNode(int64_t nodeId) const -> bool;
+    /// Get the node ID for a previously processed pointer (within the current translation unit)
+    /// \param ptr Pointer to the AST node
+    /// \return Node ID if found, -1 otherwise
+    auto getGlobalNodeId(const void* ptr) const -> int64_t;
+
+    /// Check if a node has already been processed globally
+    /// \param ptr Pointer to the AST node
+    /// \return True if the node has been processed
+    auto hasGlobalNode(const void* ptr) const -> bool;
 
-    /// Register that an Expression node has been created for this node ID
-    /// \param nodeId The node ID to register
-    void registerExpressionNode(int64_t nodeId);
+    /// Record that a specialized row is being written for a node
+    /// \param ptr Pointer to the AST node, which must have a node record
+    /// \param row The specialized table
+    /// \return True if the row had not been written yet and the caller should write it
+    auto markNodeRow(const void* ptr, NodeRow row) -> bool;
 
     /// Cleanup (optional - called automatically on destruction)
     void cleanup();
@@ -96,17 +202,97 @@ private:
     GlobalDatabaseManager() = default;
     ~GlobalDatabaseManager();
 
+    using NodeTable = llvm::DenseMap<const void*, NodeRecord>;
+
+    // Header entities keyed by stable identity: node ID and index of the emitting translation unit
+    using StableNodeMap = std::unordered_map<std::string, std::pair<int64_t, size_t>>;
+
+    /// Node bookkeeping for the files processed on one thread
+    /// Keys are AST pointers, which are only meaningful for the ASTs a thread owns,
+    /// so each thread keeps its own registry and no locking is needed.
+    struct NodeRegistry
+    {
+        // Every AST node seen in the current translation unit, in one flat table so that
+        // resolving a node and checking its specialized rows costs a single probe
+        NodeTable nodes;
+
+        // Stable keys whose rows may still be in this thread's staging database: those of the
+        // current translation unit, and those of ended ones not yet handed to the writer
+        StableNodeMap currentStableNodeIds;
+        StableNodeMap endedStableNodeIds;
+        size_t translationUnit = 0;                 // Index into translationUnits of the current one
+        std::set<size_t> borrowedTranslationUnits;  // Of the current translation unit
+
+        // Headers whose declarations are all in the database, keyed by path and content hash; like the
+        // stable keys that link them up, those of the current and ended units are not published yet
+        std::unordered_set<std::string> currentIndexedHeaders;
+        std::unordered_set<std::string> endedIndexedHeaders;
+        size_t headerGeneration = 0;       // indexedHeaderGeneration when the current unit began
+        size_t endedHeaderGeneration = 0;  // The same for the oldest unit of endedIndexedHeaders
+
+        // Source files resolved by this thread; only misses reach the shared set below
+        llvm::StringMap<int64_t> sourceFileIds;
+
+        // Estimated bytes of the unpublished stable keys, and the sizes last reported to the MemoryMonitor
+        size_t stableKeyBytes = 0;
+        size_t accountedNodeBytes = 0;
+        size_t accountedStableKeyBytes = 0;
+    };
+
+    /// Drop the calling thread's caches and flush its database, when over --max-memory
+    /// Header entities are emitted again by later translation units once their keys are gone,
+    /// and headers are no longer skipped as already indexed.
+    void relieveMemoryPressure(NodeRegistry& threadRegistry);
+
+    /// Published header entities of all threads, spread over shards by key hash
+    /// so that workers looking up keys rarely wait for the same lock
+    struct StableKeyShard
+    {
+        std::mutex mutex;
+        StableNodeMap nodeIds;
+        size_t bytes = 0;           // Estimated bytes of nodeIds
+        size_t accountedBytes = 0;  // Size last reported to the MemoryMonitor
+    };
+
+    static constexpr size_t STABLE_KEY_SHARDS = 64;
+
+    /// Get the registry of the calling thread
+    static auto registry() -> NodeRegistry&;
+
+    /// Get the shard holding a published stable key
+    auto getStableKeyShard(const std::string& key) -> StableKeyShard&;
+
+    /// Drop every published stable key
+    void clearStableKeyShards();
+
+    /// Drop every indexed header, published or not
+    /// Other threads' unpublished headers are dropped when they try to publish them, as
+    /// they may rely on the stable keys of the headers dropped here.
+    void clearIndexedHeaders(NodeRegistry& threadRegistry);
+
     std::unique_ptr<KuzuDatabase> database;
     bool initialized = false;
+    const IncrementalIndex* incrementalIndex = nullptr;
+    bool skipIndexedHeaders = false;
+    bool recordStableKeys = false;
+    AnalysisOptions analysisOptions;
+
+    std::array<StableKeyShard, STABLE_KEY_SHARDS> stableKeyShards;
+
+    // Main files of every translation unit begun on any thread, indexed by NodeRegistry::translationUnit
+    mutable std::mutex translationUnitMutex;
+    std::vector<std::string> translationUnits;
+
+    // Published indexed headers; the generation counts how often they were dropped
+    mutable std::mutex indexedHeaderMutex;
+    std::unordered_set<std::string> indexedHeaders;
+    std::atomic<size_t> indexedHeaderGeneration{0};
 
-    // Global node ID map to prevent duplicate processing across files
-    std::unordered_map<const void*, int64_t> globalNodeIdMap;
+    // IDs of the SourceFile rows in the database or written during this run
+    std::mutex sourceFileMutex;
+    std::unordered_set<int64_t> writtenSourceFiles;
 
-    // Track which specialized nodes have been created to prevent duplicates
-    std::unordered_set<int64_t> createdDeclarationNodes;
-    std::unordered_set<int64_t> createdTypeNodes;
-    std::unordered_set<int64_t> createdStatementNodes;
-    std::unordered_set<int64_t> createdExpressionNodes;
+    static thread_local KuzuDatabase* threadDatabase;
 };
 
 }  // namespace clang
@@ -0,0 +1,482 @@
+//===--- IncrementalIndex.cpp - Content-hash based incremental indexing ---===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "IncrementalIndex.h"
+
+#include "GlobalDatabaseManager.h"
+
+// clang-format off
+#include <doctest/doctest.h>
+
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <set>
+
+using namespace clang;
+
+namespace
+{
+
+// Separators of the serialized IndexedFile columns; neither occurs in a hash
+constexpr char ENTRY_SEPARATOR = '|';
+constexpr char FIELD_SEPARATOR = ' ';
+
+auto serializeDependencies(const std::vector<std::pair<std::string, std::string>>& dependencies) -> std::string
+{
+    std::string text;
+    for (const auto& [path, hash] : dependencies)
+    {
+        if (!text.empty())
+            text += ENTRY_SEPARATOR;
+        text += hash;
+        text += FIELD_SEPARATOR;
+        text += path;
+    }
+    return text;
+}
+
+auto parseDependencies(llvm::StringRef text) -> std::vector<std::pair<std::string, std::string>>
+{
+    std::vector<std::pair<std::string, std::string>> dependencies;
+    llvm::SmallVector<llvm::StringRef, 64> entries;
+    text.split(entries, ENTRY_SEPARATOR, -1, false);
+    for (auto entry : entries)
+    {
+        auto [hash, path] = entry.split(FIELD_SEPARATOR);
+        if (!path.empty())
+            dependencies.emplace_back(path.str(), hash.str());
+    }
+    return dependencies;
+}
+
+auto serializePaths(const std::vector<std::string>& paths) -> std::string
+{
+    std::string text;
+    for (const auto& path : paths)
+    {
+        if (!text.empty())
+            text += ENTRY_SEPARATOR;
+        text += path;
+    }
+    return text;
+}
+
+auto parsePaths(llvm::StringRef text) -> std::vector<std::string>
+{
+    std::vector<std::string> paths;
+    llvm::SmallVector<llvm::StringRef, 8> entries;
+    text.split(entries, ENTRY_SEPARATOR, -1, false);
+    for (auto entry : entries)
+        paths.push_back(entry.str());
+    return paths;
+}
+
+auto serializeRanges(const KuzuDatabase::NodeIdRanges& ranges) -> std::string
+{
+    std::string text;
+    for (const auto& [first, end] : ranges)
+    {
+        if (!text.empty())
+            text += ',';
+        text += std::to_string(first) + "-" + std::to_string(end);
+    }
+    return text;
+}
+
+auto parseRanges(llvm::StringRef text) -> KuzuDatabase::NodeIdRanges
+{
+    KuzuDatabase::NodeIdRanges ranges;
+    llvm::SmallVector<llvm::StringRef, 16> entries;
+    text.split(entries, ',', -1, false);
+    for (auto entry : entries)
+    {
+        auto [firstText, endText] = entry.split('-');
+        int64_t first = 0;
+        int64_t end = 0;
+        if (!firstText.getAsInteger(10, first) && !endText.getAsInteger(10, end) && first < end)
+            ranges.emplace_back(first, end);
+    }
+    return ranges;
+}
+
+// Every translation unit of a file appends to the file's row, so re-indexing deletes the nodes of all of them
+auto buildRecordQuery(const std::string& path, const IncrementalIndex::Record& record) -> std::string
+{
+    std::string dependencies = KuzuDatabase::escapeString(serializeDependencies(record.dependencies));
+    std::string ranges = serializeRanges(record.nodeRanges);
+    std::string borrowedFrom = KuzuDatabase::escapeString(serializePaths(record.borrowedFrom));
+    return "MERGE (f:IndexedFile {path: '" + KuzuDatabase::escapeString(path) + "'}) ON CREATE SET " +
+           "f.content_hash = '" + record.contentHash + "', f.command_hash = '" + record.commandHash + "', " +
+           "f.dependencies = '" + dependencies + "', f.node_ranges = '" + ranges + "', " +
+           "f.borrowed_from = '" + borrowedFrom + "' ON MATCH SET " +
+           "f.dependencies = concat(f.dependencies, '" + ENTRY_SEPARATOR + dependencies + "'), " +
+           "f.node_ranges = concat(f.node_ranges, '," + ranges + "'), " +
+           "f.borrowed_from = concat(f.borrowed_from, '" + ENTRY_SEPARATOR + borrowedFrom + "')";
+}
+
+}  // namespace
+
+void IncrementalIndex::load(KuzuDatabase& database)
+{
+    records.clear();
+    auto* connection = database.getConnection();
+    if (connection == nullptr)
+        return;
+
+    auto result = connection->query(
+        "MATCH (f:IndexedFile) "
+        "RETURN f.path, f.content_hash, f.command_hash, f.dependencies, f.node_ranges, f.borrowed_from");
+    if (!result->isSuccess())
+    {
+        llvm::errs() << "Failed to read indexed files: " << result->getErrorMessage() << "\n";
+        return;
+    }
+
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        Record record;
+        record.contentHash = row->getValue(1)->toString();
+        record.commandHash = row->getValue(2)->toString();
+        record.dependencies = parseDependencies(row->getValue(3)->toString());
+        record.nodeRanges = parseRanges(row->getValue(4)->toString());
+        record.borrowedFrom = parsePaths(row->getValue(5)->toString());
+        records[row->getValue(0)->toString()] = std::move(record);
+    }
+}
+
+auto IncrementalIndex::isUpToDate(const tooling::CompilationDatabase& compilations, llvm::StringRef file) -> bool
+{
+    std::string path = normalizePath(file);
+    auto it = records.find(path);
+    if (it == records.end())
+        return false;
+
+    const Record& record = it->second;
+    if (record.commandHash != hashCompileCommands(compilations, file))
+        return false;
+
+    auto contentHash = hashFile(path);
+    if (!contentHash || *contentHash != record.contentHash)
+        return false;
+
+    // A header that changed or disappeared invalidates every translation unit that read it
+    return std::ranges::all_of(record.dependencies,
+                               [this](const auto& dependency)
+                               {
+                                   auto hash = hashFile(dependency.first);
+                                   return hash && *hash == dependency.second;
+                               });
+}
+
+void IncrementalIndex::rescheduleBorrowers(std::vector<std::string>& scheduled,
+                                           std::vector<std::string>& skipped) const
+{
+    std::set<std::string> scheduledPaths;
+    for (const auto& file : scheduled)
+        scheduledPaths.insert(normalizePath(file));
+
+    // Each pass may schedule files that others borrow from, so repeat until nothing moves
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = skipped.begin(); it != skipped.end();)
+        {
+            auto record = records.find(normalizePath(*it));
+            bool borrowsFromScheduled = record != records.end() &&
+                                        std::ranges::any_of(record->second.borrowedFrom,
+                                                            [&](const std::string& owner)
+                                                            { return scheduledPaths.contains(owner); });
+            if (!borrowsFromScheduled)
+            {
+                ++it;
+                continue;
+            }
+
+            scheduledPaths.insert(record->first);
+            scheduled.push_back(std::move(*it));
+            it = skipped.erase(it);
+            changed = true;
+        }
+    }
+}
+
+void IncrementalIndex::prepare(KuzuDatabase& database,
+                               const tooling::CompilationDatabase& compilations,
+                               const std::vector<std::string>& files)
+{
+    KuzuDatabase::NodeIdRanges staleRanges;
+    std::string stalePaths;
+    for (const auto& file : files)
+    {
+        std::string path = normalizePath(file);
+        commandHashes[path] = hashCompileCommands(compilations, file);
+
+        auto it = records.find(path);
+        if (it == records.end())
+            continue;
+
+        staleRanges.insert(staleRanges.end(), it->second.nodeRanges.begin(), it->second.nodeRanges.end());
+        stalePaths += (stalePaths.empty() ? "'" : ", '") + KuzuDatabase::escapeString(path) + "'";
+        records.erase(it);
+    }
+
+    if (stalePaths.empty())
+        return;
+
+    if (!staleRanges.empty())
+    {
+        llvm::outs() << "Removing " << staleRanges.size() << " node ranges of previously indexed files\n";
+        database.deleteNodeRanges(staleRanges);
+    }
+
+    // The translation units append to their file's row, so the old row must not survive into this run
+    if (auto* connection = database.getConnection())
+    {
+        auto result = connection->query("MATCH (f:IndexedFile) WHERE f.path IN [" + stalePaths + "] DELETE f");
+        if (!result->isSuccess())
+            llvm::errs() << "Failed to delete indexed files: " << result->getErrorMessage() << "\n";
+    }
+}
+
+void IncrementalIndex::recordTranslationUnit(KuzuDatabase& database,
+                                             llvm::StringRef file,
+                                             const SourceManager& sourceManager) const
+{
+    std::string path = normalizePath(file);
+    auto commandHash = commandHashes.find(path);
+    if (commandHash == commandHashes.end())
+        return;
+
+    FileID mainFileId = sourceManager.getMainFileID();
+    OptionalFileEntryRef mainFile = sourceManager.getFileEntryRefForID(mainFileId);
+
+    std::vector<std::pair<std::string, std::string>> dependencies;
+    std::set<std::string> seen;
+    auto addDependency = [&](FileEntryRef file, std::optional<llvm::MemoryBufferRef> buffer)
+    {
+        if (mainFile && file == *mainFile)
+            return;
+        llvm::StringRef name = file.getFileEntry().tryGetRealPathName();
+        std::string normalized = normalizePath(name.empty() ? file.getName() : name);
+        if (!seen.insert(normalized).second)
+            return;
+
+        if (buffer)
+            dependencies.emplace_back(std::move(normalized), hashContents(buffer->getBuffer()));
+        else if (auto contents = llvm::MemoryBuffer::getFile(normalized))
+            dependencies.emplace_back(std::move(normalized), hashContents((*contents)->getBuffer()));
+    };
+
+    // In a parsed unit only files whose contents were actually loaded can have influenced it
+    for (auto it = sourceManager.fileinfo_begin(); it != sourceManager.fileinfo_end(); ++it)
+    {
+        if (auto buffer = it->second->getBufferIfLoaded())
+            addDependency(it->first, buffer);
+    }
+
+    // A unit loaded from the AST cache keeps its files in loaded entries, whose buffers are
+    // only read on demand; every file the unit entered is a dependency, hashed from disk if unread
+    for (unsigned i = 0; i < sourceManager.loaded_sloc_entry_size(); ++i)
+    {
+        bool invalid = false;
+        const auto& entry = sourceManager.getLoadedSLocEntry(i, &invalid);
+        if (invalid || !entry.isFile())
+            continue;
+        const auto& contentCache = entry.getFile().getContentCache();
+        if (contentCache.OrigEntry)
+            addDependency(*contentCache.OrigEntry, contentCache.getBufferIfLoaded());
+    }
+
+    Record record;
+    record.contentHash = hashContents(sourceManager.getBufferData(mainFileId));
+    record.commandHash = commandHash->second;
+    record.dependencies = std::move(dependencies);
+    record.nodeRanges = database.getFileNodeRanges();
+    record.borrowedFrom = GlobalDatabaseManager::getInstance().getBorrowedTranslationUnits();
+    database.addToBatch(buildRecordQuery(path, record));
+}
+
+auto IncrementalIndex::getIndexedFiles() const -> std::vector<std::string>
+{
+    std::set<std::string> files;
+    for (const auto& [path, record] : records)
+    {
+        files.insert(path);
+        for (const auto& [dependency, _] : record.dependencies)
+            files.insert(dependency);
+    }
+    return {files.begin(), files.end()};
+}
+
+auto IncrementalIndex::normalizePath(llvm::StringRef path) -> std::string
+{
+    llvm::SmallString<256> normalized(path);
+    llvm::sys::fs::make_absolute(normalized);
+    llvm::sys::path::remove_dots(normalized, true);
+    llvm::sys::path::native(normalized);
+    return std::string(normalized);
+}
+
+auto IncrementalIndex::hashContents(llvm::StringRef contents) -> std::string
+{
+    return llvm::utohexstr(llvm::xxh3_64bits(contents), true, 16);
+}
+
+auto IncrementalIndex::hashFile(const std::string& path) -> std::optional<std::string>
+{
+    // Translation units share most of their headers, so each file is read at most once
+    auto [it, inserted] = fileHashes.try_emplace(path);
+    if (!inserted)
+        return it->second;
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (buffer)
+        it->second = hashContents((*buffer)->getBuffer());
+    return it->second;
+}
+
+auto IncrementalIndex::hashCompileCommands(const tooling::CompilationDatabase& compilations, llvm::StringRef file)
+    -> std::string
+{
+    std::string fingerprint;
+    for (const auto& command : compilations.getCompileCommands(file))
+    {
+        fingerprint += command.Directory;
+        fingerprint += '\0';
+        for (const auto& argument : command.CommandLine)
+        {
+            fingerprint += argument;
+            fingerprint += '\0';
+        }
+        fingerprint += '\n';
+    }
+    return hashContents(fingerprint);
+}
+
+TEST_CASE("IncrementalIndex column serialization")
+{
+    using Dependencies = std::vector<std::pair<std::string, std::string>>;
+
+    // Paths may contain spaces; the hash in front of them never does
+    Dependencies dependencies{{"/src/a b.h", "00FF"}, {"/src/c.h", "1234"}};
+    CHECK(serializeDependencies(dependencies) == "00FF /src/a b.h|1234 /src/c.h");
+    CHECK(parseDependencies(serializeDependencies(dependencies)) == dependencies);
+    CHECK(parseDependencies("").empty());
+    CHECK(parseDependencies("00FF|1234 /src/c.h||") == Dependencies{{"/src/c.h", "1234"}});
+
+    std::vector<std::string> paths{"/src/a.cpp", "/src/b c.cpp"};
+    CHECK(serializePaths(paths) == "/src/a.cpp|/src/b c.cpp");
+    CHECK(parsePaths(serializePaths(paths)) == paths);
+    CHECK(parsePaths("").empty());
+    CHECK(parsePaths("||/src/a.cpp") == std::vector<std::string>{"/src/a.cpp"});
+
+    KuzuDatabase::NodeIdRanges ranges{{1, 5}, {10, 11}};
+    CHECK(serializeRanges(ranges) == "1-5,10-11");
+    CHECK(parseRanges(serializeRanges(ranges)) == ranges);
+    CHECK(parseRanges("").empty());
+
+    // Empty, reversed and malformed ranges are dropped
+    CHECK(parseRanges("5-5,7-3,x-9,4,3-4") == KuzuDatabase::NodeIdRanges{{3, 4}});
+}
+
+namespace
+{
+
+/// A compilation database that builds every file twice, e.g. as a debug and a release object
+class TwoCommandDatabase : public tooling::CompilationDatabase
+{
+public:
+    auto getCompileCommands(llvm::StringRef file) const -> std::vector<tooling::CompileCommand> override
+    {
+        return {tooling::CompileCommand(".", file.str(), {"clang++", "-O0", "-c", file.str()}, "debug.o"),
+                tooling::CompileCommand(".", file.str(), {"clang++", "-O2", "-c", file.str()}, "release.o")};
+    }
+};
+
+/// Count the rows of a query returning one count
+auto countRows(KuzuDatabase& database, const std::string& query) -> int64_t
+{
+    auto result = database.getConnection()->query(query);
+    REQUIRE(result->isSuccess());
+    REQUIRE(result->hasNext());
+    return result->getNext()->getValue(0)->getValue<int64_t>();
+}
+
+}  // namespace
+
+TEST_CASE("IncrementalIndex records every compile command of a file")
+{
+    llvm::SmallString<128> directory;
+    REQUIRE(!llvm::sys::fs::createUniqueDirectory("dosatsu-incremental", directory));
+    llvm::SmallString<128> databasePath(directory);
+    llvm::sys::path::append(databasePath, "db");
+    std::string file = IncrementalIndex::normalizePath(directory) + "/a.cpp";
+    TwoCommandDatabase compilations;
+    {
+        KuzuDatabase database{std::string(databasePath)};
+        database.initialize();
+        REQUIRE(database.isInitialized());
+
+        IncrementalIndex index;
+        index.load(database);
+        index.prepare(database, compilations, {file});
+
+        // One translation unit per command, each with its own nodes and headers, as recordTranslationUnit() writes them
+        for (const char* header : {"/src/debug.h", "/src/release.h"})
+        {
+            database.beginFile();
+            for (int node = 0; node < 2; ++node)
+            {
+                database.addNodeToBatch("ASTNode",
+                                        {{"node_id", database.getNextNodeId()},
+                                         {"node_type", std::string_view("FunctionDecl")},
+                                         {"memory_address", std::string_view()},
+                                         {"file_id", int64_t{0}},
+                                         {"is_implicit", false},
+                                         {"start_line", int64_t{-1}},
+                                         {"start_column", int64_t{-1}},
+                                         {"end_line", int64_t{-1}},
+                                         {"end_column", int64_t{-1}},
+                                         {"raw_text", std::string_view()}});
+            }
+            IncrementalIndex::Record record;
+            record.contentHash = "00FF";
+            record.commandHash = "1234";
+            record.dependencies = {{header, "5678"}};
+            record.nodeRanges = database.getFileNodeRanges();
+            database.addToBatch(buildRecordQuery(file, record));
+        }
+        database.flushOperations();
+        REQUIRE(countRows(database, "MATCH (n:ASTNode) RETURN count(n)") == 4);
+        CHECK(countRows(database, "MATCH (f:IndexedFile) RETURN count(f)") == 1);
+
+        // Both units' headers are dependencies of the file
+        IncrementalIndex stored;
+        stored.load(database);
+        auto files = stored.getIndexedFiles();
+        CHECK(std::ranges::count(files, "/src/debug.h") == 1);
+        CHECK(std::ranges::count(files, "/src/release.h") == 1);
+
+        // Re-indexing the file removes the nodes of both units and the old row
+        stored.prepare(database, compilations, {file});
+        CHECK(countRows(database, "MATCH (n:ASTNode) RETURN count(n)") == 0);
+        CHECK(countRows(database, "MATCH (f:IndexedFile) RETURN count(f)") == 0);
+    }
+    llvm::sys::fs::remove_directories(directory);
+}
@@ -0,0 +1,111 @@
+//===--- IncrementalIndex.h - Content-hash based incremental indexing -----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "KuzuDatabase.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringRef.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang
+{
+
+/// Tracks what every translation unit was indexed from, so unchanged ones can be skipped
+/// Each indexed main file gets an IndexedFile row holding its content hash, a
+/// fingerprint of its compile commands, the content hashes of every header it read
+/// and the node ID ranges it produced. A file with several compile commands is
+/// indexed as several translation units, which all add to the same row. A file is
+/// up to date when all of these still match; otherwise its old nodes are deleted
+/// by ID range before it is indexed again. Header nodes are shared between the
+/// translation units of a run, so each row also names the units it borrowed from.
+class IncrementalIndex
+{
+public:
+    /// Stored state of one indexed translation unit
+    struct Record
+    {
+        std::string contentHash;
+        std::string commandHash;
+        std::vector<std::pair<std::string, std::string>> dependencies;  // Header path and content hash
+        KuzuDatabase::NodeIdRanges nodeRanges;
+        std::vector<std::string> borrowedFrom;  // Translation units whose header nodes this one reuses
+    };
+
+    /// Load the records stored in a connected database
+    /// \param database The connected database
+    void load(KuzuDatabase& database);
+
+    /// Check whether a translation unit can be skipped
+    /// \param compilations Compilation database providing the file's compile commands
+    /// \param file Main source file of the translation unit
+    /// \return True if the file, its headers and its compile commands are unchanged since it was indexed
+    auto isUpToDate(const tooling::CompilationDatabase& compilations, llvm::StringRef file) -> bool;
+
+    /// Move files that reuse nodes of a scheduled file back into the schedule
+    /// Re-indexing a file deletes the header nodes it emitted, so every file that
+    /// reuses them has to be re-indexed as well, transitively.
+    /// \param scheduled Files that will be indexed, extended in place
+    /// \param skipped Files found up to date, reduced in place
+    void rescheduleBorrowers(std::vector<std::string>& scheduled, std::vector<std::string>& skipped) const;
+
+    /// Remember the compile command fingerprints of the files about to be indexed and drop their old nodes and rows
+    /// Must run on the connected database before indexing starts.
+    /// \param database The connected database
+    /// \param compilations Compilation database providing the compile commands
+    /// \param files Files that will be indexed
+    void prepare(KuzuDatabase& database,
+                 const tooling::CompilationDatabase& compilations,
+                 const std::vector<std::string>& files);
+
+    /// Add a translation unit that was just indexed to the IndexedFile row of its main file
+    /// The node ranges are taken from \p database, which must have seen beginFile()
+    /// before the translation unit's first node was created. Units of the same file
+    /// append their ranges, headers and borrowed units to the row instead of replacing them.
+    /// \param database Database (connected or staging) the translation unit was written to
+    /// \param file Main source file as passed to the frontend action
+    /// \param sourceManager Source manager of the translation unit, providing the file contents
+    void recordTranslationUnit(KuzuDatabase& database, llvm::StringRef file, const SourceManager& sourceManager) const;
+
+    /// Get every file the stored translation units were read from: their main files and headers
+    /// \return Normalized paths, each listed once
+    [[nodiscard]] auto getIndexedFiles() const -> std::vector<std::string>;
+
+    /// Normalize a path so the driver and the frontend agree on file identity
+    static auto normalizePath(llvm::StringRef path) -> std::string;
+
+    /// Hash file contents
+    /// \return Hexadecimal content hash
+    static auto hashContents(llvm::StringRef contents) -> std::string;
+
+private:
+    /// Hash a file on disk, caching the result
+    /// \return The content hash, or nullopt if the file cannot be read
+    auto hashFile(const std::string& path) -> std::optional<std::string>;
+
+    /// Fingerprint the compile commands of a file
+    static auto hashCompileCommands(const tooling::CompilationDatabase& compilations, llvm::StringRef file)
+        -> std::string;
+
+    std::map<std::string, Record> records;
+    std::map<std::string, std::optional<std::string>> fileHashes;
+
+    // Written by prepare() before indexing starts, read by all indexing threads afterwards
+    std::map<std::string, std::string> commandHashes;
+};
+
+}  // namespace clang
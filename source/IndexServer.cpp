@@ -0,0 +1,199 @@
+//===--- IndexServer.cpp - Resident indexing with change watching --------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexServer.h"
+
+#include "BoundedQueue.h"
+#include "GlobalDatabaseManager.h"
+#include "SummaryTables.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/FileSystem.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+using namespace clang;
+
+namespace
+{
+
+// Lines a client can send at once before the reader thread waits
+constexpr size_t QUEUED_COMMANDS = 64;
+
+/// Write a value on one protocol line, with the characters that would end the value escaped
+void writeEscaped(llvm::raw_ostream& os, llvm::StringRef value)
+{
+    for (char c : value)
+    {
+        if (c == '\\')
+            os << "\\\\";
+        else if (c == '\t')
+            os << "\\t";
+        else if (c == '\n')
+            os << "\\n";
+        else if (c == '\r')
+            os << "\\r";
+        else
+            os << c;
+    }
+}
+
+}  // namespace
+
+IndexServer::IndexServer(KuzuDatabase& database,
+                         const tooling::CompilationDatabase& compilations,
+                         const CompilationDatabaseLoader::FileFilter& filter,
+                         CompilationDatabaseLoader::Shard shard,
+                         Reindex reindex)
+    : database(database), compilations(compilations), filter(filter), shard(shard), reindex(std::move(reindex))
+{
+    for (const auto& file : CompilationDatabaseLoader::filterSourceFiles(compilations, filter, nullptr, shard))
+        sourceFiles.push_back(IncrementalIndex::normalizePath(file));
+}
+
+auto IndexServer::run(std::istream& commands, llvm::raw_ostream& responses) -> int
+{
+    // The reader blocks in getline() until a line or the end of input arrives, so it is detached
+    // rather than joined; the queue is shared so it outlives whichever side finishes last
+    auto queue = std::make_shared<BoundedQueue<std::string>>(QUEUED_COMMANDS);
+    std::thread(
+        [queue, &commands]
+        {
+            std::string line;
+            while (std::getline(commands, line) && queue->push(line))
+            {
+            }
+            queue->close();
+        })
+        .detach();
+
+    refresh();
+    llvm::outs() << "Serving " << sourceFiles.size() << " source files, watching " << snapshot.size()
+                 << " files\n";
+    llvm::outs().flush();
+
+    int result = 0;
+    while (!queue->isFinished())
+    {
+        if (auto command = queue->popFor(pollInterval))
+        {
+            if (!command->empty() && command->back() == '\r')
+                command->pop_back();
+            if (*command == ":quit")
+                break;
+            if (*command == ":reindex")
+                result = reindexChanged(responses);
+            else if (!command->empty())
+                runQuery(*command, responses);
+            continue;
+        }
+
+        if (takeSnapshot() != snapshot)
+            result = reindexChanged(responses);
+    }
+
+    queue->close();
+    GlobalDatabaseManager::getInstance().setIncrementalIndex(nullptr);
+    return result;
+}
+
+void IndexServer::refresh(const Snapshot& before)
+{
+    // The records change with every re-index and the index caches file hashes, so it is rebuilt each time
+    index = std::make_unique<IncrementalIndex>();
+    index->load(database);
+    snapshot = takeSnapshot();
+    for (const auto& [path, time] : before)
+    {
+        if (auto it = snapshot.find(path); it != snapshot.end())
+            it->second = time;
+    }
+}
+
+auto IndexServer::takeSnapshot() const -> Snapshot
+{
+    Snapshot times;
+    auto add = [&](const std::string& path)
+    {
+        auto [it, inserted] = times.try_emplace(path);
+        llvm::sys::fs::file_status status;
+        if (inserted && !llvm::sys::fs::status(path, status))
+            it->second = status.getLastModificationTime();
+    };
+    for (const auto& file : sourceFiles)
+        add(file);
+    for (const auto& file : index->getIndexedFiles())
+        add(file);
+    return times;
+}
+
+auto IndexServer::reindexChanged(llvm::raw_ostream& responses) -> int
+{
+    // Taken before indexing, so a file saved while the units are indexed still counts as changed afterwards
+    Snapshot before = takeSnapshot();
+    auto files = CompilationDatabaseLoader::filterSourceFiles(compilations, filter, index.get(), shard);
+    int result = 0;
+    if (!files.empty())
+    {
+        auto started = std::chrono::steady_clock::now();
+
+        // The old nodes of these files are deleted, so this thread must stop reusing them
+        auto& dbManager = GlobalDatabaseManager::getInstance();
+        std::vector<std::string> mainFiles;
+        for (const auto& file : files)
+            mainFiles.push_back(IncrementalIndex::normalizePath(file));
+        dbManager.forgetTranslationUnits(mainFiles);
+
+        index->prepare(database, compilations, files);
+        dbManager.setIncrementalIndex(index.get());
+        result = reindex(files);
+        database.flushOperations();
+        if (rebuildSummaries && !SummaryTables(database).rebuild())
+            result = 1;
+
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        responses << "indexed " << files.size() << ' '
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "\n";
+        responses.flush();
+    }
+
+    refresh(before);
+    return result;
+}
+
+void IndexServer::runQuery(const std::string& query, llvm::raw_ostream& responses)
+{
+    auto result = database.getConnection()->query(query);
+    if (!result->isSuccess())
+    {
+        responses << "error ";
+        writeEscaped(responses, result->getErrorMessage());
+        responses << "\n";
+        responses.flush();
+        return;
+    }
+
+    size_t rows = 0;
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        responses << "row";
+        for (uint32_t i = 0; i < row->len(); ++i)
+        {
+            responses << '\t';
+            writeEscaped(responses, row->getValue(i)->toString());
+        }
+        responses << "\n";
+        ++rows;
+    }
+    responses << "done " << rows << "\n";
+    responses.flush();
+}
@@ -0,0 +1,104 @@
+//===--- IndexServer.h - Resident indexing with change watching ----------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "CompilationDatabaseLoader.h"
+#include "IncrementalIndex.h"
+#include "KuzuDatabase.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <chrono>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang
+{
+
+/// Keeps the database, the compile commands and the node deduplication state of
+/// a finished run in memory, and re-indexes translation units as their files change
+/// Every source file of the compilation database and every header the indexed
+/// translation units read is polled for a new modification time; on a change the
+/// IncrementalIndex decides which translation units are out of date, so only those
+/// are parsed again. Clients talk to the server over its standard streams, one
+/// command per line:
+/// - A Cypher query is answered with one "row" line per result row, values
+///   separated by tabs, then "done <rows>", or with "error <message>".
+/// - ":reindex" checks for changes at once; ":quit" (or the end of input) stops.
+/// After each re-index the server writes "indexed <files> <milliseconds>". Lines
+/// not starting with one of these words are progress output.
+class IndexServer
+{
+public:
+    /// Index translation units into the connected database, returning the tool's exit code
+    using Reindex = std::function<int(const std::vector<std::string>& files)>;
+
+    /// Constructor
+    /// \param database The connected database
+    /// \param compilations Compile commands of the run
+    /// \param filter Files of the compilation database to index
+    /// \param shard Slice of the files to index
+    /// \param reindex Runs the indexing pipeline; called on the server's thread
+    IndexServer(KuzuDatabase& database,
+                const tooling::CompilationDatabase& compilations,
+                const CompilationDatabaseLoader::FileFilter& filter,
+                CompilationDatabaseLoader::Shard shard,
+                Reindex reindex);
+
+    /// Set how often the watched files are checked (default: 500 ms)
+    void setPollInterval(std::chrono::milliseconds interval) { pollInterval = interval; }
+
+    /// Rebuild the summary tables after every re-index
+    void setRebuildSummaries(bool rebuild) { rebuildSummaries = rebuild; }
+
+    /// Serve until ":quit" or the end of the command stream
+    /// \param commands Stream of client commands, read on a thread of its own
+    /// \param responses Stream receiving query results and re-index notices
+    /// \return Exit code of the last re-index, 0 if there was none
+    auto run(std::istream& commands, llvm::raw_ostream& responses) -> int;
+
+private:
+    using Snapshot = std::map<std::string, llvm::sys::TimePoint<>>;
+
+    /// Reload the index records from the database and take a new snapshot of the watched files
+    /// \param before Modification times to keep for the files they contain, taken before a re-index
+    void refresh(const Snapshot& before = {});
+
+    /// Modification times of the source files and of every file the index records name
+    auto takeSnapshot() const -> Snapshot;
+
+    /// Re-index the translation units that are out of date, if any
+    /// \return Exit code of the indexing run, or 0 if nothing needed indexing
+    auto reindexChanged(llvm::raw_ostream& responses) -> int;
+
+    /// Run one client query and write its result
+    void runQuery(const std::string& query, llvm::raw_ostream& responses);
+
+    KuzuDatabase& database;
+    const tooling::CompilationDatabase& compilations;
+    const CompilationDatabaseLoader::FileFilter& filter;
+    CompilationDatabaseLoader::Shard shard;
+    Reindex reindex;
+    std::chrono::milliseconds pollInterval{500};
+    bool rebuildSummaries = false;
+
+    std::vector<std::string> sourceFiles;  // Normalized source files of the compilation database
+    std::unique_ptr<IncrementalIndex> index;
+    Snapshot snapshot;
+};
+
+}  // namespace clang
@@ -6,16 +6,29 @@
 
 #include "KuzuDatabase.h"
 
+#include "MemoryMonitor.h"
+#include "Schema.h"
+#include "Statistics.h"
+#include "Trace.h"
+
 // clang-format off
 #include "NoWarningScope_Enter.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/raw_ostream.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <optional>
 #include <stdexcept>
+#include <thread>
 
 using namespace clang;
 
@@ -23,9 +36,49 @@ KuzuDatabase::KuzuDatabase(std::string databasePath) : databasePath(std::move(da
 {
 }
 
+KuzuDatabase::KuzuDatabase(BatchSink sink,
+                           std::atomic<int64_t>& nodeIdSource,
+                           int64_t nodeIdLimit,
+                           std::atomic<size_t>& batchRowSource)
+    : batchRowSource(&batchRowSource), nodeIdSource(&nodeIdSource), nodeIdLimit(nodeIdLimit),
+      batchSink(std::move(sink))
+{
+}
+
 KuzuDatabase::~KuzuDatabase()
 {
+    finishBulkLoad();
+    finishArrowExport();
     flushOperations();
+    MemoryMonitor::getInstance().update(MemorySubsystem::PendingRows, accountedPendingBytes, 0);
+}
+
+auto KuzuDatabase::createStaging(KuzuDatabase& writer, BatchSink sink) -> std::unique_ptr<KuzuDatabase>
+{
+    // Private constructor, so std::make_unique is not available here
+    return std::unique_ptr<KuzuDatabase>(
+        new KuzuDatabase(std::move(sink), *writer.nodeIdSource, writer.nodeIdLimit, *writer.batchRowSource));
+}
+
+void KuzuDatabase::setBatchLimits(const BatchLimits& limits)
+{
+    batchLimits = limits;
+    batchRows.setBounds(DEFAULT_BATCH_ROWS, limits.minBatchRows, limits.maxBatchRows);
+    commitRows.setBounds(DEFAULT_COMMIT_ROWS, limits.minCommitRows, limits.maxCommitRows);
+    chunkRows.clear();
+    batchRowSource->store(batchRows.get(), std::memory_order_relaxed);
+}
+
+auto KuzuDatabase::getChunkRows(const std::string& table) -> AdaptiveSize&
+{
+    auto it = chunkRows.find(table);
+    if (it == chunkRows.end())
+    {
+        it = chunkRows
+                 .try_emplace(table, DEFAULT_BATCH_ROWS, batchLimits.minBatchRows, batchLimits.maxBatchRows)
+                 .first;
+    }
+    return it->second;
 }
 
 void KuzuDatabase::initialize()
@@ -47,11 +100,14 @@ void KuzuDatabase::initialize()
         // Initialize connection pool for better performance
         initializeConnectionPool();
 
-        // Create schema
+        // Create schema; tables of an existing database are kept
         createSchema();
-        
-        // Initialize relationship schema information
-        initializeRelationshipSchemaInfo();
+
+        // Continue after the highest stored node ID, so re-indexing never reuses an ID
+        initializeNodeIdCounter();
+
+        auto existing = connection->query("MATCH (n:ASTNode) RETURN n.node_id LIMIT 1");
+        fresh = existing->isSuccess() && !existing->hasNext();
     }
     catch (const std::exception& e)
     {
@@ -96,6 +152,8 @@ void KuzuDatabase::commitTransaction()
         return;
     }
 
+    PhaseTimer timer(StatisticsPhase::Commit);
+    transactionSeconds = 0;
     try
     {
         auto result = connection->query("COMMIT");
@@ -131,7 +189,7 @@ void KuzuDatabase::rollbackTransaction()
 
 void KuzuDatabase::addToBatch(const std::string& query)
 {
-    if (!connection || query.empty())
+    if (!isInitialized() || query.empty())
         return;
 
     pendingQueries.push_back(query);
@@ -148,20 +206,78 @@ void KuzuDatabase::addToBatch(const std::string& query)
     }
 
     // Optimize transaction boundaries - commit periodically for better performance
-    if (operationsSinceLastCommit >= TRANSACTION_COMMIT_THRESHOLD)
+    if (operationsSinceLastCommit >= commitRows.get())
         optimizeTransactionBoundaries();
 
     // Execute batch when it reaches the configured batch size
-    if (pendingQueries.size() >= BATCH_SIZE)
+    if (isBatchFull(pendingNodeRows + pendingQueries.size()))
+        executeBatch();
+}
+
+void KuzuDatabase::addNodeToBatch(std::string_view table, std::initializer_list<ColumnBuffer::Cell> cells)
+{
+    if (!isInitialized() || cells.size() == 0)
+        return;
+
+    auto& buffer = getNodeBuffer(table);
+    if (buffer.getColumnCount() == 0 && !matchesSchema(table, cells))
+        return;
+    if (!buffer.appendRow(cells))
+    {
+        llvm::errs() << "Dropping " << table << " row: columns differ from earlier rows of this table\n";
+        return;
+    }
+    pendingNodeRows++;
+    totalOperations++;
+    operationsSinceLastCommit++;
+
+    if (!transactionActive)
+        beginTransaction();
+
+    if (operationsSinceLastCommit >= commitRows.get())
+        optimizeTransactionBoundaries();
+
+    if (isBatchFull(pendingNodeRows + pendingQueries.size()))
         executeBatch();
 }
 
+auto KuzuDatabase::matchesSchema(std::string_view table, std::initializer_list<ColumnBuffer::Cell> cells) -> bool
+{
+    const SchemaTable* schema = findSchemaTable(table);
+    if (schema == nullptr || schema->isRelationship())
+    {
+        llvm::errs() << "Dropping " << table << " row: the schema has no such node table\n";
+        return false;
+    }
+    for (const auto& cell : cells)
+    {
+        const SchemaColumn* column = schema->findColumn(cell.column);
+        if (column == nullptr || column->type != ColumnBuffer::typeOf(cell.value))
+        {
+            llvm::errs() << "Dropping " << table << " row: column " << cell.column
+                         << (column == nullptr ? " is not in the schema\n" : " has the wrong type\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+auto KuzuDatabase::getNodeBuffer(std::string_view table) -> ColumnBuffer&
+{
+    for (auto& buffer : pendingNodes)
+    {
+        if (buffer.getTable() == table)
+            return buffer;
+    }
+    return pendingNodes.emplace_back(std::string(table));
+}
+
 void KuzuDatabase::addRelationshipToBatch(int64_t fromNodeId,
                                           int64_t toNodeId,
                                           const std::string& relationshipType,
                                           const std::map<std::string, std::string>& properties)
 {
-    if (!connection)
+    if (!isInitialized())
         return;
 
     pendingRelationships.emplace_back(fromNodeId, toNodeId, relationshipType, properties);
@@ -173,18 +289,18 @@ void KuzuDatabase::addRelationshipToBatch(int64_t fromNodeId,
         beginTransaction();
 
     // Optimize transaction boundaries - commit periodically for better performance
-    if (operationsSinceLastCommit >= TRANSACTION_COMMIT_THRESHOLD)
+    if (operationsSinceLastCommit >= commitRows.get())
         optimizeTransactionBoundaries();
 
     // Execute batch when it reaches the batch size
-    if (pendingQueries.size() + pendingRelationships.size() >= BATCH_SIZE)
+    if (isBatchFull(pendingNodeRows + pendingQueries.size() + pendingRelationships.size()))
         executeBatch();
 }
 
 void KuzuDatabase::addBulkRelationshipsToBatch(
     const std::vector<std::tuple<int64_t, int64_t, std::string, std::map<std::string, std::string>>>& relationships)
 {
-    if (!connection || relationships.empty())
+    if (!isInitialized() || relationships.empty())
         return;
 
     // Add all relationships to pending batch
@@ -200,36 +316,369 @@ void KuzuDatabase::addBulkRelationshipsToBatch(
         beginTransaction();
 
     // Optimize transaction boundaries - commit periodically for better performance
-    if (operationsSinceLastCommit >= TRANSACTION_COMMIT_THRESHOLD)
+    if (operationsSinceLastCommit >= commitRows.get())
         optimizeTransactionBoundaries();
 
     // Execute batch when it reaches the batch size
-    if (pendingQueries.size() + pendingRelationships.size() >= BATCH_SIZE)
+    if (isBatchFull(pendingNodeRows + pendingQueries.size() + pendingRelationships.size()))
         executeBatch();
 }
 
 void KuzuDatabase::executeBatch()
 {
-    if (!connection || (pendingQueries.empty() && pendingRelationships.empty()))
+    if (!isInitialized() || (pendingNodeRows == 0 && pendingQueries.empty() && pendingRelationships.empty()))
+        return;
+
+    TraceSpan span("executeBatch", "database");
+
+    // A full batch is the most this instance buffers
+    accountPendingBytes();
+
+    // Staging instances hand the batch to their writer instead of executing it
+    if (batchSink)
+    {
+        PendingBatch batch;
+        batch.nodes = std::move(pendingNodes);
+        batch.queries = std::move(pendingQueries);
+        batch.relationships = std::move(pendingRelationships);
+        pendingNodes.clear();
+        pendingNodeRows = 0;
+        pendingQueries.clear();
+        pendingRelationships.clear();
+        accountPendingBytes();
+        batchSink(std::move(batch));
+        return;
+    }
+
+    // Staged batches are counted here, by the writer, so each row is counted once
+    recordBatchStatistics();
+
+    if (bulkLoader)
+    {
+        stageBatchForBulkLoad();
+        checkMemoryBudget();
+        return;
+    }
+
+    if (arrowExporter)
+    {
+        exportBatch();
+        checkMemoryBudget();
         return;
+    }
 
+    size_t operations = pendingNodeRows + pendingQueries.size() + pendingRelationships.size();
+    auto started = std::chrono::steady_clock::now();
     try
     {
+        // Nodes first: string queries and relationships may reference them
+        executeNodeBuffers();
+
         // Group queries by type for true bulk operations
         executeBulkQueries();
         
         // Execute optimized relationship batching with schema awareness
         executeOptimizedRelationships();
 
+        clearNodeBuffers();
         pendingQueries.clear();
         pendingRelationships.clear();
     }
     catch (const std::exception& e)
     {
         llvm::errs() << "Exception executing batch: " << e.what() << "\n";
+        clearNodeBuffers();
         pendingQueries.clear();
         pendingRelationships.clear();
     }
+
+    // Only full batches say something about the batch size; the last one of a flush is partial
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    transactionSeconds += seconds;
+    if (isBatchFull(operations))
+    {
+        batchRows.record(operations, seconds);
+        batchRowSource->store(batchRows.get(), std::memory_order_relaxed);
+    }
+    checkMemoryBudget();
+}
+
+auto KuzuDatabase::getPendingBytes() const -> size_t
+{
+    size_t bytes = pendingNodes.capacity() * sizeof(ColumnBuffer);
+    for (const auto& buffer : pendingNodes)
+        bytes += buffer.getMemoryBytes();
+    for (const auto& query : pendingQueries)
+        bytes += sizeof(query) + query.capacity();
+    // Relationship properties are small maps; a node per property is close enough
+    constexpr size_t PROPERTY_BYTES = 96;
+    for (const auto& relationship : pendingRelationships)
+        bytes += sizeof(relationship) + (std::get<3>(relationship).size() * PROPERTY_BYTES);
+    return bytes;
+}
+
+void KuzuDatabase::accountPendingBytes()
+{
+    auto& monitor = MemoryMonitor::getInstance();
+    if (monitor.isEnabled())
+        monitor.update(MemorySubsystem::PendingRows, accountedPendingBytes, getPendingBytes());
+}
+
+void KuzuDatabase::checkMemoryBudget()
+{
+    if (MemoryMonitor::getInstance().isOverBudget())
+    {
+        // Buffers are recreated at the size the next batch needs, and a committed
+        // transaction frees Kuzu's copy of its uncommitted rows
+        pendingNodes = std::vector<ColumnBuffer>();
+        pendingQueries.shrink_to_fit();
+        pendingRelationships.shrink_to_fit();
+        if (transactionActive)
+            optimizeTransactionBoundaries();
+
+        // Flush early until the throughput measurements grow the batches again
+        batchRows.setBounds(batchLimits.minBatchRows, batchLimits.minBatchRows, batchLimits.maxBatchRows);
+        batchRowSource->store(batchRows.get(), std::memory_order_relaxed);
+    }
+    accountPendingBytes();
+}
+
+void KuzuDatabase::executeNodeBuffers()
+{
+    PhaseTimer timer(StatisticsPhase::NodeInsert);
+
+    // Kuzu runs one write transaction at a time, so the chunks execute one after another on the
+    // main connection; converting a chunk only reads its buffer, so the next ones convert meanwhile
+    struct Chunk
+    {
+        const ColumnBuffer* buffer;
+        kuzu::main::PreparedStatement* statement;
+        size_t first;
+        size_t count;
+        size_t chunkSize;
+        std::future<std::unique_ptr<kuzu::common::Value>> rows;
+    };
+    std::deque<Chunk> converting;
+    size_t nextBuffer = 0;
+    size_t nextRow = 0;
+
+    auto startNextChunk = [&]() -> bool
+    {
+        while (nextBuffer < pendingNodes.size())
+        {
+            const ColumnBuffer& buffer = pendingNodes[nextBuffer];
+            if (nextRow >= buffer.getRowCount())
+            {
+                ++nextBuffer;
+                nextRow = 0;
+                continue;
+            }
+
+            auto* statement = getNodeInsertStatement(buffer, true);
+            if (statement == nullptr)
+            {
+                executeNodeRowsIndividually(buffer, 0, buffer.getRowCount());
+                ++nextBuffer;
+                nextRow = 0;
+                continue;
+            }
+
+            // Tables differ in how many rows one UNWIND handles best, so each has its own chunk size
+            size_t chunkSize = getChunkRows(buffer.getTable()).get();
+            size_t count = std::min(chunkSize, buffer.getRowCount() - nextRow);
+            auto rows = std::async(std::launch::async,
+                                   [&buffer, first = nextRow, count]
+                                   {
+                                       PhaseTimer buildTimer(StatisticsPhase::QueryBuild);
+                                       return toKuzuRows(buffer, first, count);
+                                   });
+            converting.push_back({&buffer, statement, nextRow, count, chunkSize, std::move(rows)});
+            nextRow += count;
+            return true;
+        }
+        return false;
+    };
+
+    while (converting.size() < PARALLEL_CONVERSIONS && startNextChunk())
+    {
+    }
+    while (!converting.empty())
+    {
+        Chunk chunk = std::move(converting.front());
+        converting.pop_front();
+        std::unordered_map<std::string, std::unique_ptr<kuzu::common::Value>> params;
+        params.emplace("rows", chunk.rows.get());
+
+        // Keep the window full while this chunk executes
+        startNextChunk();
+
+        auto started = std::chrono::steady_clock::now();
+        auto error = tryExecute(chunk.statement, std::move(params));
+        if (!error.empty())
+        {
+            const ColumnBuffer& buffer = *chunk.buffer;
+            isolateFailedRows(
+                buffer.getTable(),
+                chunk.first,
+                chunk.count,
+                error,
+                [&](size_t first, size_t count)
+                {
+                    std::unordered_map<std::string, std::unique_ptr<kuzu::common::Value>> rows;
+                    rows.emplace("rows", toKuzuRows(buffer, first, count));
+                    return tryExecute(chunk.statement, std::move(rows));
+                },
+                [&](size_t row) { return buildNodeRowQuery(buffer, row); });
+        }
+        else
+        {
+            Statistics::getInstance().addBulkStatement(chunk.count);
+            if (chunk.count == chunk.chunkSize)
+            {
+                getChunkRows(chunk.buffer->getTable())
+                    .record(chunk.count,
+                            std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+            }
+        }
+    }
+}
+
+void KuzuDatabase::executeNodeRowsIndividually(const ColumnBuffer& buffer, size_t first, size_t count)
+{
+    auto* statement = getNodeInsertStatement(buffer, false);
+    if (statement == nullptr)
+        return;
+
+    Statistics::getInstance().addFallbackRows(count);
+
+    for (size_t row = first; row < first + count; ++row)
+    {
+        std::unordered_map<std::string, std::unique_ptr<kuzu::common::Value>> params;
+        params.reserve(buffer.getColumnCount());
+        for (size_t column = 0; column < buffer.getColumnCount(); ++column)
+            params.emplace(buffer.getColumnName(column), toKuzuValue(buffer, column, row));
+
+        auto error = tryExecute(statement, std::move(params));
+        if (!error.empty())
+            rejectRow(buffer.getTable(), buildNodeRowQuery(buffer, row), error);
+    }
+}
+
+auto KuzuDatabase::buildNodeRowQuery(const ColumnBuffer& buffer, size_t row) -> std::string
+{
+    std::string query = "CREATE (n:" + buffer.getTable() + " {";
+    for (size_t column = 0; column < buffer.getColumnCount(); ++column)
+    {
+        if (column > 0)
+            query += ", ";
+        query += buffer.getColumnName(column);
+        query += ": ";
+        switch (buffer.getColumnType(column))
+        {
+        case ColumnBuffer::ColumnType::Int64:
+            query += std::to_string(buffer.getInt64(column, row));
+            break;
+        case ColumnBuffer::ColumnType::Bool:
+            query += buffer.getBool(column, row) ? "true" : "false";
+            break;
+        case ColumnBuffer::ColumnType::String:
+            query += '\'';
+            appendEscaped(query, buffer.getString(column, row));
+            query += '\'';
+            break;
+        }
+    }
+    query += "})";
+    return query;
+}
+
+void KuzuDatabase::clearNodeBuffers()
+{
+    // Keep one buffer per table so its capacity is reused by the next batch
+    std::set<std::string> seenTables;
+    std::erase_if(pendingNodes,
+                  [&seenTables](const ColumnBuffer& buffer) { return !seenTables.insert(buffer.getTable()).second; });
+    for (auto& buffer : pendingNodes)
+        buffer.clear();
+    pendingNodeRows = 0;
+}
+
+auto KuzuDatabase::getNodeInsertStatement(const ColumnBuffer& buffer, bool unwind) -> kuzu::main::PreparedStatement*
+{
+    std::string key = (unwind ? "unwind|" : "single|") + buffer.getTable();
+    for (size_t column = 0; column < buffer.getColumnCount(); ++column)
+        key += "|" + buffer.getColumnName(column);
+
+    auto it = preparedNodeInserts.find(key);
+    if (it == preparedNodeInserts.end())
+    {
+        std::string query = unwind ? "UNWIND $rows AS r CREATE (n:" : "CREATE (n:";
+        query += buffer.getTable() + " {";
+        for (size_t column = 0; column < buffer.getColumnCount(); ++column)
+        {
+            if (column > 0)
+                query += ", ";
+            const auto& name = buffer.getColumnName(column);
+            query += name + (unwind ? ": r." : ": $") + name;
+        }
+        query += "})";
+
+        auto statement = connection->prepare(query);
+        if (!statement->isSuccess())
+            llvm::errs() << "Failed to prepare " << buffer.getTable() << " insert: " << statement->getErrorMessage()
+                         << "\n";
+        // Failed statements are cached too, so the error is reported once per statement
+        it = preparedNodeInserts.emplace(std::move(key), std::move(statement)).first;
+    }
+
+    return it->second->isSuccess() ? it->second.get() : nullptr;
+}
+
+auto KuzuDatabase::toKuzuValue(const ColumnBuffer& buffer, size_t column, size_t row)
+    -> std::unique_ptr<kuzu::common::Value>
+{
+    switch (buffer.getColumnType(column))
+    {
+    case ColumnBuffer::ColumnType::Int64:
+        return std::make_unique<kuzu::common::Value>(buffer.getInt64(column, row));
+    case ColumnBuffer::ColumnType::Bool:
+        return std::make_unique<kuzu::common::Value>(buffer.getBool(column, row));
+    case ColumnBuffer::ColumnType::String:
+        break;
+    }
+    return std::make_unique<kuzu::common::Value>(std::string(buffer.getString(column, row)));
+}
+
+auto KuzuDatabase::toKuzuRows(const ColumnBuffer& buffer, size_t first, size_t count)
+    -> std::unique_ptr<kuzu::common::Value>
+{
+    using kuzu::common::LogicalType;
+
+    std::vector<kuzu::common::StructField> fields;
+    fields.reserve(buffer.getColumnCount());
+    for (size_t column = 0; column < buffer.getColumnCount(); ++column)
+    {
+        LogicalType type = LogicalType::STRING();
+        if (buffer.getColumnType(column) == ColumnBuffer::ColumnType::Int64)
+            type = LogicalType::INT64();
+        else if (buffer.getColumnType(column) == ColumnBuffer::ColumnType::Bool)
+            type = LogicalType::BOOL();
+        fields.emplace_back(buffer.getColumnName(column), std::move(type));
+    }
+    auto rowType = LogicalType::STRUCT(std::move(fields));
+
+    std::vector<std::unique_ptr<kuzu::common::Value>> rows;
+    rows.reserve(count);
+    for (size_t row = first; row < first + count; ++row)
+    {
+        std::vector<std::unique_ptr<kuzu::common::Value>> cells;
+        cells.reserve(buffer.getColumnCount());
+        for (size_t column = 0; column < buffer.getColumnCount(); ++column)
+            cells.push_back(toKuzuValue(buffer, column, row));
+        rows.push_back(std::make_unique<kuzu::common::Value>(rowType.copy(), std::move(cells)));
+    }
+
+    return std::make_unique<kuzu::common::Value>(LogicalType::LIST(std::move(rowType)), std::move(rows));
 }
 
 void KuzuDatabase::executeBulkQueries()
@@ -237,11 +686,16 @@ void KuzuDatabase::executeBulkQueries()
     if (pendingQueries.empty())
         return;
 
+    PhaseTimer timer(StatisticsPhase::BulkQueries);
+    auto& statistics = Statistics::getInstance();
     try
     {
         // Parse and group queries by table type
         std::map<std::string, std::vector<std::string>> groupedQueries;
-        parseAndGroupQueries(groupedQueries);
+        {
+            PhaseTimer buildTimer(StatisticsPhase::QueryBuild);
+            parseAndGroupQueries(groupedQueries);
+        }
         
         // Execute bulk CREATE for each node table
         for (const auto& [tableName, nodeDataList] : groupedQueries)
@@ -253,133 +707,74 @@ void KuzuDatabase::executeBulkQueries()
             if (tableName == "__unbatchable__")
             {
                 // Execute these individually as they were originally
+                statistics.addIndividualQueries(nodeDataList.size());
                 for (const auto& query : nodeDataList)
                 {
-                    auto result = connection->query(query);
-                    if (!result->isSuccess())
-                    {
-                        llvm::errs() << "Query failed: " << result->getErrorMessage() << "\n";
-                        llvm::errs() << "Query: " << query << "\n";
-                    }
-                }
-                continue;
-            }
-                
-            // Build bulk CREATE query with multiple nodes
-            std::string bulkQuery;
-            if (nodeDataList.size() == 1)
-            {
-                // Single node - use original format with CREATE prefix
-                bulkQuery = "CREATE " + nodeDataList[0];
-            }
-            else if (nodeDataList.size() > 10)
-            {
-                // Very large batch - split into smaller chunks to avoid query size limits
-                const size_t chunkSize = 50;
-                for (size_t i = 0; i < nodeDataList.size(); i += chunkSize)
-                {
-                    std::string chunkQuery = "CREATE ";
-                    size_t end = std::min(i + chunkSize, nodeDataList.size());
-                    for (size_t j = i; j < end; ++j)
-                    {
-                        if (j > i) chunkQuery += ", ";
-                        
-                        // Fix variable name conflicts: replace "(n:" with unique variable name
-                        std::string nodeData = nodeDataList[j];
-                        std::string uniqueVar = "n" + std::to_string(j);
-                        
-                        // Replace "(n:" with "(nX:" where X is the index
-                        size_t varPos = nodeData.find("(n:");
-                        if (varPos != std::string::npos)
-                        {
-                            nodeData = nodeData.substr(0, varPos + 1) + uniqueVar + nodeData.substr(varPos + 2);
-                        }
-                        
-                        chunkQuery += nodeData;
-                    }
-                    
-                    // Executing bulk insert chunk
-                    
-                    auto result = connection->query(chunkQuery);
-                    if (!result->isSuccess())
-                    {
-                        llvm::errs() << "Bulk insert chunk failed: " << result->getErrorMessage() << "\n";
-                        // Fallback to individual queries for this chunk
-                        for (size_t j = i; j < end; ++j)
-                        {
-                            auto individualResult = connection->query("CREATE " + nodeDataList[j]);
-                            if (!individualResult->isSuccess())
-                            {
-                                llvm::errs() << "Individual query also failed: " << individualResult->getErrorMessage() << "\n";
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // Bulk insert chunk succeeded
-                    }
+                    auto error = tryQuery(query);
+                    if (!error.empty())
+                        rejectRow("", query, error);
                 }
                 continue;
             }
-            else
-            {
-                // Multiple nodes - create bulk query
-                bulkQuery = "CREATE ";
-                for (size_t i = 0; i < nodeDataList.size(); ++i)
-                {
-                    if (i > 0) bulkQuery += ", ";
-                    
-                    // Fix variable name conflicts: replace "(n:" with unique variable name
-                    std::string nodeData = nodeDataList[i];
-                    std::string uniqueVar = "n" + std::to_string(i);
-                    
-                    // Replace "(n:" with "(nX:" where X is the index
-                    size_t varPos = nodeData.find("(n:");
-                    if (varPos != std::string::npos)
-                    {
-                        nodeData = nodeData.substr(0, varPos + 1) + uniqueVar + nodeData.substr(varPos + 2);
-                    }
-                    
-                    bulkQuery += nodeData;
-                }
-            }
-            
-            // Execute bulk query
-            auto result = connection->query(bulkQuery);
-            if (!result->isSuccess())
+
+            // Split into chunks of the size the table's inserts do best with
+            auto& chunk = getChunkRows(tableName);
+            const size_t chunkSize = chunk.get();
+            for (size_t i = 0; i < nodeDataList.size(); i += chunkSize)
             {
-                llvm::errs() << "Bulk query failed: " << result->getErrorMessage() << "\n";
-                // Fallback to individual queries
-                for (const auto& nodeData : nodeDataList)
+                size_t count = std::min(chunkSize, nodeDataList.size() - i);
+                auto started = std::chrono::steady_clock::now();
+                auto error = tryQuery(buildCreateQuery(nodeDataList, i, count));
+                if (!error.empty())
                 {
-                    auto individualResult = connection->query("CREATE " + nodeData);
-                    if (!individualResult->isSuccess())
-                    {
-                        llvm::errs() << "Individual query also failed: " << individualResult->getErrorMessage() << "\n";
-                        llvm::errs() << "Failed individual query: CREATE " << nodeData.substr(0, 150) << "...\n";
-                    }
+                    isolateFailedRows(
+                        tableName,
+                        i,
+                        count,
+                        error,
+                        [&](size_t first, size_t rows)
+                        { return tryQuery(buildCreateQuery(nodeDataList, first, rows)); },
+                        [&](size_t row) { return "CREATE " + nodeDataList[row]; });
+                    continue;
                 }
+
+                statistics.addBulkStatement(count);
+                if (count == chunkSize)
+                    chunk.record(chunkSize,
+                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
             }
-            // Bulk query succeeded
         }
     }
     catch (const std::exception& e)
     {
+        // Statements report their errors instead of throwing, so this is grouping running out of
+        // memory; the statements executed so far are committed, so nothing is run a second time
         llvm::errs() << "Exception in bulk query execution: " << e.what() << "\n";
-        // Fallback to original individual execution
-        for (const auto& query : pendingQueries)
+    }
+}
+
+auto KuzuDatabase::buildCreateQuery(const std::vector<std::string>& nodePatterns, size_t first, size_t count)
+    -> std::string
+{
+    std::string query = "CREATE ";
+    for (size_t i = first; i < first + count; ++i)
+    {
+        if (i > first)
+            query += ", ";
+
+        // Every pattern binds "n", so each gets a variable of its own: "(n:" becomes "(nX:" with X its index
+        const std::string& nodeData = nodePatterns[i];
+        size_t varPos = nodeData.find("(n:");
+        if (varPos == std::string::npos)
         {
-            try
-            {
-                auto result = connection->query(query);
-                if (!result->isSuccess())
-                {
-                    llvm::errs() << "Fallback query failed: " << result->getErrorMessage() << "\n";
-                }
-            }
-            catch (...) {}
+            query += nodeData;
+            continue;
         }
+        query.append(nodeData, 0, varPos + 2);
+        query += std::to_string(i);
+        query.append(nodeData, varPos + 2);
     }
+    return query;
 }
 
 void KuzuDatabase::parseAndGroupQueries(std::map<std::string, std::vector<std::string>>& groupedQueries)
@@ -454,6 +849,7 @@ void KuzuDatabase::executeOptimizedRelationships()
     if (pendingRelationships.empty())
         return;
 
+    PhaseTimer timer(StatisticsPhase::Relationships);
     try
     {
         // Group relationships by type for bulk operations
@@ -463,9 +859,39 @@ void KuzuDatabase::executeOptimizedRelationships()
         for (const auto& [fromId, toId, relType, properties] : pendingRelationships)
             groupedRelationships[relType].emplace_back(fromId, toId, properties);
 
-        // Execute each relationship type as a bulk operation
-        for (const auto& [relType, relationships] : groupedRelationships)
-            executeBulkRelationshipType(relType, relationships);
+        // Queries are built ahead on other threads, like node chunks, and executed in order after all nodes
+        std::deque<std::pair<decltype(groupedRelationships)::const_iterator, std::future<std::string>>> building;
+        auto next = groupedRelationships.cbegin();
+        auto startNextQuery = [&]()
+        {
+            if (next == groupedRelationships.cend())
+                return;
+            building.emplace_back(next,
+                                  std::async(std::launch::async,
+                                             [this, next]
+                                             {
+                                                 PhaseTimer buildTimer(StatisticsPhase::QueryBuild);
+                                                 return buildBulkRelationshipQuery(next->first, next->second);
+                                             }));
+            ++next;
+        };
+
+        while (building.size() < PARALLEL_CONVERSIONS && next != groupedRelationships.cend())
+            startNextQuery();
+        while (!building.empty())
+        {
+            auto [type, query] = std::move(building.front());
+            building.pop_front();
+            startNextQuery();
+            try
+            {
+                executeBulkRelationshipQuery(type->first, type->second, query.get());
+            }
+            catch (const std::exception& e)
+            {
+                isolateFailedRelationships(type->first, type->second, e.what());
+            }
+        }
     }
     catch (const std::exception& e)
     {
@@ -482,167 +908,455 @@ void KuzuDatabase::executeBulkRelationshipType(
 
     try
     {
-        // Get the correct node types for this relationship from schema
-        auto [fromNodeType, toNodeType] = getRelationshipNodeTypes(relationshipType);
-        
-        // Build bulk relationship creation query with correct schema
-        std::string bulkQuery = "UNWIND [";
-        
-        bool first = true;
-        for (const auto& [fromId, toId, properties] : relationships)
+        std::string bulkQuery;
         {
-            if (!first) bulkQuery += ", ";
-            first = false;
-            
-            bulkQuery += "{from_id: " + std::to_string(fromId) + 
-                        ", to_id: " + std::to_string(toId);
-            
-            // Add properties with correct type handling
-            for (const auto& [key, value] : properties)
-            {
-                if (isPropertyBoolean(relationshipType, key))
-                {
-                    // Handle boolean values without quotes
-                    std::string boolValue = (value == "true" || value == "1") ? "true" : "false";
-                    bulkQuery += ", " + key + ": " + boolValue;
-                }
-                else
-                {
-                    // Handle string values with quotes
-                    bulkQuery += ", " + key + ": '" + escapeString(value) + "'";
-                }
-            }
-            bulkQuery += "}";
+            PhaseTimer buildTimer(StatisticsPhase::QueryBuild);
+            bulkQuery = buildBulkRelationshipQuery(relationshipType, relationships);
         }
+        executeBulkRelationshipQuery(relationshipType, relationships, bulkQuery);
+    }
+    catch (const std::exception& e)
+    {
+        isolateFailedRelationships(relationshipType, relationships, e.what());
+    }
+}
+
+auto KuzuDatabase::buildBulkRelationshipQuery(
+    const std::string& relationshipType,
+    const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships)
+    -> std::string
+{
+    if (relationships.empty())
+        return {};
+
+    // The schema is consulted once for the whole statement, not per property of every row
+    RelationshipLayout layout = resolveRelationshipLayout(relationshipType, std::get<2>(relationships.front()));
+
+    // Build bulk relationship creation query with correct schema
+    std::string bulkQuery = "UNWIND [";
+    
+    bool first = true;
+    for (const auto& [fromId, toId, properties] : relationships)
+    {
+        if (!first) bulkQuery += ", ";
+        first = false;
         
-        bulkQuery += "] AS rel ";
-        
-        // Use correct node types from schema
-        bulkQuery += "MATCH (from:" + fromNodeType + " {node_id: rel.from_id}), ";
-        bulkQuery += "(to:" + toNodeType + " {node_id: rel.to_id}) ";
-        bulkQuery += "CREATE (from)-[:" + relationshipType;
+        bulkQuery += "{from_id: " + std::to_string(fromId) + 
+                    ", to_id: " + std::to_string(toId);
         
-        // Add property mapping if needed
-        if (!relationships.empty() && !std::get<2>(relationships[0]).empty())
+        // Add properties with correct type handling
+        size_t index = 0;
+        for (const auto& [key, value] : properties)
         {
-            bulkQuery += " {";
-            bool firstProp = true;
-            for (const auto& [key, _] : std::get<2>(relationships[0]))
-            {
-                if (!firstProp) bulkQuery += ", ";
-                firstProp = false;
-                bulkQuery += key + ": rel." + key;
-            }
-            bulkQuery += "}";
+            bulkQuery += ", ";
+            bulkQuery += key;
+            bulkQuery += ": ";
+            appendRelationshipProperty(bulkQuery, layout.getColumn(index++, key), value);
         }
-        
-        bulkQuery += "]->(to)";
-        
-        auto result = connection->query(bulkQuery);
-        if (!result->isSuccess())
+        bulkQuery += "}";
+    }
+    
+    bulkQuery += "] AS rel ";
+    
+    // Use correct node types from schema
+    bulkQuery += "MATCH (from:" + layout.fromNodeType + " {node_id: rel.from_id}), ";
+    bulkQuery += "(to:" + layout.toNodeType + " {node_id: rel.to_id}) ";
+    bulkQuery += "CREATE (from)-[:" + relationshipType;
+    
+    // Add property mapping if needed
+    if (!relationships.empty() && !std::get<2>(relationships[0]).empty())
+    {
+        bulkQuery += " {";
+        bool firstProp = true;
+        for (const auto& [key, _] : std::get<2>(relationships[0]))
         {
-            // Schema-aware fallback to individual queries
-            executeSchemaAwareFallbackRelationships(relationshipType, relationships);
+            if (!firstProp) bulkQuery += ", ";
+            firstProp = false;
+            bulkQuery += key + ": rel." + key;
         }
+        bulkQuery += "}";
     }
-    catch (const std::exception& e)
+    
+    bulkQuery += "]->(to)";
+    return bulkQuery;
+}
+
+void KuzuDatabase::executeBulkRelationshipQuery(
+    const std::string& relationshipType,
+    const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships,
+    const std::string& bulkQuery)
+{
+    auto error = tryQuery(bulkQuery);
+    if (!error.empty())
+        isolateFailedRelationships(relationshipType, relationships, error);
+    else
+        Statistics::getInstance().addBulkStatement(relationships.size());
+}
+
+void KuzuDatabase::isolateFailedRelationships(
+    const std::string& relationshipType,
+    const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships,
+    const std::string& error)
+{
+    isolateFailedRows(
+        relationshipType,
+        0,
+        relationships.size(),
+        error,
+        [&](size_t first, size_t count)
+        {
+            auto begin = relationships.begin() + static_cast<std::ptrdiff_t>(first);
+            std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>> part(
+                begin, begin + static_cast<std::ptrdiff_t>(count));
+            return tryQuery(buildBulkRelationshipQuery(relationshipType, part));
+        },
+        [&](size_t row) { return buildRelationshipQuery(relationshipType, relationships[row]); });
+}
+
+auto KuzuDatabase::buildRelationshipQuery(
+    const std::string& relationshipType,
+    const std::tuple<int64_t, int64_t, std::map<std::string, std::string>>& relationship) -> std::string
+{
+    const auto& [fromId, toId, properties] = relationship;
+    RelationshipLayout layout = resolveRelationshipLayout(relationshipType, properties);
+    std::string query = "MATCH (from:" + layout.fromNodeType + " {node_id: " + std::to_string(fromId) + "}), (to:" +
+                        layout.toNodeType + " {node_id: " + std::to_string(toId) + "}) " + "CREATE (from)-[:" +
+                        relationshipType;
+
+    if (!properties.empty())
     {
-        llvm::errs() << "Exception in bulk relationship creation: " << e.what() << "\n";
-        executeSchemaAwareFallbackRelationships(relationshipType, relationships);
+        query += " {";
+        size_t index = 0;
+        for (const auto& [key, value] : properties)
+        {
+            if (index > 0)
+                query += ", ";
+
+            query += key;
+            query += ": ";
+            appendRelationshipProperty(query, layout.getColumn(index++, key), value);
+        }
+        query += "}";
     }
+
+    query += "]->(to)";
+    return query;
 }
 
-void KuzuDatabase::executeFallbackRelationships(
-    const std::string& relationshipType,
-    const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships)
+void KuzuDatabase::isolateFailedRows(const std::string& table,
+                                     size_t first,
+                                     size_t count,
+                                     const std::string& error,
+                                     const RowRangeAttempt& attempt,
+                                     const std::function<std::string(size_t row)>& describe)
 {
-    // Fallback: execute individual optimized queries (still better than original MATCH...CREATE)
-    for (const auto& [fromId, toId, properties] : relationships)
+    auto& statistics = Statistics::getInstance();
+    statistics.addFallbackRows(count);
+
+    // Ranges known to fail, last to retry on top; a range is split until it holds a single row
+    struct Range
+    {
+        size_t first;
+        size_t count;
+        std::string error;
+    };
+    std::vector<Range> failing{{first, count, error}};
+    while (!failing.empty())
     {
-        std::string query = "MATCH (from:ASTNode {node_id: " + std::to_string(fromId) +
-                            "}), (to:ASTNode {node_id: " + std::to_string(toId) + "}) " +
-                            "CREATE (from)-[:" + relationshipType;
+        Range range = std::move(failing.back());
+        failing.pop_back();
+        if (range.count == 1)
+        {
+            rejectRow(table, describe(range.first), range.error);
+            continue;
+        }
 
-        if (!properties.empty())
+        // Both halves are retried even if the first one fails alone: rows can also fail together,
+        // such as two rows sharing a primary key
+        size_t half = range.count / 2;
+        std::vector<Range> stillFailing;
+        for (auto [partFirst, partCount] : {std::pair{range.first, half},
+                                            std::pair{range.first + half, range.count - half}})
         {
-            query += " {";
-            bool first = true;
-            for (const auto& [key, value] : properties)
+            statistics.addRetryStatement();
+            std::string partError;
+            try
             {
-                if (!first)
-                    query += ", ";
-                first = false;
-                query += key + ": '" + escapeString(value) + "'";
+                partError = attempt(partFirst, partCount);
             }
-            query += "}";
+            catch (const std::exception& e)
+            {
+                partError = e.what();
+            }
+
+            if (partError.empty())
+                statistics.addBulkStatement(partCount);
+            else
+                stillFailing.push_back({partFirst, partCount, std::move(partError)});
         }
+        // Pushed in reverse, so rows are rejected in their original order
+        for (auto it = stillFailing.rbegin(); it != stillFailing.rend(); ++it)
+            failing.push_back(std::move(*it));
+    }
+}
+
+void KuzuDatabase::rejectRow(const std::string& table, const std::string& statement, const std::string& error)
+{
+    ++rejectedRows;
+    Statistics::getInstance().addRejectedRows(1);
 
-        query += "]->(to)";
+    if (rejectFile.is_open())
+    {
+        auto toJson = [](const std::string& text)
+        { return llvm::json::isUTF8(text) ? text : llvm::json::fixUTF8(text); };
+
+        std::string line;
+        llvm::raw_string_ostream os(line);
+        llvm::json::OStream json(os);
+        json.object(
+            [&]
+            {
+                if (!table.empty())
+                    json.attribute("table", toJson(table));
+                json.attribute("error", toJson(error));
+                json.attribute("statement", toJson(statement));
+            });
+        rejectFile << line << '\n';
+        return;
+    }
+
+    if (rejectedRows <= REPORTED_REJECTS)
+    {
+        llvm::errs() << "Rejected " << (table.empty() ? std::string("query") : table + " row") << ": " << error
+                     << "\n  " << llvm::StringRef(statement).take_front(150) << "\n";
+    }
+    if (rejectedRows == REPORTED_REJECTS)
+        llvm::errs() << "Further rejected rows are only counted; --reject-file=<path> keeps all of them\n";
+}
+
+auto KuzuDatabase::setRejectFile(const std::string& path) -> bool
+{
+    rejectFile.open(path, std::ios::out | std::ios::trunc);
+    if (!rejectFile)
+    {
+        llvm::errs() << "Error: Cannot create reject file " << path << "\n";
+        return false;
+    }
+    rejectFilePath = path;
+    return true;
+}
 
+auto KuzuDatabase::tryQuery(const std::string& query) -> std::string
+{
+    try
+    {
         auto result = connection->query(query);
-        if (!result->isSuccess())
-            llvm::errs() << "Fallback relationship query failed: " << result->getErrorMessage() << "\n";
+        if (result->isSuccess())
+            return {};
+        auto error = result->getErrorMessage();
+        return error.empty() ? std::string("unknown error") : error;
+    }
+    catch (const std::exception& e)
+    {
+        return e.what();
     }
 }
 
-void KuzuDatabase::executeSchemaAwareFallbackRelationships(
-    const std::string& relationshipType,
-    const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships)
+auto KuzuDatabase::tryExecute(kuzu::main::PreparedStatement* statement,
+                              std::unordered_map<std::string, std::unique_ptr<kuzu::common::Value>> params)
+    -> std::string
 {
-    // Get the correct node types for this relationship from schema
-    auto [fromNodeType, toNodeType] = getRelationshipNodeTypes(relationshipType);
-    
-    // Execute individual queries with correct schema
-    for (const auto& [fromId, toId, properties] : relationships)
+    try
     {
-        std::string query = "MATCH (from:" + fromNodeType + " {node_id: " + std::to_string(fromId) +
-                            "}), (to:" + toNodeType + " {node_id: " + std::to_string(toId) + "}) " +
-                            "CREATE (from)-[:" + relationshipType;
+        auto result = connection->executeWithParams(statement, std::move(params));
+        if (result->isSuccess())
+            return {};
+        auto error = result->getErrorMessage();
+        return error.empty() ? std::string("unknown error") : error;
+    }
+    catch (const std::exception& e)
+    {
+        return e.what();
+    }
+}
+
+void KuzuDatabase::executeStagedBatch(PendingBatch batch)
+{
+    if (!connection)
+        return;
+
+    size_t nodeRows = 0;
+    for (const auto& buffer : batch.nodes)
+        nodeRows += buffer.getRowCount();
+    size_t operations = nodeRows + batch.queries.size() + batch.relationships.size();
+    if (operations == 0)
+        return;
+
+    TraceSpan span("executeStagedBatch", "database");
+
+    if (!transactionActive)
+        beginTransaction();
+
+    for (auto& buffer : batch.nodes)
+    {
+        pendingNodeRows += buffer.getRowCount();
+        if (!getNodeBuffer(buffer.getTable()).appendRows(buffer))
+            pendingNodes.push_back(std::move(buffer));
+    }
+    pendingQueries.insert(pendingQueries.end(),
+                          std::make_move_iterator(batch.queries.begin()),
+                          std::make_move_iterator(batch.queries.end()));
+    pendingRelationships.insert(pendingRelationships.end(),
+                                std::make_move_iterator(batch.relationships.begin()),
+                                std::make_move_iterator(batch.relationships.end()));
+    totalOperations += operations;
+    operationsSinceLastCommit += operations;
+
+    executeBatch();
+
+    if (operationsSinceLastCommit >= commitRows.get())
+        optimizeTransactionBoundaries();
+}
+
+void KuzuDatabase::setNodeIdShard(int64_t shard)
+{
+    if (shard < 0 || shard >= NODE_ID_SHARD_COUNT)
+        throw std::invalid_argument("Node ID shard out of range: " + std::to_string(shard));
 
-        if (!properties.empty())
+    nodeIdShard = shard;
+    nodeIdLimit = (shard + 1) * NODE_ID_SHARD_SIZE;
+    nextNodeId = (shard * NODE_ID_SHARD_SIZE) + 1;
+    blockNextId = blockEndId = 0;
+}
+
+auto KuzuDatabase::reserveNodeIds(int64_t count) -> int64_t
+{
+    int64_t first = 0;
+    if (count <= blockEndId - blockNextId)
+    {
+        first = blockNextId;
+        blockNextId += count;
+    }
+    else if (count >= NODE_ID_BLOCK_SIZE)
+    {
+        // Large requests (e.g. CFG blocks) get a block of their own and keep the current one
+        first = nodeIdSource->fetch_add(count, std::memory_order_relaxed);
+    }
+    else
+    {
+        // The rest of the current block is abandoned; IDs need to be unique, not dense
+        first = nodeIdSource->fetch_add(NODE_ID_BLOCK_SIZE, std::memory_order_relaxed);
+        blockNextId = first + count;
+        blockEndId = first + NODE_ID_BLOCK_SIZE;
+    }
+
+    if (first + count > nodeIdLimit)
+        throw std::runtime_error("Node ID space of the shard is exhausted");
+
+    // IDs of one file are mostly consecutive, so extending the last range keeps the list short
+    if (!fileNodeRanges.empty() && fileNodeRanges.back().second == first)
+        fileNodeRanges.back().second += count;
+    else
+        fileNodeRanges.emplace_back(first, first + count);
+    return first;
+}
+
+void KuzuDatabase::initializeNodeIdCounter()
+{
+    nodeIdTables.clear();
+    auto tables = connection->query("CALL show_tables() RETURN name, type");
+    if (!tables->isSuccess())
+    {
+        llvm::errs() << "Failed to list tables: " << tables->getErrorMessage() << "\n";
+        return;
+    }
+    while (tables->hasNext())
+    {
+        auto row = tables->getNext();
+        std::string name = row->getValue(0)->toString();
+        // Indexed files and source files outlive the nodes of any one translation unit
+        if (row->getValue(1)->toString() == "NODE" && name != "IndexedFile" && name != "SourceFile")
+            nodeIdTables.push_back(std::move(name));
+    }
+
+    // Only this shard's range counts: a merged database also holds the IDs of other shards
+    int64_t shardBase = nodeIdShard * NODE_ID_SHARD_SIZE;
+    std::atomic<int64_t> maxNodeId{shardBase};
+    std::atomic<size_t> nextTable{0};
+    auto scanTables = [&](kuzu::main::Connection& scanner)
+    {
+        for (size_t i = nextTable.fetch_add(1); i < nodeIdTables.size(); i = nextTable.fetch_add(1))
         {
-            query += " {";
-            bool first = true;
-            for (const auto& [key, value] : properties)
+            auto result = scanner.query("MATCH (n:" + nodeIdTables[i] + ") WHERE n.node_id >= " +
+                                        std::to_string(shardBase) + " AND n.node_id < " +
+                                        std::to_string(nodeIdLimit) + " RETURN max(n.node_id)");
+            if (!result->isSuccess() || !result->hasNext())
+                continue;
+            auto* value = result->getNext()->getValue(0);
+            if (value->isNull())
+                continue;
+            int64_t tableMax = value->getValue<int64_t>();
+            int64_t current = maxNodeId.load();
+            while (tableMax > current && !maxNodeId.compare_exchange_weak(current, tableMax))
             {
-                if (!first)
-                    query += ", ";
-                first = false;
-                
-                if (isPropertyBoolean(relationshipType, key))
-                {
-                    // Handle boolean values without quotes
-                    std::string boolValue = (value == "true" || value == "1") ? "true" : "false";
-                    query += key + ": " + boolValue;
-                }
-                else
-                {
-                    // Handle string values with quotes
-                    query += key + ": '" + escapeString(value) + "'";
-                }
             }
-            query += "}";
         }
+    };
 
-        query += "]->(to)";
+    // The scans only read committed data, so they run side by side on pooled connections
+    std::vector<std::thread> scanners;
+    std::vector<PooledConnection> borrowed;
+    while (borrowed.size() + 1 < nodeIdTables.size())
+    {
+        auto pooled = getPooledConnection();
+        if (!pooled)
+            break;
+        borrowed.push_back(std::move(pooled));
+    }
+    for (auto& pooled : borrowed)
+        scanners.emplace_back(scanTables, std::ref(*pooled.get()));
+    scanTables(*connection);
+    for (auto& scanner : scanners)
+        scanner.join();
+    nextNodeId = maxNodeId.load() + 1;
+}
 
-        auto result = connection->query(query);
-        if (!result->isSuccess())
+void KuzuDatabase::deleteNodeRanges(const NodeIdRanges& ranges)
+{
+    if (!connection || ranges.empty())
+        return;
+
+    flushOperations();
+
+    // Node IDs are unique across tables, so each table is filtered by the same ranges
+    constexpr size_t RANGES_PER_QUERY = 64;
+    for (size_t first = 0; first < ranges.size(); first += RANGES_PER_QUERY)
+    {
+        std::string condition;
+        for (size_t i = first; i < std::min(ranges.size(), first + RANGES_PER_QUERY); ++i)
         {
-            // Only log errors for debugging - some relationships might legitimately fail
-            // due to nodes not existing or schema mismatches in complex cases
-            // llvm::errs() << "Schema-aware relationship query failed: " << result->getErrorMessage() << "\n";
+            if (!condition.empty())
+                condition += " OR ";
+            condition += "(n.node_id >= " + std::to_string(ranges[i].first) +
+                         " AND n.node_id < " + std::to_string(ranges[i].second) + ")";
+        }
+
+        for (const auto& table : nodeIdTables)
+        {
+            auto result = connection->query("MATCH (n:" + table + ") WHERE " + condition + " DETACH DELETE n");
+            if (!result->isSuccess())
+                llvm::errs() << "Failed to delete nodes from " << table << ": " << result->getErrorMessage() << "\n";
         }
     }
 }
 
 void KuzuDatabase::flushOperations()
 {
-    if (!connection)
+    if (!isInitialized())
         return;
 
     // Execute any remaining batched operations
-    if (!pendingQueries.empty() || !pendingRelationships.empty())
+    if (pendingNodeRows > 0 || !pendingQueries.empty() || !pendingRelationships.empty())
         executeBatch();
 
     // Commit any active transaction
@@ -657,291 +1371,11 @@ void KuzuDatabase::createSchema()
 
     try
     {
-        // Create base ASTNode table
-        executeSchemaQuery("CREATE NODE TABLE ASTNode("
-                           "node_id INT64 PRIMARY KEY, "
-                           "node_type STRING, "
-                           "memory_address STRING, "
-                           "source_file STRING, "
-                           "start_line INT64, "
-                           "start_column INT64, "
-                           "end_line INT64, "
-                           "end_column INT64, "
-                           "is_implicit BOOLEAN, "
-                           "raw_text STRING)",
-                           "ASTNode");
-
-        // Create Declaration table
-        executeSchemaQuery("CREATE NODE TABLE Declaration("
-                           "node_id INT64 PRIMARY KEY, "
-                           "name STRING, "
-                           "qualified_name STRING, "
-                           "access_specifier STRING, "
-                           "storage_class STRING, "
-                           "is_definition BOOLEAN, "
-                           "namespace_context STRING)",
-                           "Declaration");
-
-        // Create Type table
-        executeSchemaQuery("CREATE NODE TABLE Type("
-                           "node_id INT64 PRIMARY KEY, "
-                           "type_name STRING, "
-                           "canonical_type STRING, "
-                           "size_bytes INT64, "
-                           "is_const BOOLEAN, "
-                           "is_volatile BOOLEAN, "
-                           "is_builtin BOOLEAN)",
-                           "Type");
-
-        // Create enhanced Statement table
-        executeSchemaQuery("CREATE NODE TABLE Statement("
-                           "node_id INT64 PRIMARY KEY, "
-                           "statement_kind STRING, "
-                           "has_side_effects BOOLEAN, "
-                           "is_compound BOOLEAN, "
-                           "control_flow_type STRING, "
-                           "condition_text STRING, "
-                           "is_constexpr BOOLEAN)",
-                           "Statement");
-
-        // Create enhanced Expression table
-        executeSchemaQuery("CREATE NODE TABLE Expression("
-                           "node_id INT64 PRIMARY KEY, "
-                           "expression_kind STRING, "
-                           "value_category STRING, "
-                           "literal_value STRING, "
-                           "operator_kind STRING, "
-                           "is_constexpr BOOLEAN, "
-                           "evaluation_result STRING, "
-                           "implicit_cast_kind STRING)",
-                           "Expression");
-
-        // Create Attribute table
-        executeSchemaQuery("CREATE NODE TABLE Attribute("
-                           "node_id INT64 PRIMARY KEY, "
-                           "attribute_kind STRING, "
-                           "attribute_value STRING)",
-                           "Attribute");
-
-        // Create TemplateParameter table for enhanced template system
-        executeSchemaQuery("CREATE NODE TABLE TemplateParameter("
-                           "node_id INT64 PRIMARY KEY, "
-                           "parameter_kind STRING, "
-                           "parameter_name STRING, "
-                           "has_default_argument BOOLEAN, "
-                           "default_argument_text STRING, "
-                           "is_parameter_pack BOOLEAN)",
-                           "TemplateParameter");
-
-        // Create UsingDeclaration table for namespace and using declarations
-        executeSchemaQuery("CREATE NODE TABLE UsingDeclaration("
-                           "node_id INT64 PRIMARY KEY, "
-                           "using_kind STRING, "
-                           "target_name STRING, "
-                           "introduces_name STRING, "
-                           "scope_impact STRING)",
-                           "UsingDeclaration");
-
-        // Create relationship tables
-        executeSchemaQuery("CREATE REL TABLE PARENT_OF("
-                           "FROM ASTNode TO ASTNode, "
-                           "child_index INT64, "
-                           "relationship_kind STRING)",
-                           "PARENT_OF");
-
-        executeSchemaQuery("CREATE REL TABLE HAS_TYPE("
-                           "FROM Declaration TO Type, "
-                           "type_role STRING)",
-                           "HAS_TYPE");
-
-        executeSchemaQuery("CREATE REL TABLE REFERENCES("
-                           "FROM ASTNode TO Declaration, "
-                           "reference_kind STRING, "
-                           "is_direct BOOLEAN)",
-                           "REFERENCES");
-
-        executeSchemaQuery("CREATE REL TABLE IN_SCOPE("
-                           "FROM ASTNode TO Declaration, "
-                           "scope_kind STRING)",
-                           "IN_SCOPE");
-
-        executeSchemaQuery("CREATE REL TABLE TEMPLATE_RELATION("
-                           "FROM ASTNode TO Declaration, "
-                           "relation_kind STRING, "
-                           "specialization_type STRING)",
-                           "TEMPLATE_RELATION");
-
-        // Inheritance relationship tables
-        executeSchemaQuery("CREATE REL TABLE INHERITS_FROM("
-                           "FROM Declaration TO Declaration, "
-                           "inheritance_type STRING, "
-                           "is_virtual BOOLEAN, "
-                           "base_access_path STRING)",
-                           "INHERITS_FROM");
-
-        executeSchemaQuery("CREATE REL TABLE OVERRIDES("
-                           "FROM Declaration TO Declaration, "
-                           "override_type STRING, "
-                           "is_covariant_return BOOLEAN)",
-                           "OVERRIDES");
-
-        // Enhanced template relationship table for detailed specializations
-        executeSchemaQuery("CREATE REL TABLE SPECIALIZES("
-                           "FROM Declaration TO Declaration, "
-                           "specialization_kind STRING, "
-                           "template_arguments STRING, "
-                           "instantiation_context STRING)",
-                           "SPECIALIZES");
-
-        // Preprocessor and Macro Information tables
-        executeSchemaQuery("CREATE NODE TABLE MacroDefinition("
-                           "node_id INT64 PRIMARY KEY, "
-                           "macro_name STRING, "
-                           "is_function_like BOOLEAN, "
-                           "parameter_count INT64, "
-                           "parameter_names STRING, "
-                           "replacement_text STRING, "
-                           "is_builtin BOOLEAN, "
-                           "is_conditional BOOLEAN)",
-                           "MacroDefinition");
-
-        executeSchemaQuery("CREATE NODE TABLE IncludeDirective("
-                           "node_id INT64 PRIMARY KEY, "
-                           "include_path STRING, "
-                           "is_system_include BOOLEAN, "
-                           "is_angled BOOLEAN, "
-                           "resolved_path STRING, "
-                           "include_depth INT64)",
-                           "IncludeDirective");
-
-        executeSchemaQuery("CREATE NODE TABLE ConditionalDirective("
-                           "node_id INT64 PRIMARY KEY, "
-                           "directive_type STRING, "
-                           "condition_text STRING, "
-                           "is_true_branch BOOLEAN, "
-                           "nesting_level INT64)",
-                           "ConditionalDirective");
-
-        executeSchemaQuery("CREATE NODE TABLE PragmaDirective("
-                           "node_id INT64 PRIMARY KEY, "
-                           "pragma_name STRING, "
-                           "pragma_text STRING, "
-                           "pragma_kind STRING)",
-                           "PragmaDirective");
-
-        // Create Comment table for documentation and comments
-        executeSchemaQuery("CREATE NODE TABLE Comment("
-                           "node_id INT64 PRIMARY KEY, "
-                           "comment_text STRING, "
-                           "comment_kind STRING, "
-                           "is_documentation BOOLEAN, "
-                           "brief_text STRING, "
-                           "detailed_text STRING)",
-                           "Comment");
-
-        // Create ConstantExpression table for compile-time evaluation tracking
-        executeSchemaQuery("CREATE NODE TABLE ConstantExpression("
-                           "node_id INT64 PRIMARY KEY, "
-                           "is_constexpr_function BOOLEAN, "
-                           "evaluation_context STRING, "
-                           "evaluation_result STRING, "
-                           "result_type STRING, "
-                           "is_compile_time_constant BOOLEAN, "
-                           "constant_value STRING, "
-                           "constant_type STRING, "
-                           "evaluation_status STRING)",
-                           "ConstantExpression");
-
-        // Create TemplateMetaprogramming table for template evaluation
-        executeSchemaQuery("CREATE NODE TABLE TemplateMetaprogramming("
-                           "node_id INT64 PRIMARY KEY, "
-                           "template_kind STRING, "
-                           "instantiation_depth INT64, "
-                           "template_arguments STRING, "
-                           "specialized_template_id INT64, "
-                           "metaprogram_result STRING, "
-                           "dependent_types STRING, "
-                           "substitution_failure_reason STRING)",
-                           "TemplateMetaprogramming");
-
-        // Create StaticAssertion table for static_assert tracking
-        executeSchemaQuery("CREATE NODE TABLE StaticAssertion("
-                           "node_id INT64 PRIMARY KEY, "
-                           "assertion_expression STRING, "
-                           "assertion_message STRING, "
-                           "assertion_result BOOLEAN, "
-                           "failure_reason STRING, "
-                           "evaluation_context STRING)",
-                           "StaticAssertion");
-
-        // Create CFGBlock table for control flow graph blocks
-        executeSchemaQuery("CREATE NODE TABLE CFGBlock("
-                           "node_id INT64 PRIMARY KEY, "
-                           "function_id INT64, "
-                           "block_index INT64, "
-                           "is_entry_block BOOLEAN, "
-                           "is_exit_block BOOLEAN, "
-                           "terminator_kind STRING, "
-                           "block_content STRING, "
-                           "condition_expression STRING, "
-                           "has_terminator BOOLEAN, "
-                           "reachable BOOLEAN)",
-                           "CFGBlock");
-
-        // Preprocessor relationships
-        executeSchemaQuery("CREATE REL TABLE MACRO_EXPANSION("
-                           "FROM ASTNode TO MacroDefinition, "
-                           "expansion_context STRING, "
-                           "expansion_arguments STRING)",
-                           "MACRO_EXPANSION");
-
-        executeSchemaQuery("CREATE REL TABLE INCLUDES("
-                           "FROM ASTNode TO IncludeDirective, "
-                           "include_order INT64)",
-                           "INCLUDES");
-
-        executeSchemaQuery("CREATE REL TABLE DEFINES("
-                           "FROM ASTNode TO MacroDefinition, "
-                           "definition_context STRING)",
-                           "DEFINES");
-
-        executeSchemaQuery("CREATE REL TABLE HAS_COMMENT("
-                           "FROM Declaration TO Comment, "
-                           "attachment_type STRING)",
-                           "HAS_COMMENT");
-
-        // Constant expression and compile-time evaluation relationships
-        executeSchemaQuery("CREATE REL TABLE HAS_CONSTANT_VALUE("
-                           "FROM Expression TO ConstantExpression, "
-                           "evaluation_stage STRING)",
-                           "HAS_CONSTANT_VALUE");
-
-        executeSchemaQuery("CREATE REL TABLE TEMPLATE_EVALUATES_TO("
-                           "FROM Declaration TO TemplateMetaprogramming, "
-                           "instantiation_context STRING)",
-                           "TEMPLATE_EVALUATES_TO");
-
-        executeSchemaQuery("CREATE REL TABLE CONTAINS_STATIC_ASSERT("
-                           "FROM Declaration TO StaticAssertion, "
-                           "assertion_scope STRING)",
-                           "CONTAINS_STATIC_ASSERT");
-
-        // Control Flow Graph relationships
-        executeSchemaQuery("CREATE REL TABLE CFG_EDGE("
-                           "FROM CFGBlock TO CFGBlock, "
-                           "edge_type STRING, "
-                           "condition STRING)",
-                           "CFG_EDGE");
-
-        executeSchemaQuery("CREATE REL TABLE CONTAINS_CFG("
-                           "FROM Declaration TO CFGBlock, "
-                           "cfg_role STRING)",
-                           "CONTAINS_CFG");
-
-        executeSchemaQuery("CREATE REL TABLE CFG_CONTAINS_STMT("
-                           "FROM CFGBlock TO Statement, "
-                           "statement_index INT64)",
-                           "CFG_CONTAINS_STMT");
+        for (const SchemaTable& table : SCHEMA_TABLES)
+        {
+            if (!table.isSummary)
+                executeSchemaQuery(buildCreateTableStatement(table, true), std::string(table.name));
+        }
     }
     catch (const std::exception& e)
     {
@@ -949,215 +1383,235 @@ void KuzuDatabase::createSchema()
     }
 }
 
-auto KuzuDatabase::escapeString(const std::string& str) -> std::string
+auto KuzuDatabase::escapeString(std::string_view str) -> std::string
+{
+    std::string escaped;
+    appendEscaped(escaped, str);
+    return escaped;
+}
+
+void KuzuDatabase::appendEscaped(std::string& query, std::string_view str)
 {
-    std::string escaped = str;
+    if (str.empty())
+        return;
 
-    // Escape backslashes first (for Windows paths)
-    std::string::size_type pos = 0;
-    while ((pos = escaped.find('\\', pos)) != std::string::npos)
+    // memchr is vectorized by the C runtime; almost no string holds either character,
+    // so the common case is two fast scans and one bulk append
+    const char* begin = str.data();
+    const char* end = begin + str.size();
+    bool hasBackslash = std::memchr(begin, '\\', str.size()) != nullptr;
+    bool hasQuote = std::memchr(begin, '\'', str.size()) != nullptr;
+    if (!hasBackslash && !hasQuote)
     {
-        escaped.replace(pos, 1, "\\\\");
-        pos += 2;  // Move past the escaped backslash
+        query.append(str);
+        return;
     }
 
-    // Escape single quotes
-    pos = 0;
-    while ((pos = escaped.find('\'', pos)) != std::string::npos)
+    // Backslashes (Windows paths) and single quotes are escaped with a backslash;
+    // the runs between them are appended in bulk
+    query.reserve(query.size() + str.size() + 16);
+    const char* run = begin;
+    for (const char* c = begin; c != end; ++c)
     {
-        escaped.replace(pos, 1, "\\'");
-        pos += 2;  // Move past the escaped quote
+        if (*c != '\\' && *c != '\'')
+            continue;
+        query.append(run, c);
+        query += '\\';
+        run = c;
     }
-
-    return escaped;
+    query.append(run, end);
 }
 
-void KuzuDatabase::enableCSVBulkMode(const std::string& directory)
+void KuzuDatabase::enableBulkLoad(const std::string& directory)
 {
-    csvBulkMode = true;
-    csvDirectory = directory;
-    pendingCSVNodes.clear();
-    csvFilesCreated.clear();
-    
-    // Create CSV directory if it doesn't exist
-    std::filesystem::create_directories(directory);
+    if (!connection || bulkLoader)
+        return;
+
+    // Every table this database writes is in the schema, so the COPY layouts need no table_info() queries
+    bulkLoader = std::make_unique<BulkLoader>(directory,
+                                              [this](const std::string& table)
+                                              {
+                                                  const SchemaTable* schema = findSchemaTable(table);
+                                                  if (schema == nullptr)
+                                                      return readTableColumns(*connection, table);
+                                                  std::vector<BulkLoader::TableColumn> columns;
+                                                  for (const SchemaColumn& column : schema->columns)
+                                                      columns.push_back({std::string(column.name),
+                                                                         std::string(getKuzuTypeName(column.type))});
+                                                  return columns;
+                                              });
 }
 
-void KuzuDatabase::disableCSVBulkMode()
+auto KuzuDatabase::finishBulkLoad() -> bool
 {
-    if (!csvBulkMode)
-        return;
-        
-    // Write any pending CSV nodes
-    for (const auto& [nodeType, nodes] : pendingCSVNodes)
+    if (!bulkLoader)
+        return true;
+
+    // Stage whatever is still buffered, then leave bulk mode so deferred queries execute normally
+    flushOperations();
+    auto loader = std::move(bulkLoader);
+
+    llvm::outs() << "Bulk loading " << loader->getNodeRowCount() << " nodes and " << loader->getRelationshipRowCount()
+                 << " relationships\n";
+    bool success = false;
     {
-        if (!nodes.empty())
-            writeNodesToCSV(nodeType, nodes);
+        PhaseTimer timer(StatisticsPhase::BulkImport);
+        success = loader->importInto(*connection);
     }
-    
-    // Import all CSV files
-    importCSVFiles();
-    
-    csvBulkMode = false;
-    pendingCSVNodes.clear();
-    csvFilesCreated.clear();
+
+    if (!deferredQueries.empty())
+    {
+        pendingQueries = std::move(deferredQueries);
+        deferredQueries.clear();
+        beginTransaction();
+        executeBulkQueries();
+        pendingQueries.clear();
+        commitTransaction();
+    }
+
+    return success;
 }
 
-void KuzuDatabase::writeNodesToCSV(const std::string& nodeType, const std::vector<std::map<std::string, std::string>>& nodes)
+void KuzuDatabase::stageBatchForBulkLoad()
 {
-    if (nodes.empty())
+    for (const auto& buffer : pendingNodes)
+        bulkLoader->writeNodes(buffer);
+    bulkLoader->writeRelationships(pendingRelationships);
+    deferredQueries.insert(deferredQueries.end(),
+                           std::make_move_iterator(pendingQueries.begin()),
+                           std::make_move_iterator(pendingQueries.end()));
+
+    clearNodeBuffers();
+    pendingQueries.clear();
+    pendingRelationships.clear();
+}
+
+void KuzuDatabase::enableArrowExport(const std::string& directory)
+{
+    if (!connection || arrowExporter)
         return;
-        
-    std::string csvFile = csvDirectory + "/" + nodeType + ".csv";
-    bool fileExists = csvFilesCreated.find(csvFile) != csvFilesCreated.end();
-    
-    std::ofstream file(csvFile, fileExists ? std::ios::app : std::ios::out);
-    if (!file.is_open())
-    {
-        llvm::errs() << "Failed to open CSV file: " << csvFile << "\n";
+    arrowExporter = std::make_unique<ArrowExporter>(directory);
+}
+
+auto KuzuDatabase::finishArrowExport() -> bool
+{
+    if (!arrowExporter)
+        return true;
+
+    flushOperations();
+    auto exporter = std::move(arrowExporter);
+    bool success = exporter->finish();
+    llvm::outs() << "Exported " << exporter->getNodeRowCount() << " nodes and " << exporter->getRelationshipRowCount()
+                 << " relationships to " << exporter->getDirectory() << "\n";
+    if (droppedQueries > 0)
+        llvm::outs() << "Arrow export: " << droppedQueries << " free-form queries were not exported\n";
+    droppedQueries = 0;
+    return success;
+}
+
+void KuzuDatabase::exportBatch()
+{
+    for (const auto& buffer : pendingNodes)
+        arrowExporter->writeNodes(buffer);
+    arrowExporter->writeRelationships(pendingRelationships);
+    droppedQueries += pendingQueries.size();
+
+    clearNodeBuffers();
+    pendingQueries.clear();
+    pendingRelationships.clear();
+}
+
+void KuzuDatabase::recordBatchStatistics() const
+{
+    auto& statistics = Statistics::getInstance();
+    if (!statistics.isEnabled())
         return;
-    }
-    
-    // Write header if new file
-    if (!fileExists)
+
+    for (const auto& buffer : pendingNodes)
+        statistics.addNodeRows(buffer.getTable(), buffer.getRowCount());
+
+    std::map<std::string, size_t> relationshipRows;
+    for (const auto& relationship : pendingRelationships)
+        relationshipRows[std::get<2>(relationship)]++;
+    for (const auto& [relationshipType, rows] : relationshipRows)
+        statistics.addRelationshipRows(relationshipType, rows);
+}
+
+auto KuzuDatabase::readTableColumns(kuzu::main::Connection& connection, const std::string& table)
+    -> std::vector<BulkLoader::TableColumn>
+{
+    std::vector<BulkLoader::TableColumn> columns;
+    auto result = connection.query("CALL table_info('" + escapeString(table) + "') RETURN *");
+    if (!result->isSuccess())
     {
-        // Get column names from first node
-        bool first = true;
-        for (const auto& [key, _] : nodes[0])
-        {
-            if (!first) file << ",";
-            first = false;
-            file << key;
-        }
-        file << "\n";
-        csvFilesCreated.insert(csvFile);
+        llvm::errs() << "Failed to read columns of " << table << ": " << result->getErrorMessage() << "\n";
+        return columns;
     }
-    
-    // Write data rows
-    for (const auto& node : nodes)
+
+    auto names = result->getColumnNames();
+    auto nameIndex = std::ranges::find(names, "name") - names.begin();
+    auto typeIndex = std::ranges::find(names, "type") - names.begin();
+    if (nameIndex == static_cast<std::ptrdiff_t>(names.size()) ||
+        typeIndex == static_cast<std::ptrdiff_t>(names.size()))
+        return columns;
+
+    while (result->hasNext())
     {
-        bool first = true;
-        for (const auto& [_, value] : node)
-        {
-            if (!first) file << ",";
-            first = false;
-            
-            // Quote strings that contain commas or quotes
-            if (value.find(',') != std::string::npos || value.find('"') != std::string::npos)
-            {
-                file << "\"";
-                // Escape quotes by doubling them
-                for (char c : value)
-                {
-                    if (c == '"') file << "\"\"";
-                    else file << c;
-                }
-                file << "\"";
-            }
-            else
-            {
-                file << value;
-            }
-        }
-        file << "\n";
+        auto row = result->getNext();
+        columns.push_back({row->getValue(nameIndex)->toString(), row->getValue(typeIndex)->toString()});
     }
-    
-    file.close();
+    return columns;
 }
 
-void KuzuDatabase::importCSVFiles()
+auto KuzuDatabase::RelationshipLayout::getColumn(size_t index, const std::string& name) const
+    -> const SchemaColumn*
 {
-    if (!connection || csvFilesCreated.empty())
-        return;
-        
-    try
-    {
-        beginTransaction();
-        
-        for (const auto& csvFile : csvFilesCreated)
-        {
-            // Extract table name from file path
-            std::filesystem::path filePath(csvFile);
-            std::string tableName = filePath.stem().string();
-            
-            // Use COPY FROM for bulk import
-            std::string copyQuery = "COPY " + tableName + " FROM '" + csvFile + "' (HEADER=true)";
-            
-            auto result = connection->query(copyQuery);
-            if (!result->isSuccess())
-            {
-                llvm::errs() << "CSV import failed for " << csvFile << ": " << result->getErrorMessage() << "\n";
-            }
-            else
-            {
-                llvm::outs() << "Successfully imported " << csvFile << " into " << tableName << "\n";
-            }
-        }
-        
-        commitTransaction();
-        
-        // Clean up CSV files after successful import
-        for (const auto& csvFile : csvFilesCreated)
-        {
-            std::filesystem::remove(csvFile);
-        }
-    }
-    catch (const std::exception& e)
-    {
-        llvm::errs() << "Exception during CSV import: " << e.what() << "\n";
-        rollbackTransaction();
-    }
-}
-
-void KuzuDatabase::initializeRelationshipSchemaInfo()
-{
-    // Map relationship types to their FROM/TO node types
-    relationshipNodeTypes = {
-        {"PARENT_OF", {"ASTNode", "ASTNode"}},
-        {"HAS_TYPE", {"Declaration", "Type"}},
-        {"REFERENCES", {"ASTNode", "Declaration"}},
-        {"IN_SCOPE", {"ASTNode", "Declaration"}},
-        {"TEMPLATE_RELATION", {"ASTNode", "Declaration"}},
-        {"INHERITS_FROM", {"Declaration", "Declaration"}},
-        {"OVERRIDES", {"Declaration", "Declaration"}},
-        {"SPECIALIZES", {"Declaration", "Declaration"}},
-        {"MACRO_EXPANSION", {"ASTNode", "MacroDefinition"}},
-        {"INCLUDES", {"ASTNode", "IncludeDirective"}},
-        {"DEFINES", {"ASTNode", "MacroDefinition"}},
-        {"HAS_COMMENT", {"Declaration", "Comment"}},
-        {"HAS_CONSTANT_VALUE", {"Expression", "ConstantExpression"}},
-        {"TEMPLATE_EVALUATES_TO", {"Declaration", "TemplateMetaprogramming"}},
-        {"CONTAINS_STATIC_ASSERT", {"Declaration", "StaticAssertion"}},
-        {"CFG_EDGE", {"CFGBlock", "CFGBlock"}},
-        {"CONTAINS_CFG", {"Declaration", "CFGBlock"}},
-        {"CFG_CONTAINS_STMT", {"CFGBlock", "Statement"}}
-    };
-    
-    // Map relationship types to their boolean properties
-    relationshipBooleanProperties = {
-        {"REFERENCES", {"is_direct"}},
-        {"INHERITS_FROM", {"is_virtual"}},
-        {"OVERRIDES", {"is_covariant_return"}},
-        {"CFGBlock", {"is_entry_block", "is_exit_block", "has_terminator", "reachable"}}  // For node properties
-    };
+    if (index < columns.size() && columns[index] != nullptr && columns[index]->name == name)
+        return columns[index];
+    return schema != nullptr ? schema->findColumn(name) : nullptr;
 }
 
-std::pair<std::string, std::string> KuzuDatabase::getRelationshipNodeTypes(const std::string& relationshipType)
+auto KuzuDatabase::resolveRelationshipLayout(const std::string& relationshipType,
+                                             const std::map<std::string, std::string>& properties)
+    -> RelationshipLayout
 {
-    auto it = relationshipNodeTypes.find(relationshipType);
-    if (it != relationshipNodeTypes.end())
-        return it->second;
-    
-    // Default to ASTNode for unknown relationships
-    return {"ASTNode", "ASTNode"};
+    RelationshipLayout layout;
+    const SchemaTable* table = findSchemaTable(relationshipType);
+    if (table == nullptr || !table->isRelationship())
+        return layout;
+
+    layout.fromNodeType = table->from;
+    layout.toNodeType = table->to;
+    layout.schema = table;
+    layout.columns.reserve(properties.size());
+    for (const auto& [key, _] : properties)
+        layout.columns.push_back(table->findColumn(key));
+    return layout;
 }
 
-bool KuzuDatabase::isPropertyBoolean(const std::string& relationshipType, const std::string& propertyName)
+void KuzuDatabase::appendRelationshipProperty(std::string& query, const SchemaColumn* column, const std::string& value)
 {
-    auto it = relationshipBooleanProperties.find(relationshipType);
-    if (it != relationshipBooleanProperties.end())
-        return it->second.count(propertyName) > 0;
-    return false;
+    if (column != nullptr && column->type == ColumnBuffer::ColumnType::Bool)
+    {
+        query += (value == "true" || value == "1") ? "true" : "false";
+        return;
+    }
+
+    if (column != nullptr && column->type == ColumnBuffer::ColumnType::Int64)
+    {
+        // Only a plain integer may be spliced into the query unquoted
+        size_t digitsStart = (!value.empty() && value[0] == '-') ? 1 : 0;
+        bool isInteger = value.size() > digitsStart &&
+                         std::all_of(value.begin() + static_cast<std::ptrdiff_t>(digitsStart),
+                                     value.end(),
+                                     [](unsigned char c) { return std::isdigit(c) != 0; });
+        query += isInteger ? std::string_view(value) : std::string_view("null");
+        return;
+    }
+
+    query += '\'';
+    appendEscaped(query, value);
+    query += '\'';
 }
 
 void KuzuDatabase::initializeConnectionPool()
@@ -1183,24 +1637,24 @@ void KuzuDatabase::initializeConnectionPool()
     }
 }
 
-auto KuzuDatabase::getPooledConnection() -> kuzu::main::Connection*
+auto KuzuDatabase::getPooledConnection() -> PooledConnection
 {
     std::lock_guard<std::mutex> lock(connectionPoolMutex);
+    if (connectionPool.empty())
+        return {};
 
-    if (!connectionPool.empty())
-    {
-        // Get a connection from the pool
-        auto conn = connectionPool.front().get();
-        connectionPool.pop();
+    PooledConnection pooled(*this, std::move(connectionPool.front()));
+    connectionPool.pop();
+    return pooled;
+}
 
-        // Return the connection to the pool after use (this is simplified - in a real implementation
-        // you'd want a RAII wrapper to automatically return the connection)
-        connectionPool.push(std::unique_ptr<kuzu::main::Connection>(conn));
-        return conn;
-    }
+void KuzuDatabase::PooledConnection::release()
+{
+    if (owner == nullptr || connection == nullptr)
+        return;
 
-    // Fallback to main connection if pool is empty
-    return connection.get();
+    std::lock_guard<std::mutex> lock(owner->connectionPoolMutex);
+    owner->connectionPool.push(std::move(connection));
 }
 
 void KuzuDatabase::optimizeTransactionBoundaries()
@@ -1213,11 +1667,16 @@ void KuzuDatabase::optimizeTransactionBoundaries()
         // Commit current transaction and immediately start a new one for better performance
         if (transactionActive)
         {
+            // Throughput counts the database time of the whole transaction, not the traversal in between
+            auto started = std::chrono::steady_clock::now();
+            double batchSeconds = transactionSeconds;
             commitTransaction();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            commitRows.record(operationsSinceLastCommit, batchSeconds + seconds);
             operationsSinceLastCommit = 0;
 
             // Immediately start a new transaction if we have pending operations
-            if (!pendingQueries.empty() || !pendingRelationships.empty())
+            if (pendingNodeRows > 0 || !pendingQueries.empty() || !pendingRelationships.empty())
                 beginTransaction();
         }
     }
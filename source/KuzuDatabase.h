@@ -6,12 +6,22 @@
 
 #pragma once
 
+#include "AdaptiveSize.h"
+#include "ArrowExporter.h"
+#include "BulkLoader.h"
+#include "ColumnBuffer.h"
+#include "Schema.h"
+
 // clang-format off
 #include "NoWarningScope_Enter.h"
 #include "kuzu.hpp"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -19,6 +29,8 @@
 #include <set>
 #include <string>
 #include <tuple>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace clang
@@ -28,6 +40,30 @@ namespace clang
 class KuzuDatabase
 {
 public:
+    /// Queries and relationships buffered between two flushes
+    struct PendingBatch
+    {
+        std::vector<ColumnBuffer> nodes;
+        std::vector<std::string> queries;
+        std::vector<std::tuple<int64_t, int64_t, std::string, std::map<std::string, std::string>>> relationships;
+    };
+
+    /// Receives full batches from a staging database
+    using BatchSink = std::function<void(PendingBatch&&)>;
+
+    /// Half-open node ID ranges [first, second)
+    using NodeIdRanges = std::vector<std::pair<int64_t, int64_t>>;
+
+    /// Bounds within which batch and transaction sizes follow the measured throughput
+    /// Equal bounds fix a size.
+    struct BatchLimits
+    {
+        size_t minBatchRows = 100;  // Operations buffered before a flush, also the UNWIND chunk size per table
+        size_t maxBatchRows = 20000;
+        size_t minCommitRows = 1000;  // Operations per transaction
+        size_t maxCommitRows = 500000;
+    };
+
     /// Constructor - initializes database at given path
     /// \param databasePath Path to the Kuzu database
     explicit KuzuDatabase(std::string databasePath);
@@ -35,6 +71,19 @@ public:
     /// Destructor - ensures proper cleanup
     ~KuzuDatabase();
 
+    /// Create a staging database for an indexing worker thread
+    /// A staging instance owns no connection. It buffers queries exactly like a
+    /// connected database and hands every full batch to \p sink instead of executing
+    /// it. Node IDs are drawn from \p writer so they stay unique across all workers.
+    /// \param writer The connected database that will eventually execute the batches
+    /// \param sink Callback receiving each full batch
+    static auto createStaging(KuzuDatabase& writer, BatchSink sink) -> std::unique_ptr<KuzuDatabase>;
+
+    /// Set the bounds of the adaptive batch and transaction sizes, restarting their tuning
+    /// Staging instances created from this database follow its batch size.
+    /// \param limits The bounds
+    void setBatchLimits(const BatchLimits& limits);
+
     /// Initialize database connection and create schema
     void initialize();
 
@@ -56,6 +105,14 @@ public:
     /// \param query The query to add to the batch
     void addToBatch(const std::string& query);
 
+    /// Append a node row to the typed column buffer of its table
+    /// Rows are flushed per table with one prepared UNWIND statement whose rows are
+    /// bound as a parameter, so values need no escaping and are never turned into
+    /// Cypher text.
+    /// \param table Node table name (e.g., "ASTNode", "Declaration")
+    /// \param cells Column values for the new node, including node_id, in the same order for every row
+    void addNodeToBatch(std::string_view table, std::initializer_list<ColumnBuffer::Cell> cells);
+
     /// Add optimized relationship creation to batch
     /// \param fromNodeId Source node ID
     /// \param toNodeId Target node ID
@@ -81,55 +138,260 @@ public:
     /// Optimize transaction boundaries based on operation count
     void optimizeTransactionBoundaries();
 
+    /// Execute a batch handed over by a staging database
+    /// Must only be called from the thread that owns this connection.
+    /// \param batch The batch to execute
+    void executeStagedBatch(PendingBatch batch);
+
     /// Get the database connection for direct access
     [[nodiscard]] auto getConnection() const -> kuzu::main::Connection* { return connection.get(); }
 
-    /// Check if database is properly initialized
-    [[nodiscard]] auto isInitialized() const -> bool { return connection != nullptr; }
-
-    /// Get a connection from the pool (for advanced usage)
-    [[nodiscard]] auto getPooledConnection() -> kuzu::main::Connection*;
+    /// Check if database is properly initialized (connected, or staging for a writer)
+    [[nodiscard]] auto isInitialized() const -> bool { return connection != nullptr || batchSink != nullptr; }
+
+    /// Check if this instance forwards its batches instead of executing them
+    [[nodiscard]] auto isStaging() const -> bool { return batchSink != nullptr; }
+
+    /// A connection borrowed from the pool, given back when the object goes away
+    /// Kuzu runs one write transaction at a time, so pooled connections are for
+    /// reading while the main connection holds the write transaction.
+    class PooledConnection
+    {
+    public:
+        PooledConnection() = default;
+        PooledConnection(KuzuDatabase& owner, std::unique_ptr<kuzu::main::Connection> connection)
+            : owner(&owner), connection(std::move(connection))
+        {
+        }
+        ~PooledConnection() { release(); }
+
+        PooledConnection(PooledConnection&& other) noexcept = default;
+        auto operator=(PooledConnection&& other) noexcept -> PooledConnection&
+        {
+            if (this != &other)
+            {
+                release();
+                owner = other.owner;
+                connection = std::move(other.connection);
+            }
+            return *this;
+        }
+        PooledConnection(const PooledConnection&) = delete;
+        auto operator=(const PooledConnection&) -> PooledConnection& = delete;
+
+        [[nodiscard]] auto get() const -> kuzu::main::Connection* { return connection.get(); }
+        auto operator->() const -> kuzu::main::Connection* { return connection.get(); }
+        explicit operator bool() const { return connection != nullptr; }
+
+    private:
+        void release();
+
+        KuzuDatabase* owner = nullptr;
+        std::unique_ptr<kuzu::main::Connection> connection;
+    };
+
+    /// Borrow a connection from the pool
+    /// \return The connection, or an empty object if all are borrowed or this instance stages
+    [[nodiscard]] auto getPooledConnection() -> PooledConnection;
+
+    /// Number of node IDs in each shard's ID space
+    static constexpr int64_t NODE_ID_SHARD_SIZE = int64_t{1} << 40;
+
+    /// Number of shards the node ID space is divided into
+    static constexpr int64_t NODE_ID_SHARD_COUNT = std::numeric_limits<int64_t>::max() / NODE_ID_SHARD_SIZE;
+
+    /// Allocate node IDs from a shard's private ID space
+    /// Separate processes indexing into separate databases that are merged later
+    /// each use a different shard, so their IDs never collide. Must be called
+    /// before initialize(); the default is shard 0.
+    /// \param shard Shard index in [0, NODE_ID_SHARD_COUNT)
+    void setNodeIdShard(int64_t shard);
 
     /// Get the next available node ID
     /// \return A unique node ID for this database instance
-    auto getNextNodeId() -> int64_t { return nextNodeId++; }
+    auto getNextNodeId() -> int64_t { return reserveNodeIds(1); }
+
+    /// Reserve a block of consecutive node IDs
+    /// IDs come from a block owned by this instance, refilled from the shared counter
+    /// with one atomic add, so workers neither contend nor interleave their IDs.
+    /// \param count Number of IDs to reserve
+    /// \return The first ID of the block
+    auto reserveNodeIds(int64_t count) -> int64_t;
+
+    /// Start attributing allocated node IDs to a new file
+    void beginFile() { fileNodeRanges.clear(); }
+
+    /// Get the node IDs allocated since the last beginFile()
+    [[nodiscard]] auto getFileNodeRanges() const -> const NodeIdRanges& { return fileNodeRanges; }
+
+    /// Delete every node whose ID lies in one of the ranges, with its relationships
+    /// \param ranges Node IDs to delete, as recorded by getFileNodeRanges()
+    void deleteNodeRanges(const NodeIdRanges& ranges);
 
     /// Escape string for safe use in Kuzu queries
     /// \param str The string to escape
     /// \return Escaped string safe for Kuzu query usage
-    static auto escapeString(const std::string& str) -> std::string;
-    
-    /// Enable CSV bulk import mode for very large datasets
-    /// When enabled, nodes are written to CSV files for bulk loading
-    void enableCSVBulkMode(const std::string& csvDirectory);
-    
-    /// Disable CSV bulk mode and import any pending CSV files
-    void disableCSVBulkMode();
-    
-    /// Write nodes to CSV for bulk import
-    void writeNodesToCSV(const std::string& nodeType, const std::vector<std::map<std::string, std::string>>& nodes);
+    static auto escapeString(std::string_view str) -> std::string;
+
+    /// Append a string to a query, escaped for use inside a single-quoted literal
+    /// \param query The query being built
+    /// \param str The string to escape
+    static void appendEscaped(std::string& query, std::string_view str);
     
-    /// Import CSV files using COPY FROM
-    void importCSVFiles();
+    /// Stage all node and relationship rows in per-table CSV files instead of inserting them
+    /// Free-form queries added with addToBatch() are deferred until finishBulkLoad(),
+    /// since they may match nodes that only exist once the files are loaded.
+    /// \param directory Directory for the staging files
+    void enableBulkLoad(const std::string& directory);
+
+    /// COPY all staged files into the database, then run the deferred queries
+    /// Does nothing unless enableBulkLoad() was called.
+    /// \return True if every COPY succeeded
+    auto finishBulkLoad() -> bool;
+
+    /// Check if rows are currently staged for a bulk load
+    [[nodiscard]] auto isBulkLoading() const -> bool { return bulkLoader != nullptr; }
+
+    /// Write all node and relationship rows as Arrow IPC files instead of inserting them
+    /// The database only provides the node ID counter. Free-form queries added with
+    /// addToBatch() are dropped, since they describe rows the database never receives.
+    /// \param directory Directory for the Arrow files
+    void enableArrowExport(const std::string& directory);
+
+    /// Write the footers of the Arrow files and close them
+    /// Does nothing unless enableArrowExport() was called.
+    /// \return True if every file was written completely
+    auto finishArrowExport() -> bool;
+
+    /// Write every row that fails to insert even on its own to a file, as one JSON object per line
+    /// Each object holds the table (absent for free-form queries), Kuzu's error and a Cypher
+    /// statement inserting just that row. Without a reject file the first rejected rows are
+    /// reported on stderr and the rest are only counted.
+    /// \param path Path of the reject file, truncated if it exists
+    /// \return False, after reporting the error, if the file cannot be created
+    auto setRejectFile(const std::string& path) -> bool;
+
+    /// Number of rows rejected so far, see setRejectFile()
+    [[nodiscard]] auto getRejectedRowCount() const -> size_t { return rejectedRows; }
+
+    /// Check if the database held no AST nodes when it was opened
+    /// A fresh database gains nothing from inserting row by row: no lookup during
+    /// indexing depends on rows already stored, so everything can be bulk loaded.
+    [[nodiscard]] auto isFresh() const -> bool { return fresh; }
+
+    /// Query the property columns of a table, in declaration order
+    /// For relationship tables the FROM/TO endpoints are not included.
+    /// \param connection Connection to the database holding the table
+    /// \param table Table name
+    /// \return The columns, or an empty list if the table is unknown
+    static auto readTableColumns(kuzu::main::Connection& connection, const std::string& table)
+        -> std::vector<BulkLoader::TableColumn>;
 
 private:
+    /// Staging constructor - see createStaging()
+    KuzuDatabase(BatchSink sink,
+                 std::atomic<int64_t>& nodeIdSource,
+                 int64_t nodeIdLimit,
+                 std::atomic<size_t>& batchRowSource);
+
+    /// Check whether enough operations are buffered to flush them
+    [[nodiscard]] auto isBatchFull(size_t pending) const -> bool
+    {
+        return pending >= batchRowSource->load(std::memory_order_relaxed);
+    }
+
+    /// Get the adaptive UNWIND chunk size of a table, creating it on first use
+    auto getChunkRows(const std::string& table) -> AdaptiveSize&;
+
+    /// Estimate the bytes held by the pending rows, queries and relationships
+    [[nodiscard]] auto getPendingBytes() const -> size_t;
+
+    /// Report getPendingBytes() to the MemoryMonitor
+    void accountPendingBytes();
+
+    /// After a flush: shed buffer capacity, the open transaction and batch size if over --max-memory
+    void checkMemoryBudget();
+
     /// Create the complete database schema
     void createSchema();
 
+    /// Find the node tables and seed the ID counter past the highest ID stored in this shard
+    void initializeNodeIdCounter();
+
+    /// Get the column buffer for a table, creating it on first use
+    auto getNodeBuffer(std::string_view table) -> ColumnBuffer&;
+
+    /// Check the first row of a node table against its schema description
+    /// Later rows are checked against the first one by the ColumnBuffer.
+    /// \return False, after reporting the mismatch, if a cell names an unknown column or has the wrong type
+    static auto matchesSchema(std::string_view table, std::initializer_list<ColumnBuffer::Cell> cells) -> bool;
+
+    /// Flush all pending node buffers, one UNWIND per buffer
+    void executeNodeBuffers();
+
+    /// Insert the rows of a buffer one at a time, used when the UNWIND insert cannot be prepared
+    void executeNodeRowsIndividually(const ColumnBuffer& buffer, size_t first, size_t count);
+
+    /// Drop all pending node rows
+    void clearNodeBuffers();
+
+    /// Get the cached prepared node insert for a buffer's table and columns, preparing it on first use
+    /// \param buffer Buffer whose table and column names define the statement
+    /// \param unwind True for the multi-row UNWIND form, false for a single-row CREATE
+    /// \return The prepared statement, or nullptr if Kuzu rejected it
+    auto getNodeInsertStatement(const ColumnBuffer& buffer, bool unwind) -> kuzu::main::PreparedStatement*;
+
+    /// Build the CREATE statement inserting one row of a buffer, for the reject file
+    static auto buildNodeRowQuery(const ColumnBuffer& buffer, size_t row) -> std::string;
+
+    /// Convert one buffer cell into a Kuzu parameter value
+    static auto toKuzuValue(const ColumnBuffer& buffer, size_t column, size_t row)
+        -> std::unique_ptr<kuzu::common::Value>;
+
+    /// Convert a range of rows of a buffer into a LIST(STRUCT) parameter value
+    static auto toKuzuRows(const ColumnBuffer& buffer, size_t first, size_t count)
+        -> std::unique_ptr<kuzu::common::Value>;
+
     /// Execute bulk queries for nodes (true bulk operations)
     void executeBulkQueries();
     
     /// Parse and group CREATE queries for bulk execution
     void parseAndGroupQueries(std::map<std::string, std::vector<std::string>>& groupedQueries);
 
-    /// Get schema information for relationship types
-    void initializeRelationshipSchemaInfo();
-    
-    /// Get the correct node types for a relationship
-    std::pair<std::string, std::string> getRelationshipNodeTypes(const std::string& relationshipType);
-    
-    /// Check if a property should be treated as boolean
-    bool isPropertyBoolean(const std::string& relationshipType, const std::string& propertyName);
+    /// Build one CREATE statement from a range of node patterns grouped by parseAndGroupQueries()
+    /// \param nodePatterns Patterns of one table, each binding its node to "n"
+    /// \param first First pattern of the statement
+    /// \param count Number of patterns in the statement
+    static auto buildCreateQuery(const std::vector<std::string>& nodePatterns, size_t first, size_t count)
+        -> std::string;
+
+    /// Endpoint node tables and property columns of a relationship type, looked up once per statement
+    struct RelationshipLayout
+    {
+        std::string fromNodeType = "ASTNode";  // Unknown relationships connect ASTNodes
+        std::string toNodeType = "ASTNode";
+        const SchemaTable* schema = nullptr;
+        std::vector<const SchemaColumn*> columns;  // Per property of the first row, in key order
+
+        /// Get the column of a row's property
+        /// Rows of one statement share their keys, so this is one comparison with the
+        /// first row's key in the same position; other rows fall back to a column search.
+        /// \param index Position of the property in the row's map
+        /// \param name Name of the property
+        /// \return The column, or null if the schema has none of that name
+        [[nodiscard]] auto getColumn(size_t index, const std::string& name) const -> const SchemaColumn*;
+    };
+
+    /// Look up a relationship type in the schema
+    /// \param relationshipType The relationship type
+    /// \param properties Properties of the statement's first row
+    static auto resolveRelationshipLayout(const std::string& relationshipType,
+                                          const std::map<std::string, std::string>& properties)
+        -> RelationshipLayout;
+
+    /// Append a relationship property value to a query as a Cypher literal of the property's type
+    /// \param column Column of the property; null for a property the schema lacks, written as a string
+    static void appendRelationshipProperty(std::string& query, const SchemaColumn* column, const std::string& value);
 
     /// Execute optimized relationship queries in bulk
     void executeOptimizedRelationships();
@@ -139,15 +401,71 @@ private:
         const std::string& relationshipType,
         const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships);
 
-    /// Fallback method for individual relationship creation if bulk fails
-    void executeFallbackRelationships(
+    /// Build the UNWIND query creating all relationships of one type
+    /// Only reads the schema tables, so it may run on another thread than the connection.
+    auto buildBulkRelationshipQuery(
         const std::string& relationshipType,
-        const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships);
-        
-    /// Schema-aware fallback method for individual relationship creation
-    void executeSchemaAwareFallbackRelationships(
+        const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships)
+        -> std::string;
+
+    /// Execute a query built by buildBulkRelationshipQuery(), isolating the failing relationships if it fails
+    void executeBulkRelationshipQuery(
         const std::string& relationshipType,
-        const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships);
+        const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships,
+        const std::string& bulkQuery);
+
+    /// Retry the relationships of a failed bulk query with isolateFailedRows()
+    /// \param error Error of the failed query
+    void isolateFailedRelationships(
+        const std::string& relationshipType,
+        const std::vector<std::tuple<int64_t, int64_t, std::map<std::string, std::string>>>& relationships,
+        const std::string& error);
+
+    /// Build the MATCH ... CREATE statement inserting one relationship, for the reject file
+    auto buildRelationshipQuery(const std::string& relationshipType,
+                                const std::tuple<int64_t, int64_t, std::map<std::string, std::string>>& relationship)
+        -> std::string;
+
+    /// Executes rows [first, first + count) of a failed bulk statement as one statement
+    /// \return Empty on success, otherwise the error
+    using RowRangeAttempt = std::function<std::string(size_t first, size_t count)>;
+
+    /// Find the rows that make a bulk statement fail by retrying each half of it as one statement
+    /// Halves that fail again are split again, so one bad row costs about 2 log2(count) statements
+    /// instead of one per row, and rows that fail on their own are passed to rejectRow().
+    /// \param table Table of the rows, empty for free-form queries
+    /// \param first First row of the failed statement
+    /// \param count Rows of the failed statement
+    /// \param error Error of the failed statement
+    /// \param attempt Executes a range of the rows as one statement
+    /// \param describe Builds the statement inserting one row, for the reject file
+    void isolateFailedRows(const std::string& table,
+                           size_t first,
+                           size_t count,
+                           const std::string& error,
+                           const RowRangeAttempt& attempt,
+                           const std::function<std::string(size_t row)>& describe);
+
+    /// Count a row that failed on its own and write it to the reject file, or report it
+    void rejectRow(const std::string& table, const std::string& statement, const std::string& error);
+
+    /// Run a statement on the connection
+    /// \return Empty on success, otherwise Kuzu's error or the exception's message
+    auto tryQuery(const std::string& query) -> std::string;
+
+    /// Run a prepared statement on the connection
+    /// \return Empty on success, otherwise Kuzu's error or the exception's message
+    auto tryExecute(kuzu::main::PreparedStatement* statement,
+                    std::unordered_map<std::string, std::unique_ptr<kuzu::common::Value>> params) -> std::string;
+
+    /// Write the current batch to the bulk load files instead of executing it
+    void stageBatchForBulkLoad();
+
+    /// Write the current batch to the Arrow files instead of executing it
+    void exportBatch();
+
+    /// Count the rows of the current batch per table for --stats
+    void recordBatchStatistics() const;
 
     /// Initialize connection pool for better performance
     void initializeConnectionPool();
@@ -161,10 +479,28 @@ private:
     std::queue<std::unique_ptr<kuzu::main::Connection>> connectionPool;
     std::mutex connectionPoolMutex;
 
-    // Performance optimization - batching (increased for better bulk performance)
-    static constexpr size_t BATCH_SIZE = 500;                     // Process this many operations per batch (increased for bulk ops)
-    static constexpr size_t TRANSACTION_COMMIT_THRESHOLD = 5000;  // Auto-commit after this many operations (increased for less overhead)
+    // Chunks or relationship types converted to Kuzu parameters or queries ahead of the one executing
+    static constexpr size_t PARALLEL_CONVERSIONS = 4;
+
+    // Batch and transaction sizes start here and then follow the measured throughput
+    static constexpr size_t DEFAULT_BATCH_ROWS = 500;
+    static constexpr size_t DEFAULT_COMMIT_ROWS = 5000;
+    BatchLimits batchLimits;
+    AdaptiveSize batchRows{DEFAULT_BATCH_ROWS, batchLimits.minBatchRows, batchLimits.maxBatchRows};
+    AdaptiveSize commitRows{DEFAULT_COMMIT_ROWS, batchLimits.minCommitRows, batchLimits.maxCommitRows};
+    std::unordered_map<std::string, AdaptiveSize> chunkRows;  // Per table
+
+    // Flush threshold; staging instances read their writer's, which workers share
+    std::atomic<size_t> batchRowTarget{DEFAULT_BATCH_ROWS};
+    std::atomic<size_t>* batchRowSource = &batchRowTarget;
+    double transactionSeconds = 0;  // Time spent executing batches of the open transaction
+    size_t accountedPendingBytes = 0;  // Reported to the MemoryMonitor
     std::vector<std::string> pendingQueries;
+    std::vector<ColumnBuffer> pendingNodes;  // One buffer per table, plus any staged buffer whose columns differ
+    size_t pendingNodeRows = 0;
+
+    // Prepared node inserts keyed by form, table and column list
+    std::unordered_map<std::string, std::unique_ptr<kuzu::main::PreparedStatement>> preparedNodeInserts;
 
     // Relationship batching support (currently unused)
     std::vector<std::tuple<int64_t, int64_t, std::string, std::map<std::string, std::string>>> pendingRelationships;
@@ -173,18 +509,40 @@ private:
     size_t totalOperations = 0;
     size_t operationsSinceLastCommit = 0;
 
-    // Global node ID counter for uniqueness across all files
-    int64_t nextNodeId = 1;
+    // Global node ID counter for uniqueness across all files; staging instances
+    // allocate from their writer's counter instead of their own
+    std::atomic<int64_t> nextNodeId{1};
+    std::atomic<int64_t>* nodeIdSource = &nextNodeId;
+    int64_t nodeIdShard = 0;
+    int64_t nodeIdLimit = NODE_ID_SHARD_SIZE;  // End of the shard's ID space, shared with staging instances
+
+    // Node IDs claimed from the counter but not handed out yet: [blockNextId, blockEndId)
+    static constexpr int64_t NODE_ID_BLOCK_SIZE = 4096;
+    int64_t blockNextId = 0;
+    int64_t blockEndId = 0;
+
+    // Node IDs allocated for the file being indexed, and the tables keyed by node_id
+    NodeIdRanges fileNodeRanges;
+    std::vector<std::string> nodeIdTables;
+
+    // Set for staging instances: full batches go here instead of to a connection
+    BatchSink batchSink;
     
-    // CSV bulk import mode
-    bool csvBulkMode = false;
-    std::string csvDirectory;
-    std::map<std::string, std::vector<std::map<std::string, std::string>>> pendingCSVNodes;
-    std::set<std::string> csvFilesCreated;
+    // Bulk load mode: rows go to CSV files, free-form queries wait for the COPY
+    std::unique_ptr<BulkLoader> bulkLoader;
+    bool fresh = false;
+    std::vector<std::string> deferredQueries;
+
+    // Arrow export mode: rows go to Arrow IPC files and never reach the database
+    std::unique_ptr<ArrowExporter> arrowExporter;
+    size_t droppedQueries = 0;
+
+    // Rows that failed on their own; without a reject file only the first ones are reported
+    static constexpr size_t REPORTED_REJECTS = 10;
+    std::ofstream rejectFile;
+    std::string rejectFilePath;
+    size_t rejectedRows = 0;
     
-    // Relationship schema information
-    std::map<std::string, std::pair<std::string, std::string>> relationshipNodeTypes;
-    std::map<std::string, std::set<std::string>> relationshipBooleanProperties;
 };
 
 }  // namespace clang
@@ -7,6 +7,9 @@
 
 #include "KuzuDump.h"
 
+#include "IncrementalIndex.h"
+#include "MemoryMonitor.h"
+
 // clang-format off
 #include "NoWarningScope_Enter.h"
 #include "clang/AST/DeclCXX.h"
@@ -16,12 +19,6 @@
 
 using namespace clang;
 
-KuzuDump::KuzuDump(raw_ostream& OS, ASTContext& Context, bool ShowColors)
-    : nullStream(nullptr), NodeDumper(OS, Context, ShowColors), OS(OS), database(nullptr)
-{
-    initializeAnalyzers(Context);
-}
-
 KuzuDump::KuzuDump(std::string databasePath, ASTContext& Context, bool ShowColors)
     : nullStream(std::make_unique<llvm::raw_null_ostream>()), NodeDumper(*nullStream, Context, ShowColors),
       OS(*nullStream)
@@ -58,15 +55,29 @@ void KuzuDump::initializeAnalyzers(ASTContext& Context)
         return;
     }
 
-    // Initialize all analyzers
-    nodeProcessor = std::make_unique<ASTNodeProcessor>(*database, Context);
-    scopeManager = std::make_unique<ScopeManager>(*database);
-    typeAnalyzer = std::make_unique<TypeAnalyzer>(*database, *nodeProcessor, Context);
-    declarationAnalyzer = std::make_unique<DeclarationAnalyzer>(*database);
-    statementAnalyzer = std::make_unique<StatementAnalyzer>(*database, *nodeProcessor, Context);
-    templateAnalyzer = std::make_unique<TemplateAnalyzer>(*database, *nodeProcessor, Context);
-    commentProcessor = std::make_unique<CommentProcessor>(*database, *nodeProcessor, Context);
-    advancedAnalyzer = std::make_unique<AdvancedAnalyzer>(*database, *nodeProcessor, Context);
+    // Initialize the analyzers the run's profile selects; over --max-memory only the required ones
+    const auto& options = GlobalDatabaseManager::getInstance().getAnalysisOptions();
+    const auto& profile = options.profile;
+    bool optional = !MemoryMonitor::getInstance().areOptionalAnalyzersDisabled();
+    auto& arena = TranslationUnitArena::forThread();
+    nodeProcessor = arena.create<ASTNodeProcessor>(*database, Context);
+    scopeManager = arena.create<ScopeManager>(*database);
+    declarationAnalyzer = arena.create<DeclarationAnalyzer>(*database);
+    constantEvaluator = arena.create<ConstantEvaluator>(Context, options.constants);
+    if (profile.types)
+        typeAnalyzer = arena.create<TypeAnalyzer>(*database, *nodeProcessor, Context);
+    if (profile.statements)
+        statementAnalyzer = arena.create<StatementAnalyzer>(*database, *nodeProcessor, *constantEvaluator);
+    if (profile.templates && optional)
+        templateAnalyzer = arena.create<TemplateAnalyzer>(*database, *nodeProcessor, Context);
+    if (profile.comments && optional)
+        commentProcessor = arena.create<CommentProcessor>(*database, *nodeProcessor, Context);
+    if (profile.advanced && optional)
+        advancedAnalyzer = arena.create<AdvancedAnalyzer>(*database, *nodeProcessor, *constantEvaluator, Context);
+    if (profile.calls)
+        callGraphAnalyzer = arena.create<CallGraphAnalyzer>(*database, *nodeProcessor, *declarationAnalyzer, Context);
+    traverseStatements = profile.statements;
+    instantiationBodies = options.instantiationBodies;
 }
 
 
@@ -88,27 +99,36 @@ void KuzuDump::VisitFunctionDecl(const FunctionDecl* D)
     if (D == nullptr)
         return;
 
+    // Overrides resolve virtual calls even when the method itself was emitted by an earlier translation unit
+    if (callGraphAnalyzer)
+        callGraphAnalyzer->noteMethod(dyn_cast<CXXMethodDecl>(D));
+
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create declaration node using declaration analyzer
     if (const auto* namedDecl = dyn_cast<NamedDecl>(D))
         declarationAnalyzer->createDeclarationNode(nodeId, namedDecl);
 
+    if (callGraphAnalyzer)
+        callGraphAnalyzer->analyzeFunction(D, nodeId);
+
     // Create type relationship using type analyzer
-    typeAnalyzer->createTypeNodeAndRelation(nodeId, D->getType());
+    if (typeAnalyzer)
+        typeAnalyzer->createTypeNodeAndRelation(nodeId, D->getType());
 
     // Process comments using comment processor
-    commentProcessor->processComments(D, nodeId);
+    if (commentProcessor)
+        commentProcessor->processComments(D, nodeId);
 
     // Handle template functions using template analyzer
-    if (D->isFunctionTemplateSpecialization())
+    if (templateAnalyzer && D->isFunctionTemplateSpecialization())
         templateAnalyzer->processTemplateSpecialization(nodeId, D);
 
     // Handle constexpr functions using advanced analyzer
-    if (advancedAnalyzer->detectConstexprFunction(D))
+    if (advancedAnalyzer && advancedAnalyzer->detectConstexprFunction(D))
     {
         // Create constant expression analysis for constexpr functions
         if (D->hasBody())
@@ -120,10 +140,6 @@ void KuzuDump::VisitFunctionDecl(const FunctionDecl* D)
         }
     }
 
-    // Analyze CFG for function body using advanced analyzer
-    if (D->hasBody())
-        advancedAnalyzer->analyzeCFGForFunction(D, nodeId);
-
     // Manage scope relationships
     scopeManager->createScopeRelationships(nodeId);
 
@@ -138,7 +154,17 @@ void KuzuDump::VisitFunctionDecl(const FunctionDecl* D)
         NodeDumper.Visit(D);
 
     // Continue recursive traversal for child nodes (always needed for database)
-    ASTNodeTraverser<KuzuDump, TextNodeDumper>::VisitFunctionDecl(D);
+    if (traverseStatements)
+        ASTNodeTraverser<KuzuDump, TextNodeDumper>::VisitFunctionDecl(D);
+    else
+    {
+        for (const ParmVarDecl* param : D->parameters())
+            Visit(param);
+    }
+
+    // After the body, so compact CFGs can refer to the node IDs of its statements
+    if (advancedAnalyzer && D->hasBody())
+        advancedAnalyzer->analyzeCFGForFunction(D, nodeId);
 
     // Pop function scope and parent
     scopeManager->popParent();
@@ -152,14 +178,15 @@ void KuzuDump::VisitVarDecl(const VarDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create declaration node using declaration analyzer
     declarationAnalyzer->createDeclarationNode(nodeId, D);
 
     // Create type relationship using type analyzer
-    typeAnalyzer->createTypeNodeAndRelation(nodeId, D->getType());
+    if (typeAnalyzer)
+        typeAnalyzer->createTypeNodeAndRelation(nodeId, D->getType());
 
     // Manage scope relationships
     scopeManager->createScopeRelationships(nodeId);
@@ -169,7 +196,8 @@ void KuzuDump::VisitVarDecl(const VarDecl* D)
         NodeDumper.Visit(D);
 
     // Continue recursive traversal for child nodes (needed for initializer expressions)
-    ASTNodeTraverser<KuzuDump, TextNodeDumper>::VisitVarDecl(D);
+    if (traverseStatements)
+        ASTNodeTraverser<KuzuDump, TextNodeDumper>::VisitVarDecl(D);
 
     // Note: In full implementation, would also:
     // - Process variable initializers
@@ -185,7 +213,7 @@ void KuzuDump::VisitNamespaceDecl(const NamespaceDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create declaration node using declaration analyzer
@@ -219,7 +247,7 @@ void KuzuDump::VisitUsingDecl(const UsingDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create using declaration node using declaration analyzer
@@ -240,7 +268,7 @@ void KuzuDump::VisitUsingDirectiveDecl(const UsingDirectiveDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create using directive node using declaration analyzer
@@ -272,7 +300,7 @@ void KuzuDump::VisitNamespaceAliasDecl(const NamespaceAliasDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create namespace alias node using declaration analyzer
@@ -304,7 +332,7 @@ void KuzuDump::VisitCXXRecordDecl(const CXXRecordDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create declaration node using declaration analyzer
@@ -380,15 +408,25 @@ void KuzuDump::VisitClassTemplateDecl(const ClassTemplateDecl* D)
     int64_t nodeId = nodeProcessor->createASTNode(D);
     if (nodeId == -1)
         return;
+    if (nodeProcessor->isDeduplicated(D))
+    {
+        // Instantiations only this translation unit creates are new rows even when the template is not
+        scopeManager->pushScope(nodeId);
+        visitImplicitInstantiations(D);
+        scopeManager->popScope();
+        return;
+    }
 
     // Create declaration node using declaration analyzer
     declarationAnalyzer->createDeclarationNode(nodeId, D);
 
     // Process template using template analyzer
-    templateAnalyzer->processTemplateDecl(nodeId, D);
+    if (templateAnalyzer)
+        templateAnalyzer->processTemplateDecl(nodeId, D);
 
     // Process comments
-    commentProcessor->processComments(D, nodeId);
+    if (commentProcessor)
+        commentProcessor->processComments(D, nodeId);
 
     // Create scope relationships
     scopeManager->createScopeRelationships(nodeId);
@@ -400,6 +438,8 @@ void KuzuDump::VisitClassTemplateDecl(const ClassTemplateDecl* D)
     if (!databaseOnlyMode)
         NodeDumper.Visit(D);
 
+    visitImplicitInstantiations(D);
+
     // Pop template scope
     scopeManager->popScope();
 }
@@ -413,15 +453,23 @@ void KuzuDump::VisitFunctionTemplateDecl(const FunctionTemplateDecl* D)
     int64_t nodeId = nodeProcessor->createASTNode(D);
     if (nodeId == -1)
         return;
+    if (nodeProcessor->isDeduplicated(D))
+    {
+        // Instantiations only this translation unit creates are new rows even when the template is not
+        visitImplicitInstantiations(D);
+        return;
+    }
 
     // Create declaration node using declaration analyzer
     declarationAnalyzer->createDeclarationNode(nodeId, D);
 
     // Process template using template analyzer
-    templateAnalyzer->processTemplateDecl(nodeId, D);
+    if (templateAnalyzer)
+        templateAnalyzer->processTemplateDecl(nodeId, D);
 
     // Process comments
-    commentProcessor->processComments(D, nodeId);
+    if (commentProcessor)
+        commentProcessor->processComments(D, nodeId);
 
     // Create scope relationships
     scopeManager->createScopeRelationships(nodeId);
@@ -429,6 +477,42 @@ void KuzuDump::VisitFunctionTemplateDecl(const FunctionTemplateDecl* D)
     // Standard AST traversal
     if (!databaseOnlyMode)
         NodeDumper.Visit(D);
+
+    // Instantiations are scoped like the template: in its enclosing scope
+    visitImplicitInstantiations(D);
+}
+
+template <typename TemplateDeclType> void KuzuDump::visitImplicitInstantiations(const TemplateDeclType* D)
+{
+    // Without the template analyzer there is no SPECIALIZES edge to summarize an instantiation with
+    if (!templateAnalyzer || database == nullptr)
+        return;
+
+    // Redeclarations share one specialization list; walking it from the canonical declaration only,
+    // as RecursiveASTVisitor does, emits each instantiation once
+    if (!D->isCanonicalDecl())
+        return;
+
+    for (const auto* specialization : D->specializations())
+    {
+        // Explicit specializations and instantiations are written in the source and visited there
+        auto kind = specialization->getTemplateSpecializationKind();
+        if (kind != TSK_ImplicitInstantiation && kind != TSK_Undeclared)
+            continue;
+
+        if (instantiationBodies)
+        {
+            Visit(specialization);
+            continue;
+        }
+
+        int64_t nodeId = nodeProcessor->createASTNode(specialization);
+        if (nodeId == -1 || nodeProcessor->isDeduplicated(specialization))
+            continue;
+        declarationAnalyzer->createDeclarationNode(nodeId, specialization);
+        templateAnalyzer->processTemplateSpecialization(nodeId, specialization);
+        scopeManager->createScopeRelationships(nodeId);
+    }
 }
 
 void KuzuDump::VisitClassTemplateSpecializationDecl(const ClassTemplateSpecializationDecl* D)
@@ -438,17 +522,19 @@ void KuzuDump::VisitClassTemplateSpecializationDecl(const ClassTemplateSpecializ
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create declaration node using declaration analyzer
     declarationAnalyzer->createDeclarationNode(nodeId, D);
 
     // Process template specialization using template analyzer
-    templateAnalyzer->processTemplateSpecialization(nodeId, D);
+    if (templateAnalyzer)
+        templateAnalyzer->processTemplateSpecialization(nodeId, D);
 
     // Process comments
-    commentProcessor->processComments(D, nodeId);
+    if (commentProcessor)
+        commentProcessor->processComments(D, nodeId);
 
     // Create scope relationships
     scopeManager->createScopeRelationships(nodeId);
@@ -471,14 +557,15 @@ void KuzuDump::VisitStaticAssertDecl(const StaticAssertDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // StaticAssertDecl is a Decl but not a NamedDecl, so we skip declaration analyzer
     // and go straight to advanced analyzer for static assertion processing
 
     // Process static assertion using advanced analyzer
-    advancedAnalyzer->createStaticAssertionNode(nodeId, D);
+    if (advancedAnalyzer)
+        advancedAnalyzer->createStaticAssertionNode(nodeId, D);
 
     // Create scope relationships
     scopeManager->createScopeRelationships(nodeId);
@@ -495,7 +582,7 @@ void KuzuDump::VisitTranslationUnitDecl(const TranslationUnitDecl* D)
 
     // Create AST node using node processor
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // TranslationUnitDecl is not a NamedDecl, so we skip the declaration analyzer
@@ -521,9 +608,90 @@ void KuzuDump::VisitTranslationUnitDecl(const TranslationUnitDecl* D)
     scopeManager->popScope();
 }
 
+void KuzuDump::dumpTranslationUnit(const TranslationUnitDecl* D, bool skipIndexedHeaders)
+{
+    if (!skipIndexedHeaders || database == nullptr)
+        Visit(D);
+    else
+    {
+        // Creates the translation unit node; its top-level declarations are walked here
+        // instead of by the traverser, so whole header namespaces can be left out
+        VisitTranslationUnitDecl(D);
+        for (const Decl* child : D->noload_decls())
+        {
+            if (!isInIndexedHeader(child))
+                Visit(child);
+            else
+                visitSkippedInstantiations(child);
+        }
+
+        registerIndexedHeaders(D->getASTContext().getSourceManager());
+    }
+
+    if (commentProcessor)
+        commentProcessor->finish();
+    if (callGraphAnalyzer)
+        callGraphAnalyzer->finish();
+}
+
+void KuzuDump::visitSkippedInstantiations(const Decl* D)
+{
+    // The templates themselves resolve to their earlier nodes, so only this unit's instantiations are written
+    if (const auto* classTemplate = dyn_cast<ClassTemplateDecl>(D))
+        VisitClassTemplateDecl(classTemplate);
+    else if (const auto* functionTemplate = dyn_cast<FunctionTemplateDecl>(D))
+        VisitFunctionTemplateDecl(functionTemplate);
+    else if (isa<NamespaceDecl, LinkageSpecDecl, ExportDecl>(D) ||
+             (isa<CXXRecordDecl>(D) && !cast<CXXRecordDecl>(D)->isDependentContext()))
+    {
+        for (const Decl* child : cast<DeclContext>(D)->noload_decls())
+            visitSkippedInstantiations(child);
+    }
+}
+
+auto KuzuDump::isInIndexedHeader(const Decl* D) -> bool
+{
+    const SourceManager& sourceManager = D->getASTContext().getSourceManager();
+    SourceLocation loc = sourceManager.getExpansionLoc(D->getLocation());
+    if (loc.isInvalid() || sourceManager.isInMainFile(loc))
+        return false;
+
+    FileID fileId = sourceManager.getFileID(loc);
+    auto [it, inserted] = indexedHeaderCache.try_emplace(fileId, false);
+    if (!inserted)
+        return it->second;
+
+    OptionalFileEntryRef file = sourceManager.getFileEntryRefForID(fileId);
+    std::optional<llvm::StringRef> contents = sourceManager.getBufferDataOrNone(fileId);
+    if (file && contents)
+        it->second = GlobalDatabaseManager::getInstance().isHeaderIndexed(getHeaderKey(*file, *contents));
+    return it->second;
+}
+
+void KuzuDump::registerIndexedHeaders(const SourceManager& sourceManager)
+{
+    auto& dbManager = GlobalDatabaseManager::getInstance();
+    OptionalFileEntryRef mainFile = sourceManager.getFileEntryRefForID(sourceManager.getMainFileID());
+    for (auto it = sourceManager.fileinfo_begin(); it != sourceManager.fileinfo_end(); ++it)
+    {
+        if (mainFile && it->first == *mainFile)
+            continue;
+        if (auto buffer = it->second->getBufferIfLoaded())
+            dbManager.registerIndexedHeader(getHeaderKey(it->first, buffer->getBuffer()));
+    }
+}
+
+auto KuzuDump::getHeaderKey(FileEntryRef file, llvm::StringRef contents) -> std::string
+{
+    llvm::StringRef name = file.getFileEntry().tryGetRealPathName();
+    if (name.empty())
+        name = file.getName();
+    return IncrementalIndex::normalizePath(name) + "@" + IncrementalIndex::hashContents(contents);
+}
+
 void KuzuDump::VisitStmt(const Stmt* S)
 {
-    if (S == nullptr)
+    if (S == nullptr || !statementAnalyzer)
         return;
 
     // Create AST node using node processor
@@ -553,7 +721,7 @@ void KuzuDump::VisitStmt(const Stmt* S)
 
 void KuzuDump::VisitReturnStmt(const ReturnStmt* S)
 {
-    if (S == nullptr)
+    if (S == nullptr || !statementAnalyzer)
         return;
 
     // Create AST node using node processor
@@ -583,7 +751,7 @@ void KuzuDump::VisitReturnStmt(const ReturnStmt* S)
 
 void KuzuDump::VisitExpr(const Expr* E)
 {
-    if (E == nullptr)
+    if (E == nullptr || !statementAnalyzer)
         return;
 
     // Create AST node using node processor
@@ -595,7 +763,7 @@ void KuzuDump::VisitExpr(const Expr* E)
     statementAnalyzer->createExpressionNode(nodeId, E);
 
     // Analyze constant expressions using advanced analyzer
-    if (statementAnalyzer->isExpressionConstexpr(E))
+    if (advancedAnalyzer && statementAnalyzer->isExpressionConstexpr(E))
         advancedAnalyzer->createConstantExpressionNode(nodeId, E, false, "expression_evaluation");
 
     // Create hierarchy relationships
@@ -622,7 +790,7 @@ void KuzuDump::processDeclaration(const Decl* D)
 
     // Create basic AST node
     int64_t nodeId = nodeProcessor->createASTNode(D);
-    if (nodeId == -1)
+    if (nodeId == -1 || nodeProcessor->isDeduplicated(D))
         return;
 
     // Create hierarchy relationships
@@ -634,6 +802,8 @@ void KuzuDump::processDeclaration(const Decl* D)
         declarationAnalyzer->createDeclarationNode(nodeId, namedDecl);
 
         // Create type relationships for typed declarations
+        if (!typeAnalyzer)
+            return;
         if (const auto* valueDecl = dyn_cast<ValueDecl>(namedDecl))
             typeAnalyzer->createTypeNodeAndRelation(nodeId, valueDecl->getType());
         else if (const auto* functionDecl = dyn_cast<FunctionDecl>(namedDecl))
@@ -648,7 +818,7 @@ void KuzuDump::processDeclaration(const Decl* D)
 
 void KuzuDump::processStatement(const Stmt* S)
 {
-    if ((S == nullptr) || !database->isInitialized())
+    if ((S == nullptr) || !statementAnalyzer || !database->isInitialized())
         return;
 
     // Create basic AST node
@@ -10,13 +10,16 @@
 // Include the new modular components
 #include "ASTNodeProcessor.h"
 #include "AdvancedAnalyzer.h"
+#include "CallGraphAnalyzer.h"
 #include "CommentProcessor.h"
+#include "ConstantEvaluator.h"
 #include "DeclarationAnalyzer.h"
 #include "GlobalDatabaseManager.h"
 #include "KuzuDatabase.h"
 #include "ScopeManager.h"
 #include "StatementAnalyzer.h"
 #include "TemplateAnalyzer.h"
+#include "TranslationUnitArena.h"
 #include "TypeAnalyzer.h"
 
 // clang-format off
@@ -24,6 +27,7 @@
 #include "clang/AST/ASTNodeTraverser.h"
 #include "clang/AST/TextNodeDumper.h"
 #include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
@@ -44,21 +48,31 @@ private:
     raw_ostream& OS;
     bool databaseOnlyMode = false;
 
-    // Modular components - each handles a specific responsibility
+    // Modular components - each handles a specific responsibility; they are built in the
+    // thread's TranslationUnitArena, which is reset after the translation unit
     KuzuDatabase* database;  // No longer owned by this instance
-    std::unique_ptr<ASTNodeProcessor> nodeProcessor;
-    std::unique_ptr<ScopeManager> scopeManager;
-    std::unique_ptr<TypeAnalyzer> typeAnalyzer;
-    std::unique_ptr<DeclarationAnalyzer> declarationAnalyzer;
-    std::unique_ptr<StatementAnalyzer> statementAnalyzer;
-    std::unique_ptr<TemplateAnalyzer> templateAnalyzer;
-    std::unique_ptr<CommentProcessor> commentProcessor;
-    std::unique_ptr<AdvancedAnalyzer> advancedAnalyzer;
+    TranslationUnitArena::Ptr<ASTNodeProcessor> nodeProcessor;
+    TranslationUnitArena::Ptr<ScopeManager> scopeManager;
+    TranslationUnitArena::Ptr<ConstantEvaluator> constantEvaluator;  // Shared by the statement and advanced analyzers
+    TranslationUnitArena::Ptr<TypeAnalyzer> typeAnalyzer;
+    TranslationUnitArena::Ptr<DeclarationAnalyzer> declarationAnalyzer;
+    TranslationUnitArena::Ptr<StatementAnalyzer> statementAnalyzer;
+    TranslationUnitArena::Ptr<TemplateAnalyzer> templateAnalyzer;
+    TranslationUnitArena::Ptr<CommentProcessor> commentProcessor;
+    TranslationUnitArena::Ptr<AdvancedAnalyzer> advancedAnalyzer;
+    TranslationUnitArena::Ptr<CallGraphAnalyzer> callGraphAnalyzer;
+
+    // Analyzers left out by the run's AnalysisProfile stay null; without statements
+    // the traversal stops at function bodies and variable initializers
+    bool traverseStatements = true;
+
+    // Whether implicit instantiations are traversed in full rather than summarized
+    bool instantiationBodies = false;
+
+    // Whether each header file of this translation unit was already emitted by an earlier one
+    llvm::DenseMap<FileID, bool> indexedHeaderCache;
 
 public:
-    // Legacy constructors (text output only)
-    KuzuDump(raw_ostream& OS, ASTContext& Context, bool ShowColors);
-
     // Database constructors
     KuzuDump(std::string databasePath, ASTContext& Context, bool ShowColors = false);
 
@@ -86,6 +100,17 @@ public:
     void VisitStaticAssertDecl(const StaticAssertDecl* D);
     void VisitTranslationUnitDecl(const TranslationUnitDecl* D);
 
+    /// Traverse a whole translation unit
+    /// With \p skipIndexedHeaders, top-level declarations in headers that an earlier
+    /// translation unit already emitted are not traversed, except to emit this unit's
+    /// instantiations of their templates; references to them still resolve
+    /// through the stable node keys. Headers are matched by path and content hash only,
+    /// so a header included under different macro settings is emitted for the first
+    /// configuration seen.
+    /// \param D The translation unit declaration
+    /// \param skipIndexedHeaders True to skip already indexed headers
+    void dumpTranslationUnit(const TranslationUnitDecl* D, bool skipIndexedHeaders);
+
     void VisitStmt(const Stmt* S);
     void VisitReturnStmt(const ReturnStmt* S);  // Specific return statement handler
     void VisitExpr(const Expr* E);
@@ -104,6 +129,29 @@ private:
     /// Process a statement using the appropriate analyzers
     void processStatement(const Stmt* S);
 
+    /// Emit the implicit instantiations of a template
+    /// They belong to no declaration context, so only their template reaches them. Each
+    /// is summarized as its node, Declaration row and SPECIALIZES edge, or traversed in
+    /// full with --instantiation-bodies. Only the canonical declaration walks the list,
+    /// and it does so even when the template itself was emitted by an earlier unit.
+    /// \param D A class or function template
+    template <typename TemplateDeclType> void visitImplicitInstantiations(const TemplateDeclType* D);
+
+    /// Emit the implicit instantiations of the templates in a declaration of an indexed header
+    /// The header's declarations were emitted before, but the instantiations this
+    /// translation unit creates of its templates are new rows.
+    /// \param D A top-level declaration of an indexed header, or a member of one
+    void visitSkippedInstantiations(const Decl* D);
+
+    /// Check if a top-level declaration lies in a header an earlier translation unit already emitted
+    auto isInIndexedHeader(const Decl* D) -> bool;
+
+    /// Register every header this translation unit read as emitted
+    static void registerIndexedHeaders(const SourceManager& sourceManager);
+
+    /// Identify a header by normalized path and content hash
+    static auto getHeaderKey(FileEntryRef file, llvm::StringRef contents) -> std::string;
+
     /// Get database instance (for legacy compatibility)
     [[nodiscard]] auto getDatabase() const -> KuzuDatabase* { return database; }
 };
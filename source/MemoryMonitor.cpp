@@ -0,0 +1,204 @@
+//===--- MemoryMonitor.cpp - Memory accounting and the --max-memory budget ===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "MemoryMonitor.h"
+
+// clang-format off
+#include <doctest/doctest.h>
+
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/Format.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstdio>
+#endif
+
+#include <limits>
+#include <string>
+
+using namespace clang;
+
+namespace
+{
+
+struct SubsystemName
+{
+    const char* key;    // JSON key
+    const char* label;  // Text report label
+};
+
+constexpr std::array<SubsystemName, static_cast<size_t>(MemorySubsystem::Count)> SUBSYSTEM_NAMES = {{
+    {"pending_rows", "Pending rows"},
+    {"node_table", "Node tables"},
+    {"stable_keys", "Header entity caches"},
+    {"cfg", "CFGs"},
+}};
+
+auto toMegabytes(size_t bytes) -> double
+{
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+}  // namespace
+
+auto MemoryMonitor::getInstance() -> MemoryMonitor&
+{
+    static MemoryMonitor instance;
+    return instance;
+}
+
+void MemoryMonitor::setBudget(size_t bytes)
+{
+    budget = bytes;
+    if (bytes != 0)
+        enable();
+}
+
+void MemoryMonitor::update(MemorySubsystem subsystem, size_t& accounted, size_t bytes)
+{
+    if (!isEnabled() || accounted == bytes)
+        return;
+
+    auto& totals = subsystems[static_cast<size_t>(subsystem)];
+    int64_t delta = static_cast<int64_t>(bytes) - static_cast<int64_t>(accounted);
+    accounted = bytes;
+    int64_t current = totals.current.fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64_t peak = totals.peak.load(std::memory_order_relaxed);
+    while (current > peak && !totals.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+}
+
+auto MemoryMonitor::isOverBudget() const -> bool
+{
+    return budget != 0 && getResidentBytes() > budget;
+}
+
+void MemoryMonitor::disableOptionalAnalyzers()
+{
+    if (optionalAnalyzersDisabled.exchange(true, std::memory_order_relaxed))
+        return;
+    llvm::errs() << "Warning: resident memory exceeds --max-memory (" << llvm::format("%.0f", toMegabytes(budget))
+                 << " MiB); caches dropped, and templates, comments and advanced analysis are off for the "
+                    "remaining translation units\n";
+}
+
+auto MemoryMonitor::getResidentBytes() -> size_t
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0)
+        return 0;
+    return counters.WorkingSetSize;
+#else
+    // The second field of statm is the resident set in pages
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+        return 0;
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    int fields = std::fscanf(statm, "%llu %llu", &size, &resident);
+    std::fclose(statm);
+    if (fields != 2)
+        return 0;
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+auto MemoryMonitor::getPeakResidentBytes() -> size_t
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0)
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // Kilobytes on Linux
+#endif
+}
+
+auto MemoryMonitor::parseSize(llvm::StringRef spec, size_t& bytes) -> bool
+{
+    size_t multiplier = 1;
+    if (spec.consume_back_insensitive("k"))
+        multiplier = size_t{1} << 10;
+    else if (spec.consume_back_insensitive("m"))
+        multiplier = size_t{1} << 20;
+    else if (spec.consume_back_insensitive("g"))
+        multiplier = size_t{1} << 30;
+
+    size_t value = 0;
+    if (spec.getAsInteger(10, value) || value == 0 || value > std::numeric_limits<size_t>::max() / multiplier)
+        return false;
+    bytes = value * multiplier;
+    return true;
+}
+
+void MemoryMonitor::print(llvm::raw_ostream& os) const
+{
+    os << "  Peak memory (MiB):\n";
+    os << "    " << llvm::left_justify("Resident set", 30)
+       << llvm::format(" %12.1f\n", toMegabytes(getPeakResidentBytes()));
+    for (size_t i = 0; i < subsystems.size(); ++i)
+    {
+        auto peak = static_cast<size_t>(subsystems[i].peak.load(std::memory_order_relaxed));
+        os << "    " << llvm::left_justify(SUBSYSTEM_NAMES[i].label, 30)
+           << llvm::format(" %12.1f\n", toMegabytes(peak));
+    }
+    if (areOptionalAnalyzersDisabled())
+        os << "  Memory budget exceeded: optional analyzers were turned off\n";
+}
+
+void MemoryMonitor::writeJson(llvm::json::OStream& json) const
+{
+    json.attributeObject("peak_memory_bytes",
+                         [&]
+                         {
+                             json.attribute("resident_set", static_cast<int64_t>(getPeakResidentBytes()));
+                             for (size_t i = 0; i < subsystems.size(); ++i)
+                                 json.attribute(SUBSYSTEM_NAMES[i].key, subsystems[i].peak.load());
+                         });
+    json.attribute("memory_budget_exceeded", areOptionalAnalyzersDisabled());
+}
+
+TEST_CASE("MemoryMonitor::parseSize")
+{
+    size_t bytes = 0;
+    CHECK(MemoryMonitor::parseSize("4096", bytes));
+    CHECK(bytes == 4096);
+    CHECK(MemoryMonitor::parseSize("12K", bytes));
+    CHECK(bytes == size_t{12} << 10);
+    CHECK(MemoryMonitor::parseSize("3m", bytes));
+    CHECK(bytes == size_t{3} << 20);
+    CHECK(MemoryMonitor::parseSize("2G", bytes));
+    CHECK(bytes == size_t{2} << 30);
+
+    // Rejected values leave the previous size alone
+    for (const char* spec : {"", "0", "G", "-1", "1.5G", "12T", "12 G", "99999999999999999999"})
+    {
+        CAPTURE(spec);
+        CHECK_FALSE(MemoryMonitor::parseSize(spec, bytes));
+    }
+    CHECK(bytes == size_t{2} << 30);
+
+    // A size that only overflows once the suffix is applied
+    std::string largest = std::to_string(std::numeric_limits<size_t>::max() >> 10);
+    CHECK(MemoryMonitor::parseSize(largest + "K", bytes));
+    CHECK_FALSE(MemoryMonitor::parseSize(std::to_string((std::numeric_limits<size_t>::max() >> 10) + 1) + "K", bytes));
+}
@@ -0,0 +1,111 @@
+//===--- MemoryMonitor.h - Memory accounting and the --max-memory budget --===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace clang
+{
+
+/// Holders of memory that grows with the indexed code, in report order
+enum class MemorySubsystem
+{
+    PendingRows,  // Rows and queries buffered by databases between flushes
+    NodeTable,    // Per-thread AST pointer to node record tables
+    StableKeys,   // Header entity caches kept across translation units
+    CFG,          // Control flow graphs while they are being stored
+    Count
+};
+
+/// Process-wide memory accounting for --stats and the --max-memory budget
+/// Subsystems report the bytes they hold at the points where that changes in
+/// bulk: batch flushes, translation unit ends and CFG builds. The monitor sums
+/// them over all threads and remembers the peak of each sum. The budget applies
+/// to the resident set size, since the Clang AST is by far the largest and least
+/// accountable holder and the resident set is what gets a process killed.
+class MemoryMonitor
+{
+public:
+    /// Get the singleton instance
+    static auto getInstance() -> MemoryMonitor&;
+
+    /// Start accounting; nothing is recorded before this or setBudget() is called
+    void enable() { enabled.store(true, std::memory_order_relaxed); }
+
+    [[nodiscard]] auto isEnabled() const -> bool { return enabled.load(std::memory_order_relaxed); }
+
+    /// Set the resident set size above which Dosatsu sheds memory, and enable accounting
+    /// \param bytes The budget, or 0 for none
+    void setBudget(size_t bytes);
+
+    [[nodiscard]] auto getBudget() const -> size_t { return budget; }
+
+    /// Replace what one holder accounted for a subsystem
+    /// \param subsystem The subsystem
+    /// \param accounted Bytes the holder accounted so far; set to \p bytes
+    /// \param bytes Bytes the holder holds now
+    void update(MemorySubsystem subsystem, size_t& accounted, size_t bytes);
+
+    /// Check the resident set size against the budget
+    /// \return True if a budget is set and the process exceeds it
+    [[nodiscard]] auto isOverBudget() const -> bool;
+
+    /// Turn off the optional analyzers for translation units started from now on
+    /// Reported once, the first time the budget forces it.
+    void disableOptionalAnalyzers();
+
+    /// Check whether the budget turned off the optional analyzers
+    [[nodiscard]] auto areOptionalAnalyzersDisabled() const -> bool
+    {
+        return optionalAnalyzersDisabled.load(std::memory_order_relaxed);
+    }
+
+    /// Current resident set size of the process, 0 if unknown
+    static auto getResidentBytes() -> size_t;
+
+    /// Peak resident set size of the process, 0 if unknown
+    static auto getPeakResidentBytes() -> size_t;
+
+    /// Parse a --max-memory value: bytes with an optional K, M or G suffix (powers of 1024)
+    /// \param spec The value, e.g. 12G
+    /// \param bytes Receives the size
+    /// \return False if \p spec is malformed
+    static auto parseSize(llvm::StringRef spec, size_t& bytes) -> bool;
+
+    /// Print the peaks as part of the --stats text report
+    void print(llvm::raw_ostream& os) const;
+
+    /// Write the peaks as attributes of the --stats JSON object
+    void writeJson(llvm::json::OStream& json) const;
+
+private:
+    MemoryMonitor() = default;
+
+    struct SubsystemTotals
+    {
+        std::atomic<int64_t> current{0};
+        std::atomic<int64_t> peak{0};
+    };
+
+    std::atomic<bool> enabled{false};
+    size_t budget = 0;
+    std::array<SubsystemTotals, static_cast<size_t>(MemorySubsystem::Count)> subsystems;
+    std::atomic<bool> optionalAnalyzersDisabled{false};
+};
+
+}  // namespace clang
@@ -0,0 +1,514 @@
+//===--- Microbenchmarks.cpp - Timings of the indexing hot paths ---------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+//
+// Each benchmark times one component on fixtures taken from the ASTs of the
+// Examples/cpp programs, so a change to that component can be measured without
+// the rest of the pipeline. They form the dosatsu_microbenchmarks executable,
+// built with -DENABLE_MICROBENCHMARKS=ON, which takes the examples directory on
+// its command line and passes everything else on to doctest:
+//
+//   dosatsu_microbenchmarks --examples=Examples/cpp [--test-case=<pattern>]
+//
+// Every benchmark prints its time per item, averaged over as many runs as fit
+// in MIN_RUN_TIME after one warm-up run.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ASTNodeProcessor.h"
+#include "CompilationDatabaseLoader.h"
+#include "GlobalDatabaseManager.h"
+#include "KuzuDatabase.h"
+#include "TypeAnalyzer.h"
+
+// clang-format off
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include "NoWarningScope_Enter.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace clang;
+
+namespace
+{
+
+// Long enough to average out timer resolution and scheduling, short enough for a quick run
+constexpr std::chrono::milliseconds MIN_RUN_TIME{200};
+
+// Copies of every example path under different roots, so the filter sees a project-sized file list
+constexpr size_t PATH_COPIES = 256;
+
+// The Examples/cpp directory, from --examples
+std::string examplesDirectory;
+
+/// Declarations, statements and types of one parsed example
+struct ExampleUnit
+{
+    std::unique_ptr<ASTUnit> ast;
+    std::string mainFile;
+    std::vector<const Decl*> decls;
+    std::vector<const Stmt*> stmts;
+    std::vector<QualType> types;
+    std::vector<std::pair<size_t, size_t>> parentChild;  // Indexes into decls
+};
+
+/// Everything the benchmarks run on, built once from Examples/cpp
+struct ExampleFixture
+{
+    std::vector<ExampleUnit> units;
+    std::vector<std::string> strings;  // Names, type spellings, string literals and source lines
+    std::vector<std::string> paths;
+    size_t declCount = 0;
+    size_t stmtCount = 0;
+    size_t typeCount = 0;
+};
+
+/// Collects the nodes of an example in traversal order
+class ExampleCollector : public RecursiveASTVisitor<ExampleCollector>
+{
+public:
+    ExampleCollector(ExampleUnit& unit, std::vector<std::string>& strings) : unit(unit), strings(strings) {}
+
+    auto VisitDecl(Decl* D) -> bool
+    {
+        declIndex.emplace(D, unit.decls.size());
+        if (const auto* parent = dyn_cast_or_null<Decl>(D->getDeclContext()))
+        {
+            if (auto it = declIndex.find(parent); it != declIndex.end())
+                unit.parentChild.emplace_back(it->second, unit.decls.size());
+        }
+        unit.decls.push_back(D);
+
+        if (const auto* named = dyn_cast<NamedDecl>(D); named != nullptr && !named->getDeclName().isEmpty())
+            strings.push_back(named->getQualifiedNameAsString());
+        if (const auto* value = dyn_cast<ValueDecl>(D))
+            addType(value->getType());
+        return true;
+    }
+
+    auto VisitStmt(Stmt* S) -> bool
+    {
+        unit.stmts.push_back(S);
+        if (const auto* expr = dyn_cast<Expr>(S))
+            addType(expr->getType());
+        if (const auto* literal = dyn_cast<StringLiteral>(S); literal != nullptr && literal->getCharByteWidth() == 1)
+            strings.push_back(literal->getString().str());
+        return true;
+    }
+
+private:
+    void addType(QualType type)
+    {
+        if (type.isNull())
+            return;
+        unit.types.push_back(type);
+        strings.push_back(type.getAsString());
+    }
+
+    ExampleUnit& unit;
+    std::vector<std::string>& strings;
+    std::unordered_map<const Decl*, size_t> declIndex;
+};
+
+auto buildFixture() -> ExampleFixture
+{
+    ExampleFixture fixture;
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(examplesDirectory, error), end; !error && it != end;
+         it.increment(error))
+    {
+        if (!it->is_regular_file() || it->path().extension() != ".cpp")
+            continue;
+
+        std::string path = it->path().generic_string();
+        auto code = llvm::MemoryBuffer::getFile(path);
+        if (!code)
+            continue;
+
+        ExampleUnit unit;
+        unit.mainFile = path;
+        unit.ast = tooling::buildASTFromCodeWithArgs((*code)->getBuffer(), {"-std=c++20"}, path);
+        if (!unit.ast)
+            continue;
+
+        ExampleCollector collector(unit, fixture.strings);
+        collector.TraverseDecl(unit.ast->getASTContext().getTranslationUnitDecl());
+
+        llvm::StringRef text = (*code)->getBuffer();
+        while (!text.empty())
+        {
+            auto [line, rest] = text.split('\n');
+            fixture.strings.push_back(line.str());
+            text = rest;
+        }
+
+        std::string relative = std::filesystem::path(path).lexically_relative(examplesDirectory).generic_string();
+        for (size_t copy = 0; copy < PATH_COPIES; ++copy)
+            fixture.paths.push_back("C:/work/tree" + std::to_string(copy) + "/Examples/cpp/" + relative);
+
+        fixture.declCount += unit.decls.size();
+        fixture.stmtCount += unit.stmts.size();
+        fixture.typeCount += unit.types.size();
+        fixture.units.push_back(std::move(unit));
+    }
+    return fixture;
+}
+
+auto getFixture() -> const ExampleFixture&
+{
+    static const ExampleFixture fixture = buildFixture();
+    return fixture;
+}
+
+/// Time a body and print its time per item
+/// \param name Name printed in front of the timing
+/// \param items Items one run of the body handles
+/// \param body One run
+/// \param prepare Called before every run, outside of the timing
+/// \param restore Called after every run, outside of the timing
+template <typename Body, typename Prepare, typename Restore>
+void measure(const char* name, size_t items, Body&& body, Prepare&& prepare, Restore&& restore)
+{
+    using Clock = std::chrono::steady_clock;
+
+    prepare();
+    body();
+    restore();
+
+    size_t runs = 0;
+    Clock::duration timed{};
+    auto started = Clock::now();
+    while (Clock::now() - started < MIN_RUN_TIME)
+    {
+        prepare();
+        auto runStarted = Clock::now();
+        body();
+        timed += Clock::now() - runStarted;
+        restore();
+        ++runs;
+    }
+
+    double nanoseconds = std::chrono::duration<double, std::nano>(timed).count() /
+                         static_cast<double>(runs * std::max<size_t>(items, 1));
+    llvm::outs() << llvm::format("  %-40s %12.1f ns/item  (%zu items x %zu runs)\n", name, nanoseconds, items, runs);
+}
+
+template <typename Body>
+void measure(const char* name, size_t items, Body&& body)
+{
+    measure(name, items, std::forward<Body>(body), [] {}, [] {});
+}
+
+/// Fresh node bookkeeping for one example per run, as the indexer has for each translation unit
+/// Rows go to a staging database whose batches are dropped, so no Kuzu statement is timed.
+class NodeBenchmark
+{
+public:
+    NodeBenchmark() : staging(KuzuDatabase::createStaging(writer, [](KuzuDatabase::PendingBatch&&) {}))
+    {
+        GlobalDatabaseManager::bindThreadDatabase(staging.get());
+    }
+
+    NodeBenchmark(const NodeBenchmark&) = delete;
+    auto operator=(const NodeBenchmark&) -> NodeBenchmark& = delete;
+
+    ~NodeBenchmark() { GlobalDatabaseManager::bindThreadDatabase(nullptr); }
+
+    [[nodiscard]] auto getDatabase() -> KuzuDatabase& { return *staging; }
+
+    static void begin(const ExampleUnit& unit)
+    {
+        GlobalDatabaseManager::getInstance().beginTranslationUnit(unit.mainFile);
+    }
+
+    /// End the translation unit and drop its stable keys, so the next run creates every node again
+    static void end(const ExampleUnit& unit)
+    {
+        auto& dbManager = GlobalDatabaseManager::getInstance();
+        dbManager.endTranslationUnit();
+        dbManager.forgetTranslationUnits({unit.mainFile});
+    }
+
+private:
+    KuzuDatabase writer{std::string()};
+    std::unique_ptr<KuzuDatabase> staging;
+};
+
+/// A new database in a temporary directory that is removed again with it
+/// It never commits on its own, so a benchmark can roll every run back and
+/// all runs insert into the same empty tables.
+class TemporaryDatabase
+{
+public:
+    TemporaryDatabase()
+    {
+        if (llvm::sys::fs::createUniqueDirectory("dosatsu-benchmark", directory))
+            return;
+        database = std::make_unique<KuzuDatabase>(std::string(directory) + "/db");
+        database->initialize();
+
+        KuzuDatabase::BatchLimits limits;
+        limits.minCommitRows = limits.maxCommitRows = std::numeric_limits<size_t>::max();
+        database->setBatchLimits(limits);
+    }
+
+    TemporaryDatabase(const TemporaryDatabase&) = delete;
+    auto operator=(const TemporaryDatabase&) -> TemporaryDatabase& = delete;
+
+    ~TemporaryDatabase()
+    {
+        database.reset();
+        if (!directory.empty())
+            std::filesystem::remove_all(std::string(directory));
+    }
+
+    [[nodiscard]] auto isReady() const -> bool { return database != nullptr && database->isInitialized(); }
+    [[nodiscard]] auto get() -> KuzuDatabase& { return *database; }
+
+private:
+    llvm::SmallString<128> directory;
+    std::unique_ptr<KuzuDatabase> database;
+};
+
+}  // namespace
+
+TEST_SUITE("microbenchmark")
+{
+    TEST_CASE("KuzuDatabase::escapeString")
+    {
+        const auto& fixture = getFixture();
+        REQUIRE(!fixture.strings.empty());
+
+        size_t bytes = 0;
+        measure("escapeString",
+                fixture.strings.size(),
+                [&]
+                {
+                    for (const auto& text : fixture.strings)
+                        bytes += KuzuDatabase::escapeString(text).size();
+                });
+        CHECK(bytes > 0);
+    }
+
+    TEST_CASE("KuzuDatabase::executeBatch(queries)")
+    {
+        const auto& fixture = getFixture();
+        REQUIRE(fixture.declCount > 0);
+
+        // One CREATE per declaration, in the form addToBatch() receives; executing them parses and groups them first
+        std::vector<std::string> queries;
+        int64_t nodeId = 1;
+        for (const auto& unit : fixture.units)
+        {
+            for (const auto* decl : unit.decls)
+            {
+                std::string query = "CREATE (n:ASTNode {node_id: " + std::to_string(nodeId++) + ", node_type: '";
+                query += decl->getDeclKindName();
+                query += "', memory_address: '', file_id: 0, is_implicit: false, start_line: 0, start_column: 0, "
+                         "end_line: 0, end_column: 0, raw_text: ''})";
+                queries.push_back(std::move(query));
+            }
+        }
+
+        TemporaryDatabase temporary;
+        REQUIRE(temporary.isReady());
+        KuzuDatabase& database = temporary.get();
+
+        // Every run is rolled back, so all of them insert the same node IDs
+        measure(
+            "executeBatch(CREATE queries)",
+            queries.size(),
+            [&]
+            {
+                for (const auto& query : queries)
+                    database.addToBatch(query);
+                database.executeBatch();
+            },
+            [&] { database.beginTransaction(); },
+            [&] { database.rollbackTransaction(); });
+        CHECK(database.getRejectedRowCount() == 0);
+    }
+
+    TEST_CASE("KuzuDatabase::executeBatch(relationships)")
+    {
+        const auto& fixture = getFixture();
+        REQUIRE(fixture.declCount > 0);
+
+        TemporaryDatabase temporary;
+        REQUIRE(temporary.isReady());
+        KuzuDatabase& database = temporary.get();
+
+        // An ASTNode row per declaration, and the PARENT_OF edges between them
+        std::vector<std::tuple<int64_t, int64_t, std::string, std::map<std::string, std::string>>> relationships;
+        for (const auto& unit : fixture.units)
+        {
+            std::vector<int64_t> nodeIds;
+            nodeIds.reserve(unit.decls.size());
+            for (const auto* decl : unit.decls)
+            {
+                nodeIds.push_back(database.getNextNodeId());
+                database.addNodeToBatch("ASTNode",
+                                        {{"node_id", nodeIds.back()},
+                                         {"node_type", std::string_view(decl->getDeclKindName())},
+                                         {"memory_address", std::string_view()},
+                                         {"file_id", int64_t{0}},
+                                         {"is_implicit", decl->isImplicit()},
+                                         {"start_line", int64_t{-1}},
+                                         {"start_column", int64_t{-1}},
+                                         {"end_line", int64_t{-1}},
+                                         {"end_column", int64_t{-1}},
+                                         {"raw_text", std::string_view()}});
+            }
+            for (size_t index = 0; index < unit.parentChild.size(); ++index)
+            {
+                auto [parent, child] = unit.parentChild[index];
+                relationships.emplace_back(
+                    nodeIds[parent],
+                    nodeIds[child],
+                    "PARENT_OF",
+                    std::map<std::string, std::string>{{"child_index", std::to_string(index)},
+                                                       {"relationship_kind", "child"}});
+            }
+        }
+        database.flushOperations();
+        REQUIRE(!relationships.empty());
+
+        // Every run is rolled back, so all of them insert into the same database
+        measure(
+            "executeBatch(PARENT_OF)",
+            relationships.size(),
+            [&]
+            {
+                database.addBulkRelationshipsToBatch(relationships);
+                database.executeBatch();
+            },
+            [&] { database.beginTransaction(); },
+            [&] { database.rollbackTransaction(); });
+        CHECK(database.getRejectedRowCount() == 0);
+    }
+
+    TEST_CASE("ASTNodeProcessor::createASTNode")
+    {
+        const auto& fixture = getFixture();
+        REQUIRE(fixture.declCount > 0);
+
+        NodeBenchmark nodes;
+        int64_t failed = 0;
+        for (const auto& unit : fixture.units)
+        {
+            ASTNodeProcessor nodeProcessor(nodes.getDatabase(), unit.ast->getASTContext());
+            std::string name = "createASTNode " + llvm::sys::path::filename(unit.mainFile).str();
+            measure(
+                name.c_str(),
+                unit.decls.size() + unit.stmts.size(),
+                [&]
+                {
+                    for (const auto* decl : unit.decls)
+                        failed += nodeProcessor.createASTNode(decl) == -1 ? 1 : 0;
+                    for (const auto* stmt : unit.stmts)
+                        failed += nodeProcessor.createASTNode(stmt) == -1 ? 1 : 0;
+                },
+                [&] { NodeBenchmark::begin(unit); },
+                [&] { NodeBenchmark::end(unit); });
+        }
+        CHECK(failed == 0);
+    }
+
+    TEST_CASE("TypeAnalyzer::createTypeNode")
+    {
+        const auto& fixture = getFixture();
+        REQUIRE(fixture.typeCount > 0);
+
+        NodeBenchmark nodes;
+        int64_t failed = 0;
+        for (const auto& unit : fixture.units)
+        {
+            ASTContext& context = unit.ast->getASTContext();
+            ASTNodeProcessor nodeProcessor(nodes.getDatabase(), context);
+            TypeAnalyzer typeAnalyzer(nodes.getDatabase(), nodeProcessor, context);
+            std::string name = "createTypeNode " + llvm::sys::path::filename(unit.mainFile).str();
+            measure(
+                name.c_str(),
+                unit.types.size(),
+                [&]
+                {
+                    for (QualType type : unit.types)
+                        failed += typeAnalyzer.createTypeNode(type) == -1 ? 1 : 0;
+                },
+                [&] { NodeBenchmark::begin(unit); },
+                [&] { NodeBenchmark::end(unit); });
+        }
+        CHECK(failed == 0);
+    }
+
+    TEST_CASE("CompilationDatabaseLoader::FileFilter::matches")
+    {
+        const auto& fixture = getFixture();
+        REQUIRE(!fixture.paths.empty());
+
+        CompilationDatabaseLoader::FileFilter filter;
+        std::string errorMessage;
+        REQUIRE(filter.compile({"*/examples/cpp/*", "*.cc"}, {"*/tree1?/*", "*modern*"}, errorMessage));
+
+        size_t selected = 0;
+        measure("FileFilter::matches",
+                fixture.paths.size(),
+                [&]
+                {
+                    for (const auto& path : fixture.paths)
+                        selected += filter.matches(path) ? 1 : 0;
+                });
+        CHECK(selected > 0);
+    }
+}
+
+auto main(int argc, char** argv) -> int
+{
+    // --examples is ours; every other argument is a doctest option
+    std::vector<const char*> doctestArgs;
+    for (int i = 0; i < argc; ++i)
+    {
+        llvm::StringRef arg(argv[i]);
+        if (arg.consume_front("--examples="))
+            examplesDirectory = arg.str();
+        else
+            doctestArgs.push_back(argv[i]);
+    }
+    if (examplesDirectory.empty() || !std::filesystem::is_directory(examplesDirectory))
+    {
+        llvm::errs() << "Usage: dosatsu_microbenchmarks --examples=<Examples/cpp directory> [doctest options]\n";
+        return 1;
+    }
+
+    // The selftest cases of the components are linked in as well; only the benchmarks run here
+    doctest::Context ctx;
+    ctx.addFilter("test-suite", "microbenchmark");
+    ctx.applyCommandLine(static_cast<int>(doctestArgs.size()), doctestArgs.data());
+    return ctx.run();
+}
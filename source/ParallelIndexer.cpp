@@ -0,0 +1,226 @@
+//===--- ParallelIndexer.cpp - Multi-threaded translation unit indexing ---===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "ParallelIndexer.h"
+
+#include "ASTDumpAction.h"
+#include "BoundedQueue.h"
+#include "DatabaseWriter.h"
+#include "GlobalDatabaseManager.h"
+#include "Statistics.h"
+#include "Trace.h"
+#include "TranslationUnitScheduler.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/PCHContainerOperations.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace clang;
+
+namespace
+{
+
+/// A translation unit between the parse and extract stages
+struct ParsedUnit
+{
+    size_t file;  // Index into the scheduled files
+    std::unique_ptr<ASTUnit> unit;
+    int64_t parseNanoseconds;
+    bool lastOfFile;  // Files with several compile commands produce several units
+};
+
+// Parsed ASTs that may wait per extract thread; each holds a whole translation unit in memory
+constexpr size_t PARSED_UNITS_PER_WORKER = 1;
+
+// Batches an extract thread may have in flight before it blocks on the writer
+constexpr size_t BATCHES_PER_WORKER = 4;
+
+}  // namespace
+
+ParallelIndexer::ParallelIndexer(const tooling::CompilationDatabase& compilations,
+                                 std::string databasePath,
+                                 unsigned jobs,
+                                 unsigned parseJobs)
+    : compilations(compilations),
+      databasePath(std::move(databasePath)),
+      jobs(std::max(jobs, 1U)),
+      parseJobs(parseJobs == 0 ? this->jobs : parseJobs)
+{
+}
+
+auto ParallelIndexer::run(const std::vector<std::string>& sourceFiles) -> int
+{
+    // The connected database is created once, up front, so workers only ever stage
+    auto& dbManager = GlobalDatabaseManager::getInstance();
+    if (!dbManager.isInitialized())
+        dbManager.initializeDatabase(databasePath);
+    KuzuDatabase* database = dbManager.getDatabase();
+    if (database == nullptr)
+        return 1;
+
+    auto fileCount = static_cast<unsigned>(sourceFiles.size());
+    unsigned parserCount = std::min(parseJobs, fileCount);
+    unsigned extractorCount = std::min(jobs, fileCount);
+    llvm::outs() << "Indexing " << sourceFiles.size() << " files with " << parserCount << " parse and "
+                 << extractorCount << " extract threads\n";
+
+    auto& statistics = Statistics::getInstance();
+    statistics.setStageThreads(PipelineStage::Parse, parserCount);
+    statistics.setStageThreads(PipelineStage::Extract, extractorCount);
+
+    // Every extract thread has its own queue, so the scheduler decides which thread's caches see which file
+    TranslationUnitScheduler scheduler(databasePath + ".schedule");
+    scheduler.plan(sourceFiles, extractorCount);
+    std::vector<std::unique_ptr<BoundedQueue<ParsedUnit>>> laneQueues;
+    for (unsigned i = 0; i < extractorCount; ++i)
+        laneQueues.push_back(std::make_unique<BoundedQueue<ParsedUnit>>(PARSED_UNITS_PER_WORKER));
+
+    DatabaseWriter writer(*database, static_cast<size_t>(extractorCount) * BATCHES_PER_WORKER);
+    std::atomic<unsigned> runningParsers{parserCount};
+    std::atomic<unsigned> failedFiles{0};
+    std::atomic<unsigned> cachedFiles{0};
+
+    auto& trace = Trace::getInstance();
+    auto parser = [&](unsigned number)
+    {
+        trace.setThreadName("parse " + std::to_string(number));
+        while (auto assignment = scheduler.next())
+        {
+            size_t index = assignment->file;
+            auto parseStart = std::chrono::steady_clock::now();
+            std::vector<std::unique_ptr<ASTUnit>> units;
+            try
+            {
+                // Entries are per compile command, so only files with a single one are cached
+                auto commands = compilations.getCompileCommands(sourceFiles[index]);
+                bool cacheable = astCache.has_value() && commands.size() == 1;
+                if (cacheable)
+                {
+                    if (auto unit = astCache->load(commands.front()))
+                    {
+                        ++cachedFiles;
+                        units.push_back(std::move(unit));
+                    }
+                }
+
+                if (units.empty())
+                {
+                    // Own PCH operations and a physical file system per tool, so that
+                    // per-command working directories do not race between threads
+                    tooling::ClangTool tool(compilations,
+                                            {sourceFiles[index]},
+                                            std::make_shared<PCHContainerOperations>(),
+                                            llvm::vfs::createPhysicalFileSystem());
+                    PhaseTimer timer(StatisticsPhase::ClangParse);
+                    if (tool.buildASTs(units) != 0)
+                        ++failedFiles;
+                    if (cacheable && units.size() == 1)
+                        astCache->store(*units.front(), commands.front());
+                }
+            }
+            catch (const std::exception& e)
+            {
+                llvm::errs() << "Exception parsing " << sourceFiles[index] << ": " << e.what() << "\n";
+                ++failedFiles;
+            }
+
+            // A unit with errors is still indexed, as far as Clang got, but the file counts as failed
+            int64_t parseNanoseconds = nanosecondsSince(parseStart);
+            auto pushStart = std::chrono::steady_clock::now();
+            trace.addSpan("Parse", "indexing", parseStart, pushStart, sourceFiles[index]);
+            for (size_t i = 0; i < units.size(); ++i)
+            {
+                if (units[i]->getDiagnostics().hasErrorOccurred())
+                    ++failedFiles;
+                bool lastOfFile = i + 1 == units.size();
+                laneQueues[assignment->lane]->push({index, std::move(units[i]), parseNanoseconds, lastOfFile});
+            }
+            if (units.empty())
+                scheduler.finish(assignment->lane);
+            statistics.addStageOutputWait(PipelineStage::Parse, nanosecondsSince(pushStart));
+            trace.addSpan("Wait for extract lane", "wait", pushStart, std::chrono::steady_clock::now());
+            statistics.addStageTime(PipelineStage::Parse, nanosecondsSince(parseStart), 0);
+        }
+
+        if (runningParsers.fetch_sub(1) == 1)
+        {
+            for (auto& queue : laneQueues)
+                queue->close();
+        }
+    };
+
+    auto extractor = [&](unsigned lane)
+    {
+        StagedThreadDatabase staging(*database, writer);
+        trace.setThreadName("extract " + std::to_string(lane));
+
+        auto waitStart = std::chrono::steady_clock::now();
+        while (auto parsed = laneQueues[lane]->pop())
+        {
+            const std::string& mainFile = sourceFiles[parsed->file];
+            int64_t inputWait = nanosecondsSince(waitStart);
+            auto extractStart = std::chrono::steady_clock::now();
+            trace.addSpan("Wait for parsed unit", "wait", waitStart, extractStart);
+            try
+            {
+                ASTContext& context = parsed->unit->getASTContext();
+                DosatsuASTDumpConsumer consumer(databasePath, mainFile, context);
+                consumer.HandleTranslationUnit(context);
+            }
+            catch (const std::exception& e)
+            {
+                llvm::errs() << "Exception indexing " << mainFile << ": " << e.what() << "\n";
+                ++failedFiles;
+            }
+
+            int64_t extractNanoseconds = nanosecondsSince(extractStart);
+            if (parsed->lastOfFile)
+            {
+                scheduler.record(parsed->file,
+                                 parsed->parseNanoseconds + extractNanoseconds,
+                                 TranslationUnitScheduler::getAffinityKey(parsed->unit->getSourceManager()));
+                scheduler.finish(lane);
+            }
+
+            // The AST is freed here, on the thread that used it last, before waiting for the next one
+            parsed->unit.reset();
+            statistics.addStageTime(PipelineStage::Extract, extractNanoseconds, inputWait);
+            waitStart = std::chrono::steady_clock::now();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(parserCount + extractorCount);
+    for (unsigned i = 0; i < parserCount; ++i)
+        threads.emplace_back(parser, i);
+    for (unsigned i = 0; i < extractorCount; ++i)
+        threads.emplace_back(extractor, i);
+    for (auto& thread : threads)
+        thread.join();
+
+    writer.finish();
+    scheduler.save();
+
+    if (astCache)
+        llvm::outs() << "AST cache: " << cachedFiles.load() << " of " << sourceFiles.size()
+                     << " translation units loaded instead of parsed\n";
+
+    if (failedFiles > 0)
+        llvm::errs() << failedFiles.load() << " of " << sourceFiles.size() << " files failed to index\n";
+    return failedFiles > 0 ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+//===--- ParallelIndexer.h - Multi-threaded translation unit indexing -----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "ASTCache.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang
+{
+
+/// Indexes translation units in a pipeline of three thread pools
+/// Parse threads build the ASTs, extract threads traverse them into staged rows,
+/// and a single DatabaseWriter applies the rows to the Kuzu database. Bounded
+/// queues between the stages keep at most a few parsed ASTs and staged batches
+/// alive, so a slow stage holds the others back instead of growing memory. A
+/// TranslationUnitScheduler picks the order and the extract thread of each file.
+class ParallelIndexer
+{
+public:
+    /// Constructor
+    /// \param compilations Compilation database providing the compile commands
+    /// \param databasePath Path to the Kuzu database
+    /// \param jobs Number of extract threads
+    /// \param parseJobs Number of parse threads, 0 for as many as extract threads
+    ParallelIndexer(const tooling::CompilationDatabase& compilations,
+                    std::string databasePath,
+                    unsigned jobs,
+                    unsigned parseJobs = 0);
+
+    /// Index the given source files and flush everything to the database
+    /// \param sourceFiles Files to index, each must have a compile command
+    /// \return 0 on success, 1 if any translation unit failed
+    auto run(const std::vector<std::string>& sourceFiles) -> int;
+
+    /// Load ASTs saved by earlier runs instead of parsing, and save the ones parsed
+    /// \param directory Directory of the AST files
+    void setASTCache(std::string directory) { astCache.emplace(std::move(directory)); }
+
+private:
+    const tooling::CompilationDatabase& compilations;
+    std::string databasePath;
+    unsigned jobs;
+    unsigned parseJobs;
+    std::optional<ASTCache> astCache;
+};
+
+}  // namespace clang
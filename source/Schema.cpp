@@ -0,0 +1,42 @@
+//===--- Schema.cpp - Declarative description of the database schema -----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Schema.h"
+
+using namespace clang;
+
+auto clang::buildCreateTableStatement(const SchemaTable& table, bool ifNotExists) -> std::string
+{
+    std::string statement = table.isRelationship() ? "CREATE REL TABLE " : "CREATE NODE TABLE ";
+    if (ifNotExists)
+        statement += "IF NOT EXISTS ";
+    statement += table.name;
+    statement += '(';
+
+    bool first = true;
+    if (table.isRelationship())
+    {
+        statement += "FROM ";
+        statement += table.from;
+        statement += " TO ";
+        statement += table.to;
+        first = false;
+    }
+    for (const SchemaColumn& column : table.columns)
+    {
+        if (!first)
+            statement += ", ";
+        statement += column.name;
+        statement += ' ';
+        // DDL spells BOOL as BOOLEAN, like the rest of the queries of this project
+        statement += column.type == ColumnBuffer::ColumnType::Bool ? "BOOLEAN" : getKuzuTypeName(column.type);
+        if (first && !table.isRelationship())
+            statement += " PRIMARY KEY";
+        first = false;
+    }
+    statement += ')';
+    return statement;
+}
@@ -0,0 +1,462 @@
+//===--- Schema.h - Declarative description of the database schema -------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "ColumnBuffer.h"
+
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace clang
+{
+
+/// A column of a table
+struct SchemaColumn
+{
+    std::string_view name;
+    ColumnBuffer::ColumnType type;
+};
+
+/// A node or relationship table
+/// The first column of a node table is its primary key. The DDL, the COPY column
+/// order and the typing of relationship properties are all derived from these
+/// descriptions, so a column is declared in exactly one place.
+struct SchemaTable
+{
+    std::string_view name;
+    std::string_view from;  // Endpoint tables of a relationship table; empty for node tables
+    std::string_view to;
+    std::span<const SchemaColumn> columns;
+    bool isSummary = false;  // Dropped and rebuilt by SummaryTables instead of created with the schema
+
+    [[nodiscard]] constexpr auto isRelationship() const -> bool { return !from.empty(); }
+
+    /// Find a column by name
+    /// \return The column, or null if the table has none of that name
+    [[nodiscard]] constexpr auto findColumn(std::string_view column) const -> const SchemaColumn*
+    {
+        for (const SchemaColumn& candidate : columns)
+        {
+            if (candidate.name == column)
+                return &candidate;
+        }
+        return nullptr;
+    }
+};
+
+namespace schema
+{
+
+using enum ColumnBuffer::ColumnType;
+
+// Every stored AST node; the other node tables extend it by node_id
+inline constexpr SchemaColumn AST_NODE_COLUMNS[] = {
+    {"node_id", Int64},
+    {"node_type", String},
+    {"memory_address", String},
+    {"file_id", Int64},
+    {"start_line", Int64},
+    {"start_column", Int64},
+    {"end_line", Int64},
+    {"end_column", Int64},
+    {"is_implicit", Bool},
+    {"raw_text", String},
+};
+inline constexpr SchemaColumn DECLARATION_COLUMNS[] = {
+    {"node_id", Int64},
+    {"name", String},
+    {"qualified_name", String},
+    {"access_specifier", String},
+    {"storage_class", String},
+    {"is_definition", Bool},
+    {"namespace_context", String},
+};
+inline constexpr SchemaColumn TYPE_COLUMNS[] = {
+    {"node_id", Int64},
+    {"type_name", String},
+    {"canonical_type", String},
+    {"size_bytes", Int64},
+    {"is_const", Bool},
+    {"is_volatile", Bool},
+    {"is_builtin", Bool},
+};
+inline constexpr SchemaColumn STATEMENT_COLUMNS[] = {
+    {"node_id", Int64},
+    {"statement_kind", String},
+    {"has_side_effects", Bool},
+    {"is_compound", Bool},
+    {"control_flow_type", String},
+    {"condition_text", String},
+    {"is_constexpr", Bool},
+};
+inline constexpr SchemaColumn EXPRESSION_COLUMNS[] = {
+    {"node_id", Int64},
+    {"expression_kind", String},
+    {"value_category", String},
+    {"literal_value", String},
+    {"operator_kind", String},
+    {"is_constexpr", Bool},
+    {"evaluation_result", String},
+    {"implicit_cast_kind", String},
+};
+inline constexpr SchemaColumn ATTRIBUTE_COLUMNS[] = {
+    {"node_id", Int64},
+    {"attribute_kind", String},
+    {"attribute_value", String},
+};
+inline constexpr SchemaColumn TEMPLATE_PARAMETER_COLUMNS[] = {
+    {"node_id", Int64},
+    {"parameter_kind", String},
+    {"parameter_name", String},
+    {"has_default_argument", Bool},
+    {"default_argument_text", String},
+    {"is_parameter_pack", Bool},
+};
+inline constexpr SchemaColumn USING_DECLARATION_COLUMNS[] = {
+    {"node_id", Int64},
+    {"using_kind", String},
+    {"target_name", String},
+    {"introduces_name", String},
+    {"scope_impact", String},
+};
+
+// Relationship tables
+inline constexpr SchemaColumn PARENT_OF_COLUMNS[] = {
+    {"child_index", Int64},
+    {"relationship_kind", String},
+};
+inline constexpr SchemaColumn HAS_TYPE_COLUMNS[] = {
+    {"type_role", String},
+};
+inline constexpr SchemaColumn REFERENCES_COLUMNS[] = {
+    {"reference_kind", String},
+    {"is_direct", Bool},
+};
+inline constexpr SchemaColumn IN_SCOPE_COLUMNS[] = {
+    {"scope_kind", String},
+};
+inline constexpr SchemaColumn TEMPLATE_RELATION_COLUMNS[] = {
+    {"relation_kind", String},
+    {"specialization_type", String},
+};
+
+// Inheritance
+inline constexpr SchemaColumn INHERITS_FROM_COLUMNS[] = {
+    {"inheritance_type", String},
+    {"is_virtual", Bool},
+    {"base_access_path", String},
+};
+inline constexpr SchemaColumn OVERRIDES_COLUMNS[] = {
+    {"override_type", String},
+    {"is_covariant_return", Bool},
+};
+
+// Call graph, one edge per caller and callee of a translation unit
+inline constexpr SchemaColumn CALLS_COLUMNS[] = {
+    {"count", Int64},
+    {"first_line", Int64},
+    {"is_virtual", Bool},
+};
+inline constexpr SchemaColumn SPECIALIZES_COLUMNS[] = {
+    {"specialization_kind", String},
+    {"template_arguments", String},
+    {"instantiation_context", String},
+};
+
+// Preprocessor
+inline constexpr SchemaColumn MACRO_DEFINITION_COLUMNS[] = {
+    {"node_id", Int64},
+    {"macro_name", String},
+    {"is_function_like", Bool},
+    {"parameter_count", Int64},
+    {"parameter_names", String},
+    {"replacement_text", String},
+    {"is_builtin", Bool},
+    {"is_conditional", Bool},
+};
+inline constexpr SchemaColumn INCLUDE_DIRECTIVE_COLUMNS[] = {
+    {"node_id", Int64},
+    {"include_path", String},
+    {"is_system_include", Bool},
+    {"is_angled", Bool},
+    {"resolved_path", String},
+    {"include_depth", Int64},
+};
+inline constexpr SchemaColumn CONDITIONAL_DIRECTIVE_COLUMNS[] = {
+    {"node_id", Int64},
+    {"directive_type", String},
+    {"condition_text", String},
+    {"is_true_branch", Bool},
+    {"nesting_level", Int64},
+};
+inline constexpr SchemaColumn PRAGMA_DIRECTIVE_COLUMNS[] = {
+    {"node_id", Int64},
+    {"pragma_name", String},
+    {"pragma_text", String},
+    {"pragma_kind", String},
+};
+
+// Comments and compile-time evaluation
+inline constexpr SchemaColumn COMMENT_COLUMNS[] = {
+    {"node_id", Int64},
+    {"comment_text", String},
+    {"comment_kind", String},
+    {"is_documentation", Bool},
+    {"brief_text", String},
+    {"detailed_text", String},
+};
+inline constexpr SchemaColumn CONSTANT_EXPRESSION_COLUMNS[] = {
+    {"node_id", Int64},
+    {"is_constexpr_function", Bool},
+    {"evaluation_context", String},
+    {"evaluation_result", String},
+    {"result_type", String},
+    {"is_compile_time_constant", Bool},
+    {"constant_value", String},
+    {"constant_type", String},
+    {"evaluation_status", String},
+};
+inline constexpr SchemaColumn TEMPLATE_METAPROGRAMMING_COLUMNS[] = {
+    {"node_id", Int64},
+    {"template_kind", String},
+    {"instantiation_depth", Int64},
+    {"template_arguments", String},
+    {"specialized_template_id", Int64},
+    {"metaprogram_result", String},
+    {"dependent_types", String},
+    {"substitution_failure_reason", String},
+};
+inline constexpr SchemaColumn STATIC_ASSERTION_COLUMNS[] = {
+    {"node_id", Int64},
+    {"assertion_expression", String},
+    {"assertion_message", String},
+    {"assertion_result", Bool},
+    {"failure_reason", String},
+    {"evaluation_context", String},
+};
+
+// Control flow graphs; FunctionCFG is the compact form, see AdvancedAnalyzer::createCompactCFG()
+inline constexpr SchemaColumn CFG_BLOCK_COLUMNS[] = {
+    {"node_id", Int64},
+    {"function_id", Int64},
+    {"block_index", Int64},
+    {"is_entry_block", Bool},
+    {"is_exit_block", Bool},
+    {"terminator_kind", String},
+    {"block_content", String},
+    {"condition_expression", String},
+    {"has_terminator", Bool},
+    {"reachable", Bool},
+};
+inline constexpr SchemaColumn FUNCTION_CFG_COLUMNS[] = {
+    {"node_id", Int64},
+    {"function_id", Int64},
+    {"block_count", Int64},
+    {"entry_block", Int64},
+    {"exit_block", Int64},
+    {"terminators", String},
+    {"successors", String},
+    {"statements", String},
+    {"block_content", String},
+};
+
+// Preprocessor relationships
+inline constexpr SchemaColumn MACRO_EXPANSION_COLUMNS[] = {
+    {"expansion_context", String},
+    {"expansion_arguments", String},
+};
+inline constexpr SchemaColumn INCLUDES_COLUMNS[] = {
+    {"include_order", Int64},
+};
+inline constexpr SchemaColumn DEFINES_COLUMNS[] = {
+    {"definition_context", String},
+};
+
+// Comment and compile-time evaluation relationships
+inline constexpr SchemaColumn HAS_COMMENT_COLUMNS[] = {
+    {"attachment_type", String},
+};
+inline constexpr SchemaColumn HAS_CONSTANT_VALUE_COLUMNS[] = {
+    {"evaluation_stage", String},
+};
+inline constexpr SchemaColumn TEMPLATE_EVALUATES_TO_COLUMNS[] = {
+    {"instantiation_context", String},
+};
+inline constexpr SchemaColumn CONTAINS_STATIC_ASSERT_COLUMNS[] = {
+    {"assertion_scope", String},
+};
+
+// Control flow graph relationships
+inline constexpr SchemaColumn CFG_EDGE_COLUMNS[] = {
+    {"edge_type", String},
+    {"condition", String},
+};
+inline constexpr SchemaColumn CONTAINS_CFG_COLUMNS[] = {
+    {"cfg_role", String},
+};
+inline constexpr SchemaColumn HAS_CFG_COLUMNS[] = {
+    {"cfg_format", String},
+};
+inline constexpr SchemaColumn CFG_CONTAINS_STMT_COLUMNS[] = {
+    {"statement_index", Int64},
+};
+
+// Stable identities of header entities, written for databases that are merged later
+inline constexpr SchemaColumn STABLE_KEY_COLUMNS[] = {
+    {"node_id", Int64},
+    {"stable_key", String},
+};
+
+// File paths, stored once and referenced by ASTNode.file_id
+inline constexpr SchemaColumn SOURCE_FILE_COLUMNS[] = {
+    {"file_id", Int64},
+    {"path", String},
+};
+
+// Incremental indexing bookkeeping, one row per indexed translation unit
+inline constexpr SchemaColumn INDEXED_FILE_COLUMNS[] = {
+    {"path", String},
+    {"content_hash", String},
+    {"command_hash", String},
+    {"dependencies", String},
+    {"node_ranges", String},
+    {"borrowed_from", String},
+};
+
+// Summary tables, rebuilt by SummaryTables
+inline constexpr SchemaColumn INHERITANCE_CLOSURE_COLUMNS[] = {
+    {"depth", Int64},
+    {"is_virtual", Bool},
+};
+inline constexpr SchemaColumn FILE_SUMMARY_COLUMNS[] = {
+    {"file_id", Int64},
+    {"path", String},
+    {"ast_nodes", Int64},
+    {"declarations", Int64},
+    {"functions", Int64},
+    {"records", Int64},
+};
+inline constexpr SchemaColumn CALL_SUMMARY_COLUMNS[] = {
+    {"node_id", Int64},
+    {"callers", Int64},
+    {"callees", Int64},
+    {"incoming_calls", Int64},
+};
+
+}  // namespace schema
+
+/// Every table of the database, in creation order: node tables before the relationships between them
+inline constexpr std::array<SchemaTable, 44> SCHEMA_TABLES = {{
+    {"ASTNode", "", "", schema::AST_NODE_COLUMNS},
+    {"Declaration", "", "", schema::DECLARATION_COLUMNS},
+    {"Type", "", "", schema::TYPE_COLUMNS},
+    {"Statement", "", "", schema::STATEMENT_COLUMNS},
+    {"Expression", "", "", schema::EXPRESSION_COLUMNS},
+    {"Attribute", "", "", schema::ATTRIBUTE_COLUMNS},
+    {"TemplateParameter", "", "", schema::TEMPLATE_PARAMETER_COLUMNS},
+    {"UsingDeclaration", "", "", schema::USING_DECLARATION_COLUMNS},
+    {"PARENT_OF", "ASTNode", "ASTNode", schema::PARENT_OF_COLUMNS},
+    {"HAS_TYPE", "Declaration", "Type", schema::HAS_TYPE_COLUMNS},
+    {"REFERENCES", "ASTNode", "Declaration", schema::REFERENCES_COLUMNS},
+    {"IN_SCOPE", "ASTNode", "Declaration", schema::IN_SCOPE_COLUMNS},
+    {"TEMPLATE_RELATION", "ASTNode", "Declaration", schema::TEMPLATE_RELATION_COLUMNS},
+    {"INHERITS_FROM", "Declaration", "Declaration", schema::INHERITS_FROM_COLUMNS},
+    {"OVERRIDES", "Declaration", "Declaration", schema::OVERRIDES_COLUMNS},
+    {"CALLS", "Declaration", "Declaration", schema::CALLS_COLUMNS},
+    {"SPECIALIZES", "Declaration", "Declaration", schema::SPECIALIZES_COLUMNS},
+    {"MacroDefinition", "", "", schema::MACRO_DEFINITION_COLUMNS},
+    {"IncludeDirective", "", "", schema::INCLUDE_DIRECTIVE_COLUMNS},
+    {"ConditionalDirective", "", "", schema::CONDITIONAL_DIRECTIVE_COLUMNS},
+    {"PragmaDirective", "", "", schema::PRAGMA_DIRECTIVE_COLUMNS},
+    {"Comment", "", "", schema::COMMENT_COLUMNS},
+    {"ConstantExpression", "", "", schema::CONSTANT_EXPRESSION_COLUMNS},
+    {"TemplateMetaprogramming", "", "", schema::TEMPLATE_METAPROGRAMMING_COLUMNS},
+    {"StaticAssertion", "", "", schema::STATIC_ASSERTION_COLUMNS},
+    {"CFGBlock", "", "", schema::CFG_BLOCK_COLUMNS},
+    {"FunctionCFG", "", "", schema::FUNCTION_CFG_COLUMNS},
+    {"MACRO_EXPANSION", "ASTNode", "MacroDefinition", schema::MACRO_EXPANSION_COLUMNS},
+    {"INCLUDES", "ASTNode", "IncludeDirective", schema::INCLUDES_COLUMNS},
+    {"DEFINES", "ASTNode", "MacroDefinition", schema::DEFINES_COLUMNS},
+    {"HAS_COMMENT", "Declaration", "Comment", schema::HAS_COMMENT_COLUMNS},
+    {"HAS_CONSTANT_VALUE", "Expression", "ConstantExpression", schema::HAS_CONSTANT_VALUE_COLUMNS},
+    {"TEMPLATE_EVALUATES_TO", "Declaration", "TemplateMetaprogramming", schema::TEMPLATE_EVALUATES_TO_COLUMNS},
+    {"CONTAINS_STATIC_ASSERT", "Declaration", "StaticAssertion", schema::CONTAINS_STATIC_ASSERT_COLUMNS},
+    {"CFG_EDGE", "CFGBlock", "CFGBlock", schema::CFG_EDGE_COLUMNS},
+    {"CONTAINS_CFG", "Declaration", "CFGBlock", schema::CONTAINS_CFG_COLUMNS},
+    {"HAS_CFG", "Declaration", "FunctionCFG", schema::HAS_CFG_COLUMNS},
+    {"CFG_CONTAINS_STMT", "CFGBlock", "Statement", schema::CFG_CONTAINS_STMT_COLUMNS},
+    {"StableKey", "", "", schema::STABLE_KEY_COLUMNS},
+    {"SourceFile", "", "", schema::SOURCE_FILE_COLUMNS},
+    {"IndexedFile", "", "", schema::INDEXED_FILE_COLUMNS},
+    {"INHERITANCE_CLOSURE", "Declaration", "Declaration", schema::INHERITANCE_CLOSURE_COLUMNS, true},
+    {"FileSummary", "", "", schema::FILE_SUMMARY_COLUMNS, true},
+    {"CallSummary", "", "", schema::CALL_SUMMARY_COLUMNS, true},
+}};
+
+/// Find a table by name
+/// \return The table, or null if the schema has none of that name
+constexpr auto findSchemaTable(std::string_view name) -> const SchemaTable*
+{
+    for (const SchemaTable& table : SCHEMA_TABLES)
+    {
+        if (table.name == name)
+            return &table;
+    }
+    return nullptr;
+}
+
+/// Check the schema for duplicate names and relationships between unknown node tables
+consteval auto isSchemaConsistent() -> bool
+{
+    for (size_t i = 0; i < SCHEMA_TABLES.size(); ++i)
+    {
+        const SchemaTable& table = SCHEMA_TABLES[i];
+        if (findSchemaTable(table.name) != &table || table.columns.empty())
+            return false;
+        for (const SchemaColumn& column : table.columns)
+        {
+            if (table.findColumn(column.name) != &column)
+                return false;
+        }
+        if (!table.isRelationship())
+            continue;
+        for (std::string_view endpoint : {table.from, table.to})
+        {
+            const SchemaTable* node = findSchemaTable(endpoint);
+            if (node == nullptr || node->isRelationship() || node > &table)
+                return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isSchemaConsistent(), "SCHEMA_TABLES has a duplicate name or a relationship to an unknown node table");
+
+/// Kuzu name of a column type, as CALL table_info() reports it
+constexpr auto getKuzuTypeName(ColumnBuffer::ColumnType type) -> std::string_view
+{
+    switch (type)
+    {
+    case ColumnBuffer::ColumnType::Int64:
+        return "INT64";
+    case ColumnBuffer::ColumnType::Bool:
+        return "BOOL";
+    case ColumnBuffer::ColumnType::String:
+        return "STRING";
+    }
+    return "STRING";
+}
+
+/// Build the CREATE statement of a table
+/// \param table The table
+/// \param ifNotExists Keep an existing table of the same name
+/// \return The statement
+auto buildCreateTableStatement(const SchemaTable& table, bool ifNotExists) -> std::string;
+
+}  // namespace clang
@@ -78,12 +78,10 @@ void ScopeManager::createParentChildRelation(int64_t parentId, int64_t childId,
 
     try
     {
-        std::string query = "MATCH (p:ASTNode {node_id: " + std::to_string(parentId) +
-                            "}), (c:ASTNode {node_id: " + std::to_string(childId) +
-                            "}) CREATE (p)-[:PARENT_OF {child_index: " + std::to_string(index) +
-                            ", relationship_kind: 'child'}]->(c)";
-
-        database.addToBatch(query);
+        std::map<std::string, std::string> properties;
+        properties["child_index"] = std::to_string(index);
+        properties["relationship_kind"] = "child";
+        database.addRelationshipToBatch(parentId, childId, "PARENT_OF", properties);
     }
     catch (const std::exception& e)
     {
@@ -98,12 +96,9 @@ void ScopeManager::createScopeRelation(int64_t nodeId, int64_t scopeId, const st
 
     try
     {
-        std::string escapedScopeKind = KuzuDatabase::escapeString(scopeKind);
-        std::string query = "MATCH (n:ASTNode {node_id: " + std::to_string(nodeId) +
-                            "}), (s:Declaration {node_id: " + std::to_string(scopeId) +
-                            "}) CREATE (n)-[:IN_SCOPE {scope_kind: '" + escapedScopeKind + "'}]->(s)";
-
-        database.addToBatch(query);
+        std::map<std::string, std::string> properties;
+        properties["scope_kind"] = scopeKind;
+        database.addRelationshipToBatch(nodeId, scopeId, "IN_SCOPE", properties);
     }
     catch (const std::exception& e)
     {
@@ -0,0 +1,314 @@
+//===--- ShardMerger.cpp - Combine separately indexed shard databases -----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "ShardMerger.h"
+
+#include "KuzuDatabase.h"
+#include "SummaryTables.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <optional>
+
+using namespace clang;
+
+namespace
+{
+
+// Relationships leading from a node to nodes that only exist as part of it, so a
+// dropped duplicate takes them along; everything else refers to independent entities
+constexpr std::array<const char*, 8> OWNERSHIP_RELATIONSHIPS = {"PARENT_OF",
+                                                                "HAS_COMMENT",
+                                                                "HAS_CONSTANT_VALUE",
+                                                                "TEMPLATE_EVALUATES_TO",
+                                                                "CONTAINS_STATIC_ASSERT",
+                                                                "CONTAINS_CFG",
+                                                                "HAS_CFG",
+                                                                "CFG_EDGE"};
+
+// Rows converted per ColumnBuffer or relationship vector before they are written out
+constexpr size_t MERGE_BATCH_ROWS = 10000;
+
+}  // namespace
+
+ShardMerger::ShardMerger(kuzu::main::Connection& target, const std::string& stagingDirectory)
+    : target(target),
+      loader(stagingDirectory,
+             [&target](const std::string& table) { return KuzuDatabase::readTableColumns(target, table); })
+{
+}
+
+auto ShardMerger::addShard(const std::string& shardPath) -> bool
+{
+    try
+    {
+        kuzu::main::SystemConfig config;
+        config.readOnly = true;
+        kuzu::main::Database database(shardPath, config);
+        kuzu::main::Connection connection(&database);
+
+        duplicates.clear();
+        keyedNodes.clear();
+        droppedNodes.clear();
+        if (!collectDuplicates(connection) || !dropOwnedNodes(connection))
+            return false;
+
+        auto tables = connection.query("CALL show_tables() RETURN name, type");
+        if (!tables->isSuccess())
+        {
+            llvm::errs() << "Merge: failed to list tables of " << shardPath << ": " << tables->getErrorMessage()
+                         << "\n";
+            return false;
+        }
+
+        std::vector<std::string> nodeTables;
+        std::vector<std::string> relationshipTables;
+        while (tables->hasNext())
+        {
+            auto row = tables->getNext();
+            std::string type = row->getValue(1)->toString();
+            // Summaries describe one shard only; the merged database rebuilds its own
+            if (SummaryTables::isSummaryTable(row->getValue(0)->toString()))
+                continue;
+            if (type == "NODE")
+                nodeTables.push_back(row->getValue(0)->toString());
+            else if (type == "REL")
+                relationshipTables.push_back(row->getValue(0)->toString());
+        }
+
+        bool success = true;
+        for (const auto& table : nodeTables)
+            success = stageNodeTable(connection, table) && success;
+        for (const auto& table : relationshipTables)
+            success = stageRelationshipTable(connection, table) && success;
+
+        llvm::outs() << "Merged " << shardPath << ": " << duplicates.size() << " duplicate header entities, "
+                     << droppedNodes.size() << " nodes owned by them dropped\n";
+        return success;
+    }
+    catch (const std::exception& e)
+    {
+        llvm::errs() << "Merge: cannot read shard " << shardPath << ": " << e.what() << "\n";
+        return false;
+    }
+}
+
+auto ShardMerger::finish() -> bool
+{
+    llvm::outs() << "Loading " << loader.getNodeRowCount() << " nodes and " << loader.getRelationshipRowCount()
+                 << " relationships\n";
+    return loader.importInto(target);
+}
+
+auto ShardMerger::collectDuplicates(kuzu::main::Connection& shard) -> bool
+{
+    // Within a shard the lowest node ID wins, which is the copy its first translation unit emitted
+    auto result = shard.query("MATCH (k:StableKey) RETURN k.node_id, k.stable_key ORDER BY k.node_id");
+    if (!result->isSuccess())
+    {
+        llvm::errs() << "Merge: failed to read stable keys: " << result->getErrorMessage() << "\n";
+        return false;
+    }
+
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        auto nodeId = row->getValue(0)->getValue<int64_t>();
+        auto [it, inserted] = stableNodeIds.try_emplace(row->getValue(1)->getValue<std::string>(), nodeId);
+        keyedNodes.insert(nodeId);
+        if (!inserted)
+            duplicates.try_emplace(nodeId, it->second);
+    }
+    return true;
+}
+
+auto ShardMerger::dropOwnedNodes(kuzu::main::Connection& shard) -> bool
+{
+    if (duplicates.empty())
+        return true;
+
+    std::vector<std::pair<int64_t, int64_t>> edges;
+    for (const char* relationship : OWNERSHIP_RELATIONSHIPS)
+    {
+        auto result =
+            shard.query(std::string("MATCH (a)-[:") + relationship + "]->(b) RETURN a.node_id, b.node_id");
+        if (!result->isSuccess())
+        {
+            llvm::errs() << "Merge: failed to read " << relationship << ": " << result->getErrorMessage() << "\n";
+            return false;
+        }
+        while (result->hasNext())
+        {
+            auto row = result->getNext();
+            edges.emplace_back(row->getValue(0)->getValue<int64_t>(), row->getValue(1)->getValue<int64_t>());
+        }
+    }
+    std::ranges::sort(edges);
+
+    // Nodes with a stable key are decided by their own key, since another shard may lack them
+    std::vector<int64_t> pending;
+    pending.reserve(duplicates.size());
+    for (const auto& [nodeId, _] : duplicates)
+        pending.push_back(nodeId);
+    while (!pending.empty())
+    {
+        int64_t owner = pending.back();
+        pending.pop_back();
+        auto it = std::ranges::lower_bound(edges, std::pair{owner, std::numeric_limits<int64_t>::min()});
+        for (; it != edges.end() && it->first == owner; ++it)
+        {
+            if (!keyedNodes.contains(it->second) && droppedNodes.insert(it->second).second)
+                pending.push_back(it->second);
+        }
+    }
+    return true;
+}
+
+auto ShardMerger::stageNodeTable(kuzu::main::Connection& shard, const std::string& table) -> bool
+{
+    auto columns = KuzuDatabase::readTableColumns(shard, table);
+    if (columns.empty())
+        return true;
+
+    std::string query = "MATCH (n:" + table + ") RETURN ";
+    std::optional<size_t> nodeIdColumn;
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        if (i > 0)
+            query += ", ";
+        query += "n." + columns[i].name;
+        if (columns[i].name == "node_id")
+            nodeIdColumn = i;
+    }
+
+    auto result = shard.query(query);
+    if (!result->isSuccess())
+    {
+        llvm::errs() << "Merge: failed to read " << table << ": " << result->getErrorMessage() << "\n";
+        return false;
+    }
+
+    // NULL cells are left out of the row, so a row with a different set of NULLs starts a new buffer
+    // Tables without node IDs are keyed by their first column, which every shard may hold the same row for
+    auto& mergedKeys = mergedPrimaryKeys[table];
+
+    ColumnBuffer buffer(table);
+    std::vector<std::string> strings(columns.size());
+    std::vector<ColumnBuffer::Cell> cells;
+    cells.reserve(columns.size());
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        if (nodeIdColumn)
+        {
+            auto* value = row->getValue(*nodeIdColumn);
+            if (!value->isNull())
+            {
+                auto nodeId = value->getValue<int64_t>();
+                if (duplicates.contains(nodeId) || droppedNodes.contains(nodeId))
+                    continue;
+            }
+        }
+        else if (!mergedKeys.insert(row->getValue(0)->toString()).second)
+            continue;
+
+        cells.clear();
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            auto* value = row->getValue(i);
+            if (value->isNull())
+                continue;
+            const auto& column = columns[i];
+            if (column.type == "INT64")
+                cells.push_back({column.name, value->getValue<int64_t>()});
+            else if (column.type == "BOOL")
+                cells.push_back({column.name, value->getValue<bool>()});
+            else
+            {
+                strings[i] = value->toString();
+                cells.push_back({column.name, std::string_view(strings[i])});
+            }
+        }
+
+        if (!buffer.appendRow(cells))
+        {
+            loader.writeNodes(buffer);
+            buffer = ColumnBuffer(table);
+            buffer.appendRow(cells);
+        }
+        if (buffer.getRowCount() >= MERGE_BATCH_ROWS)
+        {
+            loader.writeNodes(buffer);
+            buffer.clear();
+        }
+    }
+    loader.writeNodes(buffer);
+    return true;
+}
+
+auto ShardMerger::stageRelationshipTable(kuzu::main::Connection& shard, const std::string& table) -> bool
+{
+    auto columns = KuzuDatabase::readTableColumns(shard, table);
+
+    std::string query = "MATCH (a)-[r:" + table + "]->(b) RETURN a.node_id, b.node_id";
+    for (const auto& column : columns)
+        query += ", r." + column.name;
+
+    auto result = shard.query(query);
+    if (!result->isSuccess())
+    {
+        llvm::errs() << "Merge: failed to read " << table << ": " << result->getErrorMessage() << "\n";
+        return false;
+    }
+
+    BulkLoader::Relationships relationships;
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        auto fromId = row->getValue(0)->getValue<int64_t>();
+        auto toId = row->getValue(1)->getValue<int64_t>();
+        if (droppedNodes.contains(fromId) || droppedNodes.contains(toId))
+            continue;
+
+        // Between two duplicates the kept copies already have the edge
+        auto from = duplicates.find(fromId);
+        auto to = duplicates.find(toId);
+        if (from != duplicates.end() && to != duplicates.end())
+            continue;
+        if (from != duplicates.end())
+            fromId = from->second;
+        if (to != duplicates.end())
+            toId = to->second;
+
+        std::map<std::string, std::string> properties;
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            auto* value = row->getValue(i + 2);
+            if (value->isNull())
+                continue;
+            if (columns[i].type == "BOOL")
+                properties.emplace(columns[i].name, value->getValue<bool>() ? "true" : "false");
+            else
+                properties.emplace(columns[i].name, value->toString());
+        }
+        relationships.emplace_back(fromId, toId, table, std::move(properties));
+
+        if (relationships.size() >= MERGE_BATCH_ROWS)
+        {
+            loader.writeRelationships(relationships);
+            relationships.clear();
+        }
+    }
+    loader.writeRelationships(relationships);
+    return true;
+}
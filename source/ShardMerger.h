@@ -0,0 +1,82 @@
+//===--- ShardMerger.h - Combine separately indexed shard databases -------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "BulkLoader.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "kuzu.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace clang
+{
+
+/// Merges databases written by `--shard i/N` processes into one database
+/// Shards allocate node IDs from disjoint ranges, so their rows can be copied
+/// as they are. Header entities are emitted by every shard that includes the
+/// header; they are recognized by their StableKey rows and only the copy from
+/// the first shard is kept. The other copies, and the subtrees they own, are
+/// dropped, and relationships pointing at them are redirected to the kept copy.
+/// Rows of tables without node IDs, such as SourceFile, are kept once per primary key.
+/// All rows are staged in CSV files and loaded with one COPY per table.
+class ShardMerger
+{
+public:
+    /// Constructor
+    /// \param target Connection to the database receiving the merged rows; its schema must exist and be empty
+    /// \param stagingDirectory Directory for the CSV files; removed after a successful load
+    ShardMerger(kuzu::main::Connection& target, const std::string& stagingDirectory);
+
+    /// Stage the rows of one shard
+    /// \param shardPath Path to the shard's Kuzu database, opened read-only
+    /// \return False if the shard could not be read
+    auto addShard(const std::string& shardPath) -> bool;
+
+    /// Load everything staged into the target database
+    /// \return True if every COPY succeeded
+    auto finish() -> bool;
+
+private:
+    /// Decide which node IDs of a shard are duplicates of entities already merged
+    auto collectDuplicates(kuzu::main::Connection& shard) -> bool;
+
+    /// Drop the nodes owned by duplicates, following ownership relationships from them
+    auto dropOwnedNodes(kuzu::main::Connection& shard) -> bool;
+
+    /// Stage the rows of a node table, leaving out duplicates
+    auto stageNodeTable(kuzu::main::Connection& shard, const std::string& table) -> bool;
+
+    /// Stage the rows of a relationship table, redirecting edges to kept duplicates
+    auto stageRelationshipTable(kuzu::main::Connection& shard, const std::string& table) -> bool;
+
+    kuzu::main::Connection& target;
+    BulkLoader loader;
+
+    // Node ID of the first copy of every header entity merged so far
+    std::unordered_map<std::string, int64_t> stableNodeIds;
+
+    // Primary keys merged so far, per table without node IDs
+    std::unordered_map<std::string, std::unordered_set<std::string>> mergedPrimaryKeys;
+
+    // Per shard: duplicates mapped to their kept copy, nodes with a stable key, and nodes dropped with their owner
+    llvm::DenseMap<int64_t, int64_t> duplicates;
+    llvm::DenseSet<int64_t> keyedNodes;
+    llvm::DenseSet<int64_t> droppedNodes;
+};
+
+}  // namespace clang
@@ -7,8 +7,10 @@
 #include "StatementAnalyzer.h"
 
 #include "ASTNodeProcessor.h"
+#include "ConstantEvaluator.h"
 #include "GlobalDatabaseManager.h"
 #include "KuzuDatabase.h"
+#include "Trace.h"
 
 // clang-format off
 #include "NoWarningScope_Enter.h"
@@ -24,8 +26,10 @@
 
 using namespace clang;
 
-StatementAnalyzer::StatementAnalyzer(KuzuDatabase& database, ASTNodeProcessor& nodeProcessor, ASTContext& astContext)
-    : database(database), nodeProcessor(nodeProcessor), astContext(&astContext)
+StatementAnalyzer::StatementAnalyzer(KuzuDatabase& database,
+                                     ASTNodeProcessor& nodeProcessor,
+                                     ConstantEvaluator& constantEvaluator)
+    : database(database), nodeProcessor(nodeProcessor), constantEvaluator(constantEvaluator)
 {
 }
 
@@ -34,35 +38,22 @@ void StatementAnalyzer::createStatementNode(int64_t nodeId, const clang::Stmt* s
     if (!database.isInitialized() || (stmt == nullptr))
         return;
 
-    // Check if Statement node already exists for this nodeId
-    auto& dbManager = GlobalDatabaseManager::getInstance();
-    if (dbManager.hasStatementNode(nodeId))
+    // Claim the row up front: one probe both checks and records it
+    if (!GlobalDatabaseManager::getInstance().markNodeRow(stmt, StatementRow))
         return;
 
+    TraceSpan span("StatementAnalyzer");
+
     try
     {
-        std::string statementKind = extractStatementKind(stmt);
-        bool hasSideEffects = hasStatementSideEffects(stmt);
-        bool isCompound = isCompoundStatement(stmt);
-        std::string controlFlowType = extractControlFlowType(stmt);
-        std::string conditionText = extractConditionText(stmt);
-        bool isConstexpr = isStatementConstexpr(stmt);
-
-        // Escape strings for safe database storage
-        std::string escapedStatementKind = KuzuDatabase::escapeString(statementKind);
-        std::string escapedControlFlowType = KuzuDatabase::escapeString(controlFlowType);
-        conditionText = KuzuDatabase::escapeString(conditionText);
-
-        std::string query = "CREATE (s:Statement {node_id: " + std::to_string(nodeId) + ", statement_kind: '" +
-                            escapedStatementKind + "', has_side_effects: " + (hasSideEffects ? "true" : "false") +
-                            ", is_compound: " + (isCompound ? "true" : "false") + ", control_flow_type: '" +
-                            escapedControlFlowType + "', condition_text: '" + conditionText +
-                            "', is_constexpr: " + (isConstexpr ? "true" : "false") + "})";
-
-        database.addToBatch(query);
-
-        // Register that this Statement node has been created
-        dbManager.registerStatementNode(nodeId);
+        database.addNodeToBatch("Statement",
+                                {{"node_id", nodeId},
+                                 {"statement_kind", extractStatementKind(stmt)},
+                                 {"has_side_effects", hasStatementSideEffects(stmt)},
+                                 {"is_compound", isCompoundStatement(stmt)},
+                                 {"control_flow_type", extractControlFlowType(stmt)},
+                                 {"condition_text", extractConditionText(stmt)},
+                                 {"is_constexpr", isStatementConstexpr(stmt)}});
     }
     catch (const std::exception& e)
     {
@@ -75,39 +66,21 @@ void StatementAnalyzer::createExpressionNode(int64_t nodeId, const clang::Expr*
     if (!database.isInitialized() || (expr == nullptr))
         return;
 
-    // Check if Expression node already exists for this nodeId
-    auto& dbManager = GlobalDatabaseManager::getInstance();
-    if (dbManager.hasExpressionNode(nodeId))
+    // Claim the row up front: one probe both checks and records it
+    if (!GlobalDatabaseManager::getInstance().markNodeRow(expr, ExpressionRow))
         return;
 
     try
     {
-        std::string expressionKind = extractExpressionKind(expr);
-        std::string valueCategory = extractValueCategory(expr);
-        std::string literalValue = extractLiteralValue(expr);
-        std::string operatorKind = extractOperatorKind(expr);
-        bool isConstexpr = isExpressionConstexpr(expr);
-        std::string evaluationResult = extractEvaluationResult(expr);
-        std::string implicitCastKind = extractImplicitCastKind(expr);
-
-        // Use proper escaping for database storage
-        std::string escapedExpressionKind = KuzuDatabase::escapeString(expressionKind);
-        std::string escapedValueCategory = KuzuDatabase::escapeString(valueCategory);
-        literalValue = KuzuDatabase::escapeString(literalValue);
-        std::string escapedOperatorKind = KuzuDatabase::escapeString(operatorKind);
-        evaluationResult = KuzuDatabase::escapeString(evaluationResult);
-        std::string escapedImplicitCastKind = KuzuDatabase::escapeString(implicitCastKind);
-
-        std::string query = "CREATE (e:Expression {node_id: " + std::to_string(nodeId) + ", expression_kind: '" +
-                            escapedExpressionKind + "', value_category: '" + escapedValueCategory +
-                            "', literal_value: '" + literalValue + "', operator_kind: '" + escapedOperatorKind +
-                            "', is_constexpr: " + (isConstexpr ? "true" : "false") + ", evaluation_result: '" +
-                            evaluationResult + "', implicit_cast_kind: '" + escapedImplicitCastKind + "'})";
-
-        database.addToBatch(query);
-
-        // Register that this Expression node has been created
-        dbManager.registerExpressionNode(nodeId);
+        database.addNodeToBatch("Expression",
+                                {{"node_id", nodeId},
+                                 {"expression_kind", extractExpressionKind(expr)},
+                                 {"value_category", extractValueCategory(expr)},
+                                 {"literal_value", extractLiteralValue(expr)},
+                                 {"operator_kind", extractOperatorKind(expr)},
+                                 {"is_constexpr", isExpressionConstexpr(expr)},
+                                 {"evaluation_result", extractEvaluationResult(expr)},
+                                 {"implicit_cast_kind", extractImplicitCastKind(expr)}});
     }
     catch (const std::exception& e)
     {
@@ -115,14 +88,14 @@ void StatementAnalyzer::createExpressionNode(int64_t nodeId, const clang::Expr*
     }
 }
 
-auto StatementAnalyzer::extractStatementKind(const clang::Stmt* stmt) -> std::string
+auto StatementAnalyzer::extractStatementKind(const clang::Stmt* stmt) -> llvm::StringRef
 {
     if (stmt == nullptr)
         return "unknown";
     return stmt->getStmtClassName();
 }
 
-auto StatementAnalyzer::extractControlFlowType(const clang::Stmt* stmt) -> std::string
+auto StatementAnalyzer::extractControlFlowType(const clang::Stmt* stmt) -> llvm::StringRef
 {
     if (stmt == nullptr)
         return "none";
@@ -217,31 +190,19 @@ auto StatementAnalyzer::isStatementConstexpr(const clang::Stmt* stmt) -> bool
 
     // Check if this is a constexpr expression
     if (const auto* expr = dyn_cast<Expr>(stmt))
-    {
-        if (expr->isValueDependent() || expr->isTypeDependent())
-            return false;
-
-        // Check if the expression has a valid type before evaluating
-        QualType exprType = expr->getType();
-        if (exprType.isNull())
-            return false;
-
-        // Try to evaluate as constant expression
-        Expr::EvalResult result;
-        return expr->EvaluateAsConstantExpr(result, *astContext);
-    }
+        return constantEvaluator.isConstant(expr);
 
     return false;
 }
 
-auto StatementAnalyzer::extractExpressionKind(const clang::Expr* expr) -> std::string
+auto StatementAnalyzer::extractExpressionKind(const clang::Expr* expr) -> llvm::StringRef
 {
     if (expr == nullptr)
         return "unknown";
     return expr->getStmtClassName();
 }
 
-auto StatementAnalyzer::extractValueCategory(const clang::Expr* expr) -> std::string
+auto StatementAnalyzer::extractValueCategory(const clang::Expr* expr) -> llvm::StringRef
 {
     if (expr == nullptr)
         return "unknown";
@@ -292,15 +253,15 @@ auto StatementAnalyzer::extractLiteralValue(const clang::Expr* expr) -> std::str
     return "";
 }
 
-auto StatementAnalyzer::extractOperatorKind(const clang::Expr* expr) -> std::string
+auto StatementAnalyzer::extractOperatorKind(const clang::Expr* expr) -> llvm::StringRef
 {
     if (expr == nullptr)
         return "none";
 
     if (const auto* binOp = dyn_cast<BinaryOperator>(expr))
-        return BinaryOperator::getOpcodeStr(binOp->getOpcode()).str();
+        return BinaryOperator::getOpcodeStr(binOp->getOpcode());
     if (const auto* unOp = dyn_cast<UnaryOperator>(expr))
-        return UnaryOperator::getOpcodeStr(unOp->getOpcode()).str();
+        return UnaryOperator::getOpcodeStr(unOp->getOpcode());
     if (dyn_cast<ConditionalOperator>(expr) != nullptr)
         return "?:";
 
@@ -309,20 +270,7 @@ auto StatementAnalyzer::extractOperatorKind(const clang::Expr* expr) -> std::str
 
 auto StatementAnalyzer::isExpressionConstexpr(const clang::Expr* expr) -> bool
 {
-    if (expr == nullptr)
-        return false;
-
-    if (expr->isValueDependent() || expr->isTypeDependent())
-        return false;
-
-    // Check if the expression has a valid type before evaluating
-    QualType exprType = expr->getType();
-    if (exprType.isNull())
-        return false;
-
-    // Try to evaluate as constant expression
-    Expr::EvalResult result;
-    return expr->EvaluateAsConstantExpr(result, *astContext);
+    return expr != nullptr && constantEvaluator.isConstant(expr);
 }
 
 auto StatementAnalyzer::extractEvaluationResult(const clang::Expr* expr) -> std::string
@@ -330,34 +278,26 @@ auto StatementAnalyzer::extractEvaluationResult(const clang::Expr* expr) -> std:
     if (expr == nullptr)
         return "";
 
-    if (expr->isValueDependent() || expr->isTypeDependent())
+    const auto& evaluation = constantEvaluator.evaluate(expr);
+    switch (evaluation.status)
+    {
+    case ConstantEvaluator::Status::Dependent:
         return "dependent";
-
-    // Check if the expression has a valid type before evaluating
-    QualType exprType = expr->getType();
-    if (exprType.isNull())
+    case ConstantEvaluator::Status::InvalidType:
         return "invalid_type";
-
-    Expr::EvalResult result;
-    if (expr->EvaluateAsConstantExpr(result, *astContext))
-    {
-        if (result.Val.isInt())
-            return std::to_string(result.Val.getInt().getLimitedValue());
-        if (result.Val.isFloat())
-        {
-            llvm::SmallString<16> str;
-            result.Val.getFloat().toString(str);
-            return str.str().str();
-        }
-        return "constant";
+    case ConstantEvaluator::Status::Constant:
+        return ConstantEvaluator::formatValue(evaluation, "constant");
+    case ConstantEvaluator::Status::OverBudget:
+        return "over_budget";
+    case ConstantEvaluator::Status::NotConstant:
+        break;
     }
-
     return "not_constant";
 }
 
-auto StatementAnalyzer::extractImplicitCastKind(const clang::Expr* expr) -> std::string
+auto StatementAnalyzer::extractImplicitCastKind(const clang::Expr* expr) -> llvm::StringRef
 {
     if (const auto* implicitCast = dyn_cast<ImplicitCastExpr>(expr))
-        return {implicitCast->getCastKindName()};
+        return implicitCast->getCastKindName();
     return "none";
 }
@@ -11,6 +11,7 @@
 #include "clang/AST/Stmt.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/ASTContext.h"
+#include "llvm/ADT/StringRef.h"
 #include "NoWarningScope_Leave.h"
 // clang-format on
 
@@ -22,6 +23,7 @@ namespace clang
 
 class KuzuDatabase;
 class ASTNodeProcessor;
+class ConstantEvaluator;
 
 /// Handles statement and expression analysis for AST storage
 class StatementAnalyzer
@@ -30,8 +32,8 @@ public:
     /// Constructor
     /// \param database Database instance for storage
     /// \param nodeProcessor Node processor for creating basic nodes
-    /// \param astContext AST context for analysis
-    StatementAnalyzer(KuzuDatabase& database, ASTNodeProcessor& nodeProcessor, ASTContext& astContext);
+    /// \param constantEvaluator Shared evaluator for the constant expression columns
+    StatementAnalyzer(KuzuDatabase& database, ASTNodeProcessor& nodeProcessor, ConstantEvaluator& constantEvaluator);
 
     /// Create statement node
     /// \param nodeId Node ID for the statement
@@ -45,13 +47,13 @@ public:
 
     /// Extract statement kind
     /// \param stmt The statement
-    /// \return String representation of statement kind
-    auto extractStatementKind(const clang::Stmt* stmt) -> std::string;
+    /// \return Static string naming the statement kind
+    auto extractStatementKind(const clang::Stmt* stmt) -> llvm::StringRef;
 
     /// Extract control flow type
     /// \param stmt The statement
-    /// \return String representation of control flow type
-    auto extractControlFlowType(const clang::Stmt* stmt) -> std::string;
+    /// \return Static string naming the control flow type
+    auto extractControlFlowType(const clang::Stmt* stmt) -> llvm::StringRef;
 
     /// Extract condition text from control flow statements
     /// \param stmt The statement
@@ -75,13 +77,13 @@ public:
 
     /// Extract expression kind
     /// \param expr The expression
-    /// \return String representation of expression kind
-    auto extractExpressionKind(const clang::Expr* expr) -> std::string;
+    /// \return Static string naming the expression kind
+    auto extractExpressionKind(const clang::Expr* expr) -> llvm::StringRef;
 
     /// Extract value category
     /// \param expr The expression
-    /// \return String representation of value category
-    auto extractValueCategory(const clang::Expr* expr) -> std::string;
+    /// \return Static string naming the value category
+    auto extractValueCategory(const clang::Expr* expr) -> llvm::StringRef;
 
     /// Extract literal value
     /// \param expr The expression
@@ -90,8 +92,8 @@ public:
 
     /// Extract operator kind
     /// \param expr The expression
-    /// \return String representation of operator kind
-    auto extractOperatorKind(const clang::Expr* expr) -> std::string;
+    /// \return Static string naming the operator kind
+    auto extractOperatorKind(const clang::Expr* expr) -> llvm::StringRef;
 
     /// Check if expression is constexpr
     /// \param expr The expression
@@ -105,13 +107,13 @@ public:
 
     /// Extract implicit cast kind
     /// \param expr The expression
-    /// \return String representation of implicit cast kind
-    auto extractImplicitCastKind(const clang::Expr* expr) -> std::string;
+    /// \return Static string naming the implicit cast kind
+    auto extractImplicitCastKind(const clang::Expr* expr) -> llvm::StringRef;
 
 private:
     KuzuDatabase& database;
     ASTNodeProcessor& nodeProcessor;
-    const ASTContext* astContext;
+    ConstantEvaluator& constantEvaluator;
 };
 
 }  // namespace clang
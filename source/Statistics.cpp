@@ -0,0 +1,385 @@
+//===--- Statistics.cpp - Phase timing and row counters for --stats -------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Statistics.h"
+
+#include "MemoryMonitor.h"
+#include "Trace.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+#include <algorithm>
+
+using namespace clang;
+
+namespace
+{
+
+struct PhaseName
+{
+    const char* key;    // JSON key
+    const char* label;  // Text report label
+};
+
+constexpr std::array<PhaseName, static_cast<size_t>(StatisticsPhase::Count)> PHASE_NAMES = {{
+    {"clang_parse", "Clang parse"},
+    {"traversal", "KuzuDump traversal"},
+    {"type_analysis", "TypeAnalyzer"},
+    {"cfg_analysis", "AdvancedAnalyzer CFG"},
+    {"comment_processing", "CommentProcessor"},
+    {"template_analysis", "TemplateAnalyzer"},
+    {"constant_evaluation", "Constant evaluation"},
+    {"query_build", "Query build"},
+    {"node_insert", "Node inserts"},
+    {"bulk_queries", "executeBulkQueries"},
+    {"relationships", "executeOptimizedRelationships"},
+    {"commit", "Commit"},
+    {"bulk_import", "Bulk import (COPY)"},
+    {"summaries", "Summary tables"},
+}};
+
+constexpr std::array<PhaseName, static_cast<size_t>(PipelineStage::Count)> STAGE_NAMES = {{
+    {"parse", "Parse"},
+    {"extract", "Extract (traversal)"},
+    {"write", "Database write"},
+}};
+
+auto toMilliseconds(int64_t nanoseconds) -> double
+{
+    return static_cast<double>(nanoseconds) / 1e6;
+}
+
+}  // namespace
+
+thread_local PhaseTimer* PhaseTimer::current = nullptr;
+
+auto Statistics::getInstance() -> Statistics&
+{
+    static Statistics instance;
+    return instance;
+}
+
+void Statistics::enable()
+{
+    startTime = std::chrono::steady_clock::now();
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void Statistics::addPhaseTime(StatisticsPhase phase, int64_t wallNanoseconds, int64_t cpuNanoseconds)
+{
+    auto& totals = phases[static_cast<size_t>(phase)];
+    totals.wallNanoseconds.fetch_add(wallNanoseconds, std::memory_order_relaxed);
+    totals.cpuNanoseconds.fetch_add(cpuNanoseconds, std::memory_order_relaxed);
+    totals.calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Statistics::addNodeRows(const std::string& table, size_t rows)
+{
+    if (!isEnabled() || rows == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(tableMutex);
+    nodeRows[table] += rows;
+}
+
+void Statistics::addRelationshipRows(const std::string& relationshipType, size_t rows)
+{
+    if (!isEnabled() || rows == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(tableMutex);
+    relationshipRows[relationshipType] += rows;
+}
+
+void Statistics::addBulkStatement(size_t rows)
+{
+    if (!isEnabled())
+        return;
+    bulkStatements.fetch_add(1, std::memory_order_relaxed);
+    bulkRows.fetch_add(static_cast<int64_t>(rows), std::memory_order_relaxed);
+}
+
+void Statistics::addFallbackRows(size_t rows)
+{
+    if (isEnabled())
+        fallbackRows.fetch_add(static_cast<int64_t>(rows), std::memory_order_relaxed);
+}
+
+void Statistics::addRetryStatement()
+{
+    if (isEnabled())
+        retryStatements.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Statistics::addRejectedRows(size_t rows)
+{
+    if (isEnabled())
+        rejectedRows.fetch_add(static_cast<int64_t>(rows), std::memory_order_relaxed);
+}
+
+void Statistics::addIndividualQueries(size_t queries)
+{
+    if (isEnabled())
+        individualQueries.fetch_add(static_cast<int64_t>(queries), std::memory_order_relaxed);
+}
+
+void Statistics::addDuplicateStableNodes(size_t nodes)
+{
+    if (isEnabled() && nodes != 0)
+        duplicateStableNodes.fetch_add(static_cast<int64_t>(nodes), std::memory_order_relaxed);
+}
+
+void Statistics::setStageThreads(PipelineStage stage, unsigned threads)
+{
+    if (isEnabled())
+        stages[static_cast<size_t>(stage)].threads.store(threads, std::memory_order_relaxed);
+}
+
+void Statistics::addStageTime(PipelineStage stage, int64_t activeNanoseconds, int64_t inputWaitNanoseconds)
+{
+    if (!isEnabled())
+        return;
+    auto& totals = stages[static_cast<size_t>(stage)];
+    totals.items.fetch_add(1, std::memory_order_relaxed);
+    totals.activeNanoseconds.fetch_add(activeNanoseconds, std::memory_order_relaxed);
+    totals.inputWaitNanoseconds.fetch_add(inputWaitNanoseconds, std::memory_order_relaxed);
+}
+
+void Statistics::addStageOutputWait(PipelineStage stage, int64_t nanoseconds)
+{
+    if (isEnabled())
+        stages[static_cast<size_t>(stage)].outputWaitNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void Statistics::print(llvm::raw_ostream& os) const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+
+    os << "\nStatistics (times summed over all threads, nested phases excluded from their parent):\n";
+    os << "  " << llvm::left_justify("Phase", 32) << " " << llvm::right_justify("Wall ms", 12) << " "
+       << llvm::right_justify("CPU ms", 12) << " " << llvm::right_justify("Calls", 10) << "\n";
+
+    int64_t totalWall = 0;
+    int64_t totalCpu = 0;
+    for (size_t i = 0; i < phases.size(); ++i)
+    {
+        int64_t calls = phases[i].calls.load(std::memory_order_relaxed);
+        if (calls == 0)
+            continue;
+        int64_t wall = phases[i].wallNanoseconds.load(std::memory_order_relaxed);
+        int64_t cpu = phases[i].cpuNanoseconds.load(std::memory_order_relaxed);
+        totalWall += wall;
+        totalCpu += cpu;
+        os << "  " << llvm::left_justify(PHASE_NAMES[i].label, 32)
+           << llvm::format(
+                  " %12.1f %12.1f %10lld\n", toMilliseconds(wall), toMilliseconds(cpu), static_cast<long long>(calls));
+    }
+    os << "  " << llvm::left_justify("Total", 32)
+       << llvm::format(" %12.1f %12.1f\n", toMilliseconds(totalWall), toMilliseconds(totalCpu));
+    os << "  " << llvm::left_justify("Elapsed", 32) << llvm::format(" %12.1f\n", toMilliseconds(elapsed.count()));
+
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        for (const auto& [title, tables] : {std::pair{"Node rows per table", &nodeRows},
+                                            std::pair{"Relationship rows per table", &relationshipRows}})
+        {
+            if (tables->empty())
+                continue;
+            os << "  " << title << ":\n";
+            for (const auto& [table, rows] : *tables)
+                os << "    " << llvm::left_justify(table, 30) << llvm::format(" %12zu\n", rows);
+        }
+    }
+
+    os << "  Bulk statements: " << bulkStatements.load(std::memory_order_relaxed) << " ("
+       << bulkRows.load(std::memory_order_relaxed) << " rows)\n";
+    os << "  Fallback rows: " << fallbackRows.load(std::memory_order_relaxed) << " ("
+       << retryStatements.load(std::memory_order_relaxed) << " retry statements, "
+       << rejectedRows.load(std::memory_order_relaxed) << " rows rejected)\n";
+    os << "  Individual queries: " << individualQueries.load(std::memory_order_relaxed) << "\n";
+    os << "  Duplicate header entities: " << duplicateStableNodes.load(std::memory_order_relaxed) << "\n";
+
+    // Busy is the time a stage neither waited for input nor was blocked by the next stage;
+    // the stage with the highest busy share is the bottleneck
+    bool headerPrinted = false;
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        const auto& totals = stages[i];
+        int64_t items = totals.items.load(std::memory_order_relaxed);
+        if (items == 0)
+            continue;
+        if (!headerPrinted)
+        {
+            os << "  Pipeline stages:\n";
+            os << "    " << llvm::left_justify("Stage", 22) << " " << llvm::right_justify("Threads", 8) << " "
+               << llvm::right_justify("Items", 8) << " " << llvm::right_justify("Busy ms", 12) << " "
+               << llvm::right_justify("Input ms", 12) << " " << llvm::right_justify("Output ms", 12) << " "
+               << llvm::right_justify("Busy %", 7) << "\n";
+            headerPrinted = true;
+        }
+        int64_t active = totals.activeNanoseconds.load(std::memory_order_relaxed);
+        int64_t input = totals.inputWaitNanoseconds.load(std::memory_order_relaxed);
+        int64_t output = totals.outputWaitNanoseconds.load(std::memory_order_relaxed);
+        int64_t busy = std::max<int64_t>(active - output, 0);
+        double share = (active + input) > 0 ? 100.0 * static_cast<double>(busy) / static_cast<double>(active + input)
+                                            : 0.0;
+        os << "    " << llvm::left_justify(STAGE_NAMES[i].label, 22)
+           << llvm::format(" %8u %8lld %12.1f %12.1f %12.1f %7.1f\n",
+                           totals.threads.load(std::memory_order_relaxed),
+                           static_cast<long long>(items),
+                           toMilliseconds(busy),
+                           toMilliseconds(input),
+                           toMilliseconds(output),
+                           share);
+    }
+
+    MemoryMonitor::getInstance().print(os);
+}
+
+void Statistics::printJson(llvm::raw_ostream& os) const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+
+    llvm::json::OStream json(os);
+    json.object(
+        [&]
+        {
+            json.attribute("elapsed_ms", toMilliseconds(elapsed.count()));
+            json.attributeObject("phases",
+                                 [&]
+                                 {
+                                     for (size_t i = 0; i < phases.size(); ++i)
+                                     {
+                                         json.attributeObject(
+                                             PHASE_NAMES[i].key,
+                                             [&]
+                                             {
+                                                 const auto& totals = phases[i];
+                                                 json.attribute("wall_ms",
+                                                                toMilliseconds(totals.wallNanoseconds.load()));
+                                                 json.attribute("cpu_ms", toMilliseconds(totals.cpuNanoseconds.load()));
+                                                 json.attribute("calls", totals.calls.load());
+                                             });
+                                     }
+                                 });
+            std::lock_guard<std::mutex> lock(tableMutex);
+            for (const auto& [key, tables] :
+                 {std::pair{"node_rows", &nodeRows}, std::pair{"relationship_rows", &relationshipRows}})
+            {
+                json.attributeObject(key,
+                                     [&]
+                                     {
+                                         for (const auto& [table, rows] : *tables)
+                                             json.attribute(table, static_cast<int64_t>(rows));
+                                     });
+            }
+            json.attribute("bulk_statements", bulkStatements.load());
+            json.attribute("bulk_rows", bulkRows.load());
+            json.attribute("fallback_rows", fallbackRows.load());
+            json.attribute("retry_statements", retryStatements.load());
+            json.attribute("rejected_rows", rejectedRows.load());
+            json.attribute("individual_queries", individualQueries.load());
+            json.attribute("duplicate_stable_nodes", duplicateStableNodes.load());
+            json.attributeObject("pipeline_stages",
+                                 [&]
+                                 {
+                                     for (size_t i = 0; i < stages.size(); ++i)
+                                     {
+                                         const auto& totals = stages[i];
+                                         if (totals.items.load() == 0)
+                                             continue;
+                                         int64_t active = totals.activeNanoseconds.load();
+                                         int64_t output = totals.outputWaitNanoseconds.load();
+                                         json.attributeObject(
+                                             STAGE_NAMES[i].key,
+                                             [&]
+                                             {
+                                                 json.attribute("threads", static_cast<int64_t>(totals.threads.load()));
+                                                 json.attribute("items", totals.items.load());
+                                                 json.attribute("busy_ms",
+                                                                toMilliseconds(std::max<int64_t>(active - output, 0)));
+                                                 json.attribute("input_wait_ms",
+                                                                toMilliseconds(totals.inputWaitNanoseconds.load()));
+                                                 json.attribute("output_wait_ms", toMilliseconds(output));
+                                             });
+                                     }
+                                 });
+            MemoryMonitor::getInstance().writeJson(json);
+        });
+    os << "\n";
+}
+
+auto Statistics::getThreadCpuNanoseconds() -> int64_t
+{
+#if defined(_WIN32)
+    FILETIME creation;
+    FILETIME exit;
+    FILETIME kernel;
+    FILETIME user;
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) == 0)
+        return 0;
+    auto toHundredNanoseconds = [](const FILETIME& time)
+    { return (static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    return (toHundredNanoseconds(kernel) + toHundredNanoseconds(user)) * 100;
+#else
+    timespec time{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+        return 0;
+    return (static_cast<int64_t>(time.tv_sec) * 1000000000) + time.tv_nsec;
+#endif
+}
+
+PhaseTimer::PhaseTimer(StatisticsPhase phase)
+    : phase(phase), active(Statistics::getInstance().isEnabled()), traced(Trace::getInstance().isEnabled())
+{
+    if (!active && !traced)
+        return;
+
+    wallStart = std::chrono::steady_clock::now();
+    if (!active)
+        return;
+
+    parent = current;
+    current = this;
+    cpuStart = Statistics::getThreadCpuNanoseconds();
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    if (!active && !traced)
+        return;
+
+    auto wallEnd = std::chrono::steady_clock::now();
+    if (traced)
+        Trace::getInstance().addSpan(PHASE_NAMES[static_cast<size_t>(phase)].label, "phase", wallStart, wallEnd);
+    if (!active)
+        return;
+
+    int64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(wallEnd - wallStart).count();
+    int64_t cpu = Statistics::getThreadCpuNanoseconds() - cpuStart;
+
+    Statistics::getInstance().addPhaseTime(phase, wall - childWallNanoseconds, cpu - childCpuNanoseconds);
+
+    current = parent;
+    if (parent != nullptr)
+    {
+        parent->childWallNanoseconds += wall;
+        parent->childCpuNanoseconds += cpu;
+    }
+}
@@ -0,0 +1,190 @@
+//===--- Statistics.h - Phase timing and row counters for --stats ---------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace clang
+{
+
+/// Phases of an indexing run, in report order
+enum class StatisticsPhase
+{
+    ClangParse,
+    Traversal,
+    TypeAnalysis,
+    CFGAnalysis,
+    CommentProcessing,
+    TemplateAnalysis,
+    ConstantEvaluation,
+    QueryBuild,
+    NodeInsert,
+    BulkQueries,
+    Relationships,
+    Commit,
+    BulkImport,
+    Summaries,
+    Count
+};
+
+/// Thread pools of the indexing pipeline, in dataflow order
+enum class PipelineStage
+{
+    Parse,    // Clang builds the AST of a translation unit
+    Extract,  // KuzuDump traverses the AST into staged rows
+    Write,    // The database writer executes staged batches
+    Count
+};
+
+/// Process-wide phase times and row counters, reported by --stats
+/// Phase times are exclusive: time spent in a nested phase (e.g., a batch flush
+/// triggered while traversing) is charged to the nested phase only, so the phases
+/// add up to the total. Times are summed over all threads.
+class Statistics
+{
+public:
+    /// Get the singleton instance
+    static auto getInstance() -> Statistics&;
+
+    /// Start collecting; nothing is recorded before this is called
+    void enable();
+
+    [[nodiscard]] auto isEnabled() const -> bool { return enabled.load(std::memory_order_relaxed); }
+
+    /// Charge time to a phase
+    void addPhaseTime(StatisticsPhase phase, int64_t wallNanoseconds, int64_t cpuNanoseconds);
+
+    /// Count rows written to a node table
+    void addNodeRows(const std::string& table, size_t rows);
+
+    /// Count rows written to a relationship table
+    void addRelationshipRows(const std::string& relationshipType, size_t rows);
+
+    /// Count a multi-row statement that succeeded
+    void addBulkStatement(size_t rows);
+
+    /// Count rows of a bulk statement that failed and is retried in smaller statements
+    void addFallbackRows(size_t rows);
+
+    /// Count a statement retrying part of a failed bulk statement
+    void addRetryStatement();
+
+    /// Count rows that failed even in a statement of their own
+    void addRejectedRows(size_t rows);
+
+    /// Count string queries executed one by one
+    void addIndividualQueries(size_t queries);
+
+    /// Count header entities emitted again by a thread that could not see another thread's node yet
+    void addDuplicateStableNodes(size_t nodes);
+
+    /// Record how many threads run a pipeline stage
+    void setStageThreads(PipelineStage stage, unsigned threads);
+
+    /// Charge one item's time to a pipeline stage
+    /// \param stage The stage
+    /// \param activeNanoseconds Time after the item arrived, including time blocked handing results on
+    /// \param inputWaitNanoseconds Time spent waiting for the item
+    void addStageTime(PipelineStage stage, int64_t activeNanoseconds, int64_t inputWaitNanoseconds);
+
+    /// Charge time a stage spent blocked on the next stage's full queue
+    /// The time must also be part of the active time passed to addStageTime().
+    void addStageOutputWait(PipelineStage stage, int64_t nanoseconds);
+
+    /// Print a human-readable report
+    void print(llvm::raw_ostream& os) const;
+
+    /// Print the report as a single JSON object
+    void printJson(llvm::raw_ostream& os) const;
+
+    /// CPU time consumed by the calling thread
+    static auto getThreadCpuNanoseconds() -> int64_t;
+
+private:
+    Statistics() = default;
+
+    struct PhaseTotals
+    {
+        std::atomic<int64_t> wallNanoseconds{0};
+        std::atomic<int64_t> cpuNanoseconds{0};
+        std::atomic<int64_t> calls{0};
+    };
+
+    struct StageTotals
+    {
+        std::atomic<unsigned> threads{0};
+        std::atomic<int64_t> items{0};
+        std::atomic<int64_t> activeNanoseconds{0};
+        std::atomic<int64_t> inputWaitNanoseconds{0};
+        std::atomic<int64_t> outputWaitNanoseconds{0};
+    };
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point startTime;
+    std::array<PhaseTotals, static_cast<size_t>(StatisticsPhase::Count)> phases;
+    std::array<StageTotals, static_cast<size_t>(PipelineStage::Count)> stages;
+
+    mutable std::mutex tableMutex;
+    std::map<std::string, size_t> nodeRows;
+    std::map<std::string, size_t> relationshipRows;
+
+    std::atomic<int64_t> bulkStatements{0};
+    std::atomic<int64_t> bulkRows{0};
+    std::atomic<int64_t> fallbackRows{0};
+    std::atomic<int64_t> retryStatements{0};
+    std::atomic<int64_t> rejectedRows{0};
+    std::atomic<int64_t> individualQueries{0};
+    std::atomic<int64_t> duplicateStableNodes{0};
+};
+
+/// Wall time elapsed since a point in time, for charging pipeline stages
+inline auto nanosecondsSince(std::chrono::steady_clock::time_point start) -> int64_t
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Charges the time between construction and destruction to a phase
+/// Timers nest per thread and must be destroyed in reverse order of construction.
+/// With --trace the time is also recorded as a span named after the phase. When
+/// statistics and tracing are disabled a timer costs two relaxed loads.
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(StatisticsPhase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    auto operator=(const PhaseTimer&) -> PhaseTimer& = delete;
+    PhaseTimer(PhaseTimer&&) = delete;
+    auto operator=(PhaseTimer&&) -> PhaseTimer& = delete;
+
+private:
+    StatisticsPhase phase;
+    bool active;
+    bool traced;
+    PhaseTimer* parent = nullptr;
+    std::chrono::steady_clock::time_point wallStart;
+    int64_t cpuStart = 0;
+    int64_t childWallNanoseconds = 0;
+    int64_t childCpuNanoseconds = 0;
+
+    static thread_local PhaseTimer* current;
+};
+
+}  // namespace clang
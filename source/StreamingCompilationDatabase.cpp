@@ -0,0 +1,351 @@
+//===--- StreamingCompilationDatabase.cpp - Lazily parsed compile_commands ===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "StreamingCompilationDatabase.h"
+
+// clang-format off
+#include <doctest/doctest.h>
+
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <iterator>
+
+using namespace clang;
+
+namespace
+{
+
+/// Find the end of the JSON string starting at a quote
+/// \return Position just past the closing quote, or npos if the string is unterminated
+auto skipString(llvm::StringRef text, size_t position) -> size_t
+{
+    for (++position; position < text.size(); ++position)
+    {
+        position = text.find_first_of("\"\\", position);
+        if (position == llvm::StringRef::npos)
+            return llvm::StringRef::npos;
+        if (text[position] == '"')
+            return position + 1;
+        ++position;  // Skip the escaped character
+    }
+    return llvm::StringRef::npos;
+}
+
+/// Decode a JSON string token, quotes included
+auto decodeString(llvm::StringRef token) -> std::optional<std::string>
+{
+    // Paths almost never contain escapes other than doubled backslashes, but the JSON parser handles them all
+    if (!token.contains('\\'))
+        return token.drop_front().drop_back().str();
+    auto value = llvm::json::parse(token);
+    if (!value)
+    {
+        llvm::consumeError(value.takeError());
+        return std::nullopt;
+    }
+    if (auto string = value->getAsString())
+        return string->str();
+    return std::nullopt;
+}
+
+/// Make an entry's file path absolute and canonical, the way ClangTool looks files up
+auto normalizeFilePath(llvm::StringRef directory, llvm::StringRef file) -> std::string
+{
+    llvm::SmallString<256> path;
+    if (llvm::sys::path::is_absolute(file))
+        path = file;
+    else
+    {
+        path = directory;
+        llvm::sys::path::append(path, file);
+    }
+    llvm::sys::fs::make_absolute(path);
+    llvm::sys::path::remove_dots(path, true);
+    llvm::sys::path::native(path);
+    return std::string(path);
+}
+
+}  // namespace
+
+auto StreamingCompilationDatabase::load(const std::string& path,
+                                        llvm::function_ref<bool(llvm::StringRef)> keep,
+                                        std::string& errorMessage) -> std::unique_ptr<StreamingCompilationDatabase>
+{
+    // Without a null terminator large files are mapped rather than read
+    auto file = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!file)
+    {
+        errorMessage = "Cannot read " + path + ": " + file.getError().message();
+        return nullptr;
+    }
+
+    std::unique_ptr<StreamingCompilationDatabase> database(new StreamingCompilationDatabase());
+    database->buffer = std::move(*file);
+    llvm::StringRef text = database->buffer->getBuffer();
+
+    auto fail = [&](const std::string& reason, size_t position)
+    {
+        errorMessage = "Malformed compilation database at byte " + std::to_string(position) + ": " + reason;
+        return nullptr;
+    };
+
+    size_t position = text.find_first_not_of(" \t\r\n");
+    if (position == llvm::StringRef::npos || text[position] != '[')
+        return fail("expected an array of entries", position == llvm::StringRef::npos ? 0 : position);
+    ++position;
+
+    while (true)
+    {
+        position = text.find_first_not_of(" \t\r\n,", position);
+        if (position == llvm::StringRef::npos)
+            return fail("unterminated array", text.size());
+        if (text[position] == ']')
+            break;
+        if (text[position] != '{')
+            return fail("expected an entry object", position);
+
+        // Only the top-level "file" and "directory" strings are read now; the rest waits for parseEntry()
+        size_t start = position;
+        unsigned depth = 0;
+        bool expectingKey = false;
+        llvm::StringRef key;
+        llvm::StringRef fileToken;
+        llvm::StringRef directoryToken;
+        for (; position < text.size(); ++position)
+        {
+            char c = text[position];
+            if (c == '"')
+            {
+                size_t end = skipString(text, position);
+                if (end == llvm::StringRef::npos)
+                    return fail("unterminated string", position);
+                llvm::StringRef token = text.slice(position, end);
+                if (depth == 1 && expectingKey)
+                    key = token;
+                else if (depth == 1 && key == "\"file\"")
+                    fileToken = token;
+                else if (depth == 1 && key == "\"directory\"")
+                    directoryToken = token;
+                position = end - 1;
+            }
+            else if (c == '{' || c == '[')
+            {
+                ++depth;
+                expectingKey = depth == 1;
+            }
+            else if (c == '}' || c == ']')
+            {
+                if (--depth == 0)
+                    break;
+            }
+            else if (depth == 1 && c == ',')
+                expectingKey = true;
+            else if (depth == 1 && c == ':')
+                expectingKey = false;
+        }
+        if (position == text.size())
+            return fail("unterminated entry", start);
+        ++position;
+        ++database->entryCount;
+
+        auto fileName = fileToken.empty() ? std::nullopt : decodeString(fileToken);
+        auto directory = directoryToken.empty() ? std::optional<std::string>("") : decodeString(directoryToken);
+        if (!fileName || !directory)
+            return fail("entry without a valid \"file\" string", start);
+
+        std::string filePath = normalizeFilePath(*directory, *fileName);
+        if (!keep(filePath))
+            continue;
+
+        auto& fileEntries = database->entries[filePath];
+        if (fileEntries.empty())
+            database->files.push_back(filePath);
+        fileEntries.push_back({start, position - start});
+    }
+
+    errorMessage.clear();
+    return database;
+}
+
+auto StreamingCompilationDatabase::getCompileCommands(llvm::StringRef FilePath) const
+    -> std::vector<tooling::CompileCommand>
+{
+    auto it = entries.find(normalizeFilePath("", FilePath));
+    if (it == entries.end())
+        return {};
+
+    std::vector<tooling::CompileCommand> commands;
+    for (const auto& entry : it->second)
+    {
+        if (auto command = parseEntry(entry))
+            commands.push_back(std::move(*command));
+    }
+    return commands;
+}
+
+auto StreamingCompilationDatabase::getAllCompileCommands() const -> std::vector<tooling::CompileCommand>
+{
+    std::vector<tooling::CompileCommand> commands;
+    for (const auto& file : files)
+    {
+        auto fileCommands = getCompileCommands(file);
+        std::move(fileCommands.begin(), fileCommands.end(), std::back_inserter(commands));
+    }
+    return commands;
+}
+
+auto StreamingCompilationDatabase::parseEntry(Entry entry) const -> std::optional<tooling::CompileCommand>
+{
+    auto value = llvm::json::parse(buffer->getBuffer().substr(entry.offset, entry.length));
+    if (!value)
+    {
+        llvm::consumeError(value.takeError());
+        return std::nullopt;
+    }
+    const auto* object = value->getAsObject();
+    if (object == nullptr)
+        return std::nullopt;
+
+    auto directory = object->getString("directory");
+    auto file = object->getString("file");
+    if (!file)
+        return std::nullopt;
+
+    std::vector<std::string> commandLine;
+    if (const auto* arguments = object->getArray("arguments"))
+    {
+        for (const auto& argument : *arguments)
+        {
+            if (auto string = argument.getAsString())
+                commandLine.push_back(string->str());
+        }
+    }
+    else if (auto command = object->getString("command"))
+    {
+        // Same shell syntax JSONCompilationDatabase auto-detects for the host
+        llvm::BumpPtrAllocator allocator;
+        llvm::StringSaver saver(allocator);
+        llvm::SmallVector<const char*, 64> argv;
+#if defined(_WIN32)
+        llvm::cl::TokenizeWindowsCommandLine(*command, saver, argv);
+#else
+        llvm::cl::TokenizeGNUCommandLine(*command, saver, argv);
+#endif
+        commandLine.assign(argv.begin(), argv.end());
+    }
+    else
+        return std::nullopt;
+
+    auto output = object->getString("output");
+    return tooling::CompileCommand(directory ? directory->str() : "",
+                                   file->str(),
+                                   std::move(commandLine),
+                                   output ? output->str() : "");
+}
+
+namespace
+{
+
+/// Write a file of the test directory
+void writeTestFile(llvm::StringRef path, llvm::StringRef contents)
+{
+    std::error_code error;
+    llvm::raw_fd_ostream os(path, error);
+    REQUIRE(!error);
+    os << contents;
+}
+
+}  // namespace
+
+TEST_CASE("StreamingCompilationDatabase::load")
+{
+    llvm::SmallString<128> directory;
+    REQUIRE(!llvm::sys::fs::createUniqueDirectory("dosatsu-compile-commands", directory));
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, "compile_commands.json");
+
+    // The directory is written as a JSON string, so Windows paths exercise the escaped form
+    std::string json;
+    llvm::raw_string_ostream os(json);
+    llvm::json::Value directoryJson(directory.str());
+    os << "[\n";
+    os << R"(  {"directory": )" << directoryJson << R"(, "file": "a.cpp", "arguments": ["clang++", "-c", "a.cpp"]},)";
+    os << R"(  {"file": "sub/../b.cpp", "extra": {"file": "nested.cpp"}, "directory": )" << directoryJson;
+    os << R"(, "command": "clang++ -DNAME=\"x y\" -c b.cpp"},)";
+    os << R"(  {"directory": )" << directoryJson << R"(, "file": "skip.cpp", "command": "clang++ -c skip.cpp"},)";
+    os << R"(  {"directory": )" << directoryJson << R"(, "file": "a.cpp", "command": "clang++ -O2 -c a.cpp",)";
+    os << R"( "output": "a.o"})";
+    os << "\n]\n";
+    writeTestFile(path, json);
+
+    std::string error;
+    auto database = StreamingCompilationDatabase::load(
+        std::string(path), [](llvm::StringRef file) { return !file.ends_with("skip.cpp"); }, error);
+    REQUIRE(database);
+    CHECK(error.empty());
+    CHECK(database->getEntryCount() == 4);
+
+    // Files are normalized and listed once, in database order; nested "file" keys are not entries
+    auto files = database->getAllFiles();
+    REQUIRE(files.size() == 2);
+    CHECK(llvm::sys::path::filename(files[0]) == "a.cpp");
+    CHECK(llvm::sys::path::filename(files[1]) == "b.cpp");
+    CHECK(llvm::sys::path::is_absolute(files[1]));
+    CHECK(llvm::sys::path::parent_path(files[1]) == llvm::sys::path::parent_path(files[0]));
+
+    auto commands = database->getCompileCommands(files[0]);
+    REQUIRE(commands.size() == 2);
+    CHECK(commands[0].CommandLine == std::vector<std::string>{"clang++", "-c", "a.cpp"});
+    CHECK(commands[0].Directory == directory.str());
+    CHECK(commands[1].CommandLine == std::vector<std::string>{"clang++", "-O2", "-c", "a.cpp"});
+    CHECK(commands[1].Output == "a.o");
+
+    commands = database->getCompileCommands(files[1]);
+    REQUIRE(commands.size() == 1);
+    CHECK(commands[0].CommandLine == std::vector<std::string>{"clang++", "-DNAME=x y", "-c", "b.cpp"});
+
+    llvm::SmallString<128> skipped(directory);
+    llvm::sys::path::append(skipped, "skip.cpp");
+    CHECK(database->getCompileCommands(skipped).empty());
+    CHECK(database->getAllCompileCommands().size() == 3);
+
+    SUBCASE("Malformed files")
+    {
+        auto keepAll = [](llvm::StringRef) { return true; };
+        const char* malformed[] = {"",
+                                   "{}",
+                                   R"([{"directory": "/x"}])",
+                                   R"([{"file": "a.cpp}])",
+                                   R"([{"file": "a.cpp")",
+                                   R"([{"file": "a.cpp"})",
+                                   R"([{"file": "a.cpp"} 3])"};
+        for (const char* contents : malformed)
+        {
+            CAPTURE(contents);
+            writeTestFile(path, contents);
+            CHECK_FALSE(StreamingCompilationDatabase::load(std::string(path), keepAll, error));
+            CHECK(llvm::StringRef(error).starts_with("Malformed compilation database"));
+        }
+
+        llvm::sys::path::append(path, "missing.json");
+        CHECK_FALSE(StreamingCompilationDatabase::load(std::string(path), keepAll, error));
+        CHECK(llvm::StringRef(error).starts_with("Cannot read"));
+    }
+
+    llvm::sys::fs::remove_directories(directory);
+}
@@ -0,0 +1,74 @@
+//===--- StreamingCompilationDatabase.h - Lazily parsed compile_commands --===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang
+{
+
+/// A compile_commands.json that is memory-mapped and parsed one entry at a time
+/// Loading makes a single pass over the file that only finds where each entry
+/// starts and ends and reads its "file" and "directory" strings; entries whose
+/// file is not wanted are forgotten right away. An entry's compile command is
+/// parsed from the mapped text when it is asked for, typically by the thread
+/// about to compile it, so no command ever exists in memory before its
+/// translation unit is indexed and the first one starts after a quick scan.
+class StreamingCompilationDatabase : public tooling::CompilationDatabase
+{
+public:
+    /// Map and scan a compile_commands.json
+    /// \param path Path to the file
+    /// \param keep Decides from an entry's absolute file path whether to keep it
+    /// \param errorMessage Receives the reason if the file cannot be read or is malformed
+    /// \return The database, or null on failure
+    static auto load(const std::string& path, llvm::function_ref<bool(llvm::StringRef)> keep, std::string& errorMessage)
+        -> std::unique_ptr<StreamingCompilationDatabase>;
+
+    auto getCompileCommands(llvm::StringRef FilePath) const -> std::vector<tooling::CompileCommand> override;
+
+    auto getAllFiles() const -> std::vector<std::string> override { return files; }
+
+    auto getAllCompileCommands() const -> std::vector<tooling::CompileCommand> override;
+
+    /// Number of entries in the file, including the ones that were not kept
+    [[nodiscard]] auto getEntryCount() const -> size_t { return entryCount; }
+
+private:
+    StreamingCompilationDatabase() = default;
+
+    /// Location of one entry's JSON object in the mapped file
+    struct Entry
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    /// Parse the compile command of an entry
+    auto parseEntry(Entry entry) const -> std::optional<tooling::CompileCommand>;
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    std::vector<std::string> files;              // Kept files, in database order
+    llvm::StringMap<std::vector<Entry>> entries;  // Keyed by normalized absolute file path
+    size_t entryCount = 0;
+};
+
+}  // namespace clang
@@ -0,0 +1,270 @@
+//===--- SummaryTables.cpp - Materialized summaries for common queries ----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "SummaryTables.h"
+
+#include "KuzuDatabase.h"
+#include "Schema.h"
+#include "Statistics.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <vector>
+
+using namespace clang;
+
+namespace
+{
+
+constexpr std::array<llvm::StringLiteral, 5> FUNCTION_KINDS = {
+    "FunctionDecl", "CXXMethodDecl", "CXXConstructorDecl", "CXXDestructorDecl", "CXXConversionDecl"};
+
+constexpr std::array<llvm::StringLiteral, 4> RECORD_KINDS = {"RecordDecl",
+                                                             "CXXRecordDecl",
+                                                             "ClassTemplateSpecializationDecl",
+                                                             "ClassTemplatePartialSpecializationDecl"};
+
+/// A base reachable from a class
+struct Reach
+{
+    int64_t base;
+    int64_t depth;
+    bool isVirtual;  // Some path to the base passes a virtual base
+};
+
+struct FileCounts
+{
+    int64_t astNodes = 0;
+    int64_t declarations = 0;
+    int64_t functions = 0;
+    int64_t records = 0;
+};
+
+struct CallCounts
+{
+    int64_t callers = 0;
+    int64_t callees = 0;
+    int64_t incomingCalls = 0;  // Call sites calling the function
+};
+
+}  // namespace
+
+SummaryTables::SummaryTables(KuzuDatabase& database) : database(database)
+{
+}
+
+auto SummaryTables::rebuild() -> bool
+{
+    PhaseTimer timer(StatisticsPhase::Summaries);
+    bool success = buildInheritanceClosure();
+    success = buildFileSummary() && success;
+    success = buildCallSummary() && success;
+    database.flushOperations();
+    return success;
+}
+
+auto SummaryTables::isSummaryTable(std::string_view table) -> bool
+{
+    const SchemaTable* schema = findSchemaTable(table);
+    return schema != nullptr && schema->isSummary;
+}
+
+auto SummaryTables::resetTable(std::string_view table) -> bool
+{
+    auto* connection = database.getConnection();
+    auto dropped = connection->query("DROP TABLE IF EXISTS " + std::string(table));
+    auto created = dropped->isSuccess() ? connection->query(buildCreateTableStatement(*findSchemaTable(table), false))
+                                        : nullptr;
+    if (!created || !created->isSuccess())
+    {
+        llvm::errs() << "Summaries: cannot recreate " << table << ": "
+                     << (created ? created : dropped)->getErrorMessage() << "\n";
+        return false;
+    }
+    return true;
+}
+
+auto SummaryTables::buildInheritanceClosure() -> bool
+{
+    if (!resetTable("INHERITANCE_CLOSURE"))
+        return false;
+
+    auto result = database.getConnection()->query(
+        "MATCH (d:Declaration)-[r:INHERITS_FROM]->(b:Declaration) RETURN d.node_id, b.node_id, r.is_virtual");
+    if (!result->isSuccess())
+    {
+        llvm::errs() << "Summaries: failed to read INHERITS_FROM: " << result->getErrorMessage() << "\n";
+        return false;
+    }
+
+    llvm::DenseMap<int64_t, std::vector<Reach>> directBases;
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        auto* isVirtual = row->getValue(2);
+        directBases[row->getValue(0)->getValue<int64_t>()].push_back(
+            {row->getValue(1)->getValue<int64_t>(), 1, !isVirtual->isNull() && isVirtual->getValue<bool>()});
+    }
+
+    // A class's closure is its direct bases plus their closures one level deeper; memoized, since
+    // hierarchies share most of their bases. Cycles cannot occur in valid code but are cut anyway.
+    llvm::DenseMap<int64_t, std::vector<Reach>> closures;
+    llvm::DenseSet<int64_t> inProgress;
+    auto closureOf = [&](auto& self, int64_t derived) -> const std::vector<Reach>&
+    {
+        auto known = closures.find(derived);
+        if (known != closures.end())
+            return known->second;
+
+        std::map<int64_t, Reach> reached;
+        auto merge = [&](const Reach& reach)
+        {
+            auto [it, inserted] = reached.try_emplace(reach.base, reach);
+            if (!inserted)
+            {
+                it->second.depth = std::min(it->second.depth, reach.depth);
+                it->second.isVirtual = it->second.isVirtual || reach.isVirtual;
+            }
+        };
+
+        inProgress.insert(derived);
+        auto direct = directBases.find(derived);
+        if (direct != directBases.end())
+        {
+            for (const Reach& base : direct->second)
+            {
+                merge(base);
+                if (inProgress.contains(base.base))
+                    continue;
+                for (const Reach& indirect : self(self, base.base))
+                    merge({indirect.base, indirect.depth + 1, indirect.isVirtual || base.isVirtual});
+            }
+        }
+        inProgress.erase(derived);
+
+        auto& closure = closures[derived];
+        for (const auto& [_, reach] : reached)
+            closure.push_back(reach);
+        return closure;
+    };
+
+    size_t rows = 0;
+    for (const auto& [derived, _] : directBases)
+    {
+        for (const Reach& reach : closureOf(closureOf, derived))
+        {
+            database.addRelationshipToBatch(derived,
+                                            reach.base,
+                                            "INHERITANCE_CLOSURE",
+                                            {{"depth", std::to_string(reach.depth)},
+                                             {"is_virtual", reach.isVirtual ? "true" : "false"}});
+            ++rows;
+        }
+    }
+    llvm::outs() << "Summaries: " << rows << " inheritance closure edges for " << directBases.size()
+                 << " derived classes\n";
+    return true;
+}
+
+auto SummaryTables::buildFileSummary() -> bool
+{
+    if (!resetTable("FileSummary"))
+        return false;
+
+    // Counting per node kind keeps the scan to a single aggregation over ASTNode
+    auto result = database.getConnection()->query("MATCH (n:ASTNode) RETURN n.file_id, n.node_type, count(*)");
+    auto paths = database.getConnection()->query("MATCH (f:SourceFile) RETURN f.file_id, f.path");
+    if (!result->isSuccess() || !paths->isSuccess())
+    {
+        llvm::errs() << "Summaries: failed to count nodes per file: "
+                     << (result->isSuccess() ? paths : result)->getErrorMessage() << "\n";
+        return false;
+    }
+
+    std::map<int64_t, FileCounts> files;
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        if (row->getValue(0)->isNull())
+            continue;
+        auto& counts = files[row->getValue(0)->getValue<int64_t>()];
+        std::string kind = row->getValue(1)->isNull() ? std::string() : row->getValue(1)->getValue<std::string>();
+        auto count = row->getValue(2)->getValue<int64_t>();
+        counts.astNodes += count;
+        if (llvm::StringRef(kind).ends_with("Decl"))
+            counts.declarations += count;
+        if (llvm::is_contained(FUNCTION_KINDS, llvm::StringRef(kind)))
+            counts.functions += count;
+        if (llvm::is_contained(RECORD_KINDS, llvm::StringRef(kind)))
+            counts.records += count;
+    }
+
+    while (paths->hasNext())
+    {
+        auto row = paths->getNext();
+        auto it = files.find(row->getValue(0)->getValue<int64_t>());
+        if (it == files.end())
+            continue;
+        std::string path = row->getValue(1)->getValue<std::string>();
+        database.addNodeToBatch("FileSummary",
+                                {{"file_id", it->first},
+                                 {"path", path},
+                                 {"ast_nodes", it->second.astNodes},
+                                 {"declarations", it->second.declarations},
+                                 {"functions", it->second.functions},
+                                 {"records", it->second.records}});
+    }
+    llvm::outs() << "Summaries: " << files.size() << " files summarized\n";
+    return true;
+}
+
+auto SummaryTables::buildCallSummary() -> bool
+{
+    if (!resetTable("CallSummary"))
+        return false;
+
+    auto result = database.getConnection()->query(
+        "MATCH (a:Declaration)-[c:CALLS]->(b:Declaration) RETURN a.node_id, b.node_id, c.count");
+    if (!result->isSuccess())
+    {
+        llvm::errs() << "Summaries: failed to read CALLS: " << result->getErrorMessage() << "\n";
+        return false;
+    }
+
+    std::map<int64_t, CallCounts> functions;
+    while (result->hasNext())
+    {
+        auto row = result->getNext();
+        auto& caller = functions[row->getValue(0)->getValue<int64_t>()];
+        auto& callee = functions[row->getValue(1)->getValue<int64_t>()];
+        ++caller.callees;
+        ++callee.callers;
+        if (!row->getValue(2)->isNull())
+            callee.incomingCalls += row->getValue(2)->getValue<int64_t>();
+    }
+
+    for (const auto& [nodeId, counts] : functions)
+    {
+        database.addNodeToBatch("CallSummary",
+                                {{"node_id", nodeId},
+                                 {"callers", counts.callers},
+                                 {"callees", counts.callees},
+                                 {"incoming_calls", counts.incomingCalls}});
+    }
+    llvm::outs() << "Summaries: " << functions.size() << " functions on the call graph\n";
+    return true;
+}
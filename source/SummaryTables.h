@@ -0,0 +1,53 @@
+//===--- SummaryTables.h - Materialized summaries for common queries -----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace clang
+{
+
+class KuzuDatabase;
+
+/// Small derived tables that answer the most common lookups without traversals
+/// - INHERITANCE_CLOSURE links every class to each of its direct and indirect
+///   bases, with the shortest distance and whether a virtual base lies between.
+/// - FileSummary holds per-file counts of AST nodes, declarations, functions
+///   and records.
+/// - CallSummary holds the fan-in and fan-out of every function on the call graph.
+/// The tables are dropped and rebuilt from the whole database, so they are
+/// exact after every run that builds them; runs without --summaries leave them
+/// as they were. They are not part of the schema of a shard and are not merged.
+class SummaryTables
+{
+public:
+    /// Constructor
+    /// \param database Connected database whose writes are all flushed and committed
+    explicit SummaryTables(KuzuDatabase& database);
+
+    /// Drop and rebuild every summary table
+    /// \return False if a table could not be built
+    auto rebuild() -> bool;
+
+    /// Check whether a table is one of the summary tables
+    static auto isSummaryTable(std::string_view table) -> bool;
+
+private:
+    /// Drop a summary table and create it empty, as SCHEMA_TABLES describes it
+    auto resetTable(std::string_view table) -> bool;
+
+    auto buildInheritanceClosure() -> bool;
+
+    auto buildFileSummary() -> bool;
+
+    auto buildCallSummary() -> bool;
+
+    KuzuDatabase& database;
+};
+
+}  // namespace clang
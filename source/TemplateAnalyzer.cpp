@@ -8,6 +8,7 @@
 
 #include "ASTNodeProcessor.h"
 #include "KuzuDatabase.h"
+#include "Statistics.h"
 
 // clang-format off
 #include "NoWarningScope_Enter.h"
@@ -33,6 +34,8 @@ void TemplateAnalyzer::processTemplateDecl(int64_t /*nodeId*/, const clang::Temp
     if (!database.isInitialized() || (templateDecl == nullptr))
         return;
 
+    PhaseTimer timer(StatisticsPhase::TemplateAnalysis);
+
     // Process template parameters
     if (const auto* templateParams = templateDecl->getTemplateParameters())
         processTemplateParameters(templateParams);
@@ -65,6 +68,8 @@ void TemplateAnalyzer::processTemplateSpecialization(int64_t nodeId, const clang
     if (!database.isInitialized() || (specDecl == nullptr))
         return;
 
+    PhaseTimer timer(StatisticsPhase::TemplateAnalysis);
+
     // Handle class template specializations
     if (const auto* classSpec = dyn_cast<ClassTemplateSpecializationDecl>(specDecl))
     {
@@ -104,8 +109,16 @@ void TemplateAnalyzer::processTemplateSpecialization(int64_t nodeId, const clang
 
                 if (templateNodeId != -1)
                 {
-                    std::string templateArgs = extractTemplateArguments(templateDecl);
+                    // The arguments of the specialization, or the template's parameters if Clang has none
+                    const auto* specializationArgs = funcDecl->getTemplateSpecializationArgs();
+                    std::string templateArgs = specializationArgs != nullptr
+                                                   ? extractTemplateArguments(*specializationArgs)
+                                                   : extractTemplateArguments(templateDecl);
                     std::string instantiationContext = "implicit_instantiation";
+                    if (funcDecl->getTemplateSpecializationKind() == TSK_ExplicitSpecialization)
+                        instantiationContext = "explicit_specialization";
+                    else if (funcDecl->getTemplateSpecializationKind() != TSK_ImplicitInstantiation)
+                        instantiationContext = "explicit_instantiation";
 
                     createSpecializesRelation(
                         nodeId, templateNodeId, "function_specialization", templateArgs, instantiationContext);
@@ -155,19 +168,14 @@ void TemplateAnalyzer::createTemplateParameterNode(int64_t nodeId, const clang::
             parameterKind = "unknown";
         }
 
-        // Escape strings for safe database storage
-        parameterName = KuzuDatabase::escapeString(parameterName);
-        defaultArgumentText = KuzuDatabase::escapeString(defaultArgumentText);
-
         // Use the provided node ID for the TemplateParameter table
-        std::string escapedParameterKind = KuzuDatabase::escapeString(parameterKind);
-        std::string query = "CREATE (tp:TemplateParameter {node_id: " + std::to_string(nodeId) + ", parameter_kind: '" +
-                            escapedParameterKind + "', parameter_name: '" + parameterName +
-                            "', has_default_argument: " + (hasDefaultArgument ? "true" : "false") +
-                            ", default_argument_text: '" + defaultArgumentText +
-                            "', is_parameter_pack: " + (isParameterPack ? "true" : "false") + "})";
-
-        database.addToBatch(query);
+        database.addNodeToBatch("TemplateParameter",
+                                {{"node_id", nodeId},
+                                 {"parameter_kind", parameterKind},
+                                 {"parameter_name", parameterName},
+                                 {"has_default_argument", hasDefaultArgument},
+                                 {"default_argument_text", defaultArgumentText},
+                                 {"is_parameter_pack", isParameterPack}});
     }
     catch (const std::exception& e)
     {
@@ -241,22 +249,15 @@ void TemplateAnalyzer::createTemplateMetaprogrammingNode(int64_t nodeId,
                 specializedTemplateId = nodeProcessor.getNodeId(classTemplateSpecDecl->getSpecializedTemplate());
         }
 
-        // Use proper escaping for database storage
-        std::string escapedTemplateKind = KuzuDatabase::escapeString(templateKind);
-        templateArguments = KuzuDatabase::escapeString(templateArguments);
-        std::string escapedMetaprogramResult = KuzuDatabase::escapeString(metaprogramResult);
-        dependentTypes = KuzuDatabase::escapeString(dependentTypes);
-        substitutionFailureReason = KuzuDatabase::escapeString(substitutionFailureReason);
-
-        std::string query = "CREATE (tm:TemplateMetaprogramming {node_id: " + std::to_string(nodeId) +
-                            ", template_kind: '" + escapedTemplateKind +
-                            "', instantiation_depth: " + std::to_string(instantiationDepth) +
-                            ", template_arguments: '" + templateArguments +
-                            "', specialized_template_id: " + std::to_string(specializedTemplateId) +
-                            ", metaprogram_result: '" + escapedMetaprogramResult + "', dependent_types: '" +
-                            dependentTypes + "', substitution_failure_reason: '" + substitutionFailureReason + "'})";
-
-        database.addToBatch(query);
+        database.addNodeToBatch("TemplateMetaprogramming",
+                                {{"node_id", nodeId},
+                                 {"template_kind", templateKind},
+                                 {"instantiation_depth", instantiationDepth},
+                                 {"template_arguments", templateArguments},
+                                 {"specialized_template_id", specializedTemplateId},
+                                 {"metaprogram_result", metaprogramResult},
+                                 {"dependent_types", dependentTypes},
+                                 {"substitution_failure_reason", substitutionFailureReason}});
     }
     catch (const std::exception& e)
     {
@@ -0,0 +1,123 @@
+//===--- TextDump.cpp - AST dumps without the database analyzers ---------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "TextDump.h"
+
+#include "ASTNodeProcessor.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/JSON.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+namespace
+{
+
+/// Writes one JSON object per declaration and statement
+/// TraverseStmt() takes no data recursion queue, which makes RecursiveASTVisitor
+/// visit children from within their parent's traversal and keeps the parent stack exact.
+class JsonLinesWriter : public RecursiveASTVisitor<JsonLinesWriter>
+{
+public:
+    JsonLinesWriter(raw_ostream& OS, ASTContext& Context) : OS(OS), sourceManager(Context.getSourceManager()) {}
+
+    auto TraverseDecl(Decl* D) -> bool
+    {
+        if (D == nullptr)
+            return true;
+
+        const auto* named = dyn_cast<NamedDecl>(D);
+        const auto* value = dyn_cast<ValueDecl>(D);
+        writeLine(ASTNodeProcessor::extractNodeType(D),
+                  D->getBeginLoc(),
+                  named != nullptr && !named->getDeclName().isEmpty() ? named->getQualifiedNameAsString()
+                                                                      : std::string(),
+                  value != nullptr ? value->getType().getAsString() : std::string());
+
+        parents.push_back(nextId - 1);
+        bool result = RecursiveASTVisitor::TraverseDecl(D);
+        parents.pop_back();
+        return result;
+    }
+
+    auto TraverseStmt(Stmt* S) -> bool
+    {
+        if (S == nullptr)
+            return true;
+
+        const auto* expr = dyn_cast<Expr>(S);
+        writeLine(ASTNodeProcessor::extractNodeType(S),
+                  S->getBeginLoc(),
+                  std::string(),
+                  expr != nullptr ? expr->getType().getAsString() : std::string());
+
+        parents.push_back(nextId - 1);
+        bool result = RecursiveASTVisitor::TraverseStmt(S);
+        parents.pop_back();
+        return result;
+    }
+
+private:
+    static auto toJson(std::string text) -> std::string
+    {
+        return llvm::json::isUTF8(text) ? std::move(text) : llvm::json::fixUTF8(text);
+    }
+
+    void writeLine(llvm::StringRef kind, SourceLocation location, std::string name, std::string type)
+    {
+        llvm::json::OStream json(OS);
+        json.object(
+            [&]
+            {
+                json.attribute("id", nextId++);
+                if (!parents.empty())
+                    json.attribute("parent", parents.back());
+                json.attribute("kind", kind);
+                PresumedLoc presumed = sourceManager.getPresumedLoc(sourceManager.getExpansionLoc(location));
+                if (presumed.isValid())
+                {
+                    json.attribute("file", toJson(presumed.getFilename()));
+                    json.attribute("line", presumed.getLine());
+                    json.attribute("column", presumed.getColumn());
+                }
+                if (!name.empty())
+                    json.attribute("name", toJson(std::move(name)));
+                if (!type.empty())
+                    json.attribute("type", toJson(std::move(type)));
+            });
+        OS << '\n';
+    }
+
+    raw_ostream& OS;
+    const SourceManager& sourceManager;
+    std::vector<int64_t> parents;
+    int64_t nextId = 0;
+};
+
+}  // namespace
+
+void TextDump::write(raw_ostream& OS, ASTContext& Context, Format format)
+{
+    if (format == Format::Text)
+    {
+        Context.getTranslationUnitDecl()->dump(OS);
+        return;
+    }
+
+    JsonLinesWriter writer(OS, Context);
+    writer.TraverseDecl(Context.getTranslationUnitDecl());
+}
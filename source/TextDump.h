@@ -0,0 +1,45 @@
+//===--- TextDump.h - AST dumps without the database analyzers -----------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/AST/ASTContext.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+namespace clang
+{
+
+/// Writes the AST of a translation unit to the --output stream
+/// No database, node processor or analyzer is involved, so a dump costs one
+/// traversal and the writes into the stream's buffer.
+/// - Text is Clang's own -ast-dump tree.
+/// - JsonLines writes one object per declaration and statement in pre-order,
+///   each on its own line, with its parent's ID, node type (as the ASTNode table
+///   names it), location and, where there is one, name and type. Implicit code
+///   and template instantiations are left out, so the lines diff well. IDs
+///   restart at 0 with the TranslationUnitDecl line of every translation unit.
+class TextDump
+{
+public:
+    /// Output formats of --output
+    enum class Format
+    {
+        Text,
+        JsonLines
+    };
+
+    /// Dump a translation unit
+    /// \param OS Stream receiving the dump
+    /// \param Context AST context of the translation unit
+    /// \param format Output format
+    static void write(raw_ostream& OS, ASTContext& Context, Format format);
+};
+
+}  // namespace clang
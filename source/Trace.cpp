@@ -0,0 +1,182 @@
+//===--- Trace.cpp - Timeline tracing in the Chrome trace format ---------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Trace.h"
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+using namespace clang;
+
+namespace
+{
+
+// Spans a thread buffers before appending them to the file; a few hundred KiB per thread
+constexpr size_t BUFFERED_EVENTS = 4096;
+
+// Chrome trace timestamps are microseconds; fractions keep the nanosecond ordering of short spans
+auto toMicroseconds(int64_t nanoseconds) -> double
+{
+    return static_cast<double>(nanoseconds) / 1e3;
+}
+
+}  // namespace
+
+auto Trace::getInstance() -> Trace&
+{
+    static Trace instance;
+    return instance;
+}
+
+auto Trace::start(const std::string& path, std::chrono::microseconds minDuration) -> bool
+{
+    std::lock_guard<std::mutex> lock(fileMutex);
+    std::error_code error;
+    file = std::make_unique<llvm::raw_fd_ostream>(path, error, llvm::sys::fs::OF_None);
+    if (error)
+    {
+        llvm::errs() << "Error: Cannot create trace file " << path << ": " << error.message() << "\n";
+        file.reset();
+        return false;
+    }
+
+    *file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    firstEvent = true;
+    startTime = Clock::now();
+    minDurationNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(minDuration).count();
+    enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+auto Trace::finish() -> bool
+{
+    if (!isEnabled())
+        return true;
+
+    write(getThreadEvents());
+    enabled.store(false, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+    *file << "\n]}\n";
+    file->close();
+    bool written = !file->has_error();
+    if (!written)
+    {
+        llvm::errs() << "Error: Writing the trace file failed: " << file->error().message() << "\n";
+        file->clear_error();
+    }
+    file.reset();
+    return written;
+}
+
+void Trace::addSpan(const char* name,
+                    const char* category,
+                    Clock::time_point begin,
+                    Clock::time_point end,
+                    std::string detail)
+{
+    if (!isEnabled())
+        return;
+
+    int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    if (duration < minDurationNanoseconds && detail.empty())
+        return;
+
+    auto& threadEvents = getThreadEvents();
+    threadEvents.events.push_back(
+        {name,
+         category,
+         std::chrono::duration_cast<std::chrono::nanoseconds>(begin - startTime).count(),
+         duration,
+         std::move(detail)});
+    if (threadEvents.events.size() >= BUFFERED_EVENTS)
+        write(threadEvents);
+}
+
+void Trace::setThreadName(const std::string& name)
+{
+    if (!isEnabled())
+        return;
+
+    uint32_t thread = getThreadEvents().thread;
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (!file)
+        return;
+
+    *file << (firstEvent ? "" : ",\n");
+    firstEvent = false;
+    llvm::json::OStream json(*file);
+    json.object(
+        [&]
+        {
+            json.attribute("name", "thread_name");
+            json.attribute("ph", "M");
+            json.attribute("pid", 1);
+            json.attribute("tid", static_cast<int64_t>(thread));
+            json.attributeObject("args", [&] { json.attribute("name", name); });
+        });
+}
+
+auto Trace::getThreadEvents() -> ThreadEvents&
+{
+    thread_local ThreadEvents threadEvents;
+    if (threadEvents.thread == 0)
+    {
+        threadEvents.thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+        threadEvents.events.reserve(BUFFERED_EVENTS);
+    }
+    return threadEvents;
+}
+
+void Trace::write(ThreadEvents& threadEvents)
+{
+    if (threadEvents.events.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (file)
+    {
+        for (const auto& event : threadEvents.events)
+        {
+            *file << (firstEvent ? "" : ",\n");
+            firstEvent = false;
+            llvm::json::OStream json(*file);
+            json.object(
+                [&]
+                {
+                    json.attribute("name", event.name);
+                    json.attribute("cat", event.category);
+                    json.attribute("ph", "X");
+                    json.attribute("ts", toMicroseconds(event.beginNanoseconds));
+                    json.attribute("dur", toMicroseconds(event.durationNanoseconds));
+                    json.attribute("pid", 1);
+                    json.attribute("tid", static_cast<int64_t>(threadEvents.thread));
+                    if (!event.detail.empty())
+                    {
+                        json.attributeObject("args",
+                                             [&]
+                                             {
+                                                 json.attribute("detail",
+                                                                llvm::json::isUTF8(event.detail)
+                                                                    ? event.detail
+                                                                    : llvm::json::fixUTF8(event.detail));
+                                             });
+                    }
+                });
+        }
+    }
+    threadEvents.events.clear();
+}
+
+Trace::ThreadEvents::~ThreadEvents()
+{
+    // Threads of the pipeline end before the trace does; whatever they buffered goes to the file now
+    Trace::getInstance().write(*this);
+}
@@ -0,0 +1,144 @@
+//===--- Trace.h - Timeline tracing in the Chrome trace format -----------===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang
+{
+
+/// Process-wide span recorder for --trace, written as a Chrome trace event file
+/// The file loads in Perfetto (ui.perfetto.dev) and chrome://tracing and shows one
+/// track per thread: translation units, the phases timed by PhaseTimer, batch
+/// executions and the waits between pipeline stages. Spans are collected per
+/// thread without locking and appended to the file in blocks. Spans shorter than
+/// the minimum duration are left out, which keeps a large run's file loadable while
+/// the stalls and flush spikes a timeline is for are always long enough to show.
+class Trace
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Get the singleton instance
+    static auto getInstance() -> Trace&;
+
+    /// Create the trace file and start recording
+    /// \param path Path of the trace file
+    /// \param minDuration Spans shorter than this are dropped, unless they carry a detail
+    /// \return False, after reporting the error, if the file cannot be created
+    auto start(const std::string& path, std::chrono::microseconds minDuration) -> bool;
+
+    /// Write the spans still buffered and close the file; later spans are dropped
+    /// Every thread that recorded spans must have finished or be the calling thread.
+    /// \return False if writing the file failed
+    auto finish() -> bool;
+
+    [[nodiscard]] auto isEnabled() const -> bool { return enabled.load(std::memory_order_relaxed); }
+
+    /// Record a finished span on the calling thread's track
+    /// \param name Span name; must outlive the trace, so it is normally a literal
+    /// \param category Span category, also a literal
+    /// \param begin Start of the span
+    /// \param end End of the span
+    /// \param detail Shown as the span's "detail" argument, e.g. a file name. Spans with a
+    ///               detail mark units of work and are kept whatever their duration.
+    void addSpan(const char* name,
+                 const char* category,
+                 Clock::time_point begin,
+                 Clock::time_point end,
+                 std::string detail = {});
+
+    /// Name the calling thread's track
+    void setThreadName(const std::string& name);
+
+private:
+    struct Event
+    {
+        const char* name;
+        const char* category;
+        int64_t beginNanoseconds;  // Since the trace started
+        int64_t durationNanoseconds;
+        std::string detail;
+    };
+
+    /// Spans of one thread not written yet, written when full and when the thread exits
+    struct ThreadEvents
+    {
+        uint32_t thread = 0;
+        std::vector<Event> events;
+
+        ~ThreadEvents();
+    };
+
+    Trace() = default;
+
+    /// The calling thread's buffer, numbering the thread on first use
+    auto getThreadEvents() -> ThreadEvents&;
+
+    /// Append events to the file and clear them
+    void write(ThreadEvents& events);
+
+    std::atomic<bool> enabled{false};
+    Clock::time_point startTime;
+    int64_t minDurationNanoseconds = 0;
+    std::atomic<uint32_t> nextThread{1};
+
+    std::mutex fileMutex;
+    std::unique_ptr<llvm::raw_fd_ostream> file;
+    bool firstEvent = true;
+};
+
+/// Records the time between construction and destruction as a span on the calling thread
+/// When tracing is disabled a span costs one relaxed load.
+class TraceSpan
+{
+public:
+    /// \param name Span name, a literal
+    /// \param category Span category, a literal
+    /// \param detail See Trace::addSpan()
+    explicit TraceSpan(const char* name, const char* category = "analysis", std::string detail = {})
+        : name(name), category(category), active(Trace::getInstance().isEnabled())
+    {
+        if (!active)
+            return;
+        this->detail = std::move(detail);
+        begin = Trace::Clock::now();
+    }
+
+    ~TraceSpan()
+    {
+        if (active)
+            Trace::getInstance().addSpan(name, category, begin, Trace::Clock::now(), std::move(detail));
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    auto operator=(const TraceSpan&) -> TraceSpan& = delete;
+    TraceSpan(TraceSpan&&) = delete;
+    auto operator=(TraceSpan&&) -> TraceSpan& = delete;
+
+private:
+    const char* name;
+    const char* category;
+    bool active;
+    std::string detail;
+    Trace::Clock::time_point begin;
+};
+
+}  // namespace clang
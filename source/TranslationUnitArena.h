@@ -0,0 +1,66 @@
+//===--- TranslationUnitArena.h - Memory released with a translation unit -===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "llvm/Support/Allocator.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace clang
+{
+
+/// Bump allocator for analysis state that lives exactly as long as one translation unit
+/// A KuzuDump builds its node processor and analyzers here instead of with one heap
+/// allocation each. Nothing is freed individually: reset() returns everything at
+/// once when the translation unit ends, keeping the first slab for the thread's next
+/// unit, so a steady run allocates no memory for this state at all. Objects created
+/// with create() must be destroyed, through Ptr, before reset().
+class TranslationUnitArena
+{
+public:
+    /// Destroys an arena object without freeing its memory, which reset() reclaims
+    template <typename T> struct Destroy
+    {
+        void operator()(T* object) const { object->~T(); }
+    };
+
+    template <typename T> using Ptr = std::unique_ptr<T, Destroy<T>>;
+
+    TranslationUnitArena() = default;
+
+    TranslationUnitArena(const TranslationUnitArena&) = delete;
+    auto operator=(const TranslationUnitArena&) -> TranslationUnitArena& = delete;
+
+    /// Get the calling thread's arena
+    static auto forThread() -> TranslationUnitArena&
+    {
+        thread_local TranslationUnitArena arena;
+        return arena;
+    }
+
+    /// Construct an object in the arena
+    template <typename T, typename... Args> auto create(Args&&... args) -> Ptr<T>
+    {
+        void* memory = allocator.Allocate(sizeof(T), alignof(T));
+        return Ptr<T>(new (memory) T(std::forward<Args>(args)...));
+    }
+
+    /// Return all memory but the first slab
+    void reset() { allocator.Reset(); }
+
+private:
+    // Slabs grow geometrically from LLVM's default, so every unit is served by a few of them
+    llvm::BumpPtrAllocator allocator;
+};
+
+}  // namespace clang
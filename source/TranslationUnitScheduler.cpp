@@ -0,0 +1,302 @@
+//===--- TranslationUnitScheduler.cpp - Cost and affinity based TU order --===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#include "TranslationUnitScheduler.h"
+
+#include "IncrementalIndex.h"
+
+// clang-format off
+#include <doctest/doctest.h>
+
+#include "NoWarningScope_Enter.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <algorithm>
+#include <numeric>
+#include <set>
+
+using namespace clang;
+
+TranslationUnitScheduler::TranslationUnitScheduler(std::string historyPath) : historyPath(std::move(historyPath))
+{
+    auto buffer = llvm::MemoryBuffer::getFile(this->historyPath);
+    if (!buffer)
+        return;
+
+    // One line per file: nanoseconds, affinity key and path, separated by tabs
+    llvm::SmallVector<llvm::StringRef, 0> lines;
+    (*buffer)->getBuffer().split(lines, '\n', -1, false);
+    for (llvm::StringRef line : lines)
+    {
+        auto [time, rest] = line.split('\t');
+        auto [key, path] = rest.split('\t');
+        HistoryEntry entry;
+        if (path.empty() || time.getAsInteger(10, entry.nanoseconds) || entry.nanoseconds <= 0)
+            continue;
+        entry.affinityKey = key.str();
+        history[path.str()] = std::move(entry);
+    }
+}
+
+void TranslationUnitScheduler::plan(const std::vector<std::string>& files, unsigned laneCount)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    paths.clear();
+    costs.clear();
+    lanes.assign(laneCount, {});
+    remainingCosts.assign(laneCount, 0);
+    outstanding.assign(laneCount, 0);
+    if (laneCount == 0)
+        return;
+
+    // Files without history are priced at the measured time per byte of the files with history
+    std::vector<uint64_t> sizes;
+    double measuredNanoseconds = 0;
+    double measuredBytes = 0;
+    for (const auto& file : files)
+    {
+        paths.push_back(IncrementalIndex::normalizePath(file));
+        uint64_t size = 0;
+        llvm::sys::fs::file_size(paths.back(), size);
+        sizes.push_back(std::max<uint64_t>(size, 1));
+
+        auto it = history.find(paths.back());
+        if (it != history.end())
+        {
+            measuredNanoseconds += static_cast<double>(it->second.nanoseconds);
+            measuredBytes += static_cast<double>(sizes.back());
+        }
+    }
+    double nanosecondsPerByte = measuredBytes > 0 ? measuredNanoseconds / measuredBytes : 1.0;
+
+    // Without history, files of one directory are the best guess at files sharing headers
+    std::map<std::string, std::vector<size_t>> groups;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        auto it = history.find(paths[i]);
+        if (it != history.end())
+        {
+            costs.push_back(static_cast<double>(it->second.nanoseconds));
+            groups[it->second.affinityKey].push_back(i);
+        }
+        else
+        {
+            costs.push_back(static_cast<double>(sizes[i]) * nanosecondsPerByte);
+            groups[llvm::sys::path::parent_path(paths[i]).str()].push_back(i);
+        }
+    }
+
+    std::vector<std::pair<double, std::vector<size_t>*>> orderedGroups;
+    for (auto& [key, members] : groups)
+    {
+        std::ranges::sort(members, [this](size_t a, size_t b) { return costs[a] > costs[b]; });
+        double total = 0;
+        for (size_t file : members)
+            total += costs[file];
+        orderedGroups.emplace_back(total, &members);
+    }
+    std::ranges::sort(orderedGroups, [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    // A group stays in one lane until that lane carries its share of the total, then spills to the
+    // least loaded lane, so affinity never costs more than one file's imbalance
+    double share = std::accumulate(costs.begin(), costs.end(), 0.0) / laneCount;
+    auto leastLoaded = [this]
+    { return static_cast<unsigned>(std::ranges::min_element(remainingCosts) - remainingCosts.begin()); };
+    for (const auto& [total, members] : orderedGroups)
+    {
+        unsigned lane = leastLoaded();
+        for (size_t file : *members)
+        {
+            if (remainingCosts[lane] >= share)
+                lane = leastLoaded();
+            lanes[lane].push_back(file);
+            remainingCosts[lane] += costs[file];
+        }
+    }
+
+    for (auto& lane : lanes)
+        std::ranges::sort(lane, [this](size_t a, size_t b) { return costs[a] > costs[b]; });
+}
+
+auto TranslationUnitScheduler::next() -> std::optional<Assignment>
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lanes.empty())
+        return std::nullopt;
+
+    // Feed the thread closest to running out of work; among equals, the one with the most left to do
+    unsigned lane = 0;
+    for (unsigned i = 1; i < lanes.size(); ++i)
+    {
+        if (outstanding[i] < outstanding[lane] ||
+            (outstanding[i] == outstanding[lane] && remainingCosts[i] > remainingCosts[lane]))
+            lane = i;
+    }
+
+    // A lane that ran dry steals the largest file of the lane with the most work left
+    unsigned source = lane;
+    if (lanes[lane].empty())
+    {
+        bool found = false;
+        for (unsigned i = 0; i < lanes.size(); ++i)
+        {
+            if (!lanes[i].empty() && (!found || remainingCosts[i] > remainingCosts[source]))
+            {
+                source = i;
+                found = true;
+            }
+        }
+        if (!found)
+            return std::nullopt;
+    }
+
+    size_t file = lanes[source].front();
+    lanes[source].pop_front();
+    remainingCosts[source] = lanes[source].empty() ? 0 : remainingCosts[source] - costs[file];
+    ++outstanding[lane];
+    return Assignment{lane, file};
+}
+
+void TranslationUnitScheduler::finish(unsigned lane)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    --outstanding[lane];
+}
+
+void TranslationUnitScheduler::record(size_t file, int64_t nanoseconds, std::string affinityKey)
+{
+    if (nanoseconds <= 0)
+        return;
+
+    // Averaging with the previous run keeps one noisy measurement from reordering everything
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry = history[paths[file]];
+    entry.nanoseconds = entry.nanoseconds > 0 ? (entry.nanoseconds + nanoseconds) / 2 : nanoseconds;
+    entry.affinityKey = std::move(affinityKey);
+}
+
+void TranslationUnitScheduler::save() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Write a sibling file and rename it, so a crash leaves the previous history intact
+    std::string temporaryPath = historyPath + ".tmp";
+    {
+        std::error_code error;
+        llvm::raw_fd_ostream os(temporaryPath, error, llvm::sys::fs::OF_Text);
+        if (error)
+        {
+            llvm::errs() << "Warning: cannot write schedule history " << temporaryPath << ": " << error.message()
+                         << "\n";
+            return;
+        }
+        for (const auto& [path, entry] : history)
+            os << entry.nanoseconds << '\t' << entry.affinityKey << '\t' << path << '\n';
+    }
+    if (auto error = llvm::sys::fs::rename(temporaryPath, historyPath))
+        llvm::errs() << "Warning: cannot replace schedule history " << historyPath << ": " << error.message() << "\n";
+}
+
+auto TranslationUnitScheduler::getAffinityKey(const SourceManager& sourceManager) -> std::string
+{
+    OptionalFileEntryRef mainFile = sourceManager.getFileEntryRefForID(sourceManager.getMainFileID());
+
+    OptionalFileEntryRef heaviest;
+    auto consider = [&](const SrcMgr::SLocEntry& entry)
+    {
+        if (!entry.isFile() || SrcMgr::isSystem(entry.getFile().getFileCharacteristic()))
+            return;
+        OptionalFileEntryRef file = entry.getFile().getContentCache().OrigEntry;
+        if (!file || (mainFile && *file == *mainFile))
+            return;
+        if (!heaviest || file->getSize() > heaviest->getSize())
+            heaviest = file;
+    };
+
+    // ASTs loaded from the AST cache keep their files in loaded entries
+    for (unsigned i = 0; i < sourceManager.local_sloc_entry_size(); ++i)
+        consider(sourceManager.getLocalSLocEntry(i));
+    for (unsigned i = 0; i < sourceManager.loaded_sloc_entry_size(); ++i)
+    {
+        bool invalid = false;
+        const auto& entry = sourceManager.getLoadedSLocEntry(i, &invalid);
+        if (!invalid)
+            consider(entry);
+    }
+
+    if (!heaviest)
+        return {};
+    llvm::StringRef name = heaviest->getFileEntry().tryGetRealPathName();
+    return IncrementalIndex::normalizePath(name.empty() ? heaviest->getName() : name);
+}
+
+TEST_CASE("TranslationUnitScheduler::plan")
+{
+    llvm::SmallString<128> directory;
+    REQUIRE(!llvm::sys::fs::createUniqueDirectory("dosatsu-schedule", directory));
+    auto pathOf = [&](llvm::StringRef name)
+    {
+        llvm::SmallString<128> path(directory);
+        llvm::sys::path::append(path, name);
+        return IncrementalIndex::normalizePath(path);
+    };
+
+    // One expensive file, and three cheap ones sharing a header
+    std::vector<std::string> files{pathOf("small1.cpp"), pathOf("big.cpp"), pathOf("small2.cpp"), pathOf("small3.cpp")};
+    std::string historyPath = pathOf("schedule.history");
+    {
+        std::error_code error;
+        llvm::raw_fd_ostream os(historyPath, error, llvm::sys::fs::OF_Text);
+        REQUIRE(!error);
+        os << "1000\tbig.h\t" << files[1] << "\n";
+        for (const std::string& file : {files[0], files[2], files[3]})
+            os << "100\tshared.h\t" << file << "\n";
+        os << "fast\tshared.h\t" << pathOf("bad1.cpp") << "\n";
+        os << "0\tshared.h\t" << pathOf("bad2.cpp") << "\n";
+    }
+
+    TranslationUnitScheduler scheduler(historyPath);
+    scheduler.plan(files, 2);
+
+    // The expensive file starts first, and the cheap ones stay together in the other lane
+    auto first = scheduler.next();
+    REQUIRE(first);
+    CHECK(first->file == 1);
+    auto second = scheduler.next();
+    auto third = scheduler.next();
+    REQUIRE(second);
+    REQUIRE(third);
+    CHECK(second->lane != first->lane);
+    CHECK(third->lane == second->lane);
+
+    // The first lane ran dry and steals the remaining cheap file
+    auto fourth = scheduler.next();
+    REQUIRE(fourth);
+    CHECK(fourth->lane == first->lane);
+    CHECK(std::set<size_t>{second->file, third->file, fourth->file} == std::set<size_t>{0, 2, 3});
+    CHECK_FALSE(scheduler.next());
+
+    // Measurements are averaged with the history, and unreadable history lines are dropped
+    scheduler.record(1, 10, "big.h");
+    scheduler.save();
+    auto saved = llvm::MemoryBuffer::getFile(historyPath);
+    REQUIRE(saved);
+    llvm::StringRef history = (*saved)->getBuffer();
+    CHECK(history.contains("505\tbig.h\t" + files[1] + "\n"));
+    CHECK(history.count('\n') == 4);
+
+    scheduler.plan(files, 0);
+    CHECK_FALSE(scheduler.next());
+
+    llvm::sys::fs::remove_directories(directory);
+}
@@ -0,0 +1,93 @@
+//===--- TranslationUnitScheduler.h - Cost and affinity based TU order ----===//
+//
+// Part of the Dosatsu project
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+// clang-format off
+#include "NoWarningScope_Enter.h"
+#include "clang/Basic/SourceManager.h"
+#include "NoWarningScope_Leave.h"
+// clang-format on
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang
+{
+
+/// Decides which extract thread indexes which translation unit, and in what order
+/// Every extract thread gets a lane of files. Files are spread over the lanes
+/// largest first, so a huge translation unit never starts last and sets the
+/// wall time. Files sharing their heaviest header are kept in one lane while the
+/// lane's share of the total cost allows, so the thread's header caches serve
+/// all of them. A lane that runs dry steals the largest file of the busiest one.
+/// Costs come from the measured times of earlier runs, which are stored in a
+/// history file next to the database; files without history are estimated from
+/// their size at the measured time per byte.
+class TranslationUnitScheduler
+{
+public:
+    /// A file handed to a lane
+    struct Assignment
+    {
+        unsigned lane;
+        size_t file;  // Index into the files passed to plan()
+    };
+
+    /// Constructor - reads the history, if there is one
+    /// \param historyPath Path of the history file
+    explicit TranslationUnitScheduler(std::string historyPath);
+
+    /// Distribute files over lanes
+    /// \param files Files to index
+    /// \param laneCount Number of extract threads
+    void plan(const std::vector<std::string>& files, unsigned laneCount);
+
+    /// Claim the next file to parse, for the lane with the fewest files claimed and not finished
+    /// \return The assignment, or nullopt once every file is claimed
+    auto next() -> std::optional<Assignment>;
+
+    /// Report that a lane is done with a file it claimed
+    void finish(unsigned lane);
+
+    /// Remember how long a file took, for the next run's plan
+    /// \param file Index into the files passed to plan()
+    /// \param nanoseconds Parse and extract time
+    /// \param affinityKey Heaviest header of the translation unit, see getAffinityKey()
+    void record(size_t file, int64_t nanoseconds, std::string affinityKey);
+
+    /// Write the history, keeping the entries of files that were not indexed in this run
+    void save() const;
+
+    /// Find the largest user header a translation unit read
+    /// System headers are left out; every translation unit reads them, so they do not tell groups apart.
+    /// \return Normalized path of the header, or empty if the translation unit read none
+    static auto getAffinityKey(const SourceManager& sourceManager) -> std::string;
+
+private:
+    struct HistoryEntry
+    {
+        int64_t nanoseconds = 0;
+        std::string affinityKey;
+    };
+
+    std::string historyPath;
+    std::map<std::string, HistoryEntry> history;  // Keyed by normalized path
+
+    std::vector<std::string> paths;  // Normalized paths of the planned files
+    std::vector<double> costs;
+    std::vector<std::deque<size_t>> lanes;  // Unclaimed files per lane, largest first
+    std::vector<double> remainingCosts;
+    std::vector<unsigned> outstanding;  // Claimed but not finished, per lane
+    mutable std::mutex mutex;
+};
+
+}  // namespace clang
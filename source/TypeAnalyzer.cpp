@@ -9,6 +9,7 @@
 #include "ASTNodeProcessor.h"
 #include "GlobalDatabaseManager.h"
 #include "KuzuDatabase.h"
+#include "Statistics.h"
 
 // clang-format off
 #include "NoWarningScope_Enter.h"
@@ -32,6 +33,7 @@ auto TypeAnalyzer::createTypeNodeAndRelation(int64_t declNodeId, clang::QualType
     if (!database.isInitialized() || qualType.isNull())
         return -1;
 
+    PhaseTimer timer(StatisticsPhase::TypeAnalysis);
     int64_t typeNodeId = createTypeNode(qualType);
     if (typeNodeId != -1)
         createTypeRelation(declNodeId, typeNodeId);
@@ -46,39 +48,28 @@ auto TypeAnalyzer::createTypeNode(clang::QualType qualType) -> int64_t
 
     try
     {
-        // Create node using node processor first
-        const Type* typePtr = qualType.getTypePtr();
-        if (typePtr == nullptr)
-            return -1;
-        int64_t typeNodeId = nodeProcessor.createASTNode(typePtr);
-        if (typeNodeId == -1)
-            return -1;
-
-        // Check if Type node already exists for this nodeId
+        // Types repeat far more often than they are new: a type whose row exists,
+        // in this translation unit or a reused earlier one, costs one probe and no printing
         auto& dbManager = GlobalDatabaseManager::getInstance();
-        if (dbManager.hasTypeNode(typeNodeId))
+        const void* key = qualType.getAsOpaquePtr();
+        const auto* record = dbManager.findNodeRecord(key);
+        if (record != nullptr && (record->writtenRows & TypeRow) != 0)
+            return record->nodeId;
+
+        // Printed once, for both the stable key and the row
+        std::string spelling = extractTypeName(qualType);
+        int64_t typeNodeId = nodeProcessor.createASTNode(qualType, spelling);
+        if (typeNodeId == -1 || !dbManager.markNodeRow(key, TypeRow))
             return typeNodeId;
 
-        std::string typeName = extractTypeName(qualType);
-        std::string typeCategory = extractTypeCategory(qualType);
-        std::string qualifiers = extractTypeQualifiers(qualType);
-        bool isBuiltIn = isBuiltInType(qualType);
-
-        // Escape strings for safe database storage
-        typeName = KuzuDatabase::escapeString(typeName);
-        typeCategory = KuzuDatabase::escapeString(typeCategory);
-
-        std::string query = "CREATE (t:Type {node_id: " + std::to_string(typeNodeId) + ", type_name: '" + typeName +
-                            "', canonical_type: '" + typeCategory +
-                            "', size_bytes: -1, is_const: " + (qualType.isConstQualified() ? "true" : "false") +
-                            ", is_volatile: " + (qualType.isVolatileQualified() ? "true" : "false") +
-                            ", is_builtin: " + (isBuiltIn ? "true" : "false") + "})";
-
-        // Use batched operation for performance optimization
-        database.addToBatch(query);
-
-        // Register that this Type node has been created
-        dbManager.registerTypeNode(typeNodeId);
+        database.addNodeToBatch("Type",
+                                {{"node_id", typeNodeId},
+                                 {"type_name", spelling},
+                                 {"canonical_type", extractTypeCategory(qualType)},
+                                 {"size_bytes", int64_t{-1}},
+                                 {"is_const", qualType.isConstQualified()},
+                                 {"is_volatile", qualType.isVolatileQualified()},
+                                 {"is_builtin", isBuiltInType(qualType)}});
 
         return typeNodeId;
     }
@@ -96,11 +87,9 @@ void TypeAnalyzer::createTypeRelation(int64_t declId, int64_t typeId)
 
     try
     {
-        std::string query = "MATCH (d:Declaration {node_id: " + std::to_string(declId) + "}), " +
-                            "(t:Type {node_id: " + std::to_string(typeId) + "}) " +
-                            "CREATE (d)-[:HAS_TYPE {type_role: 'primary'}]->(t)";
-
-        database.addToBatch(query);
+        std::map<std::string, std::string> properties;
+        properties["type_role"] = "primary";
+        database.addRelationshipToBatch(declId, typeId, "HAS_TYPE", properties);
     }
     catch (const std::exception& e)
     {